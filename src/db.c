@@ -55,6 +55,31 @@
 
 db_connection_t* g_pDB = NULL;
 
+// the importer writes from its own thread while the UI keeps querying, so all use of g_pDB goes through this
+static GStaticRecMutex g_DBMutex = G_STATIC_REC_MUTEX_INIT;
+
+void db_lock(void)
+{
+	g_static_rec_mutex_lock(&g_DBMutex);
+}
+
+void db_unlock(void)
+{
+	g_static_rec_mutex_unlock(&g_DBMutex);
+}
+
+// call at the start and end of any thread (other than the main one) that uses the database, so the client
+// library sets up and frees its per-thread state.  mysql_thread_init() does nothing if it's already been called.
+void db_thread_init(void)
+{
+	mysql_thread_init();
+}
+
+void db_thread_end(void)
+{
+	mysql_thread_end();
+}
+
 
 /******************************************************
 ** Init and deinit of database module
@@ -82,7 +107,7 @@ void db_init()
 		"--ft-stopword-file=''",	// non-existant stopword file. we don't want ANY stopwords (words that are ignored)
 
 		// Misc options
-		pszKeyBufferSize
+		pszKeyBufferSize,
 	};
 
  	if(mysql_server_init(G_N_ELEMENTS(apszServerOptions), apszServerOptions, NULL) != 0) {
@@ -103,6 +128,7 @@ gboolean db_query(const gchar* pszSQL, db_resultset_t** ppResultSet)
 	g_assert(pszSQL != NULL);
 	if(g_pDB == NULL) return FALSE;
 
+	db_lock();
 	gint nResult = mysql_query(g_pDB->pMySQLConnection, pszSQL);
 	if(nResult != MYSQL_RESULT_SUCCESS) {
 		gint nErrorNumber = mysql_errno(g_pDB->pMySQLConnection);
@@ -111,6 +137,7 @@ gboolean db_query(const gchar* pszSQL, db_resultset_t** ppResultSet)
 		if(nErrorNumber != MYSQL_ERROR_DUPLICATE_KEY) {
 			g_warning("db_query: %d:%s (SQL: %s)\n", mysql_errno(g_pDB->pMySQLConnection), mysql_error(g_pDB->pMySQLConnection), pszSQL);
 		}
+		db_unlock();
 		return FALSE;
 	}
 
@@ -118,6 +145,7 @@ gboolean db_query(const gchar* pszSQL, db_resultset_t** ppResultSet)
 	if(ppResultSet != NULL) {
 		*ppResultSet = (db_resultset_t*)MYSQL_GET_RESULT(g_pDB->pMySQLConnection);
 	}
+	db_unlock();
 	return TRUE;
 }
 
@@ -171,8 +199,13 @@ gboolean db_connect(const gchar* pzHost, const gchar* pzUserName, const gchar* p
 
 static gboolean db_is_connected(void)
 {
+	if(g_pDB == NULL) return FALSE;
+
 	// 'mysql_ping' will also attempt a re-connect if necessary
-	return (g_pDB != NULL && mysql_ping(g_pDB->pMySQLConnection) == MYSQL_RESULT_SUCCESS);
+	db_lock();
+	gboolean bConnected = (mysql_ping(g_pDB->pMySQLConnection) == MYSQL_RESULT_SUCCESS);
+	db_unlock();
+	return bConnected;
 }
 
 // gets a descriptive string about the connection.  (do not free it.)
@@ -198,7 +231,9 @@ gchar* db_make_escaped_string(const gchar* pszString)
 
 	gint nLength = (strlen(pszString)*2) + 1;
 	gchar* pszNew = g_malloc(nLength);
+	db_lock();
 	mysql_real_escape_string(g_pDB->pMySQLConnection, pszNew, pszString, strlen(pszString));
+	db_unlock();
 
 	return pszNew; 		
 }
@@ -217,12 +252,15 @@ static gboolean db_insert(const gchar* pszSQL, gint* pnReturnRowsInserted)
 	g_assert(pszSQL != NULL);
 	if(g_pDB == NULL) return FALSE;
 
+	db_lock();
 	if(mysql_query(g_pDB->pMySQLConnection, pszSQL) != MYSQL_RESULT_SUCCESS) {
 		//g_warning("db_query: %s (SQL: %s)\n", mysql_error(g_pDB->pMySQLConnection), pszSQL);
+		db_unlock();
 		return FALSE;
 	}
 
 	my_ulonglong uCount = mysql_affected_rows(g_pDB->pMySQLConnection);
+	db_unlock();
 	if(uCount > 0) {
 		if(pnReturnRowsInserted != NULL) {
 			*pnReturnRowsInserted = uCount;
@@ -273,6 +311,7 @@ gboolean db_insert_road(gint nLOD, gint nRoadNameID, gint nLayerType, gint nAddr
 			DB_ROADS_TABLENAME, nLOD, nRoadNameID, nLayerType, azCoordinateList);
 	}
 
+	db_lock();
 	mysql_query(g_pDB->pMySQLConnection, pszQuery);
 	g_free(pszQuery);
 
@@ -280,9 +319,208 @@ gboolean db_insert_road(gint nLOD, gint nRoadNameID, gint nLayerType, gint nAddr
 	if(pReturnID != NULL) {
 		*pReturnID = mysql_insert_id(g_pDB->pMySQLConnection);
 	}
+	db_unlock();
 	return TRUE;
 }
 
+//
+// Batched road inserts: one multi-row INSERT per batch instead of a round-trip per road
+//
+db_road_batch_t* db_road_batch_new(gint nLOD)
+{
+	db_road_batch_t* pNew = g_new0(db_road_batch_t, 1);
+	pNew->nLOD = nLOD;
+	pNew->pSQL = g_string_sized_new(DB_ROAD_BATCH_MAX_BYTES + COORD_LIST_MAX);
+	return pNew;
+}
+
+void db_road_batch_free(db_road_batch_t* pBatch)
+{
+	g_assert(pBatch != NULL);
+	g_assert(pBatch->nCount == 0);	// flush first
+	g_string_free(pBatch->pSQL, TRUE);
+	g_free(pBatch);
+}
+
+void db_road_batch_add(db_road_batch_t* pBatch, gint nRoadNameID, gint nLayerType, gint nAddressLeftStart, gint nAddressLeftEnd, gint nAddressRightStart, gint nAddressRightEnd, gint nCityLeftID, gint nCityRightID, const gchar* pszZIPCodeLeft, const gchar* pszZIPCodeRight, GArray* pPointsArray)
+{
+	g_assert(pBatch != NULL);
+	if(pPointsArray->len == 0) return; 	// skip 0-length
+
+	if(pBatch->nCount == 0) {
+		if(pBatch->nLOD == 0) {
+			g_string_printf(pBatch->pSQL,
+				"INSERT INTO %s%d (RoadNameID, TypeID, Coordinates"
+				", AddressLeftStart, AddressLeftEnd, AddressRightStart, AddressRightEnd"
+				", CityLeftID, CityRightID, ZIPCodeLeft, ZIPCodeRight) VALUES ",
+				DB_ROADS_TABLENAME, pBatch->nLOD);
+		}
+		else {
+			g_string_printf(pBatch->pSQL, "INSERT INTO %s%d (RoadNameID, TypeID, Coordinates) VALUES ",
+				DB_ROADS_TABLENAME, pBatch->nLOD);
+		}
+	}
+	else {
+		g_string_append_c(pBatch->pSQL, ',');
+	}
+
+	g_string_append_printf(pBatch->pSQL, "(%d,%d,GeometryFromText('LINESTRING(", nRoadNameID, nLayerType);
+	gint i;
+	for(i=0 ; i < pPointsArray->len ;i++) {
+		mappoint_t* pPoint = &g_array_index(pPointsArray, mappoint_t, i);
+
+		gchar azCoord1[20], azCoord2[20];
+		g_string_append_printf(pBatch->pSQL, (i > 0) ? ",%s %s" : "%s %s",
+			g_ascii_dtostr(azCoord1, 20, pPoint->fLatitude), g_ascii_dtostr(azCoord2, 20, pPoint->fLongitude));
+	}
+	g_string_append(pBatch->pSQL, ")')");
+
+	if(pBatch->nLOD == 0) {
+		g_string_append_printf(pBatch->pSQL, ",%d,%d,%d,%d,%d,%d,'%s','%s'",
+			nAddressLeftStart, nAddressLeftEnd, nAddressRightStart, nAddressRightEnd,
+			nCityLeftID, nCityRightID,
+			(pszZIPCodeLeft != NULL) ? pszZIPCodeLeft : "", (pszZIPCodeRight != NULL) ? pszZIPCodeRight : "");
+	}
+	g_string_append_c(pBatch->pSQL, ')');
+	pBatch->nCount++;
+}
+
+gboolean db_road_batch_is_full(db_road_batch_t* pBatch)
+{
+	return (pBatch->nCount >= DB_ROAD_BATCH_MAX_ROWS || pBatch->pSQL->len >= DB_ROAD_BATCH_MAX_BYTES);
+}
+
+gboolean db_road_batch_flush(db_road_batch_t* pBatch)
+{
+	g_assert(pBatch != NULL);
+	if(pBatch->nCount == 0) return TRUE;
+
+	gboolean bSuccess = db_query(pBatch->pSQL->str, NULL);
+
+	pBatch->nCount = 0;
+	g_string_truncate(pBatch->pSQL, 0);
+	return bSuccess;
+}
+
+//
+// Precomputed tiles: a blob of map objects per tile (see map_tileblob.c), stored as rows of chunks that are
+// joined in Seq order on load.  Appending is then just inserts (no growing a row in place), and no single
+// row or query comes near the server's max_allowed_packet however big the tile gets.
+//
+#define DB_TILE_APPEND_CHUNK_BYTES	(DB_ROAD_BATCH_MAX_BYTES / 2)	// escaping can double it
+
+// Appends pData to the tile's blob.
+gboolean db_tile_append(gint nLOD, gint32 nTileX, gint32 nTileY, const guint8* pData, gint nLength)
+{
+	g_assert(nLOD >= MAP_LEVEL_OF_DETAIL_BEST && nLOD <= MAP_LEVEL_OF_DETAIL_WORST);
+	if(g_pDB == NULL) return FALSE;
+
+	GString* pSQL = g_string_sized_new((DB_TILE_APPEND_CHUNK_BYTES * 2) + 200);
+	gchar* pszEscaped = g_malloc((DB_TILE_APPEND_CHUNK_BYTES * 2) + 1);
+
+	gboolean bSuccess = TRUE;
+	gint nOffset = 0;
+	while(nOffset < nLength && bSuccess) {
+		gint nChunk = min(nLength - nOffset, DB_TILE_APPEND_CHUNK_BYTES);
+
+		db_lock();
+		mysql_real_escape_string(g_pDB->pMySQLConnection, pszEscaped, (const gchar*)(pData + nOffset), nChunk);
+		g_string_printf(pSQL,
+			"INSERT INTO %s%d (TileX, TileY, Data) VALUES (%d,%d,'%s')",
+			DB_TILES_TABLENAME, nLOD, nTileX, nTileY, pszEscaped);
+		bSuccess = db_query(pSQL->str, NULL);
+		db_unlock();
+
+		nOffset += nChunk;
+	}
+	g_free(pszEscaped);
+	g_string_free(pSQL, TRUE);
+	return bSuccess;
+}
+
+// Fills pReturnData with the tile's blob.  Returns FALSE if there's nothing in it (or there's no TileChunk table).
+gboolean db_tile_load(gint nLOD, gint32 nTileX, gint32 nTileY, GByteArray* pReturnData)
+{
+	g_assert(nLOD >= MAP_LEVEL_OF_DETAIL_BEST && nLOD <= MAP_LEVEL_OF_DETAIL_WORST);
+	if(g_pDB == NULL) return FALSE;
+
+	gchar* pszSQL = g_strdup_printf("SELECT Data FROM %s%d WHERE TileX=%d AND TileY=%d ORDER BY Seq",
+		DB_TILES_TABLENAME, nLOD, nTileX, nTileY);
+
+	db_lock();
+	g_byte_array_set_size(pReturnData, 0);
+	if(mysql_query(g_pDB->pMySQLConnection, pszSQL) == MYSQL_RESULT_SUCCESS) {
+		MYSQL_RES* pResultSet = MYSQL_GET_RESULT(g_pDB->pMySQLConnection);
+		if(pResultSet != NULL) {
+			MYSQL_ROW aRow;
+			while((aRow = mysql_fetch_row(pResultSet)) != NULL) {
+				if(aRow[0] == NULL) continue;
+
+				// it's binary, so we need the real length
+				unsigned long* puLengths = mysql_fetch_lengths(pResultSet);
+				g_byte_array_append(pReturnData, (const guint8*)aRow[0], puLengths[0]);
+			}
+			mysql_free_result(pResultSet);
+		}
+	}
+	db_unlock();
+	g_free(pszSQL);
+	return (pReturnData->len > 0);
+}
+
+// Records that the importer covered this tile and found nothing in it, so the tile manager needn't
+// go looking in the Road tables.  Does nothing if the tile has a blob, or if any Road row touches
+// pRect (say from a DB imported before we had tiles), since then it isn't empty.
+gboolean db_tile_mark_empty(gint nLOD, gint32 nTileX, gint32 nTileY, const maprect_t* pRect)
+{
+	g_assert(nLOD >= MAP_LEVEL_OF_DETAIL_BEST && nLOD <= MAP_LEVEL_OF_DETAIL_WORST);
+	g_assert(pRect != NULL);
+
+	gchar azCoord1[20], azCoord2[20], azCoord3[20], azCoord4[20], azCoord5[20], azCoord6[20], azCoord7[20], azCoord8[20];
+	gchar* pszSQL = g_strdup_printf(
+		"INSERT IGNORE INTO %s%d (TileX, TileY)"	// IGNORE: overlapping imports mark the same tiles
+		" SELECT %d,%d FROM DUAL"
+		" WHERE NOT EXISTS (SELECT * FROM %s%d WHERE TileX=%d AND TileY=%d)"
+		" AND NOT EXISTS (SELECT * FROM %s%d WHERE MBRIntersects(GeomFromText('Polygon((%s %s,%s %s,%s %s,%s %s,%s %s))'), Coordinates))",
+		DB_EMPTY_TILES_TABLENAME, nLOD,
+		nTileX, nTileY,
+		DB_TILES_TABLENAME, nLOD, nTileX, nTileY,
+		DB_ROADS_TABLENAME, nLOD,
+		g_ascii_dtostr(azCoord1, 20, pRect->A.fLatitude), g_ascii_dtostr(azCoord2, 20, pRect->A.fLongitude),
+		g_ascii_dtostr(azCoord3, 20, pRect->A.fLatitude), g_ascii_dtostr(azCoord4, 20, pRect->B.fLongitude),
+		g_ascii_dtostr(azCoord5, 20, pRect->B.fLatitude), g_ascii_dtostr(azCoord6, 20, pRect->B.fLongitude),
+		g_ascii_dtostr(azCoord7, 20, pRect->B.fLatitude), g_ascii_dtostr(azCoord8, 20, pRect->A.fLongitude),
+		azCoord1, azCoord2);
+
+	gboolean bSuccess = db_query(pszSQL, NULL);
+	g_free(pszSQL);
+	return bSuccess;
+}
+
+// Returns TRUE if the importer marked this tile empty (see db_tile_mark_empty).
+gboolean db_tile_is_empty(gint nLOD, gint32 nTileX, gint32 nTileY)
+{
+	g_assert(nLOD >= MAP_LEVEL_OF_DETAIL_BEST && nLOD <= MAP_LEVEL_OF_DETAIL_WORST);
+	if(g_pDB == NULL) return FALSE;
+
+	gchar* pszSQL = g_strdup_printf("SELECT 1 FROM %s%d WHERE TileX=%d AND TileY=%d",
+		DB_EMPTY_TILES_TABLENAME, nLOD, nTileX, nTileY);
+
+	// NOTE: not db_query(), which would warn for every tile of a DB that has no TileEmpty table
+	db_lock();
+	gboolean bEmpty = FALSE;
+	if(mysql_query(g_pDB->pMySQLConnection, pszSQL) == MYSQL_RESULT_SUCCESS) {
+		MYSQL_RES* pResultSet = MYSQL_GET_RESULT(g_pDB->pMySQLConnection);
+		if(pResultSet != NULL) {
+			bEmpty = (mysql_fetch_row(pResultSet) != NULL);
+			mysql_free_result(pResultSet);
+		}
+	}
+	db_unlock();
+	g_free(pszSQL);
+	return bEmpty;
+}
+
 /******************************************************
 **
 ******************************************************/
@@ -321,6 +559,9 @@ gboolean db_insert_roadname(const gchar* pszName, gint nSuffixID, gint* pnReturn
 {
 	gint nRoadNameID = 0;
 
+	// hold the lock from the lookup to the insert ID, or two writers adding the same name both insert it
+	db_lock();
+
 	// Step 1. Insert into RoadName
 	if(db_roadname_get_id(pszName, nSuffixID, &nRoadNameID) == FALSE) {
 		gchar* pszSafeName = db_make_escaped_string(pszName);
@@ -332,6 +573,7 @@ gboolean db_insert_roadname(const gchar* pszName, gint nSuffixID, gint* pnReturn
 		}
 		g_free(pszSQL);
 	}
+	db_unlock();
 	
 	if(nRoadNameID != 0) {
 		if(pnReturnID != NULL) {
@@ -404,6 +646,9 @@ gboolean db_insert_city(const gchar* pszName, gint nStateID, gint* pnReturnCityI
 {
 	gint nCityID = 0;
 
+	// hold the lock from the lookup to the insert ID (see db_insert_roadname)
+	db_lock();
+
 	// Step 1. Insert into RoadName
 	if(db_city_get_id(pszName, nStateID, &nCityID) == FALSE) {
 		gchar* pszSafeName = db_make_escaped_string(pszName);
@@ -419,6 +664,7 @@ gboolean db_insert_city(const gchar* pszName, gint nStateID, gint* pnReturnCityI
 		// already exists, use the existing one.
 		*pnReturnCityID = nCityID;
 	}
+	db_unlock();
 	return TRUE;
 }
 
@@ -459,6 +705,9 @@ gboolean db_insert_state(const gchar* pszName, const gchar* pszCode, gint nCount
 {
 	gint nStateID = 0;
 
+	// hold the lock from the lookup to the insert ID (see db_insert_roadname)
+	db_lock();
+
 	// Step 1. Insert into RoadName
 	if(db_state_get_id(pszName, &nStateID) == FALSE) {
 		gchar* pszSafeName = db_make_escaped_string(pszName);
@@ -476,6 +725,7 @@ gboolean db_insert_state(const gchar* pszName, const gchar* pszCode, gint nCount
 		// already exists, use the existing one.
 		*pnReturnStateID = nStateID;
 	}
+	db_unlock();
 	return TRUE;
 }
 
@@ -591,6 +841,30 @@ void db_create_tables()
 		" Coordinates point NOT NULL,"
 		" SPATIAL KEY (Coordinates));", NULL);
 
+	// TileChunk: the Road tables again, bucketed by tile (see map_tileblob.c).  A tile's blob is its rows joined in Seq order.
+	gint nLOD;
+	for(nLOD = MAP_LEVEL_OF_DETAIL_BEST ; nLOD <= MAP_LEVEL_OF_DETAIL_WORST ; nLOD++) {
+		gchar* pszSQL = g_strdup_printf(
+			"CREATE TABLE IF NOT EXISTS %s%d("
+			" Seq INT4 UNSIGNED NOT NULL AUTO_INCREMENT,"
+			" TileX INT4 NOT NULL,"
+			" TileY INT4 NOT NULL,"
+			" Data MEDIUMBLOB NOT NULL,"
+			" PRIMARY KEY (Seq),"
+			" KEY (TileX, TileY));", DB_TILES_TABLENAME, nLOD);
+		db_query(pszSQL, NULL);
+		g_free(pszSQL);
+
+		// TileEmpty: tiles the importer covered and found nothing in (see db_tile_mark_empty)
+		pszSQL = g_strdup_printf(
+			"CREATE TABLE IF NOT EXISTS %s%d("
+			" TileX INT4 NOT NULL,"
+			" TileY INT4 NOT NULL,"
+			" PRIMARY KEY (TileX, TileY));", DB_EMPTY_TILES_TABLENAME, nLOD);
+		db_query(pszSQL, NULL);
+		g_free(pszSQL);
+	}
+
 	// RoadName
 	db_query(
 		"CREATE TABLE IF NOT EXISTS RoadName("
@@ -39,6 +39,8 @@ typedef MYSQL_ROW db_row_t;
 
 #define DB_ROADS_TABLENAME 		("Road")
 #define DB_FEATURES_TABLENAME	("Feature")
+#define DB_TILES_TABLENAME		("TileChunk")
+#define DB_EMPTY_TILES_TABLENAME	("TileEmpty")
 
 #include "map.h"
 
@@ -46,6 +48,8 @@ void db_create_tables(void);
 
 void db_init(void);
 void db_deinit(void);
+void db_thread_init(void);
+void db_thread_end(void);
 
 // connect
 gboolean db_connect(const gchar* pzHost, const gchar* pzUserName, const gchar* pzPassword, const gchar* pzDatabase);
@@ -82,6 +86,29 @@ void db_disable_keys(void);
 
 gboolean db_insert_city(const gchar* pszName, gint nStateID, gint* pnReturnCityID);
 gboolean db_insert_road(gint nLOD, gint nRoadNameID, gint nLayerType, gint nAddressLeftStart, gint nAddressLeftEnd, gint nAddressRightStart, gint nAddressRightEnd, gint nCityLeftID, gint nCityRightID, const gchar* pszZIPCodeLeft, const gchar* pszZIPCodeRight, GArray* pPointsArray, gint* pReturnID);
+
+// batched road inserts
+#define DB_ROAD_BATCH_MAX_ROWS		(500)
+#define DB_ROAD_BATCH_MAX_BYTES		(512*1024)	// stay well under the server's max_allowed_packet
+
+typedef struct db_road_batch {
+	gint nLOD;
+	gint nCount;		// rows waiting in pSQL
+	GString* pSQL;
+} db_road_batch_t;
+
+db_road_batch_t* db_road_batch_new(gint nLOD);
+void db_road_batch_add(db_road_batch_t* pBatch, gint nRoadNameID, gint nLayerType, gint nAddressLeftStart, gint nAddressLeftEnd, gint nAddressRightStart, gint nAddressRightEnd, gint nCityLeftID, gint nCityRightID, const gchar* pszZIPCodeLeft, const gchar* pszZIPCodeRight, GArray* pPointsArray);
+gboolean db_road_batch_is_full(db_road_batch_t* pBatch);
+gboolean db_road_batch_flush(db_road_batch_t* pBatch);
+void db_road_batch_free(db_road_batch_t* pBatch);
+
+// precomputed tiles
+gboolean db_tile_append(gint nLOD, gint32 nTileX, gint32 nTileY, const guint8* pData, gint nLength);
+gboolean db_tile_load(gint nLOD, gint32 nTileX, gint32 nTileY, GByteArray* pReturnData);
+gboolean db_tile_mark_empty(gint nLOD, gint32 nTileX, gint32 nTileY, const maprect_t* pRect);
+gboolean db_tile_is_empty(gint nLOD, gint32 nTileX, gint32 nTileY);
+
 gboolean db_insert_state(const gchar* pszName, const gchar* pszCode, gint nCountryID, gint* pnReturnStateID);
 
 gboolean db_city_get_id(const gchar* pszName, gint nStateID, gint* pnReturnID);
@@ -43,49 +43,55 @@ static void import_progress_pulse(void)
 }
 #endif /* ROADSTER_DEAD_CODE */
 
+// Import a single county, running all stages on the calling (main) thread
+static gboolean import_from_tiger_uri(const gchar* pszURI, gint nTigerSetNumber)
+{
+	import_tiger_prepare();
+
+	tiger_import_process_t* pImportProcess = import_tiger_process_new(pszURI, nTigerSetNumber);
+	import_tiger_process_set_pulse_function(pImportProcess, importwindow_progress_pulse);
+
+	importwindow_progress_pulse();
+
+	gboolean bSuccess = import_tiger_process_fetch(pImportProcess);
+	if(bSuccess) {
+		importwindow_log_append(".");
+		bSuccess = import_tiger_process_parse(pImportProcess);
+	}
+	if(bSuccess) {
+		importwindow_log_append(".");
+		bSuccess = import_tiger_process_write(pImportProcess);
+	}
+	g_print("success = %d\n", bSuccess?1:0);
+
+	import_tiger_process_free(pImportProcess);
+	return bSuccess;
+}
+
 gboolean import_from_uri(const gchar* pszURI)
 {
-#ifdef USE_GNOME_VFS
 	gboolean bResult = FALSE;
 
 	importwindow_show();
-	GnomeVFSFileInfo *info = gnome_vfs_file_info_new();
-	if(GNOME_VFS_OK != gnome_vfs_get_file_info(pszURI, info, GNOME_VFS_FILE_INFO_DEFAULT)) {
+
+	// just assume it's a TIGER file for now since it's all we support
+	gint nTigerSetNumber;
+	if(!import_tiger_get_set_number(pszURI, &nTigerSetNumber)) {
 		importwindow_log_append("Couldn't read %s\n", pszURI);
 		return FALSE;
 	}
 
-//	func_progress_callback(0.0, pCallbackData);
-
-	gchar* pszFileBaseName = info->name;
-	g_return_val_if_fail(pszFileBaseName != NULL, FALSE);
-	// does it look like a tgr file name (tgr00000.zip) ?
-	if(strlen(pszFileBaseName) == 12 && g_str_has_prefix(pszFileBaseName, "TGR") && g_str_has_suffix(pszFileBaseName, ".ZIP")) {
-		importwindow_log_append("Importing TIGER file %s", pszFileBaseName);	// NOTE: no "\n" so we can add ...
-		gchar buf[6];
-		memcpy(buf, &pszFileBaseName[3], 5);
-		buf[5] = '\0';
-
-		gint nTigerSetNumber = atoi(buf);
-		// just assume it's a TIGER file for now since it's all we support
-
-		//	db_disable_keys();
-		bResult = import_tiger_from_uri(pszURI, nTigerSetNumber);
-		//	db_enable_keys();
-
-		if(bResult) {
-			importwindow_log_append("success.\n\n");
-		}
-		else {
-			importwindow_log_append("\n** Failed.\n\n");
-		}
-	}
-//	g_free(pszFileBaseName);
+	importwindow_log_append("Importing TIGER file TGR%05d.ZIP", nTigerSetNumber);	// NOTE: no "\n" so we can add ...
 
-	// free file info
-	gnome_vfs_file_info_unref(info);
+	//	db_disable_keys();
+	bResult = import_from_tiger_uri(pszURI, nTigerSetNumber);
+	//	db_enable_keys();
 
-//	func_progress_callback(1.0, pCallbackData);
+	if(bResult) {
+		importwindow_log_append("success.\n\n");
+	}
+	else {
+		importwindow_log_append("\n** Failed.\n\n");
+	}
 	return bResult;
-#endif
 }
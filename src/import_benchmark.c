@@ -0,0 +1,243 @@
+/***************************************************************************
+ *            import_benchmark.c
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+Purpose of import_benchmark.c:
+ - import-benchmark: import the same TIGER counties the same way every time, and report where the time went
+ - Wall time, CPU time and peak RSS for each stage (see import_stats.h), as tab-separated rows on stdout
+ - Runs the stages one after another on this thread (no scheduler), so each row is for one county alone
+ - Try it on tiger-generate's output for a dataset that doesn't change between runs
+ - With --self-test, run the importer's self-tests instead (see import_tiger_self_test); "make check" does this
+*/
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "main.h"
+#include "db.h"
+#include "import_stats.h"
+#include "import_tiger.h"
+
+#ifdef USE_GNOME_VFS
+#include <gnome-vfs-2.0/libgnomevfs/gnome-vfs.h>
+#endif
+
+#ifndef ENABLE_IMPORT_STATS
+#error "import-benchmark needs the importer built with ENABLE_IMPORT_STATS (see src/Makefile.am)"
+#endif
+
+#define EXIT_STATUS_SUCCESS			(0)
+#define EXIT_STATUS_IMPORT_FAILED	(1)
+#define EXIT_STATUS_USAGE			(2)
+#define EXIT_STATUS_SETUP_FAILED	(3)
+#define EXIT_STATUS_SELF_TEST_FAILED	(4)
+
+// options
+static gint g_nRuns = 1;
+static gint g_nThreads = 0;
+static gboolean g_bNoDB = FALSE;
+static gboolean g_bVerbose = FALSE;
+static gboolean g_bLockSharedVertices = FALSE;
+static gboolean g_bSelfTest = FALSE;
+
+static GOptionEntry g_aOptions[] = {
+	{"runs", 'n', 0, G_OPTION_ARG_INT, &g_nRuns, "Import everything this many times (default 1)", "N"},
+	{"threads", 't', 0, G_OPTION_ARG_INT, &g_nThreads, "Worker threads per county (default: one per CPU)", "N"},
+	{"no-db", 0, 0, G_OPTION_ARG_NONE, &g_bNoDB, "Stop after the parse stage; don't touch the database", NULL},
+	{"verbose", 'v', 0, G_OPTION_ARG_NONE, &g_bVerbose, "Show the importer's own messages (on stderr)", NULL},
+	{"lock-shared-vertices", 0, 0, G_OPTION_ARG_NONE, &g_bLockSharedVertices, "Keep the points where roads and polygon edges meet at every level of detail", NULL},
+	{"self-test", 0, 0, G_OPTION_ARG_NONE, &g_bSelfTest, "Run the importer's self-tests (no TIGER files or database needed) and exit", NULL},
+	{NULL}
+};
+
+// One of the fetch, parse and write stages as a whole, timed from outside (so the CPU time includes every thread)
+typedef struct import_benchmark_mark {
+	gdouble fWall;
+	gdouble fCPU;
+} import_benchmark_mark_t;
+
+static void import_benchmark_print_handler(const gchar* pszString)
+{
+	if(g_bVerbose) {
+		fputs(pszString, stderr);
+	}
+}
+
+static void import_benchmark_mark(import_benchmark_mark_t* pMark)
+{
+	pMark->fWall = import_stats_get_wall_seconds();
+	pMark->fCPU = import_stats_get_process_cpu_seconds();
+}
+
+static void import_benchmark_print_since(gint nRun, gint nTigerSetNumber, const gchar* pszStage, const import_benchmark_mark_t* pStart, gint64 nBytes)
+{
+	import_benchmark_mark_t now;
+	import_benchmark_mark(&now);
+	import_stats_print_row(stdout, nRun, nTigerSetNumber, pszStage, now.fWall - pStart->fWall, now.fCPU - pStart->fCPU, import_stats_get_max_rss_kb(), nBytes, "bytes");
+}
+
+// Import one county, printing a row for each stage.  Returns FALSE if any stage failed.
+static gboolean import_benchmark_county(gint nRun, const gchar* pszPath)
+{
+	gchar* pszAbsolutePath = g_path_is_absolute(pszPath) ? g_strdup(pszPath) : g_build_filename(g_get_current_dir(), pszPath, NULL);
+	gchar* pszURI = gnome_vfs_get_uri_from_local_path(pszAbsolutePath);
+
+	gint nTigerSetNumber;
+	struct stat info;
+	if(pszURI == NULL || !import_tiger_get_set_number(pszURI, &nTigerSetNumber) || g_stat(pszAbsolutePath, &info) != 0) {
+		fprintf(stderr, "%s: not a TIGER file (TGRnnnnn.ZIP): %s\n", g_get_prgname(), pszPath);
+		g_free(pszURI);
+		g_free(pszAbsolutePath);
+		return FALSE;
+	}
+	gint64 nBytes = info.st_size;
+
+	tiger_import_process_t* pProcess = import_tiger_process_new(pszURI, nTigerSetNumber);
+	if(g_nThreads > 0) import_tiger_process_set_thread_count(pProcess, g_nThreads);
+
+	import_benchmark_mark_t start, stage;
+	import_benchmark_mark(&start);
+
+	stage = start;
+	gboolean bSuccess = import_tiger_process_fetch(pProcess);
+	import_benchmark_print_since(nRun, nTigerSetNumber, "fetch", &stage, nBytes);
+
+	if(bSuccess) {
+		import_benchmark_mark(&stage);
+		bSuccess = import_tiger_process_parse(pProcess);
+		import_benchmark_print_since(nRun, nTigerSetNumber, "parse", &stage, nBytes);
+	}
+	if(bSuccess && !g_bNoDB) {
+		import_benchmark_mark(&stage);
+		bSuccess = import_tiger_process_write(pProcess);
+		import_benchmark_print_since(nRun, nTigerSetNumber, "write", &stage, nBytes);
+	}
+	import_benchmark_print_since(nRun, nTigerSetNumber, "total", &start, nBytes);
+
+	import_stats_print(stdout, nRun, nTigerSetNumber, import_tiger_process_get_stats(pProcess));
+	fflush(stdout);
+
+	import_tiger_process_free(pProcess);
+	g_free(pszURI);
+	g_free(pszAbsolutePath);
+
+	if(!bSuccess) {
+		fprintf(stderr, "%s: run %d: import of %s failed\n", g_get_prgname(), nRun, pszPath);
+	}
+	return bSuccess;
+}
+
+// Same settings as roadster itself
+static gboolean import_benchmark_connect(void)
+{
+	gchar* pszHost = NULL;
+	gchar* pszUser = NULL;
+	gchar* pszPassword = NULL;
+	gchar* pszDatabase = NULL;
+
+	gchar* pszConfigFile = g_strdup_printf("%s/.roadster/roadster.conf", g_get_home_dir());
+	GKeyFile* pKeyFile = g_key_file_new();
+	if(g_key_file_load_from_file(pKeyFile, pszConfigFile, G_KEY_FILE_NONE, NULL)) {
+		pszHost = g_key_file_get_string(pKeyFile, "mysql", "host", NULL);
+		pszUser = g_key_file_get_string(pKeyFile, "mysql", "user", NULL);
+		pszPassword = g_key_file_get_string(pKeyFile, "mysql", "password", NULL);
+		pszDatabase = g_key_file_get_string(pKeyFile, "mysql", "database", NULL);
+	}
+	g_key_file_free(pKeyFile);
+	g_free(pszConfigFile);
+
+	db_init();
+	gboolean bSuccess = db_connect(pszHost, pszUser, pszPassword, pszDatabase);
+	if(bSuccess) {
+		db_create_tables();
+	}
+	g_free(pszHost);
+	g_free(pszUser);
+	g_free(pszPassword);
+	g_free(pszDatabase);
+	return bSuccess;
+}
+
+int main(int argc, char* argv[])
+{
+	if(!g_thread_supported()) g_thread_init(NULL);
+	g_type_init();
+
+	GOptionContext* pContext = g_option_context_new("TGRnnnnn.ZIP... - time each stage of importing TIGER/Line counties");
+	g_option_context_add_main_entries(pContext, g_aOptions, NULL);
+	GError* pError = NULL;
+	if(!g_option_context_parse(pContext, &argc, &argv, &pError)) {
+		fprintf(stderr, "%s: %s\n", g_get_prgname(), pError->message);
+		g_error_free(pError);
+		return EXIT_STATUS_USAGE;
+	}
+	g_option_context_free(pContext);
+
+	if(g_bSelfTest) {
+		if(!import_tiger_self_test()) {
+			fprintf(stderr, "%s: self-test failed\n", g_get_prgname());
+			return EXIT_STATUS_SELF_TEST_FAILED;
+		}
+		fprintf(stdout, "self-test passed\n");
+		return EXIT_STATUS_SUCCESS;
+	}
+
+	if(argc < 2 || g_nRuns < 1 || g_nThreads < 0) {
+		fprintf(stderr, "usage: %s [OPTION...] TGRnnnnn.ZIP...  (see --help)\n", g_get_prgname());
+		return EXIT_STATUS_USAGE;
+	}
+
+	import_tiger_set_lock_shared_vertices(g_bLockSharedVertices);
+	g_set_print_handler(import_benchmark_print_handler);
+
+	if(!gnome_vfs_init()) {
+		fprintf(stderr, "%s: gnome_vfs_init failed\n", g_get_prgname());
+		return EXIT_STATUS_SETUP_FAILED;
+	}
+	if(!g_bNoDB && !import_benchmark_connect()) {
+		fprintf(stderr, "%s: couldn't connect to the database (try --no-db)\n", g_get_prgname());
+		return EXIT_STATUS_SETUP_FAILED;
+	}
+	import_tiger_prepare();
+
+	import_stats_print_header(stdout);
+
+	gint nFailed = 0;
+	gint nRun;
+	for(nRun=1 ; nRun<=g_nRuns ; nRun++) {
+		gint i;
+		for(i=1 ; i<argc ; i++) {
+			if(!import_benchmark_county(nRun, argv[i])) nFailed++;
+		}
+	}
+
+	if(!g_bNoDB) db_deinit();
+	gnome_vfs_shutdown();
+
+	return (nFailed == 0) ? EXIT_STATUS_SUCCESS : EXIT_STATUS_IMPORT_FAILED;
+}
@@ -0,0 +1,261 @@
+/***************************************************************************
+ *            import_scheduler.c
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+Purpose of import_scheduler.c:
+ - Import many counties at once, as a pipeline: while one county is being written
+   to the DB, the next is being parsed and the ones after that are being fetched
+ - Each stage (I/O, CPU, DB) has its own thread pool, so its concurrency is limited separately
+ - Report aggregate progress and an ETA to the (main thread) caller
+*/
+
+#include <glib.h>
+
+#include "main.h"
+#include "db.h"
+#include "import_scheduler.h"
+#include "import_tiger.h"
+
+#define SCHEDULER_POLL_INTERVAL_MSEC	(100)	// how often the progress callback is called while waiting
+
+// relative cost of each stage, used until every stage has been timed at least once
+static gdouble g_afDefaultStageWeights[IMPORT_NUM_STAGES] = {1.0, 3.0, 2.0};
+
+static gchar* g_apszStageNames[IMPORT_NUM_STAGES] = {"fetch", "parse", "write"};
+
+importscheduler_t* import_scheduler_new(gint nIOLimit, gint nCPULimit, gint nDBLimit)
+{
+	g_assert(nIOLimit > 0);
+	g_assert(nCPULimit > 0);
+	g_assert(nDBLimit > 0);
+
+	importscheduler_t* pNew = g_new0(importscheduler_t, 1);
+
+	pNew->anLimits[IMPORT_STAGE_FETCH] = nIOLimit;
+	pNew->anLimits[IMPORT_STAGE_PARSE] = nCPULimit;
+	pNew->anLimits[IMPORT_STAGE_WRITE] = nDBLimit;
+	pNew->nMaxInFlight = nIOLimit + nCPULimit + nDBLimit + 1;
+
+	pNew->pDoneQueue = g_async_queue_new();
+	pNew->pWaitingJobs = g_queue_new();
+	pNew->progress.fSecondsRemaining = -1.0;
+
+	// must happen here on the main thread, not in the stages
+	import_tiger_prepare();
+	return pNew;
+}
+
+void import_scheduler_add(importscheduler_t* pScheduler, const gchar* pszURI, gint nTigerSetNumber)
+{
+	g_assert(pScheduler != NULL);
+	g_assert(pszURI != NULL);
+
+	importjob_t* pJob = g_new0(importjob_t, 1);
+	pJob->pszURI = g_strdup(pszURI);
+	pJob->nTigerSetNumber = nTigerSetNumber;
+
+	g_queue_push_tail(pScheduler->pWaitingJobs, pJob);
+	pScheduler->progress.nTotal++;
+}
+
+static void import_scheduler_free_job(importjob_t* pJob)
+{
+	if(pJob->pImportProcess != NULL) import_tiger_process_free(pJob->pImportProcess);
+	g_free(pJob->pszURI);
+	g_free(pJob);
+}
+
+// NOTE: runs on a stage pool thread
+static void import_scheduler_stage_thread(gpointer pData, gpointer pUserData)
+{
+	importjob_t* pJob = (importjob_t*)pData;
+	importscheduler_t* pScheduler = (importscheduler_t*)pUserData;
+
+	// pool threads come and go, so set up (and free) the database client's per-thread state around each job
+	db_thread_init();
+	GTimer* pTimer = g_timer_new();
+	switch(pJob->eStage) {
+	case IMPORT_STAGE_FETCH:
+		pJob->bSuccess = import_tiger_process_fetch(pJob->pImportProcess);
+		break;
+	case IMPORT_STAGE_PARSE:
+		pJob->bSuccess = import_tiger_process_parse(pJob->pImportProcess);
+		break;
+	case IMPORT_STAGE_WRITE:
+		pJob->bSuccess = import_tiger_process_write(pJob->pImportProcess);
+		break;
+	default:
+		g_assert_not_reached();
+	}
+	pJob->afStageSeconds[pJob->eStage] = g_timer_elapsed(pTimer, NULL);
+	g_timer_destroy(pTimer);
+	db_thread_end();
+
+	g_async_queue_push(pScheduler->pDoneQueue, pJob);
+}
+
+static void import_scheduler_push_job(importscheduler_t* pScheduler, importjob_t* pJob, EImportStage eStage)
+{
+	pJob->eStage = eStage;
+	pScheduler->progress.anActive[eStage]++;
+	g_thread_pool_push(pScheduler->apPools[eStage], pJob, NULL);
+}
+
+static void import_scheduler_start_waiting_jobs(importscheduler_t* pScheduler)
+{
+	// counties that are started but not finished
+	gint nInFlight = pScheduler->progress.anActive[IMPORT_STAGE_FETCH] + pScheduler->progress.anActive[IMPORT_STAGE_PARSE] + pScheduler->progress.anActive[IMPORT_STAGE_WRITE];
+
+	while(nInFlight < pScheduler->nMaxInFlight && !g_queue_is_empty(pScheduler->pWaitingJobs)) {
+		importjob_t* pJob = g_queue_pop_head(pScheduler->pWaitingJobs);
+
+		// split the CPU between the counties allowed to parse at once
+		pJob->pImportProcess = import_tiger_process_new(pJob->pszURI, pJob->nTigerSetNumber);
+		import_tiger_process_set_thread_count(pJob->pImportProcess, import_tiger_get_thread_count() / pScheduler->anLimits[IMPORT_STAGE_PARSE]);
+
+		import_scheduler_push_job(pScheduler, pJob, IMPORT_STAGE_FETCH);
+		nInFlight++;
+	}
+}
+
+static void import_scheduler_update_progress(importscheduler_t* pScheduler)
+{
+	importscheduler_progress_t* pProgress = &(pScheduler->progress);
+
+	// weight stages by their measured average time once we have one for each
+	gdouble afWeights[IMPORT_NUM_STAGES];
+	gboolean bMeasured = TRUE;
+	gint i;
+	for(i=0 ; i<IMPORT_NUM_STAGES ; i++) {
+		if(pScheduler->anStageSamples[i] == 0) bMeasured = FALSE;
+		else afWeights[i] = pScheduler->afStageSecondsTotal[i] / pScheduler->anStageSamples[i];
+	}
+
+	gdouble fDone = 0.0;
+	gdouble fWeightPerCounty = 0.0;
+	for(i=0 ; i<IMPORT_NUM_STAGES ; i++) {
+		gdouble fWeight = bMeasured ? afWeights[i] : g_afDefaultStageWeights[i];
+		fDone += (fWeight * pScheduler->anStagesDone[i]);
+		fWeightPerCounty += fWeight;
+	}
+
+	pProgress->fElapsedSeconds = g_timer_elapsed(pScheduler->pTimer, NULL);
+	pProgress->fFraction = 0.0;
+	pProgress->fSecondsRemaining = -1.0;
+	if(pProgress->nTotal > 0 && fWeightPerCounty > 0.0) {
+		pProgress->fFraction = MIN(fDone / (fWeightPerCounty * pProgress->nTotal), 1.0);
+	}
+	if(pProgress->fFraction > 0.0) {
+		pProgress->fSecondsRemaining = pProgress->fElapsedSeconds * (1.0 - pProgress->fFraction) / pProgress->fFraction;
+	}
+}
+
+static void import_scheduler_stage_done(importscheduler_t* pScheduler, importjob_t* pJob, importscheduler_finished_callback_t pfnFinished, gpointer pUserData)
+{
+	EImportStage eStage = pJob->eStage;
+
+	pScheduler->progress.anActive[eStage]--;
+	pScheduler->anStagesDone[eStage]++;
+
+	g_print("TGR%05d: %s %s (%f)\n", pJob->nTigerSetNumber, g_apszStageNames[eStage], pJob->bSuccess ? "done" : "FAILED", pJob->afStageSeconds[eStage]);
+
+	if(pJob->bSuccess) {
+		pScheduler->afStageSecondsTotal[eStage] += pJob->afStageSeconds[eStage];
+		pScheduler->anStageSamples[eStage]++;
+
+		// on to the next stage
+		if(eStage + 1 < IMPORT_NUM_STAGES) {
+			import_scheduler_push_job(pScheduler, pJob, eStage + 1);
+			return;
+		}
+	}
+	else {
+		// a failed county skips its remaining stages, which count as done for progress
+		gint i;
+		for(i=eStage+1 ; i<IMPORT_NUM_STAGES ; i++) {
+			pScheduler->anStagesDone[i]++;
+		}
+		pScheduler->progress.nFailed++;
+	}
+	pScheduler->progress.nFinished++;
+
+	if(pfnFinished) pfnFinished(pJob->pszURI, pJob->nTigerSetNumber, pJob->bSuccess, pUserData);
+	import_scheduler_free_job(pJob);
+
+	// room for another
+	import_scheduler_start_waiting_jobs(pScheduler);
+}
+
+// Import everything that's been added.  Returns when all counties are finished.
+// NOTE: call from the main thread.  The callbacks are also called on the main thread.
+void import_scheduler_run(importscheduler_t* pScheduler, importscheduler_progress_callback_t pfnProgress, importscheduler_finished_callback_t pfnFinished, gpointer pUserData)
+{
+	g_assert(pScheduler != NULL);
+	g_assert(pScheduler->pTimer == NULL);	// only run once
+
+	gint i;
+	for(i=0 ; i<IMPORT_NUM_STAGES ; i++) {
+		pScheduler->apPools[i] = g_thread_pool_new(import_scheduler_stage_thread, pScheduler, pScheduler->anLimits[i], FALSE, NULL);
+	}
+	pScheduler->pTimer = g_timer_new();
+
+	g_print("importing %d counties (limits: %d fetch, %d parse, %d write)\n", pScheduler->progress.nTotal,
+		pScheduler->anLimits[IMPORT_STAGE_FETCH], pScheduler->anLimits[IMPORT_STAGE_PARSE], pScheduler->anLimits[IMPORT_STAGE_WRITE]);
+
+	import_scheduler_start_waiting_jobs(pScheduler);
+
+	while(pScheduler->progress.nFinished < pScheduler->progress.nTotal) {
+		GTimeVal timeEnd;
+		g_get_current_time(&timeEnd);
+		g_time_val_add(&timeEnd, SCHEDULER_POLL_INTERVAL_MSEC * 1000);
+
+		importjob_t* pJob = g_async_queue_timed_pop(pScheduler->pDoneQueue, &timeEnd);
+		if(pJob != NULL) {
+			import_scheduler_stage_done(pScheduler, pJob, pfnFinished, pUserData);
+		}
+
+		import_scheduler_update_progress(pScheduler);
+		if(pfnProgress) pfnProgress(&(pScheduler->progress), pUserData);
+	}
+
+	import_scheduler_update_progress(pScheduler);
+	g_print("imported %d counties (%d failed) in %f seconds\n", pScheduler->progress.nTotal, pScheduler->progress.nFailed, pScheduler->progress.fElapsedSeconds);
+}
+
+void import_scheduler_free(importscheduler_t* pScheduler)
+{
+	g_assert(pScheduler != NULL);
+
+	gint i;
+	for(i=0 ; i<IMPORT_NUM_STAGES ; i++) {
+		if(pScheduler->apPools[i] != NULL) g_thread_pool_free(pScheduler->apPools[i], FALSE, TRUE);
+	}
+	// anything never run
+	while(!g_queue_is_empty(pScheduler->pWaitingJobs)) {
+		import_scheduler_free_job(g_queue_pop_head(pScheduler->pWaitingJobs));
+	}
+	g_queue_free(pScheduler->pWaitingJobs);
+	g_async_queue_unref(pScheduler->pDoneQueue);
+	if(pScheduler->pTimer != NULL) g_timer_destroy(pScheduler->pTimer);
+	g_free(pScheduler);
+}
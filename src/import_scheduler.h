@@ -0,0 +1,88 @@
+/***************************************************************************
+ *            import_scheduler.h
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _IMPORT_SCHEDULER_H_
+#define _IMPORT_SCHEDULER_H_
+
+#include <glib.h>
+#include "import_tiger.h"
+
+// Default number of counties allowed in each stage at once
+#define IMPORT_SCHEDULER_DEFAULT_IO_LIMIT		(2)
+#define IMPORT_SCHEDULER_DEFAULT_CPU_LIMIT		(2)
+#define IMPORT_SCHEDULER_DEFAULT_DB_LIMIT		(1)		// there's only one DB connection, so more just queue on its lock
+
+typedef enum {
+	IMPORT_STAGE_FETCH,		// I/O: read the archive
+	IMPORT_STAGE_PARSE,		// CPU: decompress, parse, stitch and simplify
+	IMPORT_STAGE_WRITE,		// DB: insert
+	IMPORT_NUM_STAGES
+} EImportStage;
+
+typedef struct importscheduler_progress {
+	gint nTotal;
+	gint nFinished;					// includes failures
+	gint nFailed;
+	gint anActive[IMPORT_NUM_STAGES];	// counties queued or running in each stage
+
+	gdouble fFraction;				// 0.0 to 1.0
+	gdouble fElapsedSeconds;
+	gdouble fSecondsRemaining;		// -1 until there's enough to go on
+} importscheduler_progress_t;
+
+typedef void (*importscheduler_progress_callback_t)(const importscheduler_progress_t* pProgress, gpointer pUserData);
+typedef void (*importscheduler_finished_callback_t)(const gchar* pszURI, gint nTigerSetNumber, gboolean bSuccess, gpointer pUserData);
+
+typedef struct importjob {
+	gchar* pszURI;
+	gint nTigerSetNumber;
+	tiger_import_process_t* pImportProcess;
+
+	EImportStage eStage;			// stage being run (or just finished)
+	gboolean bSuccess;
+	gdouble afStageSeconds[IMPORT_NUM_STAGES];
+} importjob_t;
+
+typedef struct importscheduler {
+	gint anLimits[IMPORT_NUM_STAGES];
+	GThreadPool* apPools[IMPORT_NUM_STAGES];
+	GAsyncQueue* pDoneQueue;		// jobs come back here after each stage
+
+	GQueue* pWaitingJobs;			// not started yet
+	gint nMaxInFlight;				// bounds how many counties are held in memory at once
+
+	// measured stage times, for weighting progress
+	gdouble afStageSecondsTotal[IMPORT_NUM_STAGES];
+	gint anStageSamples[IMPORT_NUM_STAGES];
+	gint anStagesDone[IMPORT_NUM_STAGES];
+
+	importscheduler_progress_t progress;
+	GTimer* pTimer;
+} importscheduler_t;
+
+importscheduler_t* import_scheduler_new(gint nIOLimit, gint nCPULimit, gint nDBLimit);
+void import_scheduler_add(importscheduler_t* pScheduler, const gchar* pszURI, gint nTigerSetNumber);
+void import_scheduler_run(importscheduler_t* pScheduler, importscheduler_progress_callback_t pfnProgress, importscheduler_finished_callback_t pfnFinished, gpointer pUserData);
+void import_scheduler_free(importscheduler_t* pScheduler);
+
+#endif
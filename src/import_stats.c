@@ -0,0 +1,145 @@
+/***************************************************************************
+ *            import_stats.c
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+Purpose of import_stats.c:
+ - Wall time, CPU time and peak RSS for each stage of a TIGER import (see import-benchmark)
+ - Tab-separated output, one row per stage, so runs can be compared with the usual tools
+*/
+
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <glib.h>
+
+#include "import_stats.h"
+
+static const gchar* g_apszStageNames[IMPORTSTATS_NUM_STAGES] = {
+	"read", "decompress", "parse_met", "parse_rt1", "parse_rt2", "parse_rt7", "parse_rt8", "parse_rtc", "parse_rti",
+	"polygons", "chains", "simplify_lod0", "simplify_lod1", "simplify_lod2", "simplify_lod3", "cities", "db_write"
+};
+
+static const gchar* g_apszStageUnits[IMPORTSTATS_NUM_STAGES] = {
+	"bytes", "bytes", "files", "records", "records", "records", "records", "records", "records",
+	"polygons", "chains", "lines", "lines", "lines", "lines", "cities", "rows"
+};
+
+gdouble import_stats_get_wall_seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + (now.tv_nsec / 1000000000.0);
+}
+
+static gdouble import_stats_get_thread_cpu_seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return now.tv_sec + (now.tv_nsec / 1000000000.0);
+}
+
+// user + system, all threads
+gdouble import_stats_get_process_cpu_seconds(void)
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + ((usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0);
+}
+
+// NOTE: a high-water mark for the whole process; it never goes down
+glong import_stats_get_max_rss_kb(void)
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+void import_stats_timer_start(importstats_timer_t* pTimer)
+{
+	pTimer->fWallStart = import_stats_get_wall_seconds();
+	pTimer->fCPUStart = import_stats_get_thread_cpu_seconds();
+}
+
+// Add the time since import_stats_timer_start() to a stage.  Must be called on the thread that started the timer.
+void import_stats_timer_stop(importstats_timer_t* pTimer, importstats_t* pStats, EImportStatsStage eStage, gint64 nItems)
+{
+	g_assert(eStage >= 0 && eStage < IMPORTSTATS_NUM_STAGES);
+
+	importstats_stage_t* pStage = &(pStats->aStages[eStage]);
+	pStage->fWallSeconds += import_stats_get_wall_seconds() - pTimer->fWallStart;
+	pStage->fCPUSeconds += import_stats_get_thread_cpu_seconds() - pTimer->fCPUStart;
+	pStage->nItems += nItems;
+}
+
+// Per-chain timers don't look at memory (it's another system call), so the importer samples it at the end of each stage
+void import_stats_sample_rss(importstats_t* pStats, EImportStatsStage eStage)
+{
+	g_assert(eStage >= 0 && eStage < IMPORTSTATS_NUM_STAGES);
+	pStats->aStages[eStage].nMaxRSSKB = MAX(pStats->aStages[eStage].nMaxRSSKB, import_stats_get_max_rss_kb());
+}
+
+// Add a worker's stats to the total
+void import_stats_merge(importstats_t* pTo, const importstats_t* pFrom)
+{
+	gint i;
+	for(i=0 ; i<IMPORTSTATS_NUM_STAGES ; i++) {
+		pTo->aStages[i].fWallSeconds += pFrom->aStages[i].fWallSeconds;
+		pTo->aStages[i].fCPUSeconds += pFrom->aStages[i].fCPUSeconds;
+		pTo->aStages[i].nMaxRSSKB = MAX(pTo->aStages[i].nMaxRSSKB, pFrom->aStages[i].nMaxRSSKB);
+		pTo->aStages[i].nItems += pFrom->aStages[i].nItems;
+	}
+}
+
+const gchar* import_stats_stage_name(EImportStatsStage eStage)
+{
+	g_assert(eStage >= 0 && eStage < IMPORTSTATS_NUM_STAGES);
+	return g_apszStageNames[eStage];
+}
+
+const gchar* import_stats_stage_unit(EImportStatsStage eStage)
+{
+	g_assert(eStage >= 0 && eStage < IMPORTSTATS_NUM_STAGES);
+	return g_apszStageUnits[eStage];
+}
+
+//
+// Output: one tab-separated row per stage, after a header row.  Columns are only ever added at the end.
+//
+void import_stats_print_header(FILE* pFile)
+{
+	fprintf(pFile, "run\tcounty\tstage\twall_s\tcpu_s\tmaxrss_kb\titems\tunit\n");
+}
+
+void import_stats_print_row(FILE* pFile, gint nRun, gint nTigerSetNumber, const gchar* pszStage, gdouble fWallSeconds, gdouble fCPUSeconds, glong nMaxRSSKB, gint64 nItems, const gchar* pszUnit)
+{
+	fprintf(pFile, "%d\t%05d\t%s\t%.6f\t%.6f\t%ld\t%" G_GINT64_FORMAT "\t%s\n", nRun, nTigerSetNumber, pszStage, fWallSeconds, fCPUSeconds, nMaxRSSKB, nItems, pszUnit);
+}
+
+void import_stats_print(FILE* pFile, gint nRun, gint nTigerSetNumber, const importstats_t* pStats)
+{
+	gint i;
+	for(i=0 ; i<IMPORTSTATS_NUM_STAGES ; i++) {
+		const importstats_stage_t* pStage = &(pStats->aStages[i]);
+		import_stats_print_row(pFile, nRun, nTigerSetNumber, g_apszStageNames[i], pStage->fWallSeconds, pStage->fCPUSeconds, pStage->nMaxRSSKB, pStage->nItems, g_apszStageUnits[i]);
+	}
+}
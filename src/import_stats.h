@@ -0,0 +1,99 @@
+/***************************************************************************
+ *            import_stats.h
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _IMPORT_STATS_H_
+#define _IMPORT_STATS_H_
+
+#include <stdio.h>
+#include <glib.h>
+
+// Where an import spends its time, for import-benchmark.  Stages that run on worker threads are summed over
+// the threads (busy time), so their wall times can add up to more than the import took.
+typedef enum {
+	IMPORTSTATS_STAGE_READ,				// read the archive (fetch stage)
+	IMPORTSTATS_STAGE_DECOMPRESS,		// inflate the members, on the parse stage's thread
+	IMPORTSTATS_STAGE_PARSE_MET,
+	IMPORTSTATS_STAGE_PARSE_RT1,			// parse jobs for each record type (in ETigerTable order), plus merging and sorting their tables
+	IMPORTSTATS_STAGE_PARSE_RT2,
+	IMPORTSTATS_STAGE_PARSE_RT7,
+	IMPORTSTATS_STAGE_PARSE_RT8,
+	IMPORTSTATS_STAGE_PARSE_RTc,
+	IMPORTSTATS_STAGE_PARSE_RTi,
+	IMPORTSTATS_STAGE_POLYGONS,			// stitching RTi rings (not simplifying them)
+	IMPORTSTATS_STAGE_CHAINS,			// joining RT1s and gathering their points (not simplifying them)
+	IMPORTSTATS_STAGE_SIMPLIFY_LOD0,		// lines and polygons
+	IMPORTSTATS_STAGE_SIMPLIFY_LOD1,
+	IMPORTSTATS_STAGE_SIMPLIFY_LOD2,
+	IMPORTSTATS_STAGE_SIMPLIFY_LOD3,
+	IMPORTSTATS_STAGE_CITIES,			// inserting RTc cities
+	IMPORTSTATS_STAGE_DB_WRITE,			// the writer thread
+	IMPORTSTATS_NUM_STAGES
+} EImportStatsStage;
+
+typedef struct importstats_stage {
+	gdouble fWallSeconds;
+	gdouble fCPUSeconds;
+	glong nMaxRSSKB;		// the process's peak RSS as of the end of the stage
+	gint64 nItems;			// see import_stats_stage_unit()
+} importstats_stage_t;
+
+typedef struct importstats {
+	importstats_stage_t aStages[IMPORTSTATS_NUM_STAGES];
+} importstats_t;
+
+typedef struct importstats_timer {
+	gdouble fWallStart;
+	gdouble fCPUStart;		// of the calling thread
+} importstats_timer_t;
+
+void import_stats_timer_start(importstats_timer_t* pTimer);
+void import_stats_timer_stop(importstats_timer_t* pTimer, importstats_t* pStats, EImportStatsStage eStage, gint64 nItems);
+void import_stats_sample_rss(importstats_t* pStats, EImportStatsStage eStage);
+void import_stats_merge(importstats_t* pTo, const importstats_t* pFrom);
+
+gdouble import_stats_get_wall_seconds(void);
+gdouble import_stats_get_process_cpu_seconds(void);
+glong import_stats_get_max_rss_kb(void);
+
+const gchar* import_stats_stage_name(EImportStatsStage eStage);
+const gchar* import_stats_stage_unit(EImportStatsStage eStage);
+
+void import_stats_print_header(FILE* pFile);
+void import_stats_print_row(FILE* pFile, gint nRun, gint nTigerSetNumber, const gchar* pszStage, gdouble fWallSeconds, gdouble fCPUSeconds, glong nMaxRSSKB, gint64 nItems, const gchar* pszUnit);
+void import_stats_print(FILE* pFile, gint nRun, gint nTigerSetNumber, const importstats_t* pStats);
+
+// The importer is timed only in builds with ENABLE_IMPORT_STATS (import-benchmark), since some of these
+// are taken for every chain.  Elsewhere they compile to nothing.
+#ifdef ENABLE_IMPORT_STATS
+#define IMPORTSTATS_BEGIN(name)							importstats_timer_t name; import_stats_timer_start(&name)
+#define IMPORTSTATS_END(name, pStats, eStage, nItems)	import_stats_timer_stop(&name, (pStats), (eStage), (nItems))
+#define IMPORTSTATS_SAMPLE_RSS(pStats, eStage)			import_stats_sample_rss((pStats), (eStage))
+#define IMPORTSTATS_MERGE(pTo, pFrom)					import_stats_merge((pTo), (pFrom))
+#else
+#define IMPORTSTATS_BEGIN(name)
+#define IMPORTSTATS_END(name, pStats, eStage, nItems)
+#define IMPORTSTATS_SAMPLE_RSS(pStats, eStage)
+#define IMPORTSTATS_MERGE(pTo, pFrom)
+#endif
+
+#endif
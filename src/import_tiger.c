@@ -24,7 +24,9 @@
 // See TGR2003.PDF page 208 for county list
 #include <stdlib.h>			// for strtod
 
+#include <math.h>
 #include <string.h>
+#include <unistd.h>			// for sysconf
 
 #include <glib.h>
 #include <gdk/gdk.h>
@@ -33,9 +35,10 @@
 #include "map_math.h"
 #include "util.h"
 #include "import_tiger.h"
-#include "importwindow.h"
+#include "import_writer.h"
 #include "road.h"
 #include "tiger.h"
+#include "zipreader.h"
 
 #ifdef USE_GNOME_VFS
 #include <gnome-vfs-2.0/libgnomevfs/gnome-vfs.h>
@@ -57,10 +60,14 @@
 
 //#define BUFFER_SIZE 						(10000)
 
-#define ROWS_PER_PULSE						(18000)		// call import_progress_pulse() after this many rows parsed
-#define CALLBACKS_PER_PULSE					(30)		// call " after this many iterations over hash tables (writing to DB)
+#define RT1_ROWS_PER_PARSE_CHUNK			(20000)		// RT1 and RT2 files are split into chunks of this many lines, parsed in parallel
+#define RT2_ROWS_PER_PARSE_CHUNK			(20000)
+#define PARSE_THREADS_MAX					(8)
+#define RT1_CHAINS_PER_SAVE_JOB				(2000)		// RT1 chains are assembled and simplified by worker threads in jobs of this size
+#define RT1_MERGE_MAX_CHAINS				(64)		// longest run of RT1s joined into one line above LOD 0 (keeps bounding boxes tight for tile queries)
+#define WRITER_MAX_QUEUED_ROADS				(4000)		// bound on simplified roads waiting for the DB writer thread
+#define JOB_PULSE_INTERVAL_MSEC				(100)		// how often the main thread pulses while waiting on worker threads
 
-gint g_nStateID = 0;		// this is set during import process
 
 typedef enum {
 	IMPORT_RECORD_OK,
@@ -97,17 +104,12 @@ typedef struct tiger_record_rt1
 typedef struct tiger_record_rt2
 {
 	gint nTLID;		// index- TLID links a complete chain together
+	gint nSequence;	// RTSQ, orders the RT2 records of a chain
 
-	GArray* pPointsArray;
+	gint nNumPoints;
+	mappoint_t aPoints[TIGER_RT2_MAX_POINTS];
 } tiger_record_rt2_t;
 
-void callback_free_rt2(gpointer p)
-{
-	tiger_record_rt2_t* pRT2 = (tiger_record_rt2_t*)p;
-	g_array_free(pRT2->pPointsArray, TRUE);
-	g_free(pRT2);
-}
-
 #define TIGER_LANDMARK_NAME_LEN (30)
 typedef struct tiger_record_rt7
 {
@@ -123,49 +125,154 @@ typedef struct tiger_record_rt8
 	gint nLANDID;		// FK to table 7
 } tiger_record_rt8_t;
 
-typedef struct tiger_rt1_link
+// Links one RT1 chain to one polygon.  Each RTi line gives one for its left polygon and one for its right.
+typedef struct tiger_record_rti
 {
+	gint nPOLYID;		// index (a polygon's links are all together once the table is sorted)
 	gint nTLID;
 	gint nPointATZID;	// the unique # for the rt1's PointA, usefull for stiching chains together
 	gint nPointBTZID;	// the unique # for the rt1's PointB
-} tiger_rt1_link_t;
-
-typedef struct tiger_record_rti
-{
-	// store a list of TLIDs for a polygonID
-	gint nPOLYID;	// index
-	GPtrArray* pRT1LinksArray;
 } tiger_record_rti_t;
 
-void callback_free_rti(gpointer p)
-{
-	tiger_record_rti_t* pRTi = (tiger_record_rti_t*)p;
-	g_ptr_array_free(pRTi->pRT1LinksArray, TRUE);	// XXX: double check that RTi doesn't own these?
-	g_free(pRTi);
-}
-
 #define TIGER_CITY_NAME_LEN 	(60)
 #define TIGER_FIPS55_LEN		(5)
 typedef struct tiger_record_rtc
 {
 	// store a list of city names
 	gint nFIPS55;	// index
-	char achName[TIGER_CITY_NAME_LEN + 1];	// note the +1!!
 	gint nCityID;					// a database ID, stored here after it is inserted
+	char achName[TIGER_CITY_NAME_LEN + 1];	// note the +1!!
 } tiger_record_rtc_t;
 
-typedef struct tiger_import_process {
+//
+// Record tables
+//
+// Records are stored by value, one array per record type (so no allocation per record), and sorted
+// by key so lookups are binary searches.  Each table is freed in one go.  Every record type starts
+// with its gint key, and the gint after it orders records that share a key (eg. RT2 sequence numbers).
+//
+typedef struct tiger_table {
+	GArray* pRecords;
+	gint nRecordSize;
+} tiger_table_t;
+
+#define tiger_table_length(pTable)		((gint)((pTable)->pRecords->len))
+#define tiger_table_index(pTable, i)	((gpointer)((pTable)->pRecords->data + ((gsize)(i) * (pTable)->nRecordSize)))
+#define tiger_table_key(pRecord)		(*(const gint*)(pRecord))
+
+static tiger_table_t* tiger_table_new(gint nRecordSize, gint nReserve)
+{
+	tiger_table_t* pNew = g_new0(tiger_table_t, 1);
+	pNew->pRecords = g_array_sized_new(FALSE, TRUE, nRecordSize, nReserve);	// TRUE = new records are zeroed
+	pNew->nRecordSize = nRecordSize;
+	return pNew;
+}
+
+static void tiger_table_free(tiger_table_t* pTable)
+{
+	g_array_free(pTable->pRecords, TRUE);
+	g_free(pTable);
+}
+
+// Returns a zeroed record at the end of the table.  NOTE: the pointer is only good until the next add.
+static gpointer tiger_table_add(tiger_table_t* pTable)
+{
+	g_array_set_size(pTable->pRecords, pTable->pRecords->len + 1);
+	return tiger_table_index(pTable, pTable->pRecords->len - 1);
+}
+
+static gint tiger_table_compare_records(gconstpointer a, gconstpointer b)
+{
+	const gint* pA = (const gint*)a;
+	const gint* pB = (const gint*)b;
+
+	if(pA[0] != pB[0]) return (pA[0] < pB[0]) ? -1 : 1;
+	if(pA[1] != pB[1]) return (pA[1] < pB[1]) ? -1 : 1;
+	return 0;
+}
+
+static void tiger_table_sort(tiger_table_t* pTable)
+{
+	g_array_sort(pTable->pRecords, tiger_table_compare_records);
+}
+
+// Index of the first record with key nKey, or -1.  The table must be sorted.
+static gint tiger_table_find(const tiger_table_t* pTable, gint nKey)
+{
+	gint nLow = 0;
+	gint nHigh = tiger_table_length(pTable);
+	while(nLow < nHigh) {
+		gint nMiddle = nLow + (nHigh - nLow) / 2;
+		if(tiger_table_key(tiger_table_index(pTable, nMiddle)) < nKey) nLow = nMiddle + 1;
+		else nHigh = nMiddle;
+	}
+	if(nLow < tiger_table_length(pTable) && tiger_table_key(tiger_table_index(pTable, nLow)) == nKey) {
+		return nLow;
+	}
+	return -1;
+}
+
+static gpointer tiger_table_lookup(const tiger_table_t* pTable, gint nKey)
+{
+	gint i = tiger_table_find(pTable, nKey);
+	return (i == -1) ? NULL : tiger_table_index(pTable, i);
+}
+
+// The TIGER files we read out of each county's ZIP
+typedef enum {
+	TIGER_FILE_MET,
+	TIGER_FILE_RT1,
+	TIGER_FILE_RT2,
+	TIGER_FILE_RT7,
+	TIGER_FILE_RT8,
+	TIGER_FILE_RTc,
+	TIGER_FILE_RTi,
+	TIGER_FILE_COUNT
+} ETigerFile;
+
+static gchar* g_apszTigerFileExtensions[TIGER_FILE_COUNT] = {"MET", "RT1", "RT2", "RT7", "RT8", "RTC", "RTI"};
+
+// Keep the points where chains meet when simplifying LODs 1-3, so roads stay connected and neighboring polygons
+// share their edges exactly (see map_math_simplify_pointstring_locked).  Costs some points at the coarse LODs.
+static gboolean g_bLockSharedVertices = FALSE;
+
+// A finished road waiting for the write stage, which fills in the CityIDs once the cities are inserted
+typedef struct tiger_pending_road {
+	import_road_t* pRoad;
+	tiger_record_rtc_t* pCityLeft;		// can be NULL
+	tiger_record_rtc_t* pCityRight;
+} tiger_pending_road_t;
+
+struct tiger_import_process {
+	gchar* pszURI;
+	gint nTigerSetNumber;
+	gint nStateID;					// a database ID, set by the write stage
+	gint nThreads;					// worker threads for this county's parse and simplify jobs
+	void (*pfnPulse)(void);			// called while waiting on worker threads (can be NULL)
+
+	// the compressed archive, read by the fetch stage.  The parse stage decompresses members
+	// from it a chunk at a time, then frees it.
+	gchar* pArchive;
+	gint nArchiveLength;
+	zipreader_t* pZip;
+
 	gchar* pszFileDescription;
 
-	GHashTable* pTableRT1;
-	GHashTable* pTableRT2;
-	GHashTable* pTableRT7;
-	GHashTable* pTableRT8;
-	GHashTable* pTableRTi;
-	GHashTable* pTableRTc;
+	tiger_table_t* pTableRT1;
+	tiger_table_t* pTableRT2;
+	tiger_table_t* pTableRT7;
+	tiger_table_t* pTableRT8;
+	tiger_table_t* pTableRTi;
+	tiger_table_t* pTableRTc;
+
+	GArray* pJunctionsArray;	// tiger_rt1_end_t, sorted: where 3 or more RT1s meet.  Only with g_bLockSharedVertices.
 
-	GPtrArray* pBoundaryRT1s;
-} tiger_import_process_t;
+	GArray* pRoadsArray;		// tiger_pending_road_t, built by the parse stage
+
+	importwriter_t* pWriter;	// all roads and polygons go to the DB through this
+
+	importstats_t Stats;		// only filled in with ENABLE_IMPORT_STATS (see import_stats.h)
+};
 
 // #define MAP_OBJECT_TYPE_NONE                    (0)
 // #define MAP_OBJECT_TYPE_MINORROAD               (1)
@@ -266,7 +373,18 @@ gdouble object_type_tolerance_at_lod(gint nRecordType, gint nLOD)
 //     }
 // }
 
-static gboolean import_tiger_read_lat(char* pBuffer, gdouble* pValue)
+//
+// Field decoders
+//
+// Every field is read where it sits in the decompressed line, with no copying.  Numbers are right-justified
+// and blank-padded.  Lat and lon are fixed point: a sign and millionths of a degree ("+42350000", "-071060000").
+//
+// For the canonical form they give exactly what the old copy-and-strtod() code did: both are the correctly
+// rounded double of n/1000000.  Anything else falls back to strtod().  Ints follow atoi() over the field.
+//
+
+// The old way.  Used for lat/lon fields that aren't in canonical form (and as the reference for the self test).
+static gboolean import_tiger_read_lat_strtod(const gchar* pBuffer, gdouble* pValue)
 {
 	// 0,1,2,3
 	// - 1 2 . 1 2 3 4 5 6
@@ -286,7 +404,7 @@ static gboolean import_tiger_read_lat(char* pBuffer, gdouble* pValue)
 	return TRUE;
 }
 
-static gboolean import_tiger_read_lon(char* pBuffer, gdouble* pValue)
+static gboolean import_tiger_read_lon_strtod(const gchar* pBuffer, gdouble* pValue)
 {
 	char buffer[12];
 	memcpy(&buffer[0], &pBuffer[0], 4);	// copy first 4 bytes (yes, this is different than lat, TIGER!!)
@@ -307,37 +425,117 @@ static gboolean import_tiger_read_lon(char* pBuffer, gdouble* pValue)
 	return TRUE;
 }
 
+// nDigits decimal digits as a number, or -1 if any of them isn't a digit.  No branches in the loop.
+static inline gint64 import_tiger_decode_digits(const gchar* p, gint nDigits)
+{
+	gint64 nValue = 0;
+	guint nNotDigits = 0;
+	gint i;
+	for(i=0 ; i<nDigits ; i++) {
+		guint nDigit = ((guchar)p[i]) - '0';
+		nNotDigits |= (nDigit > 9);
+		nValue = (nValue * 10) + nDigit;
+	}
+	return (nNotDigits == 0) ? nValue : -1;
+}
+
+static gboolean import_tiger_read_lat(const gchar* pBuffer, gdouble* pValue)
+{
+	gint64 nMicrodegrees = import_tiger_decode_digits(&pBuffer[1], 8);
+	if(nMicrodegrees < 0 || (pBuffer[0] != '+' && pBuffer[0] != '-')) {
+		return import_tiger_read_lat_strtod(pBuffer, pValue);
+	}
+
+	gdouble fVal = nMicrodegrees / 1000000.0;
+	*pValue = (pBuffer[0] == '-') ? -fVal : fVal;	// NOTE: "-00000000" is -0.0, as with strtod()
+	return TRUE;
+}
 
-static gboolean import_tiger_read_int(char* pBuffer, gint nLen, gint32* pValue)
+static gboolean import_tiger_read_lon(const gchar* pBuffer, gdouble* pValue)
+{
+	gint64 nMicrodegrees = import_tiger_decode_digits(&pBuffer[1], 9);
+	if(nMicrodegrees < 0 || (pBuffer[0] != '+' && pBuffer[0] != '-')) {
+		return import_tiger_read_lon_strtod(pBuffer, pValue);
+	}
+
+	gdouble fVal = nMicrodegrees / 1000000.0;
+	fVal = (pBuffer[0] == '-') ? -fVal : fVal;
+	if(nMicrodegrees > 180000000) {
+		g_warning("bad longitude fVal (%f) from string (%.10s)\n", fVal, pBuffer);
+	}
+	*pValue = fVal;
+	return TRUE;
+}
+
+// atoi() of the nLen characters at p: leading whitespace, an optional sign, then digits up to the first non-digit
+static inline gint32 import_tiger_decode_int(const gchar* p, gint nLen)
+{
+	const gchar* pEnd = p + nLen;
+
+	while(p < pEnd && g_ascii_isspace(*p)) p++;
+
+	gboolean bNegative = FALSE;
+	if(p < pEnd && (*p == '-' || *p == '+')) {
+		bNegative = (*p == '-');
+		p++;
+	}
+
+	gint64 nValue = 0;	// a field has at most 14 digits, so this can't overflow (out-of-range values wrap, like atoi() on LP64)
+	while(p < pEnd) {
+		guint nDigit = ((guchar)*p) - '0';
+		if(nDigit > 9) break;
+		nValue = (nValue * 10) + nDigit;
+		p++;
+	}
+	return (gint32)(bNegative ? -nValue : nValue);
+}
+
+static gboolean import_tiger_read_int(const gchar* pBuffer, gint nLen, gint32* pValue)
 {
-	char buffer[11];
 	g_assert(nLen <= 10);
-	memcpy(buffer, pBuffer, nLen);
-	buffer[nLen] = '\0';
-	gint32 nVal = atoi(buffer);
-	*pValue = nVal;
+	*pValue = import_tiger_decode_int(pBuffer, nLen);
 	return TRUE;
 }
 
-static gboolean import_tiger_read_address(char* pBuffer, gint nLen, gint32* pValue)
+static gboolean import_tiger_read_address(const gchar* pBuffer, gint nLen, gint32* pValue)
 {
-	char buffer[15];
 	g_assert(nLen <= 14);
-	memcpy(buffer, pBuffer, nLen);
-	buffer[nLen] = '\0';
-	gint32 nVal = atoi(buffer);
-	*pValue = nVal;
+	*pValue = import_tiger_decode_int(pBuffer, nLen);
 	return TRUE;
 }
 
-static gboolean import_tiger_read_string(char* pBuffer, gint nLen, char* pValue)
+// Copy a field without its trailing blanks (and NULs).  pValue must have room for nLen+1.
+static gboolean import_tiger_read_string(const gchar* pBuffer, gint nLen, char* pValue)
 {
 	g_assert(pBuffer != NULL);
 	g_assert(nLen > 0);
 	g_assert(pValue != NULL);
-	
-	// NOTE: pValue must point to space enough for nLen+1 ... potential bug here!! :O
 
+	// names are mostly padding, so look for the end from the back
+	gint nLength = nLen;
+	while(nLength > 0 && (pBuffer[nLength-1] == ' ' || pBuffer[nLength-1] == '\0')) {
+		nLength--;
+	}
+	memcpy(pValue, pBuffer, nLength);
+	pValue[nLength] = '\0';
+	return TRUE;
+}
+
+//
+// Self-tests (see import_tiger_self_test, run by "import-benchmark --self-test" and "make check")
+//
+// The decoders are checked against the atoi()/strtod() code they replaced.
+//
+static gint32 import_tiger_decode_int_atoi(const gchar* pBuffer, gint nLen)
+{
+	char buffer[15];
+	memcpy(buffer, pBuffer, nLen);
+	buffer[nLen] = '\0';
+	return atoi(buffer);
+}
+
+static void import_tiger_read_string_old(const gchar* pBuffer, gint nLen, char* pValue)
+{
 	gint i;
 	gint nLength=0;
 	for(i=0 ; i<nLen ; i++) {
@@ -347,23 +545,102 @@ static gboolean import_tiger_read_string(char* pBuffer, gint nLen, char* pValue)
 	}
 	memcpy(pValue, pBuffer, nLength);
 	pValue[nLength] = '\0';
-//	snprintf(pValue, nLength+1, "%s", pBuffer);
+}
+
+// Compare two results bit for bit (so -0.0 != 0.0).  Fields that fail leave the value alone, so start both the same.
+static gboolean import_tiger_decoder_check_point(const gchar* pField, gboolean bLongitude)
+{
+	gdouble fNew = 12345.0, fOld = 12345.0;
+	gboolean bNew = bLongitude ? import_tiger_read_lon(pField, &fNew) : import_tiger_read_lat(pField, &fNew);
+	gboolean bOld = bLongitude ? import_tiger_read_lon_strtod(pField, &fOld) : import_tiger_read_lat_strtod(pField, &fOld);
+	if(bNew != bOld || memcmp(&fNew, &fOld, sizeof(gdouble)) != 0) {
+		g_printerr("%s decoder mismatch on '%.10s': %.9f vs %.9f\n", bLongitude ? "lon" : "lat", pField, fNew, fOld);
+		return FALSE;
+	}
 	return TRUE;
+}
 
-	memcpy(pValue, pBuffer, nLen);
-	pValue[nLen] = '\0';
+static gboolean import_tiger_decoder_check_int(const gchar* pField, gint nLen)
+{
+	gint32 nNew = import_tiger_decode_int(pField, nLen);
+	gint32 nOld = import_tiger_decode_int_atoi(pField, nLen);
+	if(nNew != nOld) {
+		g_printerr("int decoder mismatch on '%.*s': %d vs %d\n", nLen, pField, nNew, nOld);
+		return FALSE;
+	}
+	return TRUE;
+}
 
-	// trim whitespace
-	nLen--;
-	char* p = &pValue[nLen];	// last non-null char
-	while(nLen >= 0 && *p == ' ') {
-		*p = '\0';
-		p--;
-		nLen--;
+static gboolean import_tiger_decoder_check_string(const gchar* pField, gint nLen)
+{
+	gchar azNew[64], azOld[64];
+	import_tiger_read_string(pField, nLen, azNew);
+	import_tiger_read_string_old(pField, nLen, azOld);
+	if(strcmp(azNew, azOld) != 0) {
+		g_printerr("string decoder mismatch: '%s' vs '%s'\n", azNew, azOld);
+		return FALSE;
 	}
 	return TRUE;
 }
 
+// the strtod() fallback warns about every malformed field, and the test feeds it lots of them
+static void import_tiger_decoder_quiet_log_handler(const gchar* pszDomain, GLogLevelFlags nLevel, const gchar* pszMessage, gpointer pUserData)
+{
+}
+
+// Every field up to 6 characters long over an alphabet with each kind of character the decoders treat differently,
+// then lots of random full-width fields, some of them well-formed.  Returns FALSE at the first mismatch.
+static gboolean import_tiger_decoder_self_test(void)
+{
+	static const gchar achAlphabet[] = {' ', '\t', '+', '-', '0', '1', '9', '.', 'e', 'A', '\0'};
+	gint nAlphabet = G_N_ELEMENTS(achAlphabet);
+	gchar azField[16];
+
+	gint nLen;
+	for(nLen=1 ; nLen<=6 ; nLen++) {
+		gint nCombinations = 1;
+		gint i;
+		for(i=0 ; i<nLen ; i++) nCombinations *= nAlphabet;
+
+		gint iCombination;
+		for(iCombination=0 ; iCombination<nCombinations ; iCombination++) {
+			gint n = iCombination;
+			for(i=0 ; i<nLen ; i++) {
+				azField[i] = achAlphabet[n % nAlphabet];
+				n /= nAlphabet;
+			}
+			if(!import_tiger_decoder_check_int(azField, nLen) || !import_tiger_decoder_check_string(azField, nLen)) {
+				return FALSE;
+			}
+		}
+	}
+
+	guint nHandlerID = g_log_set_handler(NULL, G_LOG_LEVEL_WARNING, import_tiger_decoder_quiet_log_handler, NULL);
+	GRand* pRand = g_rand_new_with_seed(2005);
+	gboolean bPassed = TRUE;
+	gint iTest;
+	for(iTest=0 ; bPassed && iTest<2000000 ; iTest++) {
+		gint i;
+		if(iTest % 2) {
+			// well-formed: a sign and digits, sometimes blank-padded
+			azField[0] = g_rand_boolean(pRand) ? '+' : '-';
+			for(i=1 ; i<14 ; i++) azField[i] = '0' + g_rand_int_range(pRand, 0, 10);
+			if(iTest % 3 == 0) azField[g_rand_int_range(pRand, 0, 10)] = ' ';
+		}
+		else {
+			for(i=0 ; i<14 ; i++) azField[i] = achAlphabet[g_rand_int_range(pRand, 0, nAlphabet)];
+		}
+		bPassed = (import_tiger_decoder_check_point(azField, FALSE) &&
+				   import_tiger_decoder_check_point(azField, TRUE) &&
+				   import_tiger_decoder_check_int(azField, 10) &&
+				   import_tiger_decoder_check_int(azField, 11) &&
+				   import_tiger_decoder_check_string(azField, 14));
+	}
+	g_rand_free(pRand);
+	g_log_remove_handler(NULL, nHandlerID);
+	return bPassed;
+}
+
 // NOTE: This function can return MAP_OBJECT_TYPE_NONE.  Lines of this type shouldn't be saved, but they
 // might be used for polygons, so we have to keep them in memory.
 static gboolean import_tiger_read_layer_type(char* pBuffer, gint* pValue)
@@ -559,18 +836,16 @@ static gboolean import_tiger_parse_MET(const gchar* pszMET, tiger_import_process
 
 
 // See TGR2003.PDF page 186 for field description
-static gboolean import_tiger_parse_table_1(gchar* pBuffer, gint nLength, GHashTable* pTable, GPtrArray* pBoundaryRT1s)
+static gboolean import_tiger_parse_table_1(gchar* pBuffer, gint nLength, tiger_table_t* pTable)
 {
 	gint i;
 	for(i=0 ; i<=(nLength-TIGER_RT1_LINE_LENGTH) ; i+=TIGER_RT1_LINE_LENGTH) {
-		if((i%ROWS_PER_PULSE) == 0) importwindow_progress_pulse();
-
 		gchar* pLine = &pBuffer[i];
 
 		gint nRecordType;
 		import_tiger_read_layer_type(&pLine[56-1], &nRecordType);
 
-		tiger_record_rt1_t* pRecord = g_new0(tiger_record_rt1_t, 1);
+		tiger_record_rt1_t* pRecord = tiger_table_add(pTable);
 
 		pRecord->nRecordType = nRecordType;
 
@@ -605,11 +880,6 @@ if(achType[0] != '\0' && pRecord->nRoadNameSuffixID == ROAD_SUFFIX_NONE) {
 }
 		import_tiger_read_int(&pLine[135-1], 3, &pRecord->nCountyIDLeft);
 		import_tiger_read_int(&pLine[138-1], 3, &pRecord->nCountyIDRight);
-
-		if(pRecord->nCountyIDLeft != pRecord->nCountyIDRight) {
-			g_ptr_array_add(pBoundaryRT1s, pRecord);
-	//		g_print("county boundary\n");
-		}
 		//~ gint nFeatureType;
 		//~ import_tiger_read_int(&pLine[50-1], 4, &nFeatureType);
 		//~ g_print("name: '%s' (%d)\n", pRecord->achName, nFeatureType);
@@ -623,58 +893,42 @@ if(achType[0] != '\0' && pRecord->nRoadNameSuffixID == ROAD_SUFFIX_NONE) {
 		import_tiger_read_lat(&pLine[220-1], &pRecord->PointB.fLatitude);
 
 //g_print("name: %s, (%f,%f) (%f,%f)\n", pRecord->achName, pRecord->PointA.fLongitude, pRecord->PointA.fLatitude, pRecord->PointB.fLongitude, pRecord->PointB.fLatitude);
-
-		// add to table
-		g_hash_table_insert(pTable, &pRecord->nTLID, pRecord);
 	}
 	return TRUE;
 }
 
-static gboolean import_tiger_parse_table_2(char* pBuffer, gint nLength, GHashTable *pTable)
+static gboolean import_tiger_parse_table_2(char* pBuffer, gint nLength, tiger_table_t* pTable)
 {
 	gint i;
 	for(i=0 ; i<=(nLength-TIGER_RT2_LINE_LENGTH) ; i+=TIGER_RT2_LINE_LENGTH) {
-		if((i%ROWS_PER_PULSE) == 0) importwindow_progress_pulse();
-
 		gchar* pLine = &pBuffer[i];
 
-		// columns 6 to 15 is the TLID -
-		gint nTLID;
-		import_tiger_read_int(&pLine[6-1], TIGER_TLID_LENGTH, &nTLID);
-		tiger_record_rt2_t* pRecord = g_hash_table_lookup(pTable, &nTLID);
-		if(pRecord == NULL) {
-			// create new one and add it
-			pRecord = g_new0(tiger_record_rt2_t, 1);
-			pRecord->nTLID = nTLID;
-			pRecord->pPointsArray = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+		// A chain can have several RT2 records.  They're kept separate, in RTSQ order once the table is sorted.
+		tiger_record_rt2_t* pRecord = tiger_table_add(pTable);
 
-			// add to table
-			g_hash_table_insert(pTable, &pRecord->nTLID, pRecord);
-		}
-		else {
-			// g_print("****** updating existing record %d\n", pRecord->nTLID);
-		}
+		// columns 6 to 15 is the TLID -
+		import_tiger_read_int(&pLine[6-1], TIGER_TLID_LENGTH, &pRecord->nTLID);
+		// columns 16 to 18 is the sequence number
+		import_tiger_read_int(&pLine[16-1], 3, &pRecord->nSequence);
 
-		mappoint_t point;
 		gint iPoint;
 		for(iPoint=0 ; iPoint< TIGER_RT2_MAX_POINTS ; iPoint++) {
-			import_tiger_read_lon(&pLine[19-1 + (iPoint * 19)], &point.fLongitude);
-			import_tiger_read_lat(&pLine[29-1 + (iPoint * 19)], &point.fLatitude);
-			if(point.fLatitude == 0.0 && point.fLongitude == 0.0) {
+			mappoint_t* pPoint = &pRecord->aPoints[iPoint];
+			import_tiger_read_lon(&pLine[19-1 + (iPoint * 19)], &pPoint->fLongitude);
+			import_tiger_read_lat(&pLine[29-1 + (iPoint * 19)], &pPoint->fLatitude);
+			if(pPoint->fLatitude == 0.0 && pPoint->fLongitude == 0.0) {
 				break;
 			}
-			g_array_append_val(pRecord->pPointsArray, point);
+			pRecord->nNumPoints++;
 		}
 	}
 	return TRUE;
 }
 
-static gboolean import_tiger_parse_table_7(char* pBuffer, gint nLength, GHashTable *pTable)
+static gboolean import_tiger_parse_table_7(char* pBuffer, gint nLength, tiger_table_t* pTable)
 {
 	gint i;
 	for(i=0 ; i<=(nLength-TIGER_RT7_LINE_LENGTH) ; i+=TIGER_RT7_LINE_LENGTH) {
-		if((i%ROWS_PER_PULSE) == 0) importwindow_progress_pulse();
-
 		gchar* pLine = &pBuffer[i];
 
 		tiger_record_rt7_t* pRecord;
@@ -683,7 +937,7 @@ static gboolean import_tiger_parse_table_7(char* pBuffer, gint nLength, GHashTab
 		gint nRecordType;
 		import_tiger_read_layer_type(&pLine[22-1], &nRecordType);
 
-		pRecord = g_new0(tiger_record_rt7_t, 1);
+		pRecord = tiger_table_add(pTable);
 		pRecord->nRecordType = nRecordType;
 
 		// columns 11 to 20 is the TLID -
@@ -696,23 +950,18 @@ static gboolean import_tiger_parse_table_7(char* pBuffer, gint nLength, GHashTab
 		//}
 // g_print("record 7: TypeID=%d LANDID=%d\n", pRecord->nRecordType, pRecord->nLANDID);
 //g_print("name: '%s'\n", pRecord->achName);
-
-		// add to table
-		g_hash_table_insert(pTable, &pRecord->nLANDID, pRecord);
 	}
 	return TRUE;
 }
 
-static gboolean import_tiger_parse_table_8(char* pBuffer, gint nLength, GHashTable *pTable)
+static gboolean import_tiger_parse_table_8(char* pBuffer, gint nLength, tiger_table_t* pTable)
 {
 	gint i;
 	for(i=0 ; i<=(nLength-TIGER_RT8_LINE_LENGTH) ; i+=TIGER_RT8_LINE_LENGTH) {
-		if((i%ROWS_PER_PULSE) == 0) importwindow_progress_pulse();
-
 		gchar* pLine = &pBuffer[i];
 
 		tiger_record_rt8_t* pRecord;
-		pRecord = g_new0(tiger_record_rt8_t, 1);
+		pRecord = tiger_table_add(pTable);
 
 		// columns 16 to 25 is the POLYGON ID -
 		import_tiger_read_int(&pLine[16-1], TIGER_POLYID_LENGTH, &pRecord->nPOLYID);
@@ -721,19 +970,14 @@ static gboolean import_tiger_parse_table_8(char* pBuffer, gint nLength, GHashTab
 		import_tiger_read_int(&pLine[26-1], TIGER_LANDID_LENGTH, &pRecord->nLANDID);
 
 // g_print("record 8: POLYID=%d LANDID=%d\n", pRecord->nPOLYID, pRecord->nLANDID);
-
-		// add to table
-		g_hash_table_insert(pTable, &pRecord->nPOLYID, pRecord);
 	}
 	return TRUE;
 }
 
-static gboolean import_tiger_parse_table_c(char* pBuffer, gint nLength, GHashTable *pTable)
+static gboolean import_tiger_parse_table_c(char* pBuffer, gint nLength, tiger_table_t* pTable)
 {
 	gint i;
 	for(i=0 ; i<=(nLength-TIGER_RTc_LINE_LENGTH) ; i+=TIGER_RTc_LINE_LENGTH) {
-		if((i%ROWS_PER_PULSE) == 0) importwindow_progress_pulse();
-
 		gchar* pLine = &pBuffer[i];
 
 		// We only want Entity Type M (??)
@@ -741,25 +985,22 @@ static gboolean import_tiger_parse_table_c(char* pBuffer, gint nLength, GHashTab
 		if(chEntityType != 'P') continue;
 
 		tiger_record_rtc_t* pRecord;
-		pRecord = g_new0(tiger_record_rtc_t, 1);
+		pRecord = tiger_table_add(pTable);
 
 		// columns 15 to 19 is the FIPS number (links roads to cities)
 		import_tiger_read_int(&pLine[15-1], TIGER_FIPS55_LEN, &pRecord->nFIPS55);
 		import_tiger_read_string(&pLine[63-1], TIGER_CITY_NAME_LEN, &pRecord->achName[0]);
 		
 g_print("record c: FIPS55=%d NAME=%s\n", pRecord->nFIPS55, pRecord->achName);
-
-		// add to table
-		g_hash_table_insert(pTable, &pRecord->nFIPS55, pRecord);
 	}
 	return TRUE;
 }
 
 
-static gboolean import_tiger_parse_table_i(char* pBuffer, gint nLength, GHashTable *pTable)
+static gboolean import_tiger_parse_table_i(char* pBuffer, gint nLength, tiger_table_t* pTable)
 {
 	//
-	// Gather RTi records (chainID,TZID-A,TZID-B) and index them by POLYGON ID in the given hash table
+	// Gather RTi records (chainID,TZID-A,TZID-B) as links for the polygons on each side
 	//
 	gint i;
 	for(i=0 ; i<=(nLength-TIGER_RTi_LINE_LENGTH) ; i+=TIGER_RTi_LINE_LENGTH) {
@@ -792,635 +1033,1866 @@ static gboolean import_tiger_parse_table_i(char* pBuffer, gint nLength, GHashTab
 //         }
 
 		if(nLeftPolygonID != 0) {
-			// is there an existing RTi for this POLYID?
-			pRecord = g_hash_table_lookup(pTable, &nLeftPolygonID);	// RTi is indexed by polygon ID
-			if(pRecord == NULL) {
-				// create new RTi record and add the link to it
-				pRecord = g_new0(tiger_record_rti_t, 1);
-				pRecord->nPOLYID = nLeftPolygonID;
-				pRecord->pRT1LinksArray = g_ptr_array_new();
-
-				// add new RTi record to the RTi hash table (indexed by POLYID)
-				g_hash_table_insert(pTable, &pRecord->nPOLYID, pRecord);
-
-				//g_print("(L)added TLID %d to new polygon %d ", nTLID, pRecord->nPOLYID);
-			}
-			else {
-				//g_print("(L)added TLID %d to existing polygon %d ", nTLID, pRecord->nPOLYID);
-			}
-			tiger_rt1_link_t* pNewRT1Link = g_new0(tiger_rt1_link_t, 1);
-			pNewRT1Link->nTLID = nTLID;
-			pNewRT1Link->nPointATZID = nZeroCellA;
-			pNewRT1Link->nPointBTZID = nZeroCellB;
-			g_ptr_array_add(pRecord->pRT1LinksArray, pNewRT1Link);
+			pRecord = tiger_table_add(pTable);
+			pRecord->nPOLYID = nLeftPolygonID;
+			pRecord->nTLID = nTLID;
+			pRecord->nPointATZID = nZeroCellA;
+			pRecord->nPointBTZID = nZeroCellB;
 		}
 		if(nRightPolygonID != 0) {
-			pRecord = g_hash_table_lookup(pTable, &nRightPolygonID);
-			if(pRecord == NULL) {
-				// create new one and add it
-				pRecord = g_new0(tiger_record_rti_t, 1);
-				pRecord->nPOLYID = nRightPolygonID;
-				pRecord->pRT1LinksArray = g_ptr_array_new();
-				
-				// add new RTi record to the RTi hash table (indexed by POLYID)
-				g_hash_table_insert(pTable, &pRecord->nPOLYID, pRecord);
-				//g_print("(R)adding TLID %d to new polygon %d ", nTLID, pRecord->nPOLYID);
-			}
-			else {
-				//g_print("(R)adding TLID %d to existing polygon %d ", nTLID, pRecord->nPOLYID);
-			}
-			tiger_rt1_link_t* pNewRT1Link = g_new0(tiger_rt1_link_t, 1);
-			pNewRT1Link->nTLID = nTLID;
-			pNewRT1Link->nPointATZID = nZeroCellA;
-			pNewRT1Link->nPointBTZID = nZeroCellB;
-			g_ptr_array_add(pRecord->pRT1LinksArray, pNewRT1Link);
+			pRecord = tiger_table_add(pTable);
+			pRecord->nPOLYID = nRightPolygonID;
+			pRecord->nTLID = nTLID;
+			pRecord->nPointATZID = nZeroCellA;
+			pRecord->nPointBTZID = nZeroCellB;
 		}
 	}
 	return TRUE;
 }
 
 //
-// Callbacks
+// Parallel parsing
 //
-static void callback_save_rt1_chains(gpointer key, gpointer value, gpointer user_data)
-{
-	static int nCallCount=0; nCallCount++;
-	if((nCallCount%CALLBACKS_PER_PULSE) == 0) importwindow_progress_pulse();
-	
-	GArray* pTempPointsArray = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
-	tiger_import_process_t* pImportProcess = (tiger_import_process_t*)user_data;
-	tiger_record_rt1_t* pRecordRT1 = (tiger_record_rt1_t*)value;
-	// lookup table2 record by TLID
-	tiger_record_rt2_t* pRecordRT2 = g_hash_table_lookup(pImportProcess->pTableRT2, &pRecordRT1->nTLID);
-
-	// add RT1's point A, (optionally) add all points from RT2, then add RT1's point B
-	g_array_append_val(pTempPointsArray, pRecordRT1->PointA);
-	if(pRecordRT2 != NULL) {
-		// append all points from pRecordRT2->pPointsArray to pTempPointsArray
-		gint i;
-		for(i=0 ; i<pRecordRT2->pPointsArray->len ; i++) {
-			mappoint_t* p = &g_array_index(pRecordRT2->pPointsArray, mappoint_t, i);
-			g_array_append_val(pTempPointsArray, *p);
-		}
-	}
-	g_array_append_val(pTempPointsArray, pRecordRT1->PointB);
+// Each record type (and each line-aligned chunk of the big RT1 and RT2 files) is parsed
+// on a worker thread into its own private table.  The calling thread waits for them,
+// pulsing if it has been given a pulse function, then concatenates and sorts the chunk tables.
+//
+typedef enum {
+	TIGER_TABLE_RT1,
+	TIGER_TABLE_RT2,
+	TIGER_TABLE_RT7,
+	TIGER_TABLE_RT8,
+	TIGER_TABLE_RTc,
+	TIGER_TABLE_RTi,
+	TIGER_NUM_TABLES
+} ETigerTable;
 
-	// use RT1's FIPS code to lookup related RTc record, which contains a CityID
-	gint nCityLeftID=0;
-	gint nCityRightID=0;
+static gint g_anTigerTableLineLengths[TIGER_NUM_TABLES] = {TIGER_RT1_LINE_LENGTH, TIGER_RT2_LINE_LENGTH, TIGER_RT7_LINE_LENGTH, TIGER_RT8_LINE_LENGTH, TIGER_RTc_LINE_LENGTH, TIGER_RTi_LINE_LENGTH};
+static gint g_anTigerTableRecordSizes[TIGER_NUM_TABLES] = {sizeof(tiger_record_rt1_t), sizeof(tiger_record_rt2_t), sizeof(tiger_record_rt7_t), sizeof(tiger_record_rt8_t), sizeof(tiger_record_rtc_t), sizeof(tiger_record_rti_t)};
 
-	tiger_record_rtc_t* pRecordRTc;
+typedef struct tiger_parse_job {
+	ETigerTable eTable;
+	gchar* pBuffer;			// decompressed lines, freed by the worker once parsed
+	gint nLength;
 
-	// lookup left CityID, if the FIPS is valid
-	if(pRecordRT1->nFIPS55Left != 0) {
-		pRecordRTc = g_hash_table_lookup(pImportProcess->pTableRTc, &pRecordRT1->nFIPS55Left);
-		if(pRecordRTc) {
-			nCityLeftID = pRecordRTc->nCityID;
-		}
-		else {
-			g_warning("couldn't lookup CityID by FIPS %d for road %s\n", pRecordRT1->nFIPS55Left, pRecordRT1->achName);
-		}
-	}
+	tiger_table_t* pTable;	// owned by the job until merged
 
-	// lookup right CityID, if the FIPS is valid
-	if(pRecordRT1->nFIPS55Right != 0) {
-		pRecordRTc = g_hash_table_lookup(pImportProcess->pTableRTc, &pRecordRT1->nFIPS55Right);
-		if(pRecordRTc) {
-			nCityRightID = pRecordRTc->nCityID;
-		}
-		else {
-			g_warning("couldn't lookup city ID by FIPS %d for road %s\n", pRecordRT1->nFIPS55Right, pRecordRT1->achName);
-		}
-	}
+	GAsyncQueue* pDoneQueue;	// job pushes itself here when finished
 
-	// insert, then free temp array
-	if(pRecordRT1->nRecordType != MAP_OBJECT_TYPE_NONE) {
-		gchar azZIPCodeLeft[6];
-		g_snprintf(azZIPCodeLeft, 6, "%05d", pRecordRT1->nZIPCodeLeft);
-		gchar azZIPCodeRight[6];
-		g_snprintf(azZIPCodeRight, 6, "%05d", pRecordRT1->nZIPCodeRight);
+	importstats_t Stats;
+} tiger_parse_job_t;
 
-		gint nRoadNameID = 0;
-		if(pRecordRT1->achName[0] != '\0') {
-			//printf("inserting road name %s\n", pRecordRT1->achName);
-			db_insert_roadname(pRecordRT1->achName, pRecordRT1->nRoadNameSuffixID, &nRoadNameID);
-		}
+gint import_tiger_get_thread_count(void)
+{
+	glong nCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+	if(nCPUs < 1) nCPUs = 1;
+	return MIN(nCPUs, PARSE_THREADS_MAX);
+}
 
-		gint nLOD;
-		for(nLOD = MAP_LEVEL_OF_DETAIL_BEST ; nLOD <= MAP_LEVEL_OF_DETAIL_WORST ; nLOD++) {
-			if(!object_type_exists_at_lod(pRecordRT1->nRecordType, nLOD)) continue;
+static void import_tiger_parse_job_thread(gpointer pData, gpointer pUserData)
+{
+	tiger_parse_job_t* pJob = (tiger_parse_job_t*)pData;
+	IMPORTSTATS_BEGIN(timer);
+
+	// NOTE: runs on a worker thread.  No GTK and no DB calls here!
+	switch(pJob->eTable) {
+	case TIGER_TABLE_RT1:
+		import_tiger_parse_table_1(pJob->pBuffer, pJob->nLength, pJob->pTable);
+		break;
+	case TIGER_TABLE_RT2:
+		import_tiger_parse_table_2(pJob->pBuffer, pJob->nLength, pJob->pTable);
+		break;
+	case TIGER_TABLE_RT7:
+		import_tiger_parse_table_7(pJob->pBuffer, pJob->nLength, pJob->pTable);
+		break;
+	case TIGER_TABLE_RT8:
+		import_tiger_parse_table_8(pJob->pBuffer, pJob->nLength, pJob->pTable);
+		break;
+	case TIGER_TABLE_RTc:
+		import_tiger_parse_table_c(pJob->pBuffer, pJob->nLength, pJob->pTable);
+		break;
+	case TIGER_TABLE_RTi:
+		import_tiger_parse_table_i(pJob->pBuffer, pJob->nLength, pJob->pTable);
+		break;
+	default:
+		g_assert_not_reached();
+	}
+	g_free(pJob->pBuffer);
+	pJob->pBuffer = NULL;
 
-			GArray* pReducedPointsArray = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+	IMPORTSTATS_END(timer, &(pJob->Stats), IMPORTSTATS_STAGE_PARSE_RT1 + pJob->eTable, tiger_table_length(pJob->pTable));
+	g_async_queue_push(pJob->pDoneQueue, pJob);
+}
 
-			gdouble fTolerance = object_type_tolerance_at_lod(pRecordRT1->nRecordType, nLOD);
-			map_math_simplify_pointstring(pTempPointsArray, fTolerance, pReducedPointsArray);
+// Wait for nJobs jobs to push themselves onto pDoneQueue, keeping the UI alive (if called from the main thread)
+static void import_tiger_wait_for_jobs(tiger_import_process_t* pImportProcess, GAsyncQueue* pDoneQueue, gint nJobs)
+{
+	gint nJobsDone = 0;
+	while(nJobsDone < nJobs) {
+		if(pImportProcess->pfnPulse == NULL) {
+			g_async_queue_pop(pDoneQueue);
+			nJobsDone++;
+			continue;
+		}
 
-			// Need 2 points to form a line
-			if(pReducedPointsArray->len >= 2) {
-				if(nLOD == MAP_LEVEL_OF_DETAIL_BEST) {
-					db_insert_road(nLOD, nRoadNameID, pRecordRT1->nRecordType,
-					   pRecordRT1->nAddressLeftStart, pRecordRT1->nAddressLeftEnd,
-					   pRecordRT1->nAddressRightStart, pRecordRT1->nAddressRightEnd,
-					   nCityLeftID, nCityRightID,
-					   azZIPCodeLeft, azZIPCodeRight,
-					   pReducedPointsArray, NULL);
-					
-				}
-				else {
-					db_insert_road(nLOD, nRoadNameID, pRecordRT1->nRecordType, 0, 0, 0, 0, 0, 0, NULL, NULL,
-								   pReducedPointsArray, NULL);
-				}
+		GTimeVal timeEnd;
+		g_get_current_time(&timeEnd);
+		g_time_val_add(&timeEnd, JOB_PULSE_INTERVAL_MSEC * 1000);
 
-				if(pReducedPointsArray->len < pTempPointsArray->len) {
-					g_debug("line %s reduced from %d to %d points at LOD %d", pRecordRT1->achName, pTempPointsArray->len, pReducedPointsArray->len, nLOD);
-				}
-			}
-			else {
-				g_warning("line %s reduced to %d points", pRecordRT1->achName, pReducedPointsArray->len);
-			}
-			g_array_free(pReducedPointsArray, TRUE);
+		if(g_async_queue_timed_pop(pDoneQueue, &timeEnd) != NULL) {
+			nJobsDone++;
 		}
+		pImportProcess->pfnPulse();
 	}
-	g_array_free(pTempPointsArray, TRUE);
 }
 
-typedef enum {
-	ORDER_FORWARD,
-	ORDER_BACKWARD
-} EOrder;
-
-static void tiger_util_add_RT1_points_to_array(tiger_import_process_t* pImportProcess, gint nTLID, GArray* pPointsArray, EOrder eOrder)
+// A table with room for every record in nLength bytes of lines, so parsing never grows it
+static tiger_table_t* import_tiger_new_table(ETigerTable eTable, gint nLength)
 {
-	g_assert(pImportProcess != NULL);
-	g_assert(pImportProcess->pTableRT1 != NULL);
-	g_assert(pImportProcess->pTableRT2 != NULL);
+	gint nReserve = nLength / g_anTigerTableLineLengths[eTable];
+	if(eTable == TIGER_TABLE_RTi) nReserve *= 2;	// a link for each side
 
-	// lookup table1 record by TLID
-	tiger_record_rt1_t* pRecordRT1 = g_hash_table_lookup(pImportProcess->pTableRT1, &nTLID);
-	if(pRecordRT1 == NULL) return;
+	return tiger_table_new(g_anTigerTableRecordSizes[eTable], nReserve);
+}
 
-	// lookup table2 record by TLID
-	tiger_record_rt2_t* pRecordRT2 = g_hash_table_lookup(pImportProcess->pTableRT2, &pRecordRT1->nTLID);
+// Concatenate the chunk tables of one type, in file order, and sort the result.  The jobs' stats are added to pStats.
+static tiger_table_t* import_tiger_merge_tables(GPtrArray* pJobsArray, ETigerTable eTable, importstats_t* pStats)
+{
+	IMPORTSTATS_BEGIN(timer);
+	gint nTotal = 0;
+	gint nChunks = 0;
+	tiger_parse_job_t* pOnlyJob = NULL;
+
+	gint iJob;
+	for(iJob=0 ; iJob<pJobsArray->len ; iJob++) {
+		tiger_parse_job_t* pJob = g_ptr_array_index(pJobsArray, iJob);
+		if(pJob->eTable != eTable) continue;
+
+		nTotal += tiger_table_length(pJob->pTable);
+		nChunks++;
+		pOnlyJob = pJob;
+		IMPORTSTATS_MERGE(pStats, &(pJob->Stats));
+	}
 
-	if(eOrder == ORDER_FORWARD) {
-		g_array_append_val(pPointsArray, pRecordRT1->PointA);
-		if(pRecordRT2 != NULL) {
-			// append all points from pRecordRT2->pPointsArray
-			gint i;
-			for(i=0 ; i<pRecordRT2->pPointsArray->len ; i++) {
-				mappoint_t* p = &g_array_index(pRecordRT2->pPointsArray, mappoint_t, i);
-				g_array_append_val(pPointsArray, *p);
-			}
-		}
-		g_array_append_val(pPointsArray, pRecordRT1->PointB);
-	} else {
-		g_array_append_val(pPointsArray, pRecordRT1->PointB);
-		if(pRecordRT2 != NULL) {
-			// append all points from pRecordRT2->pPointsArray in REVERSE order
-			gint i;
-			for(i=pRecordRT2->pPointsArray->len-1 ; i>=0 ; i--) {
-				mappoint_t* p = &g_array_index(pRecordRT2->pPointsArray, mappoint_t, i);
-				g_array_append_val(pPointsArray, *p);
-			}
+	tiger_table_t* pMerged;
+	if(nChunks == 1) {
+		// just hand it over
+		pMerged = pOnlyJob->pTable;
+		pOnlyJob->pTable = NULL;
+	}
+	else {
+		pMerged = tiger_table_new(g_anTigerTableRecordSizes[eTable], nTotal);
+		for(iJob=0 ; iJob<pJobsArray->len ; iJob++) {
+			tiger_parse_job_t* pJob = g_ptr_array_index(pJobsArray, iJob);
+			if(pJob->eTable != eTable) continue;
+
+			g_array_append_vals(pMerged->pRecords, pJob->pTable->pRecords->data, pJob->pTable->pRecords->len);
+			tiger_table_free(pJob->pTable);
+			pJob->pTable = NULL;
 		}
-		g_array_append_val(pPointsArray, pRecordRT1->PointA);
 	}
+	tiger_table_sort(pMerged);
+
+	IMPORTSTATS_END(timer, pStats, IMPORTSTATS_STAGE_PARSE_RT1 + eTable, 0);
+	IMPORTSTATS_SAMPLE_RSS(pStats, IMPORTSTATS_STAGE_PARSE_RT1 + eTable);
+	return pMerged;
 }
 
-static void callback_save_rtc_cities(gpointer key, gpointer value, gpointer user_data)
+static const zipentry_t* import_tiger_find_member(tiger_import_process_t* pImportProcess, ETigerFile eFile)
 {
-	tiger_record_rtc_t* pRecordRTc = (tiger_record_rtc_t*)value;
-	g_assert(pRecordRTc != NULL);
+	gchar azName[20];
+	g_snprintf(azName, sizeof(azName), "TGR%05d.%s", pImportProcess->nTigerSetNumber, g_apszTigerFileExtensions[eFile]);
+	return zipreader_find_entry(pImportProcess->pZip, azName);
+}
 
-	gint nCityID = 0;
-	if(!db_insert_city(pRecordRTc->achName, g_nStateID, &nCityID)) {
-		g_warning("insert city %s failed\n", pRecordRTc->achName);
-	}
-	pRecordRTc->nCityID = nCityID;
+// Queue one parse job.  The job owns pBuffer.
+static void import_tiger_queue_parse_job(GThreadPool* pPool, GPtrArray* pJobsArray, GAsyncQueue* pDoneQueue, ETigerTable eTable, gchar* pBuffer, gint nLength)
+{
+	tiger_parse_job_t* pJob = g_new0(tiger_parse_job_t, 1);
+	pJob->eTable = eTable;
+	pJob->pBuffer = pBuffer;
+	pJob->nLength = nLength;
+	pJob->pTable = import_tiger_new_table(eTable, nLength);
+	pJob->pDoneQueue = pDoneQueue;
+
+	g_ptr_array_add(pJobsArray, pJob);
+	g_thread_pool_push(pPool, pJob, NULL);
 }
 
-static void callback_save_rti_polygons(gpointer key, gpointer value, gpointer user_data)
+// Queue a small member as a single job
+static gboolean import_tiger_queue_member(tiger_import_process_t* pImportProcess, GThreadPool* pPool, GPtrArray* pJobsArray, GAsyncQueue* pDoneQueue, ETigerTable eTable, ETigerFile eFile)
 {
-	static int nCallCount=0; nCallCount++;
-	if((nCallCount%CALLBACKS_PER_PULSE) == 0) importwindow_progress_pulse();
+	gchar* pBuffer;
+	gint nLength;
+	IMPORTSTATS_BEGIN(timer);
+	if(!zipreader_read_entire_entry(pImportProcess->pZip, import_tiger_find_member(pImportProcess, eFile), &pBuffer, &nLength)) {
+		return FALSE;
+	}
+	IMPORTSTATS_END(timer, &(pImportProcess->Stats), IMPORTSTATS_STAGE_DECOMPRESS, nLength);
+	import_tiger_queue_parse_job(pPool, pJobsArray, pDoneQueue, eTable, pBuffer, nLength);
+	return TRUE;
+}
 
-	tiger_import_process_t* pImportProcess = (tiger_import_process_t*)user_data;
-	g_assert(pImportProcess != NULL);
+// Decompress a big member in chunks of nRowsPerChunk lines, queueing each as a job.  TIGER lines
+// are fixed length and zipstream_read() only comes up short at the end, so every chunk is whole lines.
+// To keep the decompressed file from piling up in memory, only a few chunks are allowed to wait at once.
+static gboolean import_tiger_stream_member(tiger_import_process_t* pImportProcess, GThreadPool* pPool, GPtrArray* pJobsArray, GAsyncQueue* pDoneQueue, gint* pnJobsDone, ETigerTable eTable, ETigerFile eFile, gint nLineLength, gint nRowsPerChunk)
+{
+	zipstream_t* pStream = zipreader_open_entry(pImportProcess->pZip, import_tiger_find_member(pImportProcess, eFile));
+	if(pStream == NULL) return FALSE;
 
-	//
-	// pRecordRTi has an array of RT1 chains that make up this polygon.
-	// our job here is to stitch them together.
-	//
-	tiger_record_rti_t* pRecordRTi = (tiger_record_rti_t*)value;
-	g_assert(pRecordRTi != NULL);
+	gint nChunkLength = nRowsPerChunk * nLineLength;
+	gint nMaxWaiting = pImportProcess->nThreads * 2;
 
-	// lookup table8 (polygon-landmark link) record by POLYID
-	tiger_record_rt8_t* pRecordRT8 = g_hash_table_lookup(pImportProcess->pTableRT8, &pRecordRTi->nPOLYID);
-	if(pRecordRT8 == NULL) return;	// allowed to be null(?)
+	while(TRUE) {
+		while((gint)(pJobsArray->len) - (*pnJobsDone) >= nMaxWaiting) {
+			import_tiger_wait_for_jobs(pImportProcess, pDoneQueue, 1);
+			(*pnJobsDone)++;
+		}
 
-	// lookup table7 (landmark) record by LANDID
-	tiger_record_rt7_t* pRecordRT7 = g_hash_table_lookup(pImportProcess->pTableRT7, &pRecordRT8->nLANDID);
-	if(pRecordRT7 == NULL) return;	// allowed to be null(?)
+		gchar* pChunk = g_malloc(nChunkLength);
+		IMPORTSTATS_BEGIN(timer);
+		gint nRead = zipstream_read(pStream, pChunk, nChunkLength);
+		IMPORTSTATS_END(timer, &(pImportProcess->Stats), IMPORTSTATS_STAGE_DECOMPRESS, MAX(nRead, 0));
+		if(nRead <= 0) {
+			g_free(pChunk);
+			break;
+		}
+		import_tiger_queue_parse_job(pPool, pJobsArray, pDoneQueue, eTable, pChunk, nRead);
+	}
+	return zipstream_close(pStream);
+}
 
-	// now we have landmark data (name, type)
+static gboolean import_tiger_parse_tables(tiger_import_process_t* pImportProcess)
+{
+	GAsyncQueue* pDoneQueue = g_async_queue_new();
+	GPtrArray* pJobsArray = g_ptr_array_new();
+	GThreadPool* pPool = g_thread_pool_new(import_tiger_parse_job_thread, NULL, pImportProcess->nThreads, FALSE, NULL);
+	gint nJobsDone = 0;
 
-	g_assert(pRecordRTi->pRT1LinksArray != NULL);
-	g_assert(pRecordRTi->pRT1LinksArray->len >= 1);
+	// small tables first, as one job each, so they parse while the big ones are decompressed
+	gboolean bSuccess = TRUE;
+	bSuccess = bSuccess && import_tiger_queue_member(pImportProcess, pPool, pJobsArray, pDoneQueue, TIGER_TABLE_RTi, TIGER_FILE_RTi);
+	bSuccess = bSuccess && import_tiger_queue_member(pImportProcess, pPool, pJobsArray, pDoneQueue, TIGER_TABLE_RT7, TIGER_FILE_RT7);
+	bSuccess = bSuccess && import_tiger_queue_member(pImportProcess, pPool, pJobsArray, pDoneQueue, TIGER_TABLE_RT8, TIGER_FILE_RT8);
+	bSuccess = bSuccess && import_tiger_queue_member(pImportProcess, pPool, pJobsArray, pDoneQueue, TIGER_TABLE_RTc, TIGER_FILE_RTc);
+	bSuccess = bSuccess && import_tiger_stream_member(pImportProcess, pPool, pJobsArray, pDoneQueue, &nJobsDone, TIGER_TABLE_RT1, TIGER_FILE_RT1, TIGER_RT1_LINE_LENGTH, RT1_ROWS_PER_PARSE_CHUNK);
+	bSuccess = bSuccess && import_tiger_stream_member(pImportProcess, pPool, pJobsArray, pDoneQueue, &nJobsDone, TIGER_TABLE_RT2, TIGER_FILE_RT2, TIGER_RT2_LINE_LENGTH, RT2_ROWS_PER_PARSE_CHUNK);
+
+#ifdef ENABLE_IMPORT_STATS
+	g_print("parsing %d chunks on %d threads\n", pJobsArray->len, pImportProcess->nThreads);
+#endif
 
-	GArray* pTempPointsArray = NULL;
-	// create a temp array to hold the points for this polygon (in order)
-	g_assert(pTempPointsArray == NULL);
-	pTempPointsArray = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+	// even on failure, let queued jobs finish so everything gets freed below
+	import_tiger_wait_for_jobs(pImportProcess, pDoneQueue, pJobsArray->len - nJobsDone);
+	g_thread_pool_free(pPool, FALSE, TRUE);
+	g_async_queue_unref(pDoneQueue);
+	IMPORTSTATS_SAMPLE_RSS(&(pImportProcess->Stats), IMPORTSTATS_STAGE_DECOMPRESS);
 
-	// start with the RT1Link at index 0 (and remove it)
-	tiger_rt1_link_t* pCurrentRT1Link = g_ptr_array_index(pRecordRTi->pRT1LinksArray, 0);
-	g_ptr_array_remove_index(pRecordRTi->pRT1LinksArray, 0);	// TODO: should maybe choose the last one instead? :)  easier to remove and arbitrary anyway!
+	//
+	// Merge, in file order (not completion order)
+	//
+	pImportProcess->pTableRT1 = import_tiger_merge_tables(pJobsArray, TIGER_TABLE_RT1, &(pImportProcess->Stats));
+	pImportProcess->pTableRT2 = import_tiger_merge_tables(pJobsArray, TIGER_TABLE_RT2, &(pImportProcess->Stats));
+	pImportProcess->pTableRT7 = import_tiger_merge_tables(pJobsArray, TIGER_TABLE_RT7, &(pImportProcess->Stats));
+	pImportProcess->pTableRT8 = import_tiger_merge_tables(pJobsArray, TIGER_TABLE_RT8, &(pImportProcess->Stats));
+	pImportProcess->pTableRTc = import_tiger_merge_tables(pJobsArray, TIGER_TABLE_RTc, &(pImportProcess->Stats));
+	pImportProcess->pTableRTi = import_tiger_merge_tables(pJobsArray, TIGER_TABLE_RTi, &(pImportProcess->Stats));
+
+	gint iJob;
+	for(iJob=0 ; iJob<pJobsArray->len ; iJob++) {
+		g_free(g_ptr_array_index(pJobsArray, iJob));
+	}
+	g_ptr_array_free(pJobsArray, TRUE);
 
-	// we'll use the first RT1 in forward order, that is A->B...
-	tiger_util_add_RT1_points_to_array(pImportProcess, pCurrentRT1Link->nTLID,
-		pTempPointsArray, ORDER_FORWARD);
-	// ...so B is the last TZID for now.
-	gint nLastTZID = pCurrentRT1Link->nPointBTZID;
+	if(!bSuccess) {
+		g_warning("failed to read TIGER set %05d\n", pImportProcess->nTigerSetNumber);
+		return FALSE;
+	}
 
-	while(TRUE) {
-		if(pRecordRTi->pRT1LinksArray->len == 0) break;
-
-		// Loop through the RT1Links and try to find the next RT1 by matching TZID fields.
-		// NOTE: This is just like dominos!  Only instead of matching white dots we're
-		// matching TZIDs.  And like a domino, an RT1 chain can be in the wrong order!
-		// In that case we have to add the points from the RT1 in *reverse* order.
-
-		gboolean bFound = FALSE;
-		gint iRT1Link;
-		for(iRT1Link=0 ; iRT1Link < pRecordRTi->pRT1LinksArray->len ; iRT1Link++) {
-			tiger_rt1_link_t* pNextRT1Link = g_ptr_array_index(pRecordRTi->pRT1LinksArray, iRT1Link);
-			
-			if(nLastTZID == pNextRT1Link->nPointATZID) {
-				// add pNextRT1Link's points in order (A->B)
-				// this (pNextRT1Link) RT1Link becomes the new "current"
-				// remove it from the array!
-				g_ptr_array_remove_index(pRecordRTi->pRT1LinksArray, iRT1Link);
-				iRT1Link--;	// undo the next ++ in the for loop
-
-				// we're done forever with the old 'current'
-				// (the RT1 it links to has already had its points copied to the list!)
-				g_free(pCurrentRT1Link);
-				pCurrentRT1Link = pNextRT1Link;
-
-				// add this new RT1's points
-				tiger_util_add_RT1_points_to_array(pImportProcess, pCurrentRT1Link->nTLID,
-					pTempPointsArray, ORDER_FORWARD);
-
-				nLastTZID = pCurrentRT1Link->nPointBTZID;	// Note: point *B* of this RT1Link
-				bFound = TRUE;
-				break;
-			}
-			else if(nLastTZID == pNextRT1Link->nPointBTZID) {
-				// add pNextRT1Link's points in REVERSE order (B->A)
-				// (otherwise same as above)
+	g_print("RT1: %d records\n", tiger_table_length(pImportProcess->pTableRT1));
+	g_print("RT2: %d records\n", tiger_table_length(pImportProcess->pTableRT2));
+	g_print("RT7: %d records\n", tiger_table_length(pImportProcess->pTableRT7));
+	g_print("RT8: %d records\n", tiger_table_length(pImportProcess->pTableRT8));
+	g_print("RTc: %d records\n", tiger_table_length(pImportProcess->pTableRTc));
+	g_print("RTi: %d records\n", tiger_table_length(pImportProcess->pTableRTi));
+	return TRUE;
+}
+
+//
+// Callbacks
+//
+static void import_tiger_add_pending_road(GArray* pRoadsArray, import_road_t* pRoad, tiger_record_rtc_t* pCityLeft, tiger_record_rtc_t* pCityRight)
+{
+	tiger_pending_road_t pending;
+	pending.pRoad = pRoad;
+	pending.pCityLeft = pCityLeft;
+	pending.pCityRight = pCityRight;
+	g_array_append_val(pRoadsArray, pending);
+}
 
-				g_ptr_array_remove_index(pRecordRTi->pRT1LinksArray, iRT1Link);
-				iRT1Link--;	// undo the next ++ in the for loop
+typedef enum {
+	ORDER_FORWARD,
+	ORDER_BACKWARD
+} EOrder;
 
-				g_free(pCurrentRT1Link);
-				pCurrentRT1Link = pNextRT1Link;
+// Append the shape points from all of a chain's RT2 records (there may be none)
+static void tiger_util_add_RT2_points_to_array(tiger_import_process_t* pImportProcess, gint nTLID, GArray* pPointsArray, EOrder eOrder)
+{
+	gint iFirst = tiger_table_find(pImportProcess->pTableRT2, nTLID);
+	if(iFirst == -1) return;
 
-				// add this new RT1's points
-				tiger_util_add_RT1_points_to_array(pImportProcess, pCurrentRT1Link->nTLID,
-					pTempPointsArray, ORDER_BACKWARD);
+	// a chain's records are together, in sequence order
+	gint iEnd = iFirst;
+	while(iEnd < tiger_table_length(pImportProcess->pTableRT2) && tiger_table_key(tiger_table_index(pImportProcess->pTableRT2, iEnd)) == nTLID) {
+		iEnd++;
+	}
 
-				nLastTZID = pCurrentRT1Link->nPointATZID;	// Note: point *A* of this RT1Link
-				bFound = TRUE;
-				break;
+	gint iRecord;
+	if(eOrder == ORDER_FORWARD) {
+		for(iRecord=iFirst ; iRecord<iEnd ; iRecord++) {
+			tiger_record_rt2_t* pRecordRT2 = tiger_table_index(pImportProcess->pTableRT2, iRecord);
+			g_array_append_vals(pPointsArray, pRecordRT2->aPoints, pRecordRT2->nNumPoints);
+		}
+	}
+	else {
+		for(iRecord=iEnd-1 ; iRecord>=iFirst ; iRecord--) {
+			tiger_record_rt2_t* pRecordRT2 = tiger_table_index(pImportProcess->pTableRT2, iRecord);
+			gint i;
+			for(i=pRecordRT2->nNumPoints-1 ; i>=0 ; i--) {
+				g_array_append_val(pPointsArray, pRecordRT2->aPoints[i]);
 			}
 		}
-		if(bFound == FALSE) {
-			// no next domino-match
-			break;	// inner while() loop
+	}
+}
+
+static void tiger_util_add_RT1_record_points_to_array(tiger_import_process_t* pImportProcess, tiger_record_rt1_t* pRecordRT1, GArray* pPointsArray, EOrder eOrder)
+{
+	if(eOrder == ORDER_FORWARD) {
+		g_array_append_val(pPointsArray, pRecordRT1->PointA);
+		tiger_util_add_RT2_points_to_array(pImportProcess, pRecordRT1->nTLID, pPointsArray, ORDER_FORWARD);
+		g_array_append_val(pPointsArray, pRecordRT1->PointB);
+	} else {
+		g_array_append_val(pPointsArray, pRecordRT1->PointB);
+		tiger_util_add_RT2_points_to_array(pImportProcess, pRecordRT1->nTLID, pPointsArray, ORDER_BACKWARD);
+		g_array_append_val(pPointsArray, pRecordRT1->PointA);
+	}
+}
+
+static void tiger_util_add_RT1_points_to_array(tiger_import_process_t* pImportProcess, gint nTLID, GArray* pPointsArray, EOrder eOrder)
+{
+	g_assert(pImportProcess != NULL);
+	g_assert(pImportProcess->pTableRT1 != NULL);
+	g_assert(pImportProcess->pTableRT2 != NULL);
+
+	// lookup table1 record by TLID
+	tiger_record_rt1_t* pRecordRT1 = tiger_table_lookup(pImportProcess->pTableRT1, nTLID);
+	if(pRecordRT1 == NULL) return;
+
+	tiger_util_add_RT1_record_points_to_array(pImportProcess, pRecordRT1, pPointsArray, eOrder);
+}
+
+//
+// Chain merging
+//
+// TIGER splits a street at every intersection, so most RT1s are a single block long.  Above LOD 0 we join RT1s
+// with the same name, suffix and type end to end wherever exactly two of them meet, and save the result as
+// one line.  RT1 has no TZIDs, so chains are matched on their end coordinates.
+//
+typedef struct tiger_rt1_end {
+	gint nLatitude;		// millionths of a degree (TIGER's own precision, so this is exact)
+	gint nLongitude;
+	gint iSlot;			// 2 * (index in pTableRT1) + (0 for point A, 1 for point B)
+} tiger_rt1_end_t;
+
+#define TIGER_MICRODEGREES(f)	((gint)floor(((f) * 1000000.0) + 0.5))
+
+static gint tiger_rt1_end_compare_location(const tiger_rt1_end_t* pA, const tiger_rt1_end_t* pB)
+{
+	if(pA->nLatitude != pB->nLatitude) return (pA->nLatitude < pB->nLatitude) ? -1 : 1;
+	if(pA->nLongitude != pB->nLongitude) return (pA->nLongitude < pB->nLongitude) ? -1 : 1;
+	return 0;
+}
+
+static gint tiger_rt1_end_compare(gconstpointer a, gconstpointer b)
+{
+	const tiger_rt1_end_t* pA = a;
+	const tiger_rt1_end_t* pB = b;
+
+	gint nResult = tiger_rt1_end_compare_location(pA, pB);
+	if(nResult != 0) return nResult;
+	return pA->iSlot - pB->iSlot;	// keeps the order (and so the output) deterministic
+}
+
+// Sort all chain ends by location, so the ends that meet are next to each other
+static GArray* import_tiger_sort_rt1_ends(tiger_import_process_t* pImportProcess)
+{
+	tiger_table_t* pTable = pImportProcess->pTableRT1;
+	gint nNumRT1s = tiger_table_length(pTable);
+
+	GArray* pEndsArray = g_array_sized_new(FALSE, FALSE, sizeof(tiger_rt1_end_t), nNumRT1s * 2);
+	gint iSlot;
+	for(iSlot=0 ; iSlot<nNumRT1s*2 ; iSlot++) {
+		tiger_record_rt1_t* pRecordRT1 = tiger_table_index(pTable, iSlot / 2);
+		mappoint_t* pPoint = is_even(iSlot) ? &pRecordRT1->PointA : &pRecordRT1->PointB;
+
+		tiger_rt1_end_t end;
+		end.nLatitude = TIGER_MICRODEGREES(pPoint->fLatitude);
+		end.nLongitude = TIGER_MICRODEGREES(pPoint->fLongitude);
+		end.iSlot = iSlot;
+		g_array_append_val(pEndsArray, end);
+	}
+	g_array_sort(pEndsArray, tiger_rt1_end_compare);
+	return pEndsArray;
+}
+
+// Fill pImportProcess->pJunctionsArray with the locations where three or more chain ends meet: the only places a line
+// can be joined from its side, or a polygon edge shared with one neighbor turn into an edge shared with another.
+static void import_tiger_find_junctions(tiger_import_process_t* pImportProcess, const GArray* pEndsArray)
+{
+	pImportProcess->pJunctionsArray = g_array_new(FALSE, FALSE, sizeof(tiger_rt1_end_t));
+
+	gint iFirst = 0;
+	while(iFirst < pEndsArray->len) {
+		const tiger_rt1_end_t* pFirstEnd = &g_array_index(pEndsArray, tiger_rt1_end_t, iFirst);
+		gint iEnd = iFirst + 1;
+		while(iEnd < pEndsArray->len && tiger_rt1_end_compare_location(pFirstEnd, &g_array_index(pEndsArray, tiger_rt1_end_t, iEnd)) == 0) {
+			iEnd++;
 		}
-		// else loop and attempt to find next RT1 whose points we should append
+		if((iEnd - iFirst) >= 3) {
+			g_array_append_val(pImportProcess->pJunctionsArray, *pFirstEnd);	// still sorted
+		}
+		iFirst = iEnd;
 	}
-	g_assert(pCurrentRT1Link != NULL);
-	g_free(pCurrentRT1Link);
+}
 
+static gint tiger_rt1_end_bsearch_compare(const void* a, const void* b)
+{
+	return tiger_rt1_end_compare_location(a, b);
+}
+
+// Returns a newly allocated array with a flag for each point that's at a junction, or NULL when we're not locking them.
+// NOTE: called from worker threads.  pJunctionsArray is only read after it's built.
+static gint8* import_tiger_get_locked_points(tiger_import_process_t* pImportProcess, const GArray* pPointsArray)
+{
+	if(pImportProcess->pJunctionsArray == NULL) return NULL;
+
+	gint8* pabLocked = g_new0(gint8, pPointsArray->len);
+	gint i;
+	for(i=0 ; i<pPointsArray->len ; i++) {
+		const mappoint_t* pPoint = &g_array_index(pPointsArray, mappoint_t, i);
+
+		tiger_rt1_end_t key;
+		key.nLatitude = TIGER_MICRODEGREES(pPoint->fLatitude);
+		key.nLongitude = TIGER_MICRODEGREES(pPoint->fLongitude);
+		pabLocked[i] = (bsearch(&key, pImportProcess->pJunctionsArray->data, pImportProcess->pJunctionsArray->len,
+			sizeof(tiger_rt1_end_t), tiger_rt1_end_bsearch_compare) != NULL);
+	}
+	return pabLocked;
+}
+
+// Simplify a line for one LOD.  Returns NULL if there's nothing left to draw.  The road takes ownership of its points.
+// pabLocked can be NULL (see import_tiger_get_locked_points).
+static import_road_t* import_tiger_simplify_line(tiger_record_rt1_t* pRecordRT1, GArray* pPointsArray, const gint8* pabLocked, gint nLOD)
+{
+	GArray* pReducedPointsArray = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+
+	gdouble fTolerance = object_type_tolerance_at_lod(pRecordRT1->nRecordType, nLOD);
+	if(pabLocked != NULL) {
+		map_math_simplify_pointstring_locked(pPointsArray, pabLocked, fTolerance, pReducedPointsArray);
+	}
+	else {
+		map_math_simplify_pointstring(pPointsArray, fTolerance, pReducedPointsArray);
+	}
+
+	// Need 2 points to form a line
+	if(pReducedPointsArray->len < 2) {
+		g_warning("line %s reduced to %d points", pRecordRT1->achName, pReducedPointsArray->len);
+		g_array_free(pReducedPointsArray, TRUE);
+		return NULL;
+	}
+	if(pReducedPointsArray->len < pPointsArray->len) {
+		g_debug("line %s reduced from %d to %d points at LOD %d", pRecordRT1->achName, pPointsArray->len, pReducedPointsArray->len, nLOD);
+	}
+	return import_road_new(nLOD, pRecordRT1->nRecordType, pRecordRT1->achName, pRecordRT1->nRoadNameSuffixID, pReducedPointsArray);
+}
+
+// Save one RT1 at LOD 0, which keeps a row per RT1 since it's where the address ranges and cities live.
+// NOTE: runs on a worker thread.  The tables are only read here, and the finished roads (and timings) go to the job's own pRoadsArray (and pStats).
+static void import_tiger_save_rt1_chain(tiger_import_process_t* pImportProcess, tiger_record_rt1_t* pRecordRT1, GArray* pRoadsArray, importstats_t* pStats)
+{
+	if(pRecordRT1->nRecordType == MAP_OBJECT_TYPE_NONE) return;
+	if(!object_type_exists_at_lod(pRecordRT1->nRecordType, MAP_LEVEL_OF_DETAIL_BEST)) return;
+
+	IMPORTSTATS_BEGIN(chainTimer);
+
+	GArray* pTempPointsArray = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+
+	// add RT1's point A, (optionally) add all points from RT2, then add RT1's point B
+	tiger_util_add_RT1_record_points_to_array(pImportProcess, pRecordRT1, pTempPointsArray, ORDER_FORWARD);
+
+	// use RT1's FIPS code to lookup related RTc record, which gets a CityID in the write stage
+	tiger_record_rtc_t* pCityLeft = NULL;
+	tiger_record_rtc_t* pCityRight = NULL;
+
+	// lookup left city, if the FIPS is valid
+	if(pRecordRT1->nFIPS55Left != 0) {
+		pCityLeft = tiger_table_lookup(pImportProcess->pTableRTc, pRecordRT1->nFIPS55Left);
+		if(pCityLeft == NULL) {
+			g_warning("couldn't lookup CityID by FIPS %d for road %s\n", pRecordRT1->nFIPS55Left, pRecordRT1->achName);
+		}
+	}
+
+	// lookup right city, if the FIPS is valid
+	if(pRecordRT1->nFIPS55Right != 0) {
+		pCityRight = tiger_table_lookup(pImportProcess->pTableRTc, pRecordRT1->nFIPS55Right);
+		if(pCityRight == NULL) {
+			g_warning("couldn't lookup city ID by FIPS %d for road %s\n", pRecordRT1->nFIPS55Right, pRecordRT1->achName);
+		}
+	}
+
+	IMPORTSTATS_END(chainTimer, pStats, IMPORTSTATS_STAGE_CHAINS, 1);
+
+	// simplify and queue for the write stage, then free temp array
+	IMPORTSTATS_BEGIN(simplifyTimer);
+	import_road_t* pRoad = import_tiger_simplify_line(pRecordRT1, pTempPointsArray, NULL, MAP_LEVEL_OF_DETAIL_BEST);
+	IMPORTSTATS_END(simplifyTimer, pStats, IMPORTSTATS_STAGE_SIMPLIFY_LOD0, 1);
+	if(pRoad != NULL) {
+		pRoad->nAddressLeftStart = pRecordRT1->nAddressLeftStart;
+		pRoad->nAddressLeftEnd = pRecordRT1->nAddressLeftEnd;
+		pRoad->nAddressRightStart = pRecordRT1->nAddressRightStart;
+		pRoad->nAddressRightEnd = pRecordRT1->nAddressRightEnd;
+		g_snprintf(pRoad->azZIPCodeLeft, 6, "%05d", pRecordRT1->nZIPCodeLeft);
+		g_snprintf(pRoad->azZIPCodeRight, 6, "%05d", pRecordRT1->nZIPCodeRight);
+		import_tiger_add_pending_road(pRoadsArray, pRoad, pCityLeft, pCityRight);
+	}
+	g_array_free(pTempPointsArray, TRUE);
+}
+
+// Save a run of joined RT1s (see import_tiger_merge_rt1_chains) at LOD 1 and up.
+// NOTE: runs on a worker thread, like import_tiger_save_rt1_chain.
+static void import_tiger_save_merged_chain(tiger_import_process_t* pImportProcess, const gint* aiSlots, gint nCount, GArray* pRoadsArray, importstats_t* pStats)
+{
+	IMPORTSTATS_BEGIN(chainTimer);
+	tiger_record_rt1_t* pFirstRT1 = tiger_table_index(pImportProcess->pTableRT1, aiSlots[0] / 2);
+
+	GArray* pTempPointsArray = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+	gint i;
+	for(i=0 ; i<nCount ; i++) {
+		tiger_record_rt1_t* pRecordRT1 = tiger_table_index(pImportProcess->pTableRT1, aiSlots[i] / 2);
+
+		// the point where two chains join is in both of them
+		if(i > 0) pTempPointsArray->len--;
+
+		tiger_util_add_RT1_record_points_to_array(pImportProcess, pRecordRT1, pTempPointsArray, is_even(aiSlots[i]) ? ORDER_FORWARD : ORDER_BACKWARD);
+	}
+	gint8* pabLocked = import_tiger_get_locked_points(pImportProcess, pTempPointsArray);
+	IMPORTSTATS_END(chainTimer, pStats, IMPORTSTATS_STAGE_CHAINS, 0);	// its RT1s were counted at LOD 0
+
+	gint nLOD;
+	for(nLOD = MAP_LEVEL_OF_DETAIL_BEST+1 ; nLOD <= MAP_LEVEL_OF_DETAIL_WORST ; nLOD++) {
+		if(!object_type_exists_at_lod(pFirstRT1->nRecordType, nLOD)) continue;
+
+		IMPORTSTATS_BEGIN(simplifyTimer);
+		import_road_t* pRoad = import_tiger_simplify_line(pFirstRT1, pTempPointsArray, pabLocked, nLOD);
+		IMPORTSTATS_END(simplifyTimer, pStats, IMPORTSTATS_STAGE_SIMPLIFY_LOD0 + nLOD, 1);
+		if(pRoad != NULL) {
+			import_tiger_add_pending_road(pRoadsArray, pRoad, NULL, NULL);
+		}
+	}
+	g_free(pabLocked);
+	g_array_free(pTempPointsArray, TRUE);
+}
+
+static gboolean tiger_rt1_is_same_road(const tiger_record_rt1_t* pA, const tiger_record_rt1_t* pB)
+{
+	return (pA->nRecordType == pB->nRecordType &&
+			pA->nRoadNameSuffixID == pB->nRoadNameSuffixID &&
+			strcmp(pA->achName, pB->achName) == 0);
+}
+
+// Fill pSlotsArray with RT1 slots (even to walk a chain A->B, odd for B->A), one run per merged line, and
+// pRunStartsArray with the index where each run starts in pSlotsArray, plus one for the end of the last run.
+static void import_tiger_merge_rt1_chains(tiger_import_process_t* pImportProcess, const GArray* pEndsArray, GArray* pSlotsArray, GArray* pRunStartsArray)
+{
+	tiger_table_t* pTable = pImportProcess->pTableRT1;
+	gint nNumRT1s = tiger_table_length(pTable);
+	gint iSlot;
+
+	// anPartner[slot] is the slot of the chain end joined to it, or -1
+	gint* anPartner = g_new(gint, nNumRT1s * 2);
+	for(iSlot=0 ; iSlot<nNumRT1s*2 ; iSlot++) {
+		anPartner[iSlot] = -1;
+	}
+
+	gint iFirst = 0;
+	while(iFirst < pEndsArray->len) {
+		const tiger_rt1_end_t* pFirstEnd = &g_array_index(pEndsArray, tiger_rt1_end_t, iFirst);
+		gint iEnd = iFirst + 1;
+		while(iEnd < pEndsArray->len && tiger_rt1_end_compare_location(pFirstEnd, &g_array_index(pEndsArray, tiger_rt1_end_t, iEnd)) == 0) {
+			iEnd++;
+		}
+
+		// join two ends only if they're the only ends of that road here (three or more is a fork)
+		gint i,j;
+		for(i=iFirst ; i<iEnd ; i++) {
+			gint iSlotA = g_array_index(pEndsArray, tiger_rt1_end_t, i).iSlot;
+			tiger_record_rt1_t* pRecordA = tiger_table_index(pTable, iSlotA / 2);
+			if(pRecordA->nRecordType == MAP_OBJECT_TYPE_NONE) continue;
+
+			gint iMatchSlot = -1;
+			gint nMatches = 0;
+			for(j=iFirst ; j<iEnd ; j++) {
+				if(j == i) continue;
+				gint iSlotB = g_array_index(pEndsArray, tiger_rt1_end_t, j).iSlot;
+				if(tiger_rt1_is_same_road(pRecordA, tiger_table_index(pTable, iSlotB / 2))) {
+					iMatchSlot = iSlotB;
+					nMatches++;
+				}
+			}
+			// (a chain that loops back to itself isn't joined)
+			if(nMatches == 1 && (iMatchSlot / 2) != (iSlotA / 2)) {
+				anPartner[iSlotA] = iMatchSlot;
+			}
+		}
+		iFirst = iEnd;
+	}
 	//
-	// IMPORTANT: Remove last point!
-	//  A) It's the same as first, so there's no reason to store it.
-	//  B) It lets us use 'map_math_simplify_pointstring' which doesn't work on closed polygons.
-	//
-	// NOTE: We copy the last point to the first when loading this polygon
+	// Walk the joined chains.  Each run starts at a chain end with no partner (or anywhere, for a loop).
 	//
-	mappoint_t* p1 = &g_array_index(pTempPointsArray, mappoint_t, 0);
-	mappoint_t* p2 = &g_array_index(pTempPointsArray, mappoint_t, pTempPointsArray->len-1);
+	gboolean* abUsed = g_new0(gboolean, nNumRT1s);
+	gint iRT1;
+	for(iRT1=0 ; iRT1<nNumRT1s ; iRT1++) {
+		if(abUsed[iRT1]) continue;
+
+		tiger_record_rt1_t* pRecordRT1 = tiger_table_index(pTable, iRT1);
+		if(pRecordRT1->nRecordType == MAP_OBJECT_TYPE_NONE) continue;
+
+		// back up to the start of the whole line: the previous chain is walked toward our start, so it starts at its other end
+		gint iStartSlot = iRT1 * 2;
+		while(anPartner[iStartSlot] != -1) {
+			gint iPreviousStartSlot = anPartner[iStartSlot] ^ 1;
+			if((iPreviousStartSlot / 2) == iRT1) break;				// it's a loop
+			if(abUsed[iPreviousStartSlot / 2]) break;				// already in a run
+			iStartSlot = iPreviousStartSlot;
+		}
 
-	if(p1->fLatitude != p2->fLatitude || p1->fLongitude != p2->fLongitude) {
-		g_warning("Found a polygon that doesn't loop %s\n", pRecordRT7->achName);
+		// walk the whole line forward, leaving each chain by its other end, cutting it into runs of RT1_MERGE_MAX_CHAINS
+		gint nRunStart = pSlotsArray->len;
+		g_array_append_val(pRunStartsArray, nRunStart);
+
+		iSlot = iStartSlot;
+		while(TRUE) {
+			abUsed[iSlot / 2] = TRUE;
+			g_array_append_val(pSlotsArray, iSlot);
+
+			gint iNextSlot = anPartner[iSlot ^ 1];
+			if(iNextSlot == -1 || abUsed[iNextSlot / 2]) break;
+			if((pSlotsArray->len - nRunStart) >= RT1_MERGE_MAX_CHAINS) {
+				// the next run starts where this one was cut
+				nRunStart = pSlotsArray->len;
+				g_array_append_val(pRunStartsArray, nRunStart);
+			}
+			iSlot = iNextSlot;
+		}
 	}
+	gint nEnd = pSlotsArray->len;
+	g_array_append_val(pRunStartsArray, nEnd);
 
-	pTempPointsArray->len--;
+	g_free(abUsed);
+	g_free(anPartner);
+}
 
-	// save this polygon
-	if(pTempPointsArray->len >= 3) {	// takes 3 to make a polygon
+static void import_tiger_merge_self_test_add(GArray* pRecordsArray, const gchar* pszName, gint nRecordType, gdouble fLatitudeA, gdouble fLongitudeA, gdouble fLatitudeB, gdouble fLongitudeB)
+{
+	tiger_record_rt1_t record;
+	memset(&record, 0, sizeof(record));
+	record.nTLID = pRecordsArray->len + 1;
+	record.nRecordType = nRecordType;
+	g_strlcpy(record.achName, pszName, sizeof(record.achName));
+	record.PointA.fLatitude = fLatitudeA;
+	record.PointA.fLongitude = fLongitudeA;
+	record.PointB.fLatitude = fLatitudeB;
+	record.PointB.fLongitude = fLongitudeB;
+	g_array_append_val(pRecordsArray, record);
+}
+
+// Where a slot enters its chain (pass iSlot ^ 1 for where it leaves)
+static void import_tiger_merge_self_test_slot_point(const tiger_table_t* pTable, gint iSlot, gint* pnLatitude, gint* pnLongitude)
+{
+	tiger_record_rt1_t* pRecordRT1 = tiger_table_index(pTable, iSlot / 2);
+	mappoint_t* pPoint = is_even(iSlot) ? &pRecordRT1->PointA : &pRecordRT1->PointB;
+	*pnLatitude = TIGER_MICRODEGREES(pPoint->fLatitude);
+	*pnLongitude = TIGER_MICRODEGREES(pPoint->fLongitude);
+}
+
+// Join a long street, a long loop, a fork and a short street, stored in random order and facing random ways, and check
+// that every RT1 comes out exactly once, in runs no longer than RT1_MERGE_MAX_CHAINS whose chains really meet.
+static gboolean import_tiger_merge_self_test(void)
+{
+	const gint nLongChains = (RT1_MERGE_MAX_CHAINS * 3) + 8;		// 4 runs
+	const gint nLoopChains = (RT1_MERGE_MAX_CHAINS * 2) + 22;		// 3 runs
+	const gint nExpectedRuns = 4 + 3 + 3 + 1;						// ... + one per fork branch + the short street
+
+	GArray* pRecordsArray = g_array_new(FALSE, FALSE, sizeof(tiger_record_rt1_t));
+	gint i;
+	for(i=0 ; i<nLongChains ; i++) {
+		import_tiger_merge_self_test_add(pRecordsArray, "Long", MAP_OBJECT_TYPE_MINORROAD, 30.0, -90.0 + (i * 0.001), 30.0, -90.0 + ((i+1) * 0.001));
+	}
+	for(i=0 ; i<nLoopChains ; i++) {
+		// around a long thin rectangle: along the bottom, then back along the top
+		gint nHalf = nLoopChains / 2;
+		gint iA = i, iB = (i + 1) % nLoopChains;
+		import_tiger_merge_self_test_add(pRecordsArray, "Loop", MAP_OBJECT_TYPE_MINORROAD,
+			(iA < nHalf) ? 31.0 : 31.01, -90.0 + (((iA < nHalf) ? iA : (nLoopChains - 1 - iA)) * 0.001),
+			(iB < nHalf) ? 31.0 : 31.01, -90.0 + (((iB < nHalf) ? iB : (nLoopChains - 1 - iB)) * 0.001));
+	}
+	for(i=0 ; i<3 ; i++) {
+		import_tiger_merge_self_test_add(pRecordsArray, "Fork", MAP_OBJECT_TYPE_MINORROAD, 32.0, -90.0, 32.0 + (i * 0.001), -89.9);
+	}
+	import_tiger_merge_self_test_add(pRecordsArray, "Short", MAP_OBJECT_TYPE_MINORROAD, 33.0, -90.0, 33.0, -89.999);
+	import_tiger_merge_self_test_add(pRecordsArray, "Short", MAP_OBJECT_TYPE_MINORROAD, 33.0, -89.998, 33.0, -89.999);
+	// skipped records, one of them sitting on the long street
+	import_tiger_merge_self_test_add(pRecordsArray, "Long", MAP_OBJECT_TYPE_NONE, 30.0, -90.0 + 0.001, 30.0, -90.0 + 0.002);
+	import_tiger_merge_self_test_add(pRecordsArray, "", MAP_OBJECT_TYPE_NONE, 34.0, -90.0, 34.0, -89.999);
+
+	// shuffle, and flip about half of them
+	GRand* pRand = g_rand_new_with_seed(2005);
+	for(i=pRecordsArray->len-1 ; i>0 ; i--) {
+		gint j = g_rand_int_range(pRand, 0, i + 1);
+		tiger_record_rt1_t temp = g_array_index(pRecordsArray, tiger_record_rt1_t, i);
+		g_array_index(pRecordsArray, tiger_record_rt1_t, i) = g_array_index(pRecordsArray, tiger_record_rt1_t, j);
+		g_array_index(pRecordsArray, tiger_record_rt1_t, j) = temp;
+	}
+	tiger_import_process_t* pImportProcess = g_new0(tiger_import_process_t, 1);
+	pImportProcess->pTableRT1 = tiger_table_new(sizeof(tiger_record_rt1_t), pRecordsArray->len);
+	for(i=0 ; i<pRecordsArray->len ; i++) {
+		tiger_record_rt1_t* pRecordRT1 = tiger_table_add(pImportProcess->pTableRT1);
+		*pRecordRT1 = g_array_index(pRecordsArray, tiger_record_rt1_t, i);
+		if(g_rand_boolean(pRand)) {
+			mappoint_t temp = pRecordRT1->PointA;
+			pRecordRT1->PointA = pRecordRT1->PointB;
+			pRecordRT1->PointB = temp;
+		}
+	}
+	g_rand_free(pRand);
+	g_array_free(pRecordsArray, TRUE);
+
+	tiger_table_t* pTable = pImportProcess->pTableRT1;
+	gint nNumRT1s = tiger_table_length(pTable);
+
+	GArray* pEndsArray = import_tiger_sort_rt1_ends(pImportProcess);
+	GArray* pSlotsArray = g_array_new(FALSE, FALSE, sizeof(gint));
+	GArray* pRunStartsArray = g_array_new(FALSE, FALSE, sizeof(gint));
+	import_tiger_merge_rt1_chains(pImportProcess, pEndsArray, pSlotsArray, pRunStartsArray);
+
+	gboolean bPassed = TRUE;
+
+	gint* anTimesEmitted = g_new0(gint, nNumRT1s);
+	for(i=0 ; i<pSlotsArray->len ; i++) {
+		anTimesEmitted[g_array_index(pSlotsArray, gint, i) / 2]++;
+	}
+	for(i=0 ; i<nNumRT1s ; i++) {
+		tiger_record_rt1_t* pRecordRT1 = tiger_table_index(pTable, i);
+		gint nExpected = (pRecordRT1->nRecordType == MAP_OBJECT_TYPE_NONE) ? 0 : 1;
+		if(anTimesEmitted[i] != nExpected) {
+			g_printerr("RT1 %d ('%s') was emitted %d times, expected %d\n", pRecordRT1->nTLID, pRecordRT1->achName, anTimesEmitted[i], nExpected);
+			bPassed = FALSE;
+		}
+	}
+	g_free(anTimesEmitted);
+
+	gint nNumRuns = pRunStartsArray->len - 1;
+	if(nNumRuns != nExpectedRuns) {
+		g_printerr("merged into %d runs, expected %d\n", nNumRuns, nExpectedRuns);
+		bPassed = FALSE;
+	}
+	gint iRun;
+	for(iRun=0 ; iRun<nNumRuns ; iRun++) {
+		gint iRunStart = g_array_index(pRunStartsArray, gint, iRun);
+		gint iRunEnd = g_array_index(pRunStartsArray, gint, iRun + 1);
+		if(iRunEnd <= iRunStart || (iRunEnd - iRunStart) > RT1_MERGE_MAX_CHAINS) {
+			g_printerr("run %d has %d chains\n", iRun, iRunEnd - iRunStart);
+			bPassed = FALSE;
+			continue;
+		}
+		for(i=iRunStart+1 ; i<iRunEnd ; i++) {
+			gint nLatitudeLeave, nLongitudeLeave, nLatitudeEnter, nLongitudeEnter;
+			import_tiger_merge_self_test_slot_point(pTable, g_array_index(pSlotsArray, gint, i-1) ^ 1, &nLatitudeLeave, &nLongitudeLeave);
+			import_tiger_merge_self_test_slot_point(pTable, g_array_index(pSlotsArray, gint, i), &nLatitudeEnter, &nLongitudeEnter);
+			if(nLatitudeLeave != nLatitudeEnter || nLongitudeLeave != nLongitudeEnter) {
+				g_printerr("run %d jumps between chains %d and %d\n", iRun, i-1 - iRunStart, i - iRunStart);
+				bPassed = FALSE;
+			}
+		}
+	}
+
+	g_array_free(pEndsArray, TRUE);
+	g_array_free(pSlotsArray, TRUE);
+	g_array_free(pRunStartsArray, TRUE);
+	tiger_table_free(pImportProcess->pTableRT1);
+	g_free(pImportProcess);
+	return bPassed;
+}
+
+typedef struct tiger_save_job {
+	tiger_import_process_t* pImportProcess;
+	gint iFirst;				// range of pTableRT1 (or, for a merged job, of runs)
+	gint nCount;
+
+	gboolean bMerged;
+	GArray* pSlotsArray;		// see import_tiger_merge_rt1_chains
+	GArray* pRunStartsArray;
+
+	GArray* pRoadsArray;		// tiger_pending_road_t, owned by the job until merged
+
+	GAsyncQueue* pDoneQueue;
+
+	importstats_t Stats;
+} tiger_save_job_t;
+
+static void import_tiger_save_job_thread(gpointer pData, gpointer pUserData)
+{
+	tiger_save_job_t* pJob = (tiger_save_job_t*)pData;
+
+	gint i;
+	for(i=pJob->iFirst ; i<(pJob->iFirst + pJob->nCount) ; i++) {
+		if(pJob->bMerged) {
+			gint iRunStart = g_array_index(pJob->pRunStartsArray, gint, i);
+			gint iRunEnd = g_array_index(pJob->pRunStartsArray, gint, i+1);
+			import_tiger_save_merged_chain(pJob->pImportProcess, &g_array_index(pJob->pSlotsArray, gint, iRunStart), iRunEnd - iRunStart, pJob->pRoadsArray, &(pJob->Stats));
+		}
+		else {
+			import_tiger_save_rt1_chain(pJob->pImportProcess, tiger_table_index(pJob->pImportProcess->pTableRT1, i), pJob->pRoadsArray, &(pJob->Stats));
+		}
+	}
+	g_async_queue_push(pJob->pDoneQueue, pJob);
+}
+
+static void import_tiger_queue_save_jobs(tiger_import_process_t* pImportProcess, GThreadPool* pPool, GPtrArray* pJobsArray, GAsyncQueue* pDoneQueue, gint nTotal, GArray* pSlotsArray, GArray* pRunStartsArray)
+{
+	gint iFirst;
+	for(iFirst=0 ; iFirst<nTotal ; iFirst += RT1_CHAINS_PER_SAVE_JOB) {
+		tiger_save_job_t* pJob = g_new0(tiger_save_job_t, 1);
+		pJob->pImportProcess = pImportProcess;
+		pJob->iFirst = iFirst;
+		pJob->nCount = MIN(RT1_CHAINS_PER_SAVE_JOB, nTotal - iFirst);
+		pJob->bMerged = (pSlotsArray != NULL);
+		pJob->pSlotsArray = pSlotsArray;
+		pJob->pRunStartsArray = pRunStartsArray;
+		pJob->pRoadsArray = g_array_new(FALSE, FALSE, sizeof(tiger_pending_road_t));
+		pJob->pDoneQueue = pDoneQueue;
+
+		g_ptr_array_add(pJobsArray, pJob);
+		g_thread_pool_push(pPool, pJob, NULL);
+	}
+}
+
+// Assemble and simplify chains on all of this county's threads, appending the results to pImportProcess->pRoadsArray
+static void import_tiger_save_rt1_chains(tiger_import_process_t* pImportProcess, const GArray* pEndsArray)
+{
+	gint nNumRT1s = tiger_table_length(pImportProcess->pTableRT1);
+
+	GArray* pSlotsArray = g_array_sized_new(FALSE, FALSE, sizeof(gint), nNumRT1s);
+	GArray* pRunStartsArray = g_array_new(FALSE, FALSE, sizeof(gint));
+	IMPORTSTATS_BEGIN(timer);
+	import_tiger_merge_rt1_chains(pImportProcess, pEndsArray, pSlotsArray, pRunStartsArray);
+	IMPORTSTATS_END(timer, &(pImportProcess->Stats), IMPORTSTATS_STAGE_CHAINS, 0);
+	gint nNumRuns = pRunStartsArray->len - 1;
+#ifdef ENABLE_IMPORT_STATS
+	g_print("joined %d RT1 chains into %d lines\n", pSlotsArray->len, nNumRuns);
+#endif
+
+	GAsyncQueue* pDoneQueue = g_async_queue_new();
+	GThreadPool* pPool = g_thread_pool_new(import_tiger_save_job_thread, NULL, pImportProcess->nThreads, FALSE, NULL);
+
+	// LOD 0 one RT1 at a time, the others a run at a time
+	GPtrArray* pJobsArray = g_ptr_array_new();
+	import_tiger_queue_save_jobs(pImportProcess, pPool, pJobsArray, pDoneQueue, nNumRT1s, NULL, NULL);
+	import_tiger_queue_save_jobs(pImportProcess, pPool, pJobsArray, pDoneQueue, nNumRuns, pSlotsArray, pRunStartsArray);
+
+	import_tiger_wait_for_jobs(pImportProcess, pDoneQueue, pJobsArray->len);
+	g_thread_pool_free(pPool, FALSE, TRUE);
+	g_async_queue_unref(pDoneQueue);
+
+	// merge in job order so the row order doesn't depend on thread timing
+	gint i;
+	for(i=0 ; i<pJobsArray->len ; i++) {
+		tiger_save_job_t* pJob = g_ptr_array_index(pJobsArray, i);
+		g_array_append_vals(pImportProcess->pRoadsArray, pJob->pRoadsArray->data, pJob->pRoadsArray->len);
+		g_array_free(pJob->pRoadsArray, TRUE);
+		IMPORTSTATS_MERGE(&(pImportProcess->Stats), &(pJob->Stats));
+		g_free(pJob);
+	}
+	g_ptr_array_free(pJobsArray, TRUE);
+
+	IMPORTSTATS_SAMPLE_RSS(&(pImportProcess->Stats), IMPORTSTATS_STAGE_CHAINS);
+	for(i=MAP_LEVEL_OF_DETAIL_BEST ; i<=MAP_LEVEL_OF_DETAIL_WORST ; i++) {
+		IMPORTSTATS_SAMPLE_RSS(&(pImportProcess->Stats), IMPORTSTATS_STAGE_SIMPLIFY_LOD0 + i);
+	}
+
+	g_array_free(pSlotsArray, TRUE);
+	g_array_free(pRunStartsArray, TRUE);
+}
+
+static void import_tiger_save_rtc_city(tiger_import_process_t* pImportProcess, tiger_record_rtc_t* pRecordRTc)
+{
+	g_assert(pRecordRTc != NULL);
+	g_assert(pImportProcess != NULL);
+
+	gint nCityID = 0;
+	if(!db_insert_city(pRecordRTc->achName, pImportProcess->nStateID, &nCityID)) {
+		g_warning("insert city %s failed\n", pRecordRTc->achName);
+	}
+	pRecordRTc->nCityID = nCityID;
+}
+
+// Twice the signed area of a ring (shoelace).  Positive for counter-clockwise rings.
+static gdouble import_tiger_ring_area(GArray* pRing)
+{
+	gdouble fArea = 0.0;
+	gint i;
+	for(i=0 ; i<pRing->len ; i++) {
+		mappoint_t* p1 = &g_array_index(pRing, mappoint_t, i);
+		mappoint_t* p2 = &g_array_index(pRing, mappoint_t, (i+1) % pRing->len);
+		fArea += (p1->fLongitude * p2->fLatitude) - (p2->fLongitude * p1->fLatitude);
+	}
+	return fArea;
+}
+
+static void import_tiger_ring_reverse(GArray* pRing)
+{
+	gint i,j;
+	for(i=0, j=pRing->len-1 ; i<j ; i++, j--) {
+		mappoint_t pt = g_array_index(pRing, mappoint_t, i);
+		g_array_index(pRing, mappoint_t, i) = g_array_index(pRing, mappoint_t, j);
+		g_array_index(pRing, mappoint_t, j) = pt;
+	}
+}
+
+// Which way p, q, r turn: positive if counter-clockwise, negative if clockwise, 0 if they're in a line
+static gdouble import_tiger_orientation(const mappoint_t* p, const mappoint_t* q, const mappoint_t* r)
+{
+	return ((q->fLongitude - p->fLongitude) * (r->fLatitude - p->fLatitude)) - ((q->fLatitude - p->fLatitude) * (r->fLongitude - p->fLongitude));
+}
+
+static gboolean import_tiger_points_equal(const mappoint_t* p, const mappoint_t* q)
+{
+	return (p->fLatitude == q->fLatitude && p->fLongitude == q->fLongitude);
+}
+
+// Is p (in a line with a and b) between them?
+static gboolean import_tiger_point_on_segment(const mappoint_t* p, const mappoint_t* a, const mappoint_t* b)
+{
+	return (p->fLongitude >= MIN(a->fLongitude, b->fLongitude) && p->fLongitude <= MAX(a->fLongitude, b->fLongitude) &&
+			p->fLatitude >= MIN(a->fLatitude, b->fLatitude) && p->fLatitude <= MAX(a->fLatitude, b->fLatitude));
+}
+
+// Do segments a-b and c-d meet anywhere?  Segments that share an end don't count, since rings meet like that.
+static gboolean import_tiger_segments_cross(const mappoint_t* a, const mappoint_t* b, const mappoint_t* c, const mappoint_t* d)
+{
+	if(import_tiger_points_equal(a, c) || import_tiger_points_equal(a, d) || import_tiger_points_equal(b, c) || import_tiger_points_equal(b, d)) {
+		return FALSE;
+	}
+	gdouble o1 = import_tiger_orientation(a, b, c);
+	gdouble o2 = import_tiger_orientation(a, b, d);
+	gdouble o3 = import_tiger_orientation(c, d, a);
+	gdouble o4 = import_tiger_orientation(c, d, b);
+
+	if(((o1 > 0.0 && o2 < 0.0) || (o1 < 0.0 && o2 > 0.0)) && ((o3 > 0.0 && o4 < 0.0) || (o3 < 0.0 && o4 > 0.0))) {
+		return TRUE;
+	}
+	// one touches the other
+	return ((o1 == 0.0 && import_tiger_point_on_segment(c, a, b)) ||
+			(o2 == 0.0 && import_tiger_point_on_segment(d, a, b)) ||
+			(o3 == 0.0 && import_tiger_point_on_segment(a, c, d)) ||
+			(o4 == 0.0 && import_tiger_point_on_segment(b, c, d)));
+}
+
+// Does the segment from pFrom to pTo cross any edge of pRing (stored without its closing point)?
+static gboolean import_tiger_ring_crossed_by(const GArray* pRing, const mappoint_t* pFrom, const mappoint_t* pTo)
+{
+	gint i;
+	for(i=0 ; i<pRing->len ; i++) {
+		if(import_tiger_segments_cross(pFrom, pTo, &g_array_index(pRing, mappoint_t, i), &g_array_index(pRing, mappoint_t, (i+1) % pRing->len))) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+typedef struct {
+	GArray* pRing;
+	gint iEastmost;		// index of its eastmost point
+} tiger_ring_hole_t;
+
+static gint import_tiger_ring_hole_compare(gconstpointer a, gconstpointer b)
+{
+	const tiger_ring_hole_t* pA = a;
+	const tiger_ring_hole_t* pB = b;
+	gdouble fA = g_array_index(pA->pRing, mappoint_t, pA->iEastmost).fLongitude;
+	gdouble fB = g_array_index(pB->pRing, mappoint_t, pB->iEastmost).fLongitude;
+	if(fA != fB) return (fA > fB) ? -1 : 1;		// east to west
+	return 0;
+}
+
+typedef struct {
+	gdouble fDistance;	// squared
+	gint iPoint;
+} tiger_ring_bridge_t;
+
+static gint import_tiger_ring_bridge_compare(gconstpointer a, gconstpointer b)
+{
+	const tiger_ring_bridge_t* pA = a;
+	const tiger_ring_bridge_t* pB = b;
+	if(pA->fDistance != pB->fDistance) return (pA->fDistance < pB->fDistance) ? -1 : 1;
+	return pA->iPoint - pB->iPoint;
+}
+
+// Cut each hole into pOuter with a zero-width 'keyhole' bridge: walk the outer ring to a point near the hole's
+// eastmost point, go around the hole, and come back the same way.  The result is one ring that both the even-odd
+// (cairo) and the polygon (GDK) fill leave the holes open in.  Rings must not include their closing points and
+// the holes must wind the opposite way from the outer ring.
+//
+// The bridge goes to the nearest outer point it can reach without crossing an edge of the outer ring or of any
+// hole, or the fill would leak out along it.  Holes are cut in east to west, so the ones east of a hole (that it
+// might otherwise have to get around) are already part of the outer ring and can be bridged to.
+static void import_tiger_ring_splice_holes(GArray* pOuter, const GPtrArray* pHolesArray)
+{
+	g_assert(pOuter->len > 0);
+
+	GArray* pHoleOrderArray = g_array_sized_new(FALSE, FALSE, sizeof(tiger_ring_hole_t), pHolesArray->len);
+	gint i;
+	for(i=0 ; i<pHolesArray->len ; i++) {
+		tiger_ring_hole_t hole;
+		hole.pRing = g_ptr_array_index(pHolesArray, i);
+		g_assert(hole.pRing->len > 0);
+
+		hole.iEastmost = 0;
+		gint j;
+		for(j=1 ; j<hole.pRing->len ; j++) {
+			if(g_array_index(hole.pRing, mappoint_t, j).fLongitude > g_array_index(hole.pRing, mappoint_t, hole.iEastmost).fLongitude) hole.iEastmost = j;
+		}
+		g_array_append_val(pHoleOrderArray, hole);
+	}
+	g_array_sort(pHoleOrderArray, import_tiger_ring_hole_compare);
+
+	GArray* pBridgesArray = g_array_new(FALSE, FALSE, sizeof(tiger_ring_bridge_t));
+	GArray* pSpliced = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+
+	gint iHole;
+	for(iHole=0 ; iHole<pHoleOrderArray->len ; iHole++) {
+		GArray* pHole = g_array_index(pHoleOrderArray, tiger_ring_hole_t, iHole).pRing;
+		gint iHolePoint = g_array_index(pHoleOrderArray, tiger_ring_hole_t, iHole).iEastmost;
+		mappoint_t* pHolePoint = &g_array_index(pHole, mappoint_t, iHolePoint);
+
+		// try the outer ring's points nearest first
+		g_array_set_size(pBridgesArray, pOuter->len);
+		for(i=0 ; i<pOuter->len ; i++) {
+			mappoint_t* pPoint = &g_array_index(pOuter, mappoint_t, i);
+			gdouble fDeltaX = pPoint->fLongitude - pHolePoint->fLongitude;
+			gdouble fDeltaY = pPoint->fLatitude - pHolePoint->fLatitude;
+			g_array_index(pBridgesArray, tiger_ring_bridge_t, i).fDistance = (fDeltaX * fDeltaX) + (fDeltaY * fDeltaY);
+			g_array_index(pBridgesArray, tiger_ring_bridge_t, i).iPoint = i;
+		}
+		g_array_sort(pBridgesArray, import_tiger_ring_bridge_compare);
 
-		// insert record
-		if(pRecordRT7->nRecordType != MAP_OBJECT_TYPE_NONE) {
-			if(pRecordRT7->nRecordType == MAP_OBJECT_TYPE_RIVER) {
-				pRecordRT7->nRecordType = MAP_OBJECT_TYPE_LAKE;
-				g_debug("river => lake");
+		gint iOuter = g_array_index(pBridgesArray, tiger_ring_bridge_t, 0).iPoint;	// if nothing is clear (bad data), the nearest
+		for(i=0 ; i<pBridgesArray->len ; i++) {
+			gint iCandidate = g_array_index(pBridgesArray, tiger_ring_bridge_t, i).iPoint;
+			mappoint_t* pOuterPoint = &g_array_index(pOuter, mappoint_t, iCandidate);
+
+			gboolean bClear = !import_tiger_ring_crossed_by(pOuter, pHolePoint, pOuterPoint);
+			gint iOther;
+			for(iOther=iHole ; iOther<pHoleOrderArray->len && bClear ; iOther++) {	// this hole and the ones still to come
+				bClear = !import_tiger_ring_crossed_by(g_array_index(pHoleOrderArray, tiger_ring_hole_t, iOther).pRing, pHolePoint, pOuterPoint);
+			}
+			if(bClear) {
+				iOuter = iCandidate;
+				break;
 			}
+		}
+
+		// outer[0..iOuter], hole[iHolePoint..end], hole[0..iHolePoint], outer[iOuter..end]
+		g_array_set_size(pSpliced, 0);
+		g_array_append_vals(pSpliced, &g_array_index(pOuter, mappoint_t, 0), iOuter + 1);
+		g_array_append_vals(pSpliced, &g_array_index(pHole, mappoint_t, iHolePoint), pHole->len - iHolePoint);
+		g_array_append_vals(pSpliced, &g_array_index(pHole, mappoint_t, 0), iHolePoint + 1);
+		g_array_append_vals(pSpliced, &g_array_index(pOuter, mappoint_t, iOuter), pOuter->len - iOuter);
+
+		g_array_set_size(pOuter, 0);
+		g_array_append_vals(pOuter, pSpliced->data, pSpliced->len);
+	}
+	g_array_free(pSpliced, TRUE);
+	g_array_free(pBridgesArray, TRUE);
+	g_array_free(pHoleOrderArray, TRUE);
+}
+
+// The direction from pPoints[iFrom] to the first point after it (stepping by nStep) that isn't on top of it.
+// (0,0) if there isn't one.
+static void import_tiger_points_heading(const GArray* pPoints, gint iFrom, gint nStep, gdouble* pfDeltaX, gdouble* pfDeltaY)
+{
+	*pfDeltaX = 0.0;
+	*pfDeltaY = 0.0;
+	if(iFrom < 0 || iFrom >= pPoints->len) return;
+
+	const mappoint_t* pFrom = &g_array_index(pPoints, mappoint_t, iFrom);
+	gint i;
+	for(i=iFrom+nStep ; i>=0 && i<pPoints->len ; i+=nStep) {
+		const mappoint_t* pTo = &g_array_index(pPoints, mappoint_t, i);
+		if(!import_tiger_points_equal(pFrom, pTo)) {
+			*pfDeltaX = pTo->fLongitude - pFrom->fLongitude;
+			*pfDeltaY = pTo->fLatitude - pFrom->fLatitude;
+			return;
+		}
+	}
+}
+
+// How far a walk heading along (fInX,fInY) turns to head along (fOutX,fOutY): from -pi (hard right) through 0
+// (straight on) to pi (hard left, back the way it came)
+static gdouble import_tiger_turn_angle(gdouble fInX, gdouble fInY, gdouble fOutX, gdouble fOutY)
+{
+	gdouble fAngle = atan2((fInX * fOutY) - (fInY * fOutX), (fInX * fOutX) + (fInY * fOutY));
+	return (fAngle <= -G_PI) ? G_PI : fAngle;
+}
+
+// Join a polygon's edges into rings.  Edge i goes through the points in apEdgePoints[i], from the point with
+// TZID anEndTZIDs[2*i] to the one with anEndTZIDs[2*i + 1].  This is just like dominos!  Only instead of matching
+// white dots we're matching TZIDs.  And like a domino, an edge can be in the wrong order, in which case we add its
+// points in *reverse*.  A polygon with islands in it has more than one ring.
+//
+// Where more than two edges meet (a figure-8, or a hole that touches the outside) a walk always takes the edge
+// that turns furthest right, counting the edge it started with as one of the choices back at its start.  So rings
+// touch there but never cross, and a ring doesn't close early at its start while it still has a way to go on.
+//
+// The rings are added to pRingsArray without their closing points.  Returns FALSE if a walk found no way back
+// to where it started.
+static gboolean import_tiger_join_rings(GArray** apEdgePoints, const gint* anEndTZIDs, gint nNumEdges, GPtrArray* pRingsArray)
+{
+	//
+	// Index the edges by TZID.  Each edge has two ends (slot 2*i is end A, 2*i+1 is end B).  The hash maps a TZID
+	// to its first slot (+1, so it's never NULL) and anNextSlot chains the other slots at the same TZID.
+	//
+	gint* anNextSlot = g_new(gint, nNumEdges * 2);
+	gboolean* abUsed = g_new0(gboolean, nNumEdges);
+	GHashTable* pTZIDHash = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	gint iSlot;
+	for(iSlot=0 ; iSlot<nNumEdges*2 ; iSlot++) {
+		anNextSlot[iSlot] = GPOINTER_TO_INT(g_hash_table_lookup(pTZIDHash, GINT_TO_POINTER(anEndTZIDs[iSlot]))) - 1;
+		g_hash_table_insert(pTZIDHash, GINT_TO_POINTER(anEndTZIDs[iSlot]), GINT_TO_POINTER(iSlot + 1));
+	}
 
-			gint nRoadNameID = 0;
-			if(pRecordRT7->achName[0] != '\0') {
-				//g_printf("inserting area name %s\n", pRecordRT7->achName);
-				db_insert_roadname(pRecordRT7->achName, 0, &nRoadNameID);
+	gboolean bAllClosed = TRUE;
+	gint iStartEdge;
+	for(iStartEdge=0 ; iStartEdge<nNumEdges ; iStartEdge++) {
+		if(abUsed[iStartEdge]) continue;
+
+		// we'll use the first edge in forward order, that is A->B...
+		GArray* pRing = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+		GArray* pEdge = apEdgePoints[iStartEdge];
+		abUsed[iStartEdge] = TRUE;
+		g_array_append_vals(pRing, pEdge->data, pEdge->len);
+
+		// ...so B is the last TZID for now.
+		gint nStartTZID = anEndTZIDs[iStartEdge*2];
+		gint nLastTZID = anEndTZIDs[iStartEdge*2 + 1];
+
+		while(TRUE) {
+			gdouble fInX, fInY, fOutX, fOutY;
+			import_tiger_points_heading(pRing, pRing->len - 1, -1, &fInX, &fInY);
+			fInX = -fInX;
+			fInY = -fInY;
+
+			// back at the start, closing the ring is one of the choices
+			gint iBestSlot = -1;
+			gdouble fBestAngle = G_MAXDOUBLE;
+			if(nLastTZID == nStartTZID) {
+				import_tiger_points_heading(pRing, 0, 1, &fOutX, &fOutY);
+				fBestAngle = import_tiger_turn_angle(fInX, fInY, fOutX, fOutY);
 			}
 
-			// Write LOD 0
-			gint nLOD;
-			for(nLOD = MAP_LEVEL_OF_DETAIL_BEST ; nLOD <= MAP_LEVEL_OF_DETAIL_WORST ; nLOD++) {
-				if(!object_type_exists_at_lod(pRecordRT7->nRecordType, nLOD)) continue;
-
-				GArray* pReducedPointsArray = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
-
-				gdouble fTolerance = object_type_tolerance_at_lod(pRecordRT7->nRecordType, nLOD);
-				map_math_simplify_pointstring(pTempPointsArray, fTolerance, pReducedPointsArray);
-
-				// Need three points to form a polygon
-				if(pReducedPointsArray->len >= 3) {
-					if(nLOD == MAP_LEVEL_OF_DETAIL_BEST) {
-						db_insert_road(nLOD, nRoadNameID, pRecordRT7->nRecordType, 0, 0, 0, 0, 0, 0, "", "", 
-									   pReducedPointsArray, NULL);
-					}
-					else {
-						db_insert_road(nLOD, nRoadNameID, pRecordRT7->nRecordType, 0, 0, 0, 0, 0, 0, NULL, NULL,
-									   pReducedPointsArray, NULL);
-					}
-					g_debug("%s reduced from %d to %d points at LOD %d\n", pRecordRT7->achName, pTempPointsArray->len, pReducedPointsArray->len, nLOD);
+			// the unused edges with an end at nLastTZID
+			for(iSlot = GPOINTER_TO_INT(g_hash_table_lookup(pTZIDHash, GINT_TO_POINTER(nLastTZID))) - 1 ; iSlot != -1 ; iSlot = anNextSlot[iSlot]) {
+				if(abUsed[iSlot/2]) continue;
+
+				pEdge = apEdgePoints[iSlot/2];
+				if(is_even(iSlot)) {
+					import_tiger_points_heading(pEdge, 0, 1, &fOutX, &fOutY);
 				}
 				else {
-					g_debug("%s had %d and was excluded at LOD %d\n", pRecordRT7->achName, pTempPointsArray->len, nLOD);
-					//g_debug("%s reduced from %d to %d points\n", pRecordRT7->achName, pTempPointsArray->len, pReducedPointsArray->len);
+					import_tiger_points_heading(pEdge, pEdge->len - 1, -1, &fOutX, &fOutY);
+				}
+				gdouble fAngle = import_tiger_turn_angle(fInX, fInY, fOutX, fOutY);
+				if(fAngle < fBestAngle) {
+					fBestAngle = fAngle;
+					iBestSlot = iSlot;
+				}
+			}
+
+			if(iBestSlot == -1) {
+				// closed, or no next domino-match
+				if(nLastTZID != nStartTZID) bAllClosed = FALSE;
+				break;
+			}
+
+			pEdge = apEdgePoints[iBestSlot/2];
+			abUsed[iBestSlot/2] = TRUE;
+			if(is_even(iBestSlot)) {
+				// matched on A: add points in order (A->B)
+				g_array_append_vals(pRing, pEdge->data, pEdge->len);
+				nLastTZID = anEndTZIDs[iBestSlot + 1];
+			}
+			else {
+				// matched on B: add points in REVERSE order (B->A)
+				gint i;
+				for(i=pEdge->len-1 ; i>=0 ; i--) {
+					g_array_append_val(pRing, g_array_index(pEdge, mappoint_t, i));
 				}
-				g_array_free(pReducedPointsArray, TRUE);
+				nLastTZID = anEndTZIDs[iBestSlot - 1];
+			}
+		}
+
+		//
+		// IMPORTANT: Remove last point!
+		//  A) It's the same as first, so there's no reason to store it.
+		//  B) It lets us use 'map_math_simplify_pointstring' which doesn't work on closed polygons.
+		//
+		// NOTE: We copy the last point to the first when loading this polygon
+		//
+		if(pRing->len > 1) {
+			mappoint_t* p1 = &g_array_index(pRing, mappoint_t, 0);
+			mappoint_t* p2 = &g_array_index(pRing, mappoint_t, pRing->len-1);
+			if(import_tiger_points_equal(p1, p2)) {
+				pRing->len--;
 			}
 		}
-	}
-	g_array_free(pTempPointsArray, TRUE);
 
-	// we SHOULD have used all RT1 links up!
-	if(pRecordRTi->pRT1LinksArray->len > 0) {
-		//g_warning("RT1 Links remain:\n");
-		while(pRecordRTi->pRT1LinksArray->len > 0) {
-			tiger_rt1_link_t* pTemp = g_ptr_array_remove_index(pRecordRTi->pRT1LinksArray, 0);
-			//g_print("  (A-TZID:%d B-TZID:%d)\n", pTemp->nPointATZID, pTemp->nPointBTZID);
-			g_free( pTemp );
+		if(pRing->len >= 3) {	// takes 3 to make a polygon
+			g_ptr_array_add(pRingsArray, pRing);
+		}
+		else {
+			g_array_free(pRing, TRUE);
 		}
 	}
+	g_hash_table_destroy(pTZIDHash);
+	g_free(anNextSlot);
+	g_free(abUsed);
+	return bAllClosed;
 }
 
-//
-//
-//
-static gboolean import_tiger_from_directory(const gchar* pszDirectoryPath, gint nTigerSetNumber);
-static gboolean import_tiger_from_buffers(char* pBufferMET, gint nLengthMET, char* pBufferRT1, gint nLengthRT1, char* pBufferRT2, gint nLengthRT2,	char* pBufferRT7, gint nLengthRT7,	char* pBufferRT8, gint nLengthRT8, char* pBufferRTc, gint nLengthRTc, char* pBufferRTi, gint nLengthRTi);
+// Self-test (see import_tiger_self_test)
+static GArray* import_tiger_ring_self_test_points(const gdouble* afLongitudeLatitude, gint nNumPoints)
+{
+	GArray* pPointsArray = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+	gint i;
+	for(i=0 ; i<nNumPoints ; i++) {
+		mappoint_t point;
+		point.fLongitude = afLongitudeLatitude[i*2];
+		point.fLatitude = afLongitudeLatitude[i*2 + 1];
+		g_array_append_val(pPointsArray, point);
+	}
+	return pPointsArray;
+}
 
-gboolean import_tiger_from_uri(const gchar* pszURI, gint nTigerSetNumber)
+static gboolean import_tiger_ring_self_test_crosses_itself(const GArray* pRing)
 {
-#ifdef USE_GNOME_VFS
-	//g_print("pszURI = %s\n", pszURI);
+	gint i,j;
+	for(i=0 ; i<pRing->len ; i++) {
+		for(j=i+1 ; j<pRing->len ; j++) {
+			if(import_tiger_segments_cross(&g_array_index(pRing, mappoint_t, i), &g_array_index(pRing, mappoint_t, (i+1) % pRing->len),
+										   &g_array_index(pRing, mappoint_t, j), &g_array_index(pRing, mappoint_t, (j+1) % pRing->len))) {
+				return TRUE;
+			}
+		}
+	}
+	return FALSE;
+}
 
-	importwindow_progress_pulse();
+static gboolean import_tiger_ring_self_test(void)
+{
+	gboolean bPassed = TRUE;
+	gint i;
 
 	//
-	// Make a temporary directory
+	// A figure-8 whose loops touch at TZID 1, starting there: one ring, touching itself but not crossing
 	//
-	gchar* pszTempDir = g_strdup_printf("%s/roadster", g_get_tmp_dir());
-	gnome_vfs_make_directory(pszTempDir, 0700);
-	gchar* pszLocalFileUri  = g_strdup_printf("file:///%s/tiger.zip", pszTempDir);
-
-	// convert from "file:///path/to/file" to "/path/to/file" (only works on local files)
-	gchar* pszLocalFilePath = gnome_vfs_get_local_path_from_uri(pszLocalFileUri);
-	if(pszLocalFilePath == NULL) {
-		g_warning("import_tiger_from_uri: gnome_vfs_get_local_path_from_uri failed (not local?)\n");
-		return FALSE;
+	const gdouble afEdge0[] = {0,0, -1,1, -2,0};	// 1 -> 3
+	const gdouble afEdge1[] = {-2,0, -1,-1, 0,0};	// 3 -> 1
+	const gdouble afEdge2[] = {1,1, 0,0};			// 5 -> 1 (backwards around the loop)
+	const gdouble afEdge3[] = {2,0, 1,1};			// 6 -> 5 (backwards)
+	const gdouble afEdge4[] = {0,0, 1,-1, 2,0};		// 1 -> 6
+	const gint anEndTZIDs[] = {1,3, 3,1, 5,1, 6,5, 1,6};
+	GArray* apEdgePoints[5];
+	apEdgePoints[0] = import_tiger_ring_self_test_points(afEdge0, 3);
+	apEdgePoints[1] = import_tiger_ring_self_test_points(afEdge1, 3);
+	apEdgePoints[2] = import_tiger_ring_self_test_points(afEdge2, 2);
+	apEdgePoints[3] = import_tiger_ring_self_test_points(afEdge3, 2);
+	apEdgePoints[4] = import_tiger_ring_self_test_points(afEdge4, 3);
+
+	GPtrArray* pRingsArray = g_ptr_array_new();
+	if(!import_tiger_join_rings(apEdgePoints, anEndTZIDs, 5, pRingsArray)) {
+		g_printerr("figure-8 didn't close\n");
+		bPassed = FALSE;
+	}
+	if(pRingsArray->len != 1) {
+		g_printerr("figure-8 made %d rings, expected 1\n", pRingsArray->len);
+		bPassed = FALSE;
+	}
+	else {
+		GArray* pRing = g_ptr_array_index(pRingsArray, 0);
+		if(pRing->len != (3+3+2+2+3) - 1) {	// every edge's points, less the closing point
+			g_printerr("figure-8 ring has %d points, expected %d\n", pRing->len, (3+3+2+2+3) - 1);
+			bPassed = FALSE;
+		}
+		if(import_tiger_ring_self_test_crosses_itself(pRing)) {
+			g_printerr("figure-8 ring crosses itself\n");
+			bPassed = FALSE;
+		}
+	}
+	for(i=0 ; i<pRingsArray->len ; i++) {
+		g_array_free(g_ptr_array_index(pRingsArray, i), TRUE);
+	}
+	g_ptr_array_free(pRingsArray, TRUE);
+	for(i=0 ; i<5 ; i++) {
+		g_array_free(apEdgePoints[i], TRUE);
 	}
-	
-	GnomeVFSURI *src = gnome_vfs_uri_new(pszURI);
-	GnomeVFSURI *dst = gnome_vfs_uri_new(pszLocalFileUri);
-	gnome_vfs_xfer_uri(src, dst, GNOME_VFS_XFER_DEFAULT, GNOME_VFS_XFER_ERROR_MODE_ABORT, GNOME_VFS_XFER_OVERWRITE_MODE_REPLACE, NULL, NULL);
 
 	//
-	// Create unzip command line
+	// Two holes near the west side.  The nearest outer point to each is on the far side of itself or of
+	// the other one, so the bridges have to go around.
 	//
-	gchar* pszCommandLine = g_strdup_printf("unzip -qq -o -j %s -d %s -x *RT4 *RT5 *RT6 *RTA *RTE *RTH *RTP *RTR *RTT *RTS *RTZ", pszLocalFilePath, pszTempDir);
-	// NOTE: to use other TIGER file types, remove them from the 'exclude' list (-x)
-	// -qq = be very quiet (no output)
-	// -o = overwrite files without prompting
-	// -j = don't create directories (shouldn't be any)
-	// -d = next argument is directory to extract to
-	// -x = Exclude list follows
-
-	g_free(pszLocalFilePath); pszLocalFilePath = NULL;
-
-	// run unzip
-	gint nExitStatus=0;
-	gboolean bUnzipOK = g_spawn_command_line_sync(pszCommandLine,
-                                             NULL, //gchar **standard_output,
-                                             NULL, //gchar **standard_error,
-                                             &nExitStatus, //gint *exit_status,
-                                             NULL); //GError **error);
-
-	g_free(pszCommandLine);	pszCommandLine = NULL;
-
-	if(!bUnzipOK || nExitStatus != 0) {
-		g_free(pszTempDir);
-
-		g_warning("error involking unzip command (exit status = %d)\n", nExitStatus);
-		return FALSE;
+	const gdouble afOuter[] = {0,0, 10,0, 10,10, 0,10, 0,5};	// counter-clockwise
+	const gdouble afHoleA[] = {1,4, 1,6, 2,5};					// clockwise
+	const gdouble afHoleB[] = {0.5,2, 0.5,3, 1.5,2.5};			// clockwise, across the way from A to (0,0)
+	GArray* pOuter = import_tiger_ring_self_test_points(afOuter, 5);
+	GPtrArray* pHolesArray = g_ptr_array_new();
+	g_ptr_array_add(pHolesArray, import_tiger_ring_self_test_points(afHoleB, 3));
+	g_ptr_array_add(pHolesArray, import_tiger_ring_self_test_points(afHoleA, 3));
+
+	import_tiger_ring_splice_holes(pOuter, pHolesArray);
+	if(pOuter->len != 5 + (3+2) + (3+2)) {
+		g_printerr("spliced ring has %d points, expected %d\n", pOuter->len, 5 + (3+2) + (3+2));
+		bPassed = FALSE;
+	}
+	if(import_tiger_ring_self_test_crosses_itself(pOuter)) {
+		g_printerr("a hole's bridge crosses an edge\n");
+		bPassed = FALSE;
+	}
+	for(i=0 ; i<pHolesArray->len ; i++) {
+		g_array_free(g_ptr_array_index(pHolesArray, i), TRUE);
+	}
+	g_ptr_array_free(pHolesArray, TRUE);
+	g_array_free(pOuter, TRUE);
+
+	return bPassed;
+}
+
+// pLinksArray holds one polygon's RTi links (tiger_record_rti_t).
+// Simplify a ring (stored without its closing point) keeping its locked points.  The ring is simplified as a line
+// from one locked point all the way around back to it, so each edge between two locked points is simplified
+// the same way as the neighboring polygon that shares it.
+static void import_tiger_simplify_ring_locked(const GArray* pRing, const gint8* pabLocked, gdouble fTolerance, GArray* pOutput)
+{
+	gint nNumPoints = pRing->len;
+	gint iStart;
+	for(iStart=0 ; iStart<nNumPoints ; iStart++) {
+		if(pabLocked[iStart]) break;
+	}
+	if(iStart == nNumPoints) {
+		map_math_simplify_pointstring(pRing, fTolerance, pOutput);
+		return;
 	}
 
-	gboolean bSuccess = import_tiger_from_directory(pszTempDir, nTigerSetNumber);
+	// rotate to start at iStart and close the ring
+	GArray* pRotated = g_array_sized_new(FALSE, FALSE, sizeof(mappoint_t), nNumPoints + 1);
+	gint8* pabRotatedLocked = g_new(gint8, nNumPoints + 1);
+	gint i;
+	for(i=0 ; i<=nNumPoints ; i++) {
+		gint iFrom = (iStart + i) % nNumPoints;
+		g_array_append_val(pRotated, g_array_index(pRing, mappoint_t, iFrom));
+		pabRotatedLocked[i] = pabLocked[iFrom];
+	}
 
-	g_print("success = %d\n", bSuccess?1:0);
-	
-	g_free(pszTempDir);
-	return bSuccess;
-#endif
+	map_math_simplify_pointstring_locked(pRotated, pabRotatedLocked, fTolerance, pOutput);
+	if(pOutput->len > 1) g_array_set_size(pOutput, pOutput->len - 1);	// drop the closing point again
+
+	g_free(pabRotatedLocked);
+	g_array_free(pRotated, TRUE);
 }
 
-static gboolean import_tiger_from_directory(const gchar* pszDirectoryPath, gint nTigerSetNumber)
+static void import_tiger_save_rti_polygon(tiger_import_process_t* pImportProcess, GArray* pLinksArray)
 {
-#ifdef USE_GNOME_VFS
-	g_print("import_tiger_from_directory\n");
+	g_assert(pImportProcess != NULL);
+	g_assert(pLinksArray != NULL);
+	g_assert(pLinksArray->len >= 1);
 
-	gchar* pszFilePath;
+	//
+	// pLinksArray has the RT1 chains that make up this polygon.
+	// our job here is to stitch them together into rings.
+	//
+	gint nPOLYID = g_array_index(pLinksArray, tiger_record_rti_t, 0).nPOLYID;
 
-	gchar* apszExtensions[7] = {"MET", "RT1", "RT2", "RT7", "RT8", "RTC", "RTI"};	
-	char* apBuffers[G_N_ELEMENTS(apszExtensions)] = {0};
-	gint nSizes[G_N_ELEMENTS(apszExtensions)] = {0};
+	// lookup table8 (polygon-landmark link) record by POLYID
+	tiger_record_rt8_t* pRecordRT8 = tiger_table_lookup(pImportProcess->pTableRT8, nPOLYID);
+	if(pRecordRT8 == NULL) return;	// allowed to be null(?)
 
-	// open, read, and delete (unlink) each file
+	// lookup table7 (landmark) record by LANDID
+	tiger_record_rt7_t* pRecordRT7 = tiger_table_lookup(pImportProcess->pTableRT7, pRecordRT8->nLANDID);
+	if(pRecordRT7 == NULL) return;	// allowed to be null(?)
+
+	if(pRecordRT7->nRecordType == MAP_OBJECT_TYPE_NONE) return;
+
+	// now we have landmark data (name, type)
+	IMPORTSTATS_BEGIN(polygonTimer);
+
+	//
+	// Stitch the RT1 chains together into rings
+	//
+	gint nNumLinks = pLinksArray->len;
+	GArray** apLinkPointsArrays = g_new(GArray*, nNumLinks);
+	gint* anEndTZIDs = g_new(gint, nNumLinks * 2);
 	gint i;
-	gboolean bSuccess = TRUE;
-	for(i=0 ; i<G_N_ELEMENTS(apszExtensions) ; i++) {
-		pszFilePath = g_strdup_printf("file://%s/TGR%05d.%s", pszDirectoryPath, nTigerSetNumber, apszExtensions[i]);
-		if(GNOME_VFS_OK != gnome_vfs_read_entire_file(pszFilePath, &nSizes[i], (char**)&apBuffers[i])) {
-			bSuccess = FALSE;
+	for(i=0 ; i<nNumLinks ; i++) {
+		tiger_record_rti_t* pLink = &g_array_index(pLinksArray, tiger_record_rti_t, i);
+		apLinkPointsArrays[i] = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+		tiger_util_add_RT1_points_to_array(pImportProcess, pLink->nTLID, apLinkPointsArrays[i], ORDER_FORWARD);
+		anEndTZIDs[i*2] = pLink->nPointATZID;
+		anEndTZIDs[i*2 + 1] = pLink->nPointBTZID;
+	}
+
+	GPtrArray* pRingsArray = g_ptr_array_new();
+	if(!import_tiger_join_rings(apLinkPointsArrays, anEndTZIDs, nNumLinks, pRingsArray)) {
+		g_warning("Found a polygon that doesn't loop %s\n", pRecordRT7->achName);
+	}
+	for(i=0 ; i<nNumLinks ; i++) {
+		g_array_free(apLinkPointsArrays[i], TRUE);
+	}
+	g_free(apLinkPointsArrays);
+	g_free(anEndTZIDs);
+
+	if(pRingsArray->len == 0) {
+		g_ptr_array_free(pRingsArray, TRUE);
+		IMPORTSTATS_END(polygonTimer, &(pImportProcess->Stats), IMPORTSTATS_STAGE_POLYGONS, 1);
+		return;
+	}
+
+	//
+	// The ring with the largest area is the outside, the rest are holes (islands in a lake, etc.).
+	// Wind the outside counter-clockwise and the holes clockwise, then cut the holes into the outside.
+	// (A ring beside the outside rather than in it, like the other loop of a figure-8, is cut in the same
+	// way: the even-odd fill fills it all the same.)
+	//
+	gint iOuter = 0;
+	gdouble fOuterArea = 0.0;
+	gint iRing;
+	for(iRing=0 ; iRing<pRingsArray->len ; iRing++) {
+		gdouble fArea = fabs(import_tiger_ring_area(g_ptr_array_index(pRingsArray, iRing)));
+		if(fArea > fOuterArea) {
+			fOuterArea = fArea;
+			iOuter = iRing;
 		}
-		gnome_vfs_unlink(pszFilePath);
-		g_free(pszFilePath);
 	}
 
-	// did we read all files?
-	if(bSuccess) {
-		gint nStateID = (nTigerSetNumber / 1000);	// int division (eg. turn 25017 into 25)
-		GSList *states;
-		for (states = tiger_get_states(); states; states = g_slist_next(states))
-		{
-			struct tiger_state *st = g_slist_nth_data(states, 0);
+	GArray* pTempPointsArray = g_ptr_array_index(pRingsArray, iOuter);
+	if(import_tiger_ring_area(pTempPointsArray) < 0.0) import_tiger_ring_reverse(pTempPointsArray);
 
-			if (nStateID == atoi(st->fips_code))
-			{
-				gint nCountryID = 1;	// USA is #1 *gag*
-				db_insert_state(st->name, st->abbrev, nCountryID, &g_nStateID);
-				break;
-			}
+	g_ptr_array_remove_index_fast(pRingsArray, iOuter);
+	for(iRing=0 ; iRing<pRingsArray->len ; iRing++) {
+		GArray* pHole = g_ptr_array_index(pRingsArray, iRing);
+		if(import_tiger_ring_area(pHole) > 0.0) import_tiger_ring_reverse(pHole);
+	}
+	import_tiger_ring_splice_holes(pTempPointsArray, pRingsArray);
+	for(iRing=0 ; iRing<pRingsArray->len ; iRing++) {
+		g_array_free(g_ptr_array_index(pRingsArray, iRing), TRUE);
+	}
+	g_ptr_array_free(pRingsArray, TRUE);
+
+	// save this polygon
+	if(pRecordRT7->nRecordType == MAP_OBJECT_TYPE_RIVER) {
+		pRecordRT7->nRecordType = MAP_OBJECT_TYPE_LAKE;
+		g_debug("river => lake");
+	}
+	IMPORTSTATS_END(polygonTimer, &(pImportProcess->Stats), IMPORTSTATS_STAGE_POLYGONS, 1);
+
+	// Write LOD 0
+	gint nLOD;
+	for(nLOD = MAP_LEVEL_OF_DETAIL_BEST ; nLOD <= MAP_LEVEL_OF_DETAIL_WORST ; nLOD++) {
+		if(!object_type_exists_at_lod(pRecordRT7->nRecordType, nLOD)) continue;
+
+		GArray* pReducedPointsArray = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+
+		IMPORTSTATS_BEGIN(simplifyTimer);
+		gdouble fTolerance = object_type_tolerance_at_lod(pRecordRT7->nRecordType, nLOD);
+		gint8* pabLocked = (nLOD == MAP_LEVEL_OF_DETAIL_BEST) ? NULL : import_tiger_get_locked_points(pImportProcess, pTempPointsArray);
+		if(pabLocked != NULL) {
+			import_tiger_simplify_ring_locked(pTempPointsArray, pabLocked, fTolerance, pReducedPointsArray);
+			g_free(pabLocked);
 		}
+		else {
+			map_math_simplify_pointstring(pTempPointsArray, fTolerance, pReducedPointsArray);
+		}
+		IMPORTSTATS_END(simplifyTimer, &(pImportProcess->Stats), IMPORTSTATS_STAGE_SIMPLIFY_LOD0 + nLOD, 1);
 
-		g_assert(G_N_ELEMENTS(apszExtensions) == 7);
-		bSuccess = import_tiger_from_buffers(apBuffers[0], nSizes[0], apBuffers[1], nSizes[1], apBuffers[2], nSizes[2], apBuffers[3], nSizes[3], apBuffers[4], nSizes[4], apBuffers[5], nSizes[5], apBuffers[6], nSizes[6]);
+		// Need three points to form a polygon
+		if(pReducedPointsArray->len >= 3) {
+			g_debug("%s reduced from %d to %d points at LOD %d\n", pRecordRT7->achName, pTempPointsArray->len, pReducedPointsArray->len, nLOD);
+
+			// the road takes ownership of pReducedPointsArray
+			import_tiger_add_pending_road(pImportProcess->pRoadsArray,
+				import_road_new(nLOD, pRecordRT7->nRecordType, pRecordRT7->achName, 0, pReducedPointsArray), NULL, NULL);
+		}
+		else {
+			g_debug("%s had %d and was excluded at LOD %d\n", pRecordRT7->achName, pTempPointsArray->len, nLOD);
+			g_array_free(pReducedPointsArray, TRUE);
+		}
 	}
-	for(i=0 ; i<G_N_ELEMENTS(apszExtensions) ; i++) {
-		g_free(apBuffers[i]); // can be null
+	g_array_free(pTempPointsArray, TRUE);
+}
+
+// Stitch and simplify every polygon.  A polygon's links are together in the sorted RTi table.
+static void import_tiger_save_rti_polygons(tiger_import_process_t* pImportProcess)
+{
+	GArray* pLinksArray = g_array_new(FALSE, FALSE, sizeof(tiger_record_rti_t));	// reused for each polygon
+
+	gint nNumLinks = tiger_table_length(pImportProcess->pTableRTi);
+	gint iFirst = 0;
+	while(iFirst < nNumLinks) {
+		gint nPOLYID = tiger_table_key(tiger_table_index(pImportProcess->pTableRTi, iFirst));
+		gint iEnd = iFirst + 1;
+		while(iEnd < nNumLinks && tiger_table_key(tiger_table_index(pImportProcess->pTableRTi, iEnd)) == nPOLYID) {
+			iEnd++;
+		}
+
+		g_array_append_vals(pLinksArray, tiger_table_index(pImportProcess->pTableRTi, iFirst), iEnd - iFirst);
+		import_tiger_save_rti_polygon(pImportProcess, pLinksArray);
+		g_array_set_size(pLinksArray, 0);
+
+		iFirst = iEnd;
 	}
-	return bSuccess;
-#endif
+	g_array_free(pLinksArray, TRUE);
+
+	IMPORTSTATS_SAMPLE_RSS(&(pImportProcess->Stats), IMPORTSTATS_STAGE_POLYGONS);
 }
 
-static gboolean import_tiger_from_buffers(
-	char* pBufferMET, gint nLengthMET,
-	char* pBufferRT1, gint nLengthRT1,
-	char* pBufferRT2, gint nLengthRT2,
-	char* pBufferRT7, gint nLengthRT7,
-	char* pBufferRT8, gint nLengthRT8,
-	char* pBufferRTc, gint nLengthRTc,
-	char* pBufferRTi, gint nLengthRTi)
+//
+// Stages
+//
+// A county is imported in three stages: fetch (read the archive, I/O bound), parse (decompress, parse, stitch
+// and simplify, CPU bound) and write (DB bound).  Each stage may be run on a different thread,
+// so none of them touch GTK.
+//
+// Load the lists that the stages read from worker threads.  Call from the main thread before running any stage.
+void import_tiger_prepare(void)
 {
-	//	g_hash_table_lookup
-//	g_assert(func_progress_callback != NULL);
+	// both of these load on first use, which would race in the threads
+	gint nSuffixID;
+	road_suffix_atoi("", &nSuffixID);
+	tiger_get_states();
+}
 
-	tiger_import_process_t importProcess = {0};
+// Call before parsing any county
+void import_tiger_set_lock_shared_vertices(gboolean bLock)
+{
+	g_bLockSharedVertices = bLock;
+}
 
-	// Parse each file
-	importwindow_log_append(".");
-	importwindow_progress_pulse();	
+tiger_import_process_t* import_tiger_process_new(const gchar* pszURI, gint nTigerSetNumber)
+{
+	g_assert(pszURI != NULL);
 
-	g_print("parsing MET\n");
-	gchar* pszZeroTerminatedBufferMET = g_malloc(nLengthMET + 1);
-	memcpy(pszZeroTerminatedBufferMET, pBufferMET, nLengthMET);
-	pszZeroTerminatedBufferMET[nLengthMET] = '\0';
-		import_tiger_parse_MET(pszZeroTerminatedBufferMET, &importProcess);
-	g_free(pszZeroTerminatedBufferMET);
-	g_print("MET Title: %s\n", importProcess.pszFileDescription );
+	tiger_import_process_t* pNew = g_new0(tiger_import_process_t, 1);
+	pNew->pszURI = g_strdup(pszURI);
+	pNew->nTigerSetNumber = nTigerSetNumber;
+	pNew->nThreads = import_tiger_get_thread_count();
+	return pNew;
+}
 
-	importwindow_log_append(".");
-	importwindow_progress_pulse();
+void import_tiger_process_set_thread_count(tiger_import_process_t* pImportProcess, gint nThreads)
+{
+	g_assert(pImportProcess != NULL);
+	pImportProcess->nThreads = MAX(nThreads, 1);
+}
 
-	// a list of RT1 records that make up the boundary of this county
-	importProcess.pBoundaryRT1s = g_ptr_array_new();
+// NOTE: only pass a pulse function if the stages will be run on the main thread
+void import_tiger_process_set_pulse_function(tiger_import_process_t* pImportProcess, void (*pfnPulse)(void))
+{
+	g_assert(pImportProcess != NULL);
+	pImportProcess->pfnPulse = pfnPulse;
+}
 
-	g_print("parsing RT1\n");
-	importProcess.pTableRT1 = g_hash_table_new_full(g_int_hash, g_int_equal, NULL, g_free);
-	import_tiger_parse_table_1(pBufferRT1, nLengthRT1, importProcess.pTableRT1, importProcess.pBoundaryRT1s);
-	g_print("RT1: %d records\n", g_hash_table_size(importProcess.pTableRT1));
+static void import_tiger_process_pulse(tiger_import_process_t* pImportProcess)
+{
+	if(pImportProcess->pfnPulse != NULL) pImportProcess->pfnPulse();
+}
 
-	importwindow_log_append(".");
-	importwindow_progress_pulse();
+gboolean import_tiger_process_fetch(tiger_import_process_t* pImportProcess)
+{
+#ifdef USE_GNOME_VFS
+	g_assert(pImportProcess != NULL);
+	g_assert(pImportProcess->pArchive == NULL);
+	//g_print("pszURI = %s\n", pImportProcess->pszURI);
 
-	g_print("parsing RT2\n");
-	importProcess.pTableRT2 = g_hash_table_new_full(g_int_hash, g_int_equal, NULL, callback_free_rt2);
-	import_tiger_parse_table_2(pBufferRT2, nLengthRT2, importProcess.pTableRT2);
-	g_print("RT2: %d records\n", g_hash_table_size(importProcess.pTableRT2));
+	// Just the compressed archive is read here.  The members are decompressed as they're parsed.
+	IMPORTSTATS_BEGIN(timer);
+	if(GNOME_VFS_OK != gnome_vfs_read_entire_file(pImportProcess->pszURI, &(pImportProcess->nArchiveLength), &(pImportProcess->pArchive))) {
+		g_warning("import_tiger_process_fetch: couldn't read %s\n", pImportProcess->pszURI);
+		return FALSE;
+	}
+	IMPORTSTATS_END(timer, &(pImportProcess->Stats), IMPORTSTATS_STAGE_READ, pImportProcess->nArchiveLength);
+	IMPORTSTATS_SAMPLE_RSS(&(pImportProcess->Stats), IMPORTSTATS_STAGE_READ);
 
-	importwindow_log_append(".");
-	importwindow_progress_pulse();
+	pImportProcess->pZip = zipreader_new(pImportProcess->pArchive, pImportProcess->nArchiveLength);
+	if(pImportProcess->pZip == NULL) {
+		return FALSE;
+	}
 
-	g_print("parsing RT7\n");
-	importProcess.pTableRT7 = g_hash_table_new_full(g_int_hash, g_int_equal, NULL, g_free);
-	import_tiger_parse_table_7(pBufferRT7, nLengthRT7, importProcess.pTableRT7);
-	g_print("RT7: %d records\n", g_hash_table_size(importProcess.pTableRT7));
+	// make sure it has everything we need
+	gint i;
+	for(i=0 ; i<TIGER_FILE_COUNT ; i++) {
+		if(import_tiger_find_member(pImportProcess, i) == NULL) {
+			g_warning("import_tiger_process_fetch: TGR%05d.%s is missing\n", pImportProcess->nTigerSetNumber, g_apszTigerFileExtensions[i]);
+			return FALSE;
+		}
+	}
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
 
-	importwindow_log_append(".");
-	importwindow_progress_pulse();
+gboolean import_tiger_process_parse(tiger_import_process_t* pImportProcess)
+{
+	g_assert(pImportProcess != NULL);
+	g_assert(pImportProcess->pZip != NULL);
 
-	g_print("parsing RT8\n");
-	importProcess.pTableRT8 = g_hash_table_new_full(g_int_hash, g_int_equal, NULL, g_free);
-	import_tiger_parse_table_8(pBufferRT8, nLengthRT8, importProcess.pTableRT8);
-	g_print("RT8: %d records\n", g_hash_table_size(importProcess.pTableRT8));
+	g_print("parsing MET\n");
+	IMPORTSTATS_BEGIN(timer);
+	gchar* pszZeroTerminatedBufferMET;
+	gint nLengthMET;
+	if(!zipreader_read_entire_entry(pImportProcess->pZip, import_tiger_find_member(pImportProcess, TIGER_FILE_MET), &pszZeroTerminatedBufferMET, &nLengthMET)) {
+		return FALSE;
+	}
+	import_tiger_parse_MET(pszZeroTerminatedBufferMET, pImportProcess);
+	g_free(pszZeroTerminatedBufferMET);
+	IMPORTSTATS_END(timer, &(pImportProcess->Stats), IMPORTSTATS_STAGE_PARSE_MET, 1);
+	g_print("MET Title: %s\n", pImportProcess->pszFileDescription);
 
-	importwindow_log_append(".");
-	importwindow_progress_pulse();
+	import_tiger_process_pulse(pImportProcess);
 
-	g_print("parsing RTc\n");
-	importProcess.pTableRTc = g_hash_table_new_full(g_int_hash, g_int_equal, NULL, g_free);
-	import_tiger_parse_table_c(pBufferRTc, nLengthRTc, importProcess.pTableRTc);
-	g_print("RTc: %d records\n", g_hash_table_size(importProcess.pTableRTc));
+	// Decompress and parse RT1, RT2, RT7, RT8, RTc and RTi concurrently
+	g_print("parsing RT1, RT2, RT7, RT8, RTc, RTi\n");
+	gboolean bSuccess = import_tiger_parse_tables(pImportProcess);
 
-	g_print("parsing RTi\n");
-	importProcess.pTableRTi = g_hash_table_new_full(g_int_hash, g_int_equal, NULL, callback_free_rti);
-	import_tiger_parse_table_i(pBufferRTi, nLengthRTi, importProcess.pTableRTi);
-	g_print("RTi: %d records\n", g_hash_table_size(importProcess.pTableRTi));
+	// the archive isn't needed any more
+	zipreader_free(pImportProcess->pZip); pImportProcess->pZip = NULL;
+	g_free(pImportProcess->pArchive); pImportProcess->pArchive = NULL;
 
-	importwindow_log_append(".");
-	importwindow_progress_pulse();
+	if(!bSuccess) return FALSE;
 
-	//
-	// Insert cities first
-	//
-	g_print("iterating over RTc cities...\n");
-	g_hash_table_foreach(importProcess.pTableRTc, callback_save_rtc_cities, &importProcess);
-	g_print("done.\n");
-	
-	importwindow_log_append(".");
-	importwindow_progress_pulse();
+	import_tiger_process_pulse(pImportProcess);
+
+	pImportProcess->pRoadsArray = g_array_new(FALSE, FALSE, sizeof(tiger_pending_road_t));
+
+	// Find where chains meet, for joining chains and (optionally) locking the junctions before polygons are simplified
+	IMPORTSTATS_BEGIN(timerEnds);
+	GArray* pEndsArray = import_tiger_sort_rt1_ends(pImportProcess);
+	if(g_bLockSharedVertices) {
+		import_tiger_find_junctions(pImportProcess, pEndsArray);
+#ifdef ENABLE_IMPORT_STATS
+		g_print("locking %d junctions\n", pImportProcess->pJunctionsArray->len);
+#endif
+	}
+	IMPORTSTATS_END(timerEnds, &(pImportProcess->Stats), IMPORTSTATS_STAGE_CHAINS, 0);
 
 	//
-	// Stitch and insert polygons
+	// Stitch polygons
 	//
 	g_print("iterating over RTi polygons...\n");
-	g_hash_table_foreach(importProcess.pTableRTi, callback_save_rti_polygons, &importProcess);
+	import_tiger_save_rti_polygons(pImportProcess);
 	g_print("done.\n");
 
-	importwindow_log_append(".");
-	importwindow_progress_pulse();
+	import_tiger_process_pulse(pImportProcess);
 
 	//
 	// Roads
 	//
 	g_print("iterating over RT1 chains...\n");
-	g_hash_table_foreach(importProcess.pTableRT1, callback_save_rt1_chains, &importProcess);
+	import_tiger_save_rt1_chains(pImportProcess, pEndsArray);
+	g_print("done (%d roads and polygons).\n", pImportProcess->pRoadsArray->len);
+
+	g_array_free(pEndsArray, TRUE);
+	if(pImportProcess->pJunctionsArray) {
+		g_array_free(pImportProcess->pJunctionsArray, TRUE); pImportProcess->pJunctionsArray = NULL;
+	}
+
+	//
+	// free up all tables but RTc, which the write stage needs for CityIDs (one free per table)
+	//
+	tiger_table_free(pImportProcess->pTableRT1); pImportProcess->pTableRT1 = NULL;
+	tiger_table_free(pImportProcess->pTableRT2); pImportProcess->pTableRT2 = NULL;
+	tiger_table_free(pImportProcess->pTableRT7); pImportProcess->pTableRT7 = NULL;
+	tiger_table_free(pImportProcess->pTableRT8); pImportProcess->pTableRT8 = NULL;
+	tiger_table_free(pImportProcess->pTableRTi); pImportProcess->pTableRTi = NULL;
+	return TRUE;
+}
+
+gboolean import_tiger_process_write(tiger_import_process_t* pImportProcess)
+{
+	g_assert(pImportProcess != NULL);
+	g_assert(pImportProcess->pRoadsArray != NULL);
+
+	//
+	// State
+	//
+	gint nStateFIPS = (pImportProcess->nTigerSetNumber / 1000);	// int division (eg. turn 25017 into 25)
+	GSList *states;
+	for (states = tiger_get_states(); states; states = g_slist_next(states))
+	{
+		struct tiger_state *st = g_slist_nth_data(states, 0);
+
+		if (nStateFIPS == atoi(st->fips_code))
+		{
+			gint nCountryID = 1;	// USA is #1 *gag*
+			db_insert_state(st->name, st->abbrev, nCountryID, &(pImportProcess->nStateID));
+			break;
+		}
+	}
+
+	//
+	// Insert cities first
+	//
+	g_print("iterating over RTc cities...\n");
+	IMPORTSTATS_BEGIN(timer);
+	gint iCity;
+	for(iCity=0 ; iCity<tiger_table_length(pImportProcess->pTableRTc) ; iCity++) {
+		import_tiger_save_rtc_city(pImportProcess, tiger_table_index(pImportProcess->pTableRTc, iCity));
+	}
+	IMPORTSTATS_END(timer, &(pImportProcess->Stats), IMPORTSTATS_STAGE_CITIES, tiger_table_length(pImportProcess->pTableRTc));
+	IMPORTSTATS_SAMPLE_RSS(&(pImportProcess->Stats), IMPORTSTATS_STAGE_CITIES);
 	g_print("done.\n");
 
-	importwindow_log_append(".");
-	importwindow_progress_pulse();
-g_print("cleaning up\n");
+	import_tiger_process_pulse(pImportProcess);
+
 	//
-	// free up the importprocess structure
+	// Roads and polygons, now that their CityIDs are known
 	//
-	g_hash_table_destroy(importProcess.pTableRT1);
-	g_hash_table_destroy(importProcess.pTableRT2);
-	g_hash_table_destroy(importProcess.pTableRT7);
-	g_hash_table_destroy(importProcess.pTableRT8);
-	g_hash_table_destroy(importProcess.pTableRTc);
-	
-	// XXX: this call sometimes segfaults:
-	//g_warning("leaking some memory due to unsolved bug in import.  just restart roadster after/between imports ;)\n");
-	g_hash_table_destroy(importProcess.pTableRTi);
-
-	g_free(importProcess.pszFileDescription);
+	pImportProcess->pWriter = import_writer_new(WRITER_MAX_QUEUED_ROADS, &(pImportProcess->Stats));
+
+	gint i;
+	for(i=0 ; i<pImportProcess->pRoadsArray->len ; i++) {
+		tiger_pending_road_t* pPending = &g_array_index(pImportProcess->pRoadsArray, tiger_pending_road_t, i);
+		if(pPending->pCityLeft != NULL) pPending->pRoad->nCityLeftID = pPending->pCityLeft->nCityID;
+		if(pPending->pCityRight != NULL) pPending->pRoad->nCityRightID = pPending->pCityRight->nCityID;
+
+		import_writer_add_road(pImportProcess->pWriter, pPending->pRoad);	// NOTE: may block if the writer is behind
+		pPending->pRoad = NULL;	// the writer owns it now
+	}
+	g_array_free(pImportProcess->pRoadsArray, TRUE);
+	pImportProcess->pRoadsArray = NULL;
+
+	// wait for the writer to finish
+	import_writer_close(pImportProcess->pWriter);
+	if(pImportProcess->pfnPulse != NULL) {
+		while(!import_writer_is_done(pImportProcess->pWriter)) {
+			g_usleep(JOB_PULSE_INTERVAL_MSEC * 1000);
+			pImportProcess->pfnPulse();
+		}
+	}
+	import_writer_free(pImportProcess->pWriter);	// joins the thread
+	pImportProcess->pWriter = NULL;
+	g_print("done.\n");
+
+	tiger_table_free(pImportProcess->pTableRTc); pImportProcess->pTableRTc = NULL;
 	return TRUE;
 }
 
+void import_tiger_process_free(tiger_import_process_t* pImportProcess)
+{
+	g_assert(pImportProcess != NULL);
+	g_assert(pImportProcess->pWriter == NULL);
+
+	// any of these can be left over if a stage failed
+	if(pImportProcess->pZip) zipreader_free(pImportProcess->pZip);
+	g_free(pImportProcess->pArchive);
+	if(pImportProcess->pTableRT1) tiger_table_free(pImportProcess->pTableRT1);
+	if(pImportProcess->pTableRT2) tiger_table_free(pImportProcess->pTableRT2);
+	if(pImportProcess->pTableRT7) tiger_table_free(pImportProcess->pTableRT7);
+	if(pImportProcess->pTableRT8) tiger_table_free(pImportProcess->pTableRT8);
+	if(pImportProcess->pTableRTc) tiger_table_free(pImportProcess->pTableRTc);
+	if(pImportProcess->pTableRTi) tiger_table_free(pImportProcess->pTableRTi);
+	if(pImportProcess->pJunctionsArray) g_array_free(pImportProcess->pJunctionsArray, TRUE);
+	if(pImportProcess->pRoadsArray) {
+		gint i;
+		for(i=0 ; i<pImportProcess->pRoadsArray->len ; i++) {
+			import_road_free(g_array_index(pImportProcess->pRoadsArray, tiger_pending_road_t, i).pRoad);
+		}
+		g_array_free(pImportProcess->pRoadsArray, TRUE);
+	}
+	g_free(pImportProcess->pszFileDescription);
+	g_free(pImportProcess->pszURI);
+	g_free(pImportProcess);
+}
+
+// Where the stages have spent their time so far.  All zeros unless built with ENABLE_IMPORT_STATS.
+// NOTE: don't call while a stage is running
+const importstats_t* import_tiger_process_get_stats(tiger_import_process_t* pImportProcess)
+{
+	g_assert(pImportProcess != NULL);
+	return &(pImportProcess->Stats);
+}
+
+// Does pszURI name a TIGER file (TGR00000.ZIP)?  If so, return its set number (the county's FIPS code).
+gboolean import_tiger_get_set_number(const gchar* pszURI, gint* pnReturnTigerSetNumber)
+{
+#ifdef USE_GNOME_VFS
+	g_assert(pszURI != NULL);
+	g_assert(pnReturnTigerSetNumber != NULL);
+
+	GnomeVFSFileInfo *info = gnome_vfs_file_info_new();
+	if(GNOME_VFS_OK != gnome_vfs_get_file_info(pszURI, info, GNOME_VFS_FILE_INFO_DEFAULT)) {
+		gnome_vfs_file_info_unref(info);
+		return FALSE;
+	}
+
+	gboolean bResult = FALSE;
+	gchar* pszFileBaseName = info->name;
+	if(pszFileBaseName != NULL && strlen(pszFileBaseName) == 12 && g_str_has_prefix(pszFileBaseName, "TGR") && g_str_has_suffix(pszFileBaseName, ".ZIP")) {
+		gchar buf[6];
+		memcpy(buf, &pszFileBaseName[3], 5);
+		buf[5] = '\0';
+
+		*pnReturnTigerSetNumber = atoi(buf);
+		bResult = TRUE;
+	}
+
+	// free file info
+	gnome_vfs_file_info_unref(info);
+	return bResult;
+#else
+	return FALSE;
+#endif
+}
+
+// Check the importer's internals that can be checked without a TIGER file.  Prints what failed (on stderr) and returns FALSE.
+gboolean import_tiger_self_test(void)
+{
+	gboolean bPassed = TRUE;
+	if(!import_tiger_decoder_self_test()) {
+		g_printerr("TIGER field decoders don't match the old ones\n");
+		bPassed = FALSE;
+	}
+	if(!import_tiger_merge_self_test()) {
+		g_printerr("TIGER chain joining lost or repeated chains\n");
+		bPassed = FALSE;
+	}
+	if(!import_tiger_ring_self_test()) {
+		g_printerr("TIGER polygon rings were joined or spliced wrong\n");
+		bPassed = FALSE;
+	}
+	return bPassed;
+}
+
 #ifdef ROADSTER_DEAD_CODE
 static void debug_print_string(char* str, gint len)
 {
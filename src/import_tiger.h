@@ -28,8 +28,28 @@ G_BEGIN_DECLS
 
 #include <gtk/gtk.h>
 #include "db.h"
+#include "import_stats.h"
 
-gboolean import_tiger_from_uri(const gchar* pszURI, gint nTigerSetNumber);
+typedef struct tiger_import_process tiger_import_process_t;
+
+void import_tiger_prepare(void);
+void import_tiger_set_lock_shared_vertices(gboolean bLock);
+
+// One county's import, as separate stages that can run on different threads (see import_scheduler.c)
+tiger_import_process_t* import_tiger_process_new(const gchar* pszURI, gint nTigerSetNumber);
+void import_tiger_process_set_thread_count(tiger_import_process_t* pImportProcess, gint nThreads);
+void import_tiger_process_set_pulse_function(tiger_import_process_t* pImportProcess, void (*pfnPulse)(void));
+gboolean import_tiger_process_fetch(tiger_import_process_t* pImportProcess);	// I/O
+gboolean import_tiger_process_parse(tiger_import_process_t* pImportProcess);	// CPU
+gboolean import_tiger_process_write(tiger_import_process_t* pImportProcess);	// DB
+void import_tiger_process_free(tiger_import_process_t* pImportProcess);
+const importstats_t* import_tiger_process_get_stats(tiger_import_process_t* pImportProcess);
+
+gint import_tiger_get_thread_count(void);
+
+gboolean import_tiger_get_set_number(const gchar* pszURI, gint* pnReturnTigerSetNumber);
+
+gboolean import_tiger_self_test(void);
 
 G_END_DECLS
 
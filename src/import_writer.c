@@ -0,0 +1,389 @@
+/***************************************************************************
+ *            import_writer.c
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+Purpose of import_writer.c:
+ - The single consumer of the import pipeline: a thread that drains a bounded
+   queue of finished roads into batched multi-row INSERTs
+ - Resolves road names to RoadNameIDs (with a cache, since names repeat a lot)
+ - Buckets each road into the tiles it touches and writes those as tile blobs (see map_tileblob.c), plus an
+   empty marker for each tile in the area it covered that nothing at all is in
+*/
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <glib.h>
+
+#include "main.h"
+#include "db.h"
+#include "map_math.h"
+#include "map_tileblob.h"
+#include "import_writer.h"
+
+#define IMPORT_WRITER_TILE_BUFFER_MAX_BYTES	(32*1024*1024)	// flush tile blobs to the DB when they get this big
+
+static import_road_t g_EndOfQueueMarker;	// pushed by import_writer_free() to stop the thread
+
+typedef struct {
+	gint32 nTileX;
+	gint32 nTileY;
+	GByteArray* pData;
+} import_tile_t;
+
+import_road_t* import_road_new(gint nLOD, gint nTypeID, const gchar* pszName, gint nSuffixID, GArray* pPointsArray)
+{
+	import_road_t* pNew = g_new0(import_road_t, 1);
+	pNew->nLOD = nLOD;
+	pNew->nTypeID = nTypeID;
+	pNew->pszName = g_strdup((pszName != NULL) ? pszName : "");
+	pNew->nSuffixID = nSuffixID;
+	pNew->pPointsArray = pPointsArray;
+	return pNew;
+}
+
+void import_road_free(import_road_t* pRoad)
+{
+	g_free(pRoad->pszName);
+	g_array_free(pRoad->pPointsArray, TRUE);
+	g_free(pRoad);
+}
+
+static gint import_writer_get_roadname_id(importwriter_t* pWriter, const gchar* pszName, gint nSuffixID)
+{
+	if(pszName[0] == '\0') return 0;
+
+	gchar* pszKey = g_strdup_printf("%s\t%d", pszName, nSuffixID);
+	gpointer pValue = g_hash_table_lookup(pWriter->pRoadNameIDHash, pszKey);
+	if(pValue != NULL) {
+		g_free(pszKey);
+		return GPOINTER_TO_INT(pValue);
+	}
+
+	gint nRoadNameID = 0;
+	db_insert_roadname(pszName, nSuffixID, &nRoadNameID);
+	g_hash_table_insert(pWriter->pRoadNameIDHash, pszKey, GINT_TO_POINTER(nRoadNameID));	// takes pszKey
+	return nRoadNameID;
+}
+
+//
+// Tile blobs
+//
+static guint import_tile_hash(gconstpointer p)
+{
+	const import_tile_t* pTile = p;
+	return ((guint)pTile->nTileX * 65599) ^ (guint)pTile->nTileY;
+}
+
+static gboolean import_tile_equal(gconstpointer pA, gconstpointer pB)
+{
+	const import_tile_t* pTileA = pA;
+	const import_tile_t* pTileB = pB;
+	return (pTileA->nTileX == pTileB->nTileX && pTileA->nTileY == pTileB->nTileY);
+}
+
+static void import_tile_free(gpointer p)
+{
+	import_tile_t* pTile = p;
+	g_byte_array_free(pTile->pData, TRUE);
+	g_free(pTile);
+}
+
+static import_tile_t* import_writer_lookup_tile(importwriter_t* pWriter, gint nLOD, gint32 nTileX, gint32 nTileY)
+{
+	import_tile_t key;
+	key.nTileX = nTileX;
+	key.nTileY = nTileY;
+	return g_hash_table_lookup(pWriter->apTileHashes[nLOD], &key);
+}
+
+static GByteArray* import_writer_get_tile_blob(importwriter_t* pWriter, gint nLOD, gint32 nTileX, gint32 nTileY)
+{
+	import_tile_t* pTile = import_writer_lookup_tile(pWriter, nLOD, nTileX, nTileY);
+	if(pTile == NULL) {
+		pTile = g_new0(import_tile_t, 1);
+		pTile->nTileX = nTileX;
+		pTile->nTileY = nTileY;
+		pTile->pData = g_byte_array_new();
+		g_hash_table_insert(pWriter->apTileHashes[nLOD], pTile, pTile);
+	}
+	return pTile->pData;
+}
+
+static void import_writer_add_road_to_tiles(importwriter_t* pWriter, const import_road_t* pRoad)
+{
+	if(pRoad->pPointsArray->len == 0) return;
+
+	maprect_t rcBoundingBox;
+	map_util_calculate_bounding_box(pRoad->pPointsArray, &rcBoundingBox);
+
+	if(pWriter->bTilesCovered) {
+		map_util_bounding_box_union(&(pWriter->rcTilesCovered), &rcBoundingBox);
+	}
+	else {
+		pWriter->rcTilesCovered = rcBoundingBox;
+		pWriter->bTilesCovered = TRUE;
+	}
+
+	gint32 nTileX1 = map_tileblob_tile_index(rcBoundingBox.A.fLongitude, pRoad->nLOD);
+	gint32 nTileX2 = map_tileblob_tile_index(rcBoundingBox.B.fLongitude, pRoad->nLOD);
+	gint32 nTileY1 = map_tileblob_tile_index(rcBoundingBox.A.fLatitude, pRoad->nLOD);
+	gint32 nTileY2 = map_tileblob_tile_index(rcBoundingBox.B.fLatitude, pRoad->nLOD);
+
+	// Polygons that span tiles are clipped to each one.  Lines are not: the renderer (and labels)
+	// want the whole line, and that's what the old MBRIntersects query returned for each tile.
+	gboolean bClip = map_object_type_is_polygon(pRoad->nTypeID) && (nTileX1 != nTileX2 || nTileY1 != nTileY2);
+
+	gint32 nTileX, nTileY;
+	for(nTileY = nTileY1 ; nTileY <= nTileY2 ; nTileY++) {
+		for(nTileX = nTileX1 ; nTileX <= nTileX2 ; nTileX++) {
+			const GArray* pPointsArray = pRoad->pPointsArray;
+			if(bClip) {
+				maprect_t rcTile;
+				map_tileblob_tile_rect(pRoad->nLOD, nTileX, nTileY, &rcTile);
+
+				pPointsArray = map_math_clip_polygon_to_worldrect(&g_array_index(pRoad->pPointsArray, mappoint_t, 0), pRoad->pPointsArray->len, &rcTile, pWriter->pClipBuffer);
+				if(pPointsArray->len < 3) continue;		// bounding box touches this tile but the polygon doesn't
+			}
+
+			GByteArray* pBlob = import_writer_get_tile_blob(pWriter, pRoad->nLOD, nTileX, nTileY);
+			guint uOldLength = pBlob->len;
+			map_tileblob_append_record(pBlob, pRoad->nTypeID, pRoad->pszName, pRoad->nSuffixID,
+				pRoad->nAddressLeftStart, pRoad->nAddressLeftEnd,
+				pRoad->nAddressRightStart, pRoad->nAddressRightEnd,
+				pPointsArray);
+			pWriter->nTileBytesBuffered += (pBlob->len - uOldLength);
+		}
+	}
+}
+
+static void import_writer_write_tile(importwriter_t* pWriter, gint nLOD, gint32 nTileX, gint32 nTileY, const guint8* pData, gint nLength)
+{
+	if(!db_tile_append(nLOD, nTileX, nTileY, pData, nLength)) {
+		g_warning("couldn't write tile %d,%d at LOD %d\n", nTileX, nTileY, nLOD);
+		pWriter->nTileWriteFailures++;
+	}
+}
+
+typedef struct {
+	importwriter_t* pWriter;
+	gint nLOD;
+} import_tile_flush_t;
+
+static void import_writer_flush_tile_callback(gpointer pKey, gpointer pValue, gpointer pData)
+{
+	import_tile_t* pTile = pValue;
+	import_tile_flush_t* pFlush = pData;
+
+	if(pTile->pData->len == 0) return;	// nothing new since the last flush
+
+	import_writer_write_tile(pFlush->pWriter, pFlush->nLOD, pTile->nTileX, pTile->nTileY, pTile->pData->data, pTile->pData->len);
+
+	// the tile stays in the hash (so we know it isn't empty) but its memory goes
+	g_byte_array_free(pTile->pData, TRUE);
+	pTile->pData = g_byte_array_new();
+}
+
+static void import_writer_flush_tiles(importwriter_t* pWriter)
+{
+	import_tile_flush_t flush;
+	flush.pWriter = pWriter;
+	for(flush.nLOD = MAP_LEVEL_OF_DETAIL_BEST ; flush.nLOD <= MAP_LEVEL_OF_DETAIL_WORST ; flush.nLOD++) {
+		g_hash_table_foreach(pWriter->apTileHashes[flush.nLOD], import_writer_flush_tile_callback, &flush);
+	}
+	pWriter->nTileBytesBuffered = 0;
+}
+
+// Mark each tile in the area we covered that nothing was written to as empty, so the tile manager knows
+// not to bother with the slow spatial query on the Road tables.  (db_tile_mark_empty leaves alone any
+// tile that another import wrote to, or that has Road rows from before we had tiles.)
+static void import_writer_write_empty_tiles(importwriter_t* pWriter)
+{
+	if(!pWriter->bTilesCovered) return;
+
+	gint nLOD;
+	for(nLOD = MAP_LEVEL_OF_DETAIL_BEST ; nLOD <= MAP_LEVEL_OF_DETAIL_WORST ; nLOD++) {
+		gint32 nTileX1 = map_tileblob_tile_index(pWriter->rcTilesCovered.A.fLongitude, nLOD);
+		gint32 nTileX2 = map_tileblob_tile_index(pWriter->rcTilesCovered.B.fLongitude, nLOD);
+		gint32 nTileY1 = map_tileblob_tile_index(pWriter->rcTilesCovered.A.fLatitude, nLOD);
+		gint32 nTileY2 = map_tileblob_tile_index(pWriter->rcTilesCovered.B.fLatitude, nLOD);
+
+		gint32 nTileX, nTileY;
+		for(nTileY = nTileY1 ; nTileY <= nTileY2 ; nTileY++) {
+			for(nTileX = nTileX1 ; nTileX <= nTileX2 ; nTileX++) {
+				if(import_writer_lookup_tile(pWriter, nLOD, nTileX, nTileY) == NULL) {
+					maprect_t rcTile;
+					map_tileblob_tile_rect(nLOD, nTileX, nTileY, &rcTile);
+					if(!db_tile_mark_empty(nLOD, nTileX, nTileY, &rcTile)) {
+						g_warning("couldn't mark tile %d,%d at LOD %d empty\n", nTileX, nTileY, nLOD);
+						pWriter->nTileWriteFailures++;
+					}
+				}
+			}
+		}
+	}
+}
+
+static gpointer import_writer_thread(gpointer pData)
+{
+	importwriter_t* pWriter = (importwriter_t*)pData;
+	db_thread_init();
+	IMPORTSTATS_BEGIN(timer);
+
+	while(TRUE) {
+		import_road_t* pRoad = g_async_queue_pop(pWriter->pQueue);
+		if(pRoad == &g_EndOfQueueMarker) break;
+
+		// make room for producers
+		g_mutex_lock(pWriter->pQueueMutex);
+		pWriter->nQueued--;
+		g_cond_signal(pWriter->pQueueNotFullCond);
+		g_mutex_unlock(pWriter->pQueueMutex);
+
+		gint nRoadNameID = import_writer_get_roadname_id(pWriter, pRoad->pszName, pRoad->nSuffixID);
+
+		db_road_batch_t* pBatch = pWriter->apBatches[pRoad->nLOD];
+		db_road_batch_add(pBatch, nRoadNameID, pRoad->nTypeID,
+			pRoad->nAddressLeftStart, pRoad->nAddressLeftEnd,
+			pRoad->nAddressRightStart, pRoad->nAddressRightEnd,
+			pRoad->nCityLeftID, pRoad->nCityRightID,
+			pRoad->azZIPCodeLeft, pRoad->azZIPCodeRight,
+			pRoad->pPointsArray);
+		if(db_road_batch_is_full(pBatch)) {
+			db_road_batch_flush(pBatch);
+		}
+
+#ifdef ENABLE_TILE_BLOBS
+		import_writer_add_road_to_tiles(pWriter, pRoad);
+		if(pWriter->nTileBytesBuffered >= IMPORT_WRITER_TILE_BUFFER_MAX_BYTES) {
+			import_writer_flush_tiles(pWriter);
+		}
+#endif
+
+		pWriter->nRoadsWritten++;
+		import_road_free(pRoad);
+	}
+
+	// write the stragglers
+	gint nLOD;
+	for(nLOD = MAP_LEVEL_OF_DETAIL_BEST ; nLOD <= MAP_LEVEL_OF_DETAIL_WORST ; nLOD++) {
+		db_road_batch_flush(pWriter->apBatches[nLOD]);
+	}
+	import_writer_flush_tiles(pWriter);
+	import_writer_write_empty_tiles(pWriter);
+
+	if(pWriter->pStats != NULL) {
+		IMPORTSTATS_END(timer, pWriter->pStats, IMPORTSTATS_STAGE_DB_WRITE, pWriter->nRoadsWritten);
+		IMPORTSTATS_SAMPLE_RSS(pWriter->pStats, IMPORTSTATS_STAGE_DB_WRITE);
+	}
+	db_thread_end();
+	g_atomic_int_set(&pWriter->nDone, TRUE);
+	return NULL;
+}
+
+importwriter_t* import_writer_new(gint nMaxQueued, importstats_t* pStats)
+{
+	g_assert(nMaxQueued > 0);
+
+	importwriter_t* pNew = g_new0(importwriter_t, 1);
+	pNew->pQueue = g_async_queue_new();
+	pNew->pQueueMutex = g_mutex_new();
+	pNew->pQueueNotFullCond = g_cond_new();
+	pNew->nMaxQueued = nMaxQueued;
+	pNew->pStats = pStats;
+	pNew->pRoadNameIDHash = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	pNew->pClipBuffer = map_math_clipbuffer_new();
+
+	gint nLOD;
+	for(nLOD = MAP_LEVEL_OF_DETAIL_BEST ; nLOD <= MAP_LEVEL_OF_DETAIL_WORST ; nLOD++) {
+		pNew->apBatches[nLOD] = db_road_batch_new(nLOD);
+		pNew->apTileHashes[nLOD] = g_hash_table_new_full(import_tile_hash, import_tile_equal, NULL, import_tile_free);
+	}
+
+	pNew->pThread = g_thread_create(import_writer_thread, pNew, TRUE, NULL);
+	g_assert(pNew->pThread != NULL);
+	return pNew;
+}
+
+// Called from any thread.  Blocks while the queue is full.
+void import_writer_add_road(importwriter_t* pWriter, import_road_t* pRoad)
+{
+	g_assert(pWriter != NULL);
+	g_assert(pRoad != NULL);
+	g_assert(pRoad->nLOD >= MAP_LEVEL_OF_DETAIL_BEST && pRoad->nLOD <= MAP_LEVEL_OF_DETAIL_WORST);
+
+	g_mutex_lock(pWriter->pQueueMutex);
+	while(pWriter->nQueued >= pWriter->nMaxQueued) {
+		g_cond_wait(pWriter->pQueueNotFullCond, pWriter->pQueueMutex);
+	}
+	pWriter->nQueued++;
+	g_mutex_unlock(pWriter->pQueueMutex);
+
+	g_async_queue_push(pWriter->pQueue, pRoad);
+}
+
+// No more roads will be added.  The thread writes everything still queued and then stops.
+void import_writer_close(importwriter_t* pWriter)
+{
+	g_assert(pWriter != NULL);
+	g_assert(pWriter->bClosed == FALSE);
+
+	pWriter->bClosed = TRUE;
+	g_async_queue_push(pWriter->pQueue, &g_EndOfQueueMarker);
+}
+
+// TRUE once a closed writer has written everything
+gboolean import_writer_is_done(importwriter_t* pWriter)
+{
+	return g_atomic_int_get(&pWriter->nDone);
+}
+
+// Closes the writer if needed and waits for it
+void import_writer_free(importwriter_t* pWriter)
+{
+	g_assert(pWriter != NULL);
+
+	if(!pWriter->bClosed) {
+		import_writer_close(pWriter);
+	}
+	g_thread_join(pWriter->pThread);
+
+	g_print("writer: %d roads written\n", pWriter->nRoadsWritten);
+	if(pWriter->nTileWriteFailures > 0) {
+		g_warning("writer: %d tile writes failed\n", pWriter->nTileWriteFailures);
+	}
+
+	gint nLOD;
+	for(nLOD = MAP_LEVEL_OF_DETAIL_BEST ; nLOD <= MAP_LEVEL_OF_DETAIL_WORST ; nLOD++) {
+		db_road_batch_free(pWriter->apBatches[nLOD]);
+		g_hash_table_destroy(pWriter->apTileHashes[nLOD]);
+	}
+	g_hash_table_destroy(pWriter->pRoadNameIDHash);
+	map_math_clipbuffer_free(pWriter->pClipBuffer);
+	g_async_queue_unref(pWriter->pQueue);
+	g_mutex_free(pWriter->pQueueMutex);
+	g_cond_free(pWriter->pQueueNotFullCond);
+	g_free(pWriter);
+}
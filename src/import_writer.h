@@ -0,0 +1,90 @@
+/***************************************************************************
+ *            import_writer.h
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _IMPORT_WRITER_H_
+#define _IMPORT_WRITER_H_
+
+#include <glib.h>
+#include "db.h"
+#include "map.h"
+#include "import_stats.h"
+
+// A road (or polygon) ready to be written.  The writer owns it once it's been added.
+typedef struct import_road {
+	gint nLOD;
+	gint nTypeID;
+
+	gchar* pszName;		// resolved to a RoadNameID by the writer thread ("" for none)
+	gint nSuffixID;
+
+	gint nAddressLeftStart;
+	gint nAddressLeftEnd;
+	gint nAddressRightStart;
+	gint nAddressRightEnd;
+
+	gint nCityLeftID;
+	gint nCityRightID;
+
+	gchar azZIPCodeLeft[6];
+	gchar azZIPCodeRight[6];
+
+	GArray* pPointsArray;	// mappoint_t
+} import_road_t;
+
+typedef struct importwriter {
+	GThread* pThread;
+	GAsyncQueue* pQueue;
+
+	// bounds the queue so producers can't run arbitrarily far ahead of the DB
+	GMutex* pQueueMutex;
+	GCond* pQueueNotFullCond;
+	gint nQueued;
+	gint nMaxQueued;
+
+	// owned by the writer thread
+	db_road_batch_t* apBatches[MAP_NUM_LEVELS_OF_DETAIL];
+	GHashTable* pRoadNameIDHash;	// "name\tsuffix" -> RoadNameID
+	GHashTable* apTileHashes[MAP_NUM_LEVELS_OF_DETAIL];	// every tile written to, with what's waiting to be appended to TileChunk<LOD> (see map_tileblob.c)
+	gint nTileBytesBuffered;
+	maprect_t rcTilesCovered;		// bounding box of everything bucketed into tiles (valid if bTilesCovered)
+	gboolean bTilesCovered;
+	gint nTileWriteFailures;
+	mapclipbuffer_t* pClipBuffer;	// for clipping polygons to tiles
+
+	gint nRoadsWritten;
+	importstats_t* pStats;	// can be NULL.  The thread adds its own time (as IMPORTSTATS_STAGE_DB_WRITE) when it stops.
+
+	gboolean bClosed;
+	volatile gint nDone;	// set by the thread when it has finished
+} importwriter_t;
+
+import_road_t* import_road_new(gint nLOD, gint nTypeID, const gchar* pszName, gint nSuffixID, GArray* pPointsArray);
+void import_road_free(import_road_t* pRoad);
+
+importwriter_t* import_writer_new(gint nMaxQueued, importstats_t* pStats);
+void import_writer_add_road(importwriter_t* pWriter, import_road_t* pRoad);
+void import_writer_close(importwriter_t* pWriter);
+gboolean import_writer_is_done(importwriter_t* pWriter);
+void import_writer_free(importwriter_t* pWriter);
+
+#endif
@@ -26,6 +26,8 @@
 #include "main.h"
 #include "db.h"
 #include "import.h"
+#include "import_scheduler.h"
+#include "import_tiger.h"
 #include "mainwindow.h"
 #include "importwindow.h"
 #include "util.h"
@@ -91,6 +93,39 @@ void importwindow_progress_pulse(void)
 	GTK_PROCESS_MAINLOOP;
 }
 
+static void importwindow_scheduler_progress_callback(const importscheduler_progress_t* pProgress, gpointer _unused)
+{
+	gchar azRemaining[50] = "";
+	if(pProgress->fSecondsRemaining >= 0.0) {
+		gint nSeconds = (gint)pProgress->fSecondsRemaining;
+		g_snprintf(azRemaining, sizeof(azRemaining), ", about %d:%02d left", nSeconds / 60, nSeconds % 60);
+	}
+
+	gchar* pszText = g_strdup_printf("%d of %d done (%d fetching, %d parsing, %d writing)%s",
+		pProgress->nFinished, pProgress->nTotal,
+		pProgress->anActive[IMPORT_STAGE_FETCH], pProgress->anActive[IMPORT_STAGE_PARSE], pProgress->anActive[IMPORT_STAGE_WRITE],
+		azRemaining);
+	gtk_progress_bar_set_text(g_ImportWindow.pProgressBar, pszText);
+	g_free(pszText);
+
+	gtk_progress_bar_set_fraction(g_ImportWindow.pProgressBar, pProgress->fFraction);
+
+	// ensure the UI gets updated
+	GTK_PROCESS_MAINLOOP;
+}
+
+static void importwindow_scheduler_finished_callback(const gchar* pszURI, gint nTigerSetNumber, gboolean bSuccess, gpointer _unused)
+{
+	g_ImportWindow.nCurrentFile++;
+
+	if(bSuccess) {
+		importwindow_log_append("Imported TIGER file TGR%05d.ZIP\n", nTigerSetNumber);
+	}
+	else {
+		importwindow_log_append("** Failed to import TIGER file TGR%05d.ZIP\n", nTigerSetNumber);
+	}
+}
+
 void importwindow_begin(GSList* pSelectedFileList)
 {
 	// empty progress buffer
@@ -100,32 +135,45 @@ void importwindow_begin(GSList* pSelectedFileList)
 	gtk_widget_show(GTK_WIDGET(g_ImportWindow.pWindow));
 	gtk_window_present(g_ImportWindow.pWindow);
 	gtk_widget_set_sensitive(GTK_WIDGET(g_ImportWindow.pOKButton), FALSE);
+	gtk_progress_bar_set_fraction(g_ImportWindow.pProgressBar, 0.0);
 
 	GTK_PROCESS_MAINLOOP;
 
 	g_ImportWindow.nTotalFiles = g_slist_length(pSelectedFileList);
-	g_ImportWindow.nCurrentFile = 1;
+	g_ImportWindow.nCurrentFile = 0;
 
 	g_print("Importing %d file(s)\n", g_ImportWindow.nTotalFiles);
 
-	gint nTotalSuccess = 0;
+	// counties are fetched, parsed and written concurrently
+	importscheduler_t* pScheduler = import_scheduler_new(IMPORT_SCHEDULER_DEFAULT_IO_LIMIT, IMPORT_SCHEDULER_DEFAULT_CPU_LIMIT, IMPORT_SCHEDULER_DEFAULT_DB_LIMIT);
+
+	gint nTotalUnrecognized = 0;
 	GSList* pFile = pSelectedFileList;
 	while(pFile != NULL) {
-		// do some work
-		if(import_from_uri((gchar*)pFile->data)) {
-			nTotalSuccess++;
+		const gchar* pszURI = (const gchar*)pFile->data;
+
+		gint nTigerSetNumber;
+		if(import_tiger_get_set_number(pszURI, &nTigerSetNumber)) {
+			import_scheduler_add(pScheduler, pszURI, nTigerSetNumber);
+		}
+		else {
+			importwindow_log_append("** Not a TIGER file: %s\n", pszURI);
+			nTotalUnrecognized++;
 		}
 
 		// Move to next file
 		pFile = pFile->next;
-		g_ImportWindow.nCurrentFile++;
 	}
-	// nTotalSuccess / g_ImportWindow.nTotalFiles
+
+	import_scheduler_run(pScheduler, importwindow_scheduler_progress_callback, importwindow_scheduler_finished_callback, NULL);
+
+	gint nTotalFailed = pScheduler->progress.nFailed + nTotalUnrecognized;
+	import_scheduler_free(pScheduler);
 
 	gtk_progress_bar_set_fraction(g_ImportWindow.pProgressBar, 1.0);
 	gtk_widget_set_sensitive(GTK_WIDGET(g_ImportWindow.pOKButton), TRUE);
 
-	if(nTotalSuccess == g_ImportWindow.nTotalFiles) {
+	if(nTotalFailed == 0) {
 		gtk_progress_bar_set_text(g_ImportWindow.pProgressBar, "Completed Successfully");
 	}
 	else {
@@ -56,6 +56,9 @@ int main (int argc, char *argv[])
 		textdomain(PACKAGE);
 	#endif
 
+	// the importer parses on worker threads
+	if(!g_thread_supported()) g_thread_init(NULL);
+
 	gtk_init(&argc, &argv);
 
 	g_type_init();
@@ -1377,6 +1377,11 @@ static gboolean mainwindow_on_key_press(GtkWidget *widget, GdkEventKey *pEvent,
 	else if(pEvent->keyval == GDK_F2) {
 		gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(g_MainWindow.pZoomToolRadioButton), TRUE);
 	}
+	else if(pEvent->keyval == GDK_F12) {
+		// debugging: which style layers cost the most to draw at this zoom level
+		map_set_show_layer_stats(g_MainWindow.pMap, !map_get_show_layer_stats(g_MainWindow.pMap));
+		mainwindow_draw_map(DRAWFLAG_ALL);
+	}
 	else if(pEvent->keyval == GDK_Escape) {
 		if(g_MainWindow.bDrawingZoomRect == TRUE) {
 			// cancel zoom-rect
@@ -30,6 +30,10 @@
 #include "map_style.h"
 #include "map_tilemanager.h"
 #include "map_math.h"
+#include "map_projection.h"
+#include "map_rastercache.h"
+#include "map_textcache.h"
+#include "map_labelcache.h"
 #include "gui.h"
 #include "map.h"
 #include "map_draw_gdk.h"
@@ -46,6 +50,12 @@
 //#define ENABLE_SCENEMANAGER_DEBUG_TEST
 //#define ENABLE_LABELS_WHILE_DRAGGING
 //#define ENABLE_RIVER_SMOOTHING	// hacky. rivers are animated when scrolling. :) only good for proof-of-concept screenshots
+//#define ENABLE_PRINT_RENDER_STATS	// print map_draw's counters (renderstats_t) after each frame
+
+#define RASTER_CACHE_BUDGET_IN_BYTES	(64 * 1024 * 1024)	// drawn geometry kept for panning (256 cells)
+#define TEXT_CACHE_MAX_ENTRIES			(8192)		// label strings and the prefixes of them tried on curvy roads
+
+#define ENABLE_SCROLL_BY_SHIFTING	// when scrolling between geometry-only frames, shift the last frame and draw only the uncovered strips
 
 #ifdef THREADED_RENDERING
 #define RENDERING_THREAD_YIELD          g_thread_yield()
@@ -186,6 +196,12 @@ gboolean map_new(map_t** ppMap, GtkWidget* pTargetWidget)
 //     }
 
 	pMap->pTileManager = map_tilemanager_new();
+	pMap->pClipBuffer = map_math_clipbuffer_new();
+	pMap->pProjection = map_projection_new();
+	pMap->pRasterCache = map_rastercache_new(RASTER_CACHE_BUDGET_IN_BYTES);
+	pMap->pTextCache = map_textcache_new(TEXT_CACHE_MAX_ENTRIES);
+	pMap->pLabelCache = map_labelcache_new();
+	pMap->pLayerStatsArray = g_array_new(FALSE, TRUE, sizeof(maplayerstats_t));
 
 	// init POI selection
 	pMap->pLocationSelectionArray = g_ptr_array_new();
@@ -195,30 +211,108 @@ gboolean map_new(map_t** ppMap, GtkWidget* pTargetWidget)
 	return TRUE;
 }
 
-void map_draw(map_t* pMap, GdkPixmap* pTargetPixmap, gint nDrawFlags)
+#ifdef ENABLE_SCROLL_BY_SHIFTING
+// If the map just scrolled since the last frame drawn to pTarget, shift that frame by the whole-pixel
+// distance and return the region still left to draw.  Returns NULL if everything has to be drawn.
+static GdkRegion* map_shift_last_frame(map_t* pMap, GdkDrawable* pTarget, const rendermetrics_t* pRenderMetrics, gint nDrawFlags)
 {
-	g_assert(pMap != NULL);
+	const rendermetrics_t* pLast = &(pMap->LastFrameMetrics);
+
+	// Only geometry: labels would have to be laid out again for the whole window anyway
+	if(nDrawFlags != DRAWFLAG_GEOMETRY || pMap->nLastFrameDrawFlags != DRAWFLAG_GEOMETRY) return NULL;
+	if(pMap->bShowLayerStats) return NULL;	// the overlay doesn't scroll either, and covers much of the window
+	if(pMap->pLastFrameTarget != pTarget) return NULL;
+	if(pLast->nZoomLevel != pRenderMetrics->nZoomLevel ||
+	   pLast->nWindowWidth != pRenderMetrics->nWindowWidth || pLast->nWindowHeight != pRenderMetrics->nWindowHeight ||
+	   pLast->fScaleX != pRenderMetrics->fScaleX || pLast->fScaleY != pRenderMetrics->fScaleY)
+	{
+		return NULL;
+	}
 
-	// Get area of world to draw and screen dimensions to draw to, etc.
-	rendermetrics_t renderMetrics = {0};
-	map_get_render_metrics(pMap, &renderMetrics);
-	rendermetrics_t* pRenderMetrics = &renderMetrics;
+	// the offsets are whole pixels (see map_get_render_metrics)
+	gint nWidth = pRenderMetrics->nWindowWidth;
+	gint nHeight = pRenderMetrics->nWindowHeight;
+	gint nDeltaX = (gint)(pRenderMetrics->fOffsetX - pLast->fOffsetX);
+	gint nDeltaY = (gint)(pRenderMetrics->fOffsetY - pLast->fOffsetY);
+	if(ABS(nDeltaX) >= nWidth || ABS(nDeltaY) >= nHeight) return NULL;
+
+	GdkGC* pGC = pMap->pTargetWidget->style->fg_gc[GTK_WIDGET_STATE(pMap->pTargetWidget)];
+	gdk_draw_drawable(pTarget, pGC, pTarget, 0,0, nDeltaX,nDeltaY, nWidth,nHeight);
+
+	GdkRegion* pRegion = gdk_region_new();
+	GdkRectangle rect;
+	if(nDeltaX != 0) {
+		rect.x = (nDeltaX > 0) ? 0 : (nWidth + nDeltaX);
+		rect.y = 0;
+		rect.width = ABS(nDeltaX);
+		rect.height = nHeight;
+		gdk_region_union_with_rect(pRegion, &rect);
+	}
+	if(nDeltaY != 0) {
+		rect.x = 0;
+		rect.y = (nDeltaY > 0) ? 0 : (nHeight + nDeltaY);
+		rect.width = nWidth;
+		rect.height = ABS(nDeltaY);
+		gdk_region_union_with_rect(pRegion, &rect);
+	}
+
+	// the map scale stays put: draw the map under where it was shifted to, and draw it again where it goes
+	if(pMap->rcMapScale.width > 0 && (nDeltaX != 0 || nDeltaY != 0)) {
+		rect = pMap->rcMapScale;
+		gdk_region_union_with_rect(pRegion, &rect);
+		rect.x += nDeltaX;
+		rect.y += nDeltaY;
+		gdk_region_union_with_rect(pRegion, &rect);
+	}
+	return pRegion;
+}
+#endif
 
+// Load the tiles for a frame and reset the per-frame state.  bCairoGeometry if cairo will draw the geometry.
+static GPtrArray* map_begin_frame(map_t* pMap, rendermetrics_t* pRenderMetrics, gboolean bCairoGeometry)
+{
 	// Load geometry
 	TIMER_BEGIN(loadtimer, "--- BEGIN ALL DB LOAD");
+	GTimer* pTimer = g_timer_new();
 
 	if(pMap->pLastActiveTilesArray != NULL) {
 		map_tilemanager_free_tile_list(pMap->pTileManager, pMap->pLastActiveTilesArray);
 	}
-	GPtrArray* pTilesArray = map_tilemanager_load_tiles_for_worldrect(pMap->pTileManager, &(pRenderMetrics->rWorldBoundingBox), pRenderMetrics->nLevelOfDetail);
+	maprect_t rcLoad = pRenderMetrics->rWorldBoundingBox;
+	if(bCairoGeometry) {
+		// cairo draws (and caches) whole raster cells, which reach past the window's edges
+		map_rastercache_get_cells_worldrect(pRenderMetrics, &rcLoad);
+	}
+	GPtrArray* pTilesArray = map_tilemanager_load_tiles_for_worldrect(pMap->pTileManager, &rcLoad, pRenderMetrics->nLevelOfDetail);
 
 	// save this list for hit testing
 	pMap->pLastActiveTilesArray = pTilesArray;
 
+	// tiles are projected to screen space as they're first drawn
+	map_projection_begin_frame(pMap->pProjection, pRenderMetrics, pTilesArray);
+	memset(&(pMap->RenderStats), 0, sizeof(pMap->RenderStats));
+	g_array_set_size(pMap->pLayerStatsArray, pMap->pLayersArray->len);
+	memset(pMap->pLayerStatsArray->data, 0, pMap->pLayerStatsArray->len * sizeof(maplayerstats_t));
+	pMap->RenderStats.fLoadSeconds = g_timer_elapsed(pTimer, NULL);
+	g_timer_destroy(pTimer);
+
 	TIMER_END(loadtimer, "--- END ALL DB LOAD");
 
 	scenemanager_clear(pMap->pSceneManager);
 	scenemanager_set_screen_dimensions(pMap->pSceneManager, pRenderMetrics->nWindowWidth, pRenderMetrics->nWindowHeight);
+	return pTilesArray;
+}
+
+void map_draw(map_t* pMap, GdkPixmap* pTargetPixmap, gint nDrawFlags)
+{
+	g_assert(pMap != NULL);
+
+	// Get area of world to draw and screen dimensions to draw to, etc.
+	rendermetrics_t renderMetrics = {0};
+	map_get_render_metrics(pMap, &renderMetrics);
+	rendermetrics_t* pRenderMetrics = &renderMetrics;
+
+	GPtrArray* pTilesArray = map_begin_frame(pMap, pRenderMetrics, pMap->bAntiAliased);
 
 #ifdef ENABLE_LABELS_WHILE_DRAGGING
 	nDrawFlags |= DRAWFLAG_LABELS;	// always turn on labels
@@ -229,18 +323,34 @@ void map_draw(map_t* pMap, GdkPixmap* pTargetPixmap, gint nDrawFlags)
 	scenemanager_claim_polygon(pMap->pSceneManager, aPoints, 4);
 #endif
 
+	// NULL to draw the whole window
+	GdkRegion* pClipRegion = NULL;
+#ifdef ENABLE_SCROLL_BY_SHIFTING
+	pClipRegion = map_shift_last_frame(pMap, pTargetPixmap, pRenderMetrics, nDrawFlags);
+#endif
+	pMap->pLastFrameTarget = pTargetPixmap;
+	pMap->LastFrameMetrics = *pRenderMetrics;
+	pMap->nLastFrameDrawFlags = nDrawFlags;
+
 	if(pMap->bAntiAliased == FALSE) {
 		// 
 		if(nDrawFlags & DRAWFLAG_GEOMETRY) {
-			map_draw_gdk(pMap, pTilesArray, pRenderMetrics, pTargetPixmap, DRAWFLAG_GEOMETRY);
+			GTimer* pTimer = g_timer_new();
+			map_draw_gdk(pMap, pTilesArray, pRenderMetrics, pTargetPixmap, pClipRegion, DRAWFLAG_GEOMETRY);
+			pMap->RenderStats.fGeometrySeconds = g_timer_elapsed(pTimer, NULL);
+			g_timer_destroy(pTimer);
 			nDrawFlags &= ~DRAWFLAG_GEOMETRY;
 		}
 
 		// Call cairo for finishing the scene
-		map_draw_cairo(pMap, pTilesArray, pRenderMetrics, pTargetPixmap, nDrawFlags);
+		map_draw_cairo(pMap, pTilesArray, pRenderMetrics, pTargetPixmap, pClipRegion, nDrawFlags);
 	}
 	else {
-		map_draw_cairo(pMap, pTilesArray, pRenderMetrics, pTargetPixmap, nDrawFlags);
+		map_draw_cairo(pMap, pTilesArray, pRenderMetrics, pTargetPixmap, pClipRegion, nDrawFlags);
+	}
+
+	if(pClipRegion != NULL) {
+		gdk_region_destroy(pClipRegion);
 	}
 
 #ifdef ENABLE_SCENEMANAGER_DEBUG_TEST
@@ -248,9 +358,31 @@ void map_draw(map_t* pMap, GdkPixmap* pTargetPixmap, gint nDrawFlags)
 					 FALSE, aPoints, 4);
 #endif
 
+#ifdef ENABLE_PRINT_RENDER_STATS
+	g_print("points: %d loaded, %d emitted; cells: %d drawn, %d from cache; %d strokes, %d fills\n", pMap->RenderStats.nPointsLoaded, pMap->RenderStats.nPointsEmitted,
+			pMap->RenderStats.nCellsDrawn, pMap->RenderStats.nCellsFromCache, pMap->RenderStats.nStrokes, pMap->RenderStats.nFills);
+	g_print("objects: %d drawn; labels: %d placed, %d where they were; seconds: %f load, %f geometry, %f labels\n", pMap->RenderStats.nObjectsDrawn,
+			pMap->RenderStats.nLabelsPlaced, pMap->RenderStats.nLabelsFromCache,
+			pMap->RenderStats.fLoadSeconds, pMap->RenderStats.fGeometrySeconds, pMap->RenderStats.fLabelSeconds);
+#endif
+
 	gtk_widget_queue_draw(pMap->pTargetWidget);
 }
 
+// Draw a whole frame with cairo to pSurface, which must be the map's dimensions.  For tools with no
+// window (see render_benchmark.c): it doesn't need the target widget and doesn't shift the last frame.
+void map_draw_to_surface(map_t* pMap, cairo_surface_t* pSurface, gint nDrawFlags)
+{
+	g_assert(pMap != NULL);
+	g_assert(pSurface != NULL);
+
+	rendermetrics_t renderMetrics = {0};
+	map_get_render_metrics(pMap, &renderMetrics);
+
+	GPtrArray* pTilesArray = map_begin_frame(pMap, &renderMetrics, TRUE);
+	map_draw_cairo_surface(pMap, pTilesArray, &renderMetrics, pSurface, NULL, nDrawFlags);
+}
+
 void map_draw_xor_rect(map_t* pMap, GdkDrawable* pTargetDrawable, screenrect_t* pRect)
 {
 	map_draw_gdk_xor_rect(pMap, pTargetDrawable, pRect);
@@ -295,6 +427,28 @@ guint32 map_get_scale(const map_t* pMap)
 	return g_sZoomLevels[pMap->uZoomLevel-1].uScale;	// returns "5000" for 1:5000 scale
 }
 
+gdouble map_degrees_to_pixels(map_t* pMap, gdouble fDegrees, guint16 uZoomLevel)
+{
+	gdouble fMonitorPixelsPerInch = 85.333;	// XXX: don't hardcode this
+
+	gdouble fResultInMeters = WORLD_DEGREES_TO_METERS(fDegrees);
+	gdouble fResultInPixels = (INCHES_PER_METER * fResultInMeters) * fMonitorPixelsPerInch;
+	fResultInPixels /= (float)g_sZoomLevels[uZoomLevel-1].uScale;
+	return fResultInPixels;
+}
+
+void map_windowpoint_to_mappoint(map_t* pMap, screenpoint_t* pScreenPoint, mappoint_t* pMapPoint)
+{
+	// Calculate the # of pixels away from the center point the click was
+	gint16 nPixelDeltaX = (gint)(pScreenPoint->nX) - (pMap->MapDimensions.uWidth / 2);
+	gint16 nPixelDeltaY = (gint)(pScreenPoint->nY) - (pMap->MapDimensions.uHeight / 2);
+
+	// Convert pixels to world coordinates
+	pMapPoint->fLongitude = pMap->MapCenter.fLongitude + map_math_pixels_to_degrees_at_scale(nPixelDeltaX, map_get_scale(pMap));
+	// reverse the X, clicking above
+	pMapPoint->fLatitude = pMap->MapCenter.fLatitude - map_math_pixels_to_degrees_at_scale(nPixelDeltaY, map_get_scale(pMap));
+}
+
 gdouble map_get_altitude(const map_t* pMap, EDistanceUnits eUnit)
 {
 	g_warning("broken function :)\n");
@@ -411,7 +565,10 @@ void map_set_dimensions(map_t* pMap, const dimensions_t* pDimensions)
 	// XXX: free old pixmap?
 	//g_assert(pMap->pPixmap == NULL);
 
-	pMap->pPixmap = gdk_pixmap_new(pMap->pTargetWidget->window,	pMap->MapDimensions.uWidth, pMap->MapDimensions.uHeight, -1);
+	if(pMap->pTargetWidget != NULL) {	// NULL for maps that only draw with map_draw_to_surface
+		pMap->pPixmap = gdk_pixmap_new(pMap->pTargetWidget->window,	pMap->MapDimensions.uWidth, pMap->MapDimensions.uHeight, -1);
+	}
+	pMap->pLastFrameTarget = NULL;
 }
 
 // ========================================================
@@ -441,6 +598,68 @@ void map_get_render_metrics(const map_t* pMap, rendermetrics_t* pMetrics)
 	pMetrics->rWorldBoundingBox.A.fLatitude = pMap->MapCenter.fLatitude - pMetrics->fScreenLatitude/2;
 	pMetrics->rWorldBoundingBox.B.fLongitude = pMap->MapCenter.fLongitude + pMetrics->fScreenLongitude/2;
 	pMetrics->rWorldBoundingBox.B.fLatitude = pMap->MapCenter.fLatitude + pMetrics->fScreenLatitude/2;	
+
+	// Precompute world to screen, so SCALE_X and SCALE_Y are a multiply and an add (screen Y runs down, latitude up)
+	pMetrics->fScaleX = pMetrics->nWindowWidth / pMetrics->fScreenLongitude;
+	pMetrics->fOffsetX = -(pMetrics->rWorldBoundingBox.A.fLongitude * pMetrics->fScaleX);
+	pMetrics->fScaleY = -(pMetrics->nWindowHeight / pMetrics->fScreenLatitude);
+	pMetrics->fOffsetY = pMetrics->nWindowHeight - (pMetrics->rWorldBoundingBox.A.fLatitude * pMetrics->fScaleY);
+
+	// Put the window on whole pixels of the zoom level's world-fixed pixel grid (moving it less than half a pixel),
+	// so geometry drawn in an earlier frame can be copied into this one (see map_rastercache.c)
+	pMetrics->fOffsetX = floor(pMetrics->fOffsetX + 0.5);
+	pMetrics->fOffsetY = floor(pMetrics->fOffsetY + 0.5);
+	pMetrics->rWorldBoundingBox.A.fLongitude = -(pMetrics->fOffsetX) / pMetrics->fScaleX;
+	pMetrics->rWorldBoundingBox.B.fLongitude = (pMetrics->nWindowWidth - pMetrics->fOffsetX) / pMetrics->fScaleX;
+	pMetrics->rWorldBoundingBox.A.fLatitude = (pMetrics->nWindowHeight - pMetrics->fOffsetY) / pMetrics->fScaleY;
+	pMetrics->rWorldBoundingBox.B.fLatitude = -(pMetrics->fOffsetY) / pMetrics->fScaleY;
+}
+
+const renderstats_t* map_get_render_stats(const map_t* pMap)
+{
+	return &(pMap->RenderStats);
+}
+
+// Counters for style layer iLayer (an index into pMap->pLayersArray) in the last frame drawn
+const maplayerstats_t* map_get_layer_stats(const map_t* pMap, gint iLayer)
+{
+	g_assert(iLayer >= 0 && iLayer < pMap->pLayerStatsArray->len);
+	return &g_array_index(pMap->pLayerStatsArray, maplayerstats_t, iLayer);
+}
+
+// Add what a layer drew to its counters, from the frame's counters before and after drawing it
+void map_layerstats_add_frame_delta(maplayerstats_t* pLayerStats, const renderstats_t* pBefore, const renderstats_t* pAfter, gdouble fSeconds)
+{
+	pLayerStats->fSeconds += fSeconds;
+	pLayerStats->nObjectsConsidered += (pAfter->nObjectsConsidered - pBefore->nObjectsConsidered);
+	pLayerStats->nObjectsCulled += (pAfter->nObjectsCulled - pBefore->nObjectsCulled);
+	pLayerStats->nPointsEmitted += (pAfter->nPointsEmitted - pBefore->nPointsEmitted);
+	pLayerStats->nClipCalls += (pAfter->nClipCalls - pBefore->nClipCalls);
+	pLayerStats->nLabelsAttempted += (pAfter->nLabelsAttempted - pBefore->nLabelsAttempted);
+	pLayerStats->nLabelsPlaced += (pAfter->nLabelsPlaced - pBefore->nLabelsPlaced);
+}
+
+void map_layerstats_add(maplayerstats_t* pTotal, const maplayerstats_t* pLayerStats)
+{
+	pTotal->fSeconds += pLayerStats->fSeconds;
+	pTotal->nObjectsConsidered += pLayerStats->nObjectsConsidered;
+	pTotal->nObjectsCulled += pLayerStats->nObjectsCulled;
+	pTotal->nPointsEmitted += pLayerStats->nPointsEmitted;
+	pTotal->nClipCalls += pLayerStats->nClipCalls;
+	pTotal->nLabelsAttempted += pLayerStats->nLabelsAttempted;
+	pTotal->nLabelsPlaced += pLayerStats->nLabelsPlaced;
+}
+
+gboolean map_get_show_layer_stats(const map_t* pMap)
+{
+	return pMap->bShowLayerStats;
+}
+
+// Draw a table of each layer's counters over the map (see map_draw_cairo_layer_stats)
+void map_set_show_layer_stats(map_t* pMap, gboolean bShow)
+{
+	pMap->bShowLayerStats = bShow;
+	pMap->pLastFrameTarget = NULL;	// the last frame has (or lacks) the table
 }
 
 // void map_add_track(map_t* pMap, gint hTrack)
@@ -472,6 +691,18 @@ gboolean map_layer_render_type_atoi(const gchar* pszName, gint* pnReturnRenderTy
 	return FALSE;
 }
 
+const gchar* map_object_type_itoa(gint nObjectTypeID)
+{
+	g_assert(nObjectTypeID >= 0 && nObjectTypeID < MAP_NUM_OBJECT_TYPES);
+	return g_apszMapObjectTypeNames[nObjectTypeID];
+}
+
+const gchar* map_layer_render_type_itoa(gint nRenderTypeID)
+{
+	g_assert(nRenderTypeID >= 0 && nRenderTypeID < G_N_ELEMENTS(g_apszMapRenderTypeNames));
+	return g_apszMapRenderTypeNames[nRenderTypeID];
+}
+
 //
 //
 //
@@ -603,6 +834,7 @@ gboolean map_get_antialiased(const map_t* pMap)
 void map_set_antialiased(map_t* pMap, gboolean bAntiAliased)
 {
 	pMap->bAntiAliased = bAntiAliased;
+	pMap->pLastFrameTarget = NULL;	// drawn the other way
 }
 
 #ifdef ROADSTER_DEAD_CODE
@@ -25,6 +25,7 @@
 #define _MAP_H_
 
 #include <math.h>
+#include <cairo.h>
 
 //
 // Map Object Types
@@ -136,6 +137,12 @@ typedef struct {
 	screenpoint_t B;
 } screenrect_t;
 
+// A projected map point, before rounding (see map_math_project_points)
+typedef struct {
+	gdouble fX;
+	gdouble fY;
+} screenpointf_t;
+
 typedef struct {
 	guint16 uWidth;
 	guint16 uHeight;
@@ -184,10 +191,23 @@ typedef struct {
 	gint nWindowWidth;
 	gint nWindowHeight;
 	gint nLevelOfDetail;
+
+	// world to screen is x = (longitude * fScaleX) + fOffsetX, y = (latitude * fScaleY) + fOffsetY (set by map_get_render_metrics)
+	gdouble fScaleX;
+	gdouble fOffsetX;
+	gdouble fScaleY;
+	gdouble fOffsetY;
 } rendermetrics_t;
 
-#define SCALE_X(p, x)  ((((x) - (p)->rWorldBoundingBox.A.fLongitude) / (p)->fScreenLongitude) * (p)->nWindowWidth)
-#define SCALE_Y(p, y)  ((p)->nWindowHeight - ((((y) - (p)->rWorldBoundingBox.A.fLatitude) / (p)->fScreenLatitude) * (p)->nWindowHeight))
+#define SCALE_X(p, x)  (((x) * (p)->fScaleX) + (p)->fOffsetX)
+#define SCALE_Y(p, y)  (((y) * (p)->fScaleY) + (p)->fOffsetY)
+
+// Scratch space for the clippers in map_math.c, kept and reused so clipping doesn't allocate
+typedef struct {
+	GArray* pPointsArray;		// mappoint_t: the result
+	GArray* pTempArray;			// mappoint_t: for the polygon clipper's in-between passes
+	GArray* pRunsArray;			// gint: points in each piece of a clipped line (see map_math_clip_polyline_to_worldrect)
+} mapclipbuffer_t;
 
 // typedef struct {
 //     GPtrArray* pRoadsArray;
@@ -199,6 +219,42 @@ typedef struct {
 
 #include "map_tilemanager.h"
 
+typedef struct mapprojection mapprojection_t;	// see map_projection.h
+typedef struct maprastercache maprastercache_t;	// see map_rastercache.h
+typedef struct maptextcache maptextcache_t;		// see map_textcache.h
+typedef struct maplabelcache maplabelcache_t;	// see map_labelcache.h
+
+// Counters for the last frame drawn (reset by map_draw)
+typedef struct {
+	gint nPointsLoaded;			// points in the objects drawn, as stored in their tiles
+	gint nPointsEmitted;		// points handed to cairo or GDK for them, after simplification and clipping
+	gint nCellsDrawn;			// raster cells whose geometry was drawn (see map_rastercache.c)...
+	gint nCellsFromCache;		// ...and those that were copied from the cache
+	gint nStrokes;				// stroke calls (cairo_stroke, or gdk_draw_lines for each line)
+	gint nFills;				// fill calls (cairo_fill or cairo_paint, or gdk_draw_polygon for each polygon)
+	gint nObjectsConsidered;	// objects in the visible tiles' layers, for geometry and labels...
+	gint nObjectsCulled;		// ...those skipped because their bounding box is off screen
+	gint nObjectsDrawn;			// lines and polygons handed to cairo or GDK
+	gint nClipCalls;			// objects cut to the screen (map_math_clip_*) because they're partly off it
+	gint nLabelsAttempted;		// labels we tried to place...
+	gint nLabelsPlaced;			// ...and those that found room (see scenemanager.c)...
+	gint nLabelsFromCache;		// ...in the same place as last frame (see map_labelcache.c)
+	gdouble fLoadSeconds;		// loading the visible tiles (they're simplified and projected as they're drawn)
+	gdouble fGeometrySeconds;	// drawing the geometry layers
+	gdouble fLabelSeconds;		// placing and drawing labels
+} renderstats_t;
+
+// Counters for one style layer in the last frame drawn (see map_get_layer_stats)
+typedef struct {
+	gdouble fSeconds;			// for cairo geometry this is summed over the raster cells, so over threads too
+	gint nObjectsConsidered;
+	gint nObjectsCulled;
+	gint nPointsEmitted;
+	gint nClipCalls;
+	gint nLabelsAttempted;
+	gint nLabelsPlaced;
+} maplayerstats_t;
+
 typedef struct {
 	mappoint_t 		MapCenter;
 	dimensions_t 	MapDimensions;
@@ -214,6 +270,14 @@ typedef struct {
 
 	maptilemanager_t* pTileManager;
 	GPtrArray* pLastActiveTilesArray;	// holds currently visible tiles at correct LOD (they're owned by tile manager)
+	mapclipbuffer_t* pClipBuffer;		// reused for every clipped object we draw
+	mapprojection_t* pProjection;		// the visible tiles' points in screen space, for drawing and hit testing
+	maprastercache_t* pRasterCache;		// drawn geometry, kept between frames (cairo only)
+	maptextcache_t* pTextCache;			// label text measured (and shaped) in earlier frames (cairo only)
+	maplabelcache_t* pLabelCache;		// where road labels went in the last frame, to put them back there
+	renderstats_t RenderStats;
+	GArray* pLayerStatsArray;			// maplayerstats_t for each of pLayersArray
+	gboolean bShowLayerStats;			// draw pLayerStatsArray over the map
 
 	// Locationsets
 	GHashTable		*pLocationArrayHashTable;
@@ -222,6 +286,12 @@ typedef struct {
 
 	GdkPixmap* pPixmap;
 
+	// The last frame drawn, so scrolling can shift it instead of drawing it all again (see map_draw)
+	GdkDrawable* pLastFrameTarget;		// NULL if there's no frame we could shift
+	rendermetrics_t LastFrameMetrics;
+	gint nLastFrameDrawFlags;
+	GdkRectangle rcMapScale;			// where map_draw_cairo drew the map scale, which doesn't scroll with the map
+
 	GPtrArray* pLayersArray;
 } map_t;
 
@@ -309,11 +379,18 @@ GdkPixmap* map_get_pixmap(map_t* pMap);
 void map_release_pixmap(map_t* pMap);
 
 void map_draw(map_t* pMap, GdkPixmap* pTargetPixmap, gint nDrawFlags);
+void map_draw_to_surface(map_t* pMap, cairo_surface_t* pSurface, gint nDrawFlags);
 void map_draw_xor_rect(map_t* pMap, GdkDrawable* pTargetDrawable, screenrect_t* pRect);
 
 void map_add_track(map_t* pMap, gint hTrack);
 
 void map_get_render_metrics(const map_t* pMap, rendermetrics_t* pMetrics);
+const renderstats_t* map_get_render_stats(const map_t* pMap);
+const maplayerstats_t* map_get_layer_stats(const map_t* pMap, gint iLayer);
+void map_layerstats_add_frame_delta(maplayerstats_t* pLayerStats, const renderstats_t* pBefore, const renderstats_t* pAfter, gdouble fSeconds);
+void map_layerstats_add(maplayerstats_t* pTotal, const maplayerstats_t* pLayerStats);
+gboolean map_get_show_layer_stats(const map_t* pMap);
+void map_set_show_layer_stats(map_t* pMap, gboolean bShow);
 
 gboolean map_location_selection_add(map_t* pMap, gint nLocationID);
 gboolean map_location_selection_remove(map_t* pMap, gint nLocationID);
@@ -322,6 +399,8 @@ const gchar* map_location_selection_get_attribute(const map_t* pMap, const locat
 
 gboolean map_object_type_atoi(const gchar* pszName, gint* pnReturnObjectTypeID);
 gboolean map_layer_render_type_atoi(const gchar* pszName, gint* pnReturnRenderTypeID);
+const gchar* map_object_type_itoa(gint nObjectTypeID);
+const gchar* map_layer_render_type_itoa(gint nRenderTypeID);
 
 gboolean map_rects_overlap(const maprect_t* p1, const maprect_t* p2);
 
@@ -29,11 +29,16 @@
 #define ENABLE_LABEL_LIMIT_TO_ROAD				// take road line length into account when drawing labels!
 #define	ACCEPTABLE_LINE_LABEL_OVERDRAW_IN_PIXELS (18)	// XXX: make this a run-time variable
 #define ENABLE_DRAW_MAP_SCALE
+#define ENABLE_DRAW_LAYER_STATS					// the table of per-layer counters (see map_set_show_layer_stats)
 //#define ENABLE_MAP_DROP_SHADOW
 
 //#define ENABLE_HACK_AROUND_CAIRO_LINE_CAP_BUG	// enable to ensure roads have rounded caps if the style dictates
 												// supposedly fixed as of 1.0 but I haven't tested yet
 
+#define ENABLE_RASTER_CACHE						// keep drawn geometry between frames, so panning is mostly copying (see map_rastercache.c)
+#define ENABLE_PARALLEL_CELL_RENDERING			// draw the raster cells' geometry on worker threads
+#define 	MAX_RENDER_THREADS		(8)
+
 #define ROAD_FONT	"Free Sans" //Bitstream Vera Sans"
 #define AREA_FONT	"Free Sans" // "Bitstream Vera Sans"
 
@@ -46,10 +51,16 @@
 #include <cairo-xlib.h>
 #include <math.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "main.h"
 #include "map.h"
+#include "map_draw_cairo.h"
 #include "map_math.h"
+#include "map_projection.h"
+#include "map_rastercache.h"
+#include "map_textcache.h"
+#include "map_labelcache.h"
 #include "mainwindow.h"
 #include "util.h"
 #include "road.h"
@@ -60,9 +71,13 @@
 #include "util.h"
 
 // Draw whole layers
-static void map_draw_cairo_layer_polygons(cairo_t* pCairo, rendermetrics_t* pRenderMetrics, GPtrArray* pRoadsArray, maplayerstyle_t* pLayerStyle);
-static void map_draw_cairo_layer_lines(cairo_t* pCairo, rendermetrics_t* pRenderMetrics, GPtrArray* pRoadsArray, maplayerstyle_t* pLayerStyle);
-static void map_draw_cairo_layer_road_labels(map_t* pMap, cairo_t* pCairo, rendermetrics_t* pRenderMetrics, GPtrArray* pRoadsArray, maplayerstyle_t* pLayerStyle);
+static void map_draw_cairo_geometry_cells(map_t* pMap, cairo_t* pCairo, GPtrArray* pTiles, rendermetrics_t* pRenderMetrics, const GdkRegion* pClipRegion);
+static void map_draw_cairo_geometry_layers(map_t* pMap, cairo_t* pCairo, rendermetrics_t* pRenderMetrics, mapclipbuffer_t* pClipBuffer, renderstats_t* pStats, maplayerstats_t* aLayerStats, const gint* aiTiles, gint nNumTiles);
+static void map_draw_cairo_layer_polygons(map_t* pMap, cairo_t* pCairo, rendermetrics_t* pRenderMetrics, mapclipbuffer_t* pClipBuffer, renderstats_t* pStats, const gint* aiTiles, gint nNumTiles, gint nObjectType, maplayerstyle_t* pLayerStyle);
+static void map_draw_cairo_layer_lines(map_t* pMap, cairo_t* pCairo, rendermetrics_t* pRenderMetrics, mapclipbuffer_t* pClipBuffer, renderstats_t* pStats, const gint* aiTiles, gint nNumTiles, gint nObjectType, maplayerstyle_t* pLayerStyle);
+static void map_draw_cairo_layer_fill(map_t* pMap, cairo_t* pCairo, rendermetrics_t* pRenderMetrics, renderstats_t* pStats, maplayerstyle_t* pLayerStyle);
+static void map_draw_cairo_layer_road_labels(map_t* pMap, cairo_t* pCairo, rendermetrics_t* pRenderMetrics, gint iTile, gint nObjectType, maplayerstyle_t* pLayerStyle);
+static void map_draw_cairo_layer_cached_road_labels(map_t* pMap, cairo_t* pCairo, rendermetrics_t* pRenderMetrics, gint iTile, gint nObjectType, maplayerstyle_t* pLayerStyle);
 static void map_draw_cairo_layer_polygon_labels(map_t* pMap, cairo_t* pCairo, rendermetrics_t* pRenderMetrics, GPtrArray* pRoadsArray, maplayerstyle_t* pLayerStyle);
 
 // Draw a single line/polygon/point
@@ -70,15 +85,15 @@ static void map_draw_cairo_layer_polygon_labels(map_t* pMap, cairo_t* pCairo, re
 //static void map_draw_cairo_locationset(map_t* pMap, cairo_t *pCairo, rendermetrics_t* pRenderMetrics, locationset_t* pLocationSet, GPtrArray* pLocationsArray);
 //static void map_draw_cairo_locationselection(map_t* pMap, cairo_t *pCairo, rendermetrics_t* pRenderMetrics, GPtrArray* pLocationSelectionArray);
 
-static void map_draw_cairo_layer_fill(map_t* pMap, cairo_t* pCairo, rendermetrics_t* pRenderMetrics, maplayerstyle_t* pLayerStyle);
-
 // Draw labels for a single line/polygon
-static void map_draw_cairo_road_label(map_t* pMap, cairo_t *pCairo, maplayerstyle_t* pLayerStyle, rendermetrics_t* pRenderMetrics, GArray* pMapPointsArray, gchar* pszLabel);
+static void map_draw_cairo_road_label(map_t* pMap, cairo_t *pCairo, maplayerstyle_t* pLayerStyle, rendermetrics_t* pRenderMetrics, const screenpointf_t* aPoints, gint nNumPoints, gchar* pszLabel);
+static gboolean map_draw_cairo_road_label_cached(map_t* pMap, cairo_t *pCairo, maplayerstyle_t* pLayerStyle, rendermetrics_t* pRenderMetrics, const maplabelplacement_t* pPlacement);
 static void map_draw_cairo_polygon_label(map_t* pMap, cairo_t *pCairo, maplayerstyle_t* pLayerStyle, rendermetrics_t* pRenderMetrics, GArray* pMapPointsArray, maprect_t* pBoundingRect, const gchar* pszLabel);
 
 // Draw map extras
 static void map_draw_cairo_map_scale(map_t* pMap, cairo_t *pCairo, rendermetrics_t* pRenderMetrics);
 static void map_draw_cairo_message(map_t* pMap, cairo_t *pCairo, gchar* pszMessage);
+static void map_draw_cairo_layer_stats(map_t* pMap, cairo_t *pCairo, rendermetrics_t* pRenderMetrics);
 
 static struct { gint nX,nY; } g_aHaloOffsets[] = {{2,1},{2,-1},{-2,1},{-2,-1},{1,2},{1,-2},{-1,2},{-1,-2}};	// larger
 //static struct { gint nX,nY; } g_aHaloOffsets[] = {{1,1},{1,-1},{-1,1},{-1,-1}};	// smaller
@@ -107,7 +122,8 @@ void map_draw_cairo_set_rgba(cairo_t* pCairo, color_t* pColor)
 	cairo_set_source_rgba(pCairo, pColor->fRed, pColor->fGreen, pColor->fBlue, pColor->fAlpha);
 }
 
-void map_draw_cairo(map_t* pMap, GPtrArray* pTiles, rendermetrics_t* pRenderMetrics, GdkPixmap* pPixmap, gint nDrawFlags)
+// pClipRegion limits drawing to part of the window (NULL for all of it)
+void map_draw_cairo(map_t* pMap, GPtrArray* pTiles, rendermetrics_t* pRenderMetrics, GdkPixmap* pPixmap, const GdkRegion* pClipRegion, gint nDrawFlags)
 {
 	// 1. Set draw target to X Drawable
 	Display* dpy;
@@ -119,6 +135,16 @@ void map_draw_cairo(map_t* pMap, GPtrArray* pTiles, rendermetrics_t* pRenderMetr
 
 	gdk_drawable_get_size (pPixmap, &width, &height);
 	cairo_surface_t *pSurface = cairo_xlib_surface_create (dpy, drawable, visual, width, height);
+
+	map_draw_cairo_surface(pMap, pTiles, pRenderMetrics, pSurface, pClipRegion, nDrawFlags);
+	cairo_surface_destroy(pSurface);
+}
+
+// Draw to any cairo surface (an image surface, for render-benchmark) the size of the window
+void map_draw_cairo_surface(map_t* pMap, GPtrArray* pTiles, rendermetrics_t* pRenderMetrics, cairo_surface_t* pSurface, const GdkRegion* pClipRegion, gint nDrawFlags)
+{
+	gint height = pRenderMetrics->nWindowHeight;
+
 	cairo_t* pCairo = cairo_create (pSurface);
 	cairo_set_miter_limit(pCairo, 10);
 
@@ -140,52 +166,61 @@ void map_draw_cairo(map_t* pMap, GPtrArray* pTiles, rendermetrics_t* pRenderMetr
 	// 2.1. Settings for all rendering
 	cairo_set_fill_rule(pCairo, CAIRO_FILL_RULE_WINDING);
 
+	if(pClipRegion != NULL) {
+		GdkRectangle* aRects;
+		gint nNumRects;
+		gdk_region_get_rectangles(pClipRegion, &aRects, &nNumRects);
+
+		gint iRect;
+		for(iRect=0 ; iRect<nNumRects ; iRect++) {
+			cairo_rectangle(pCairo, aRects[iRect].x, aRects[iRect].y, aRects[iRect].width, aRects[iRect].height);
+		}
+		cairo_clip(pCairo);
+		g_free(aRects);
+	}
+
 	// 2.2. Render Layers
 	if(pMap->pLayersArray->len == 0) {
 		map_draw_cairo_message(pMap, pCairo, "The style XML file couldn't be loaded");
 	}
 	else {
-		gint i;
-		for(i=pMap->pLayersArray->len-1 ; i>=0 ; i--) {
-			maplayer_t* pLayer = g_ptr_array_index(pMap->pLayersArray, i);
+		// All geometry, then all labels.  (The style file puts every label layer above every geometry layer.)
+		if(nDrawFlags & DRAWFLAG_GEOMETRY) {
+			GTimer* pTimer = g_timer_new();
+			map_draw_cairo_geometry_cells(pMap, pCairo, pTiles, pRenderMetrics, pClipRegion);
+			pMap->RenderStats.fGeometrySeconds = g_timer_elapsed(pTimer, NULL);
+			g_timer_destroy(pTimer);
+		}
 
+		// Labels stay on this thread: they all claim space in the one scenemanager
+		if(nDrawFlags & DRAWFLAG_LABELS) {
+			GTimer* pTimer = g_timer_new();
+			GTimer* pLayerTimer = g_timer_new();
 			gint nStyleZoomLevel = g_sZoomLevels[pRenderMetrics->nZoomLevel-1].nStyleZoomLevel;
 
-			if(pLayer->nDrawType == MAP_LAYER_RENDERTYPE_LINES) {
-				if(nDrawFlags & DRAWFLAG_GEOMETRY) {
-					gint iTile;
-					for(iTile=0 ; iTile < pTiles->len ; iTile++) {
-						maptile_t* pTile = g_ptr_array_index(pTiles, iTile);
-						map_draw_cairo_layer_lines(pCairo, pRenderMetrics,
-												 pTile->apMapObjectArrays[pLayer->nDataSource],               // data
-												 pLayer->paStylesAtZoomLevels[nStyleZoomLevel-1]);       // style
-					}
-				}
-			}
-			else if(pLayer->nDrawType == MAP_LAYER_RENDERTYPE_POLYGONS) {
-				if(nDrawFlags & DRAWFLAG_GEOMETRY) {
+			map_labelcache_begin_frame(pMap->pLabelCache, pRenderMetrics);
+
+			gint i;
+			for(i=pMap->pLayersArray->len-1 ; i>=0 ; i--) {
+				maplayer_t* pLayer = g_ptr_array_index(pMap->pLayersArray, i);
+
+				renderstats_t before = pMap->RenderStats;
+				g_timer_start(pLayerTimer);
+
+				if(pLayer->nDrawType == MAP_LAYER_RENDERTYPE_LINE_LABELS) {
 					gint iTile;
 					for(iTile=0 ; iTile < pTiles->len ; iTile++) {
-						maptile_t* pTile = g_ptr_array_index(pTiles, iTile);
-						map_draw_cairo_layer_polygons(pCairo, pRenderMetrics,
-												 pTile->apMapObjectArrays[pLayer->nDataSource],               // data
-												 pLayer->paStylesAtZoomLevels[nStyleZoomLevel-1]);       // style
+						map_draw_cairo_layer_cached_road_labels(pMap, pCairo, pRenderMetrics,
+																iTile, pLayer->nDataSource,
+																pLayer->paStylesAtZoomLevels[nStyleZoomLevel-1]);
 					}
-				}
-			}
-			else if(pLayer->nDrawType == MAP_LAYER_RENDERTYPE_LINE_LABELS) {
-				if(nDrawFlags & DRAWFLAG_LABELS) {
-					gint iTile;
 					for(iTile=0 ; iTile < pTiles->len ; iTile++) {
-						maptile_t* pTile = g_ptr_array_index(pTiles, iTile);
 						map_draw_cairo_layer_road_labels(pMap, pCairo, pRenderMetrics,
-														 pTile->apMapObjectArrays[pLayer->nDataSource],               // data
+														 iTile, pLayer->nDataSource,               // data
 														 pLayer->paStylesAtZoomLevels[nStyleZoomLevel-1]);
 					}
 				}
-			}
-			else if(pLayer->nDrawType == MAP_LAYER_RENDERTYPE_POLYGON_LABELS) {
-				if(nDrawFlags & DRAWFLAG_LABELS) {
+				else if(pLayer->nDrawType == MAP_LAYER_RENDERTYPE_POLYGON_LABELS) {
 					gint iTile;
 					for(iTile=0 ; iTile < pTiles->len ; iTile++) {
 						maptile_t* pTile = g_ptr_array_index(pTiles, iTile);
@@ -194,12 +229,14 @@ void map_draw_cairo(map_t* pMap, GPtrArray* pTiles, rendermetrics_t* pRenderMetr
 															pLayer->paStylesAtZoomLevels[nStyleZoomLevel-1]);
 					}
 				}
-			}
-			else if(pLayer->nDrawType == MAP_LAYER_RENDERTYPE_FILL) {
-				if(nDrawFlags & DRAWFLAG_GEOMETRY) {
-					map_draw_cairo_layer_fill(pMap, pCairo, pRenderMetrics, pLayer->paStylesAtZoomLevels[nStyleZoomLevel-1]);       // style
+				else {
+					continue;	// geometry, done above
 				}
+				map_layerstats_add_frame_delta(&g_array_index(pMap->pLayerStatsArray, maplayerstats_t, i), &before, &(pMap->RenderStats), g_timer_elapsed(pLayerTimer, NULL));
 			}
+			g_timer_destroy(pLayerTimer);
+			pMap->RenderStats.fLabelSeconds = g_timer_elapsed(pTimer, NULL);
+			g_timer_destroy(pTimer);
 		}
 	}
 
@@ -216,18 +253,244 @@ void map_draw_cairo(map_t* pMap, GPtrArray* pTiles, rendermetrics_t* pRenderMetr
 #ifdef ENABLE_DRAW_MAP_SCALE
 	map_draw_cairo_map_scale(pMap, pCairo, pRenderMetrics);
 #endif
+#ifdef ENABLE_DRAW_LAYER_STATS
+	if(pMap->bShowLayerStats && pMap->pLayersArray->len > 0) {
+		map_draw_cairo_layer_stats(pMap, pCairo, pRenderMetrics);
+	}
+#endif
 
 	// 4. Cleanup
 	cairo_restore(pCairo);
+	cairo_destroy(pCairo);
 	TIMER_END(maptimer, "END RENDER MAP (cairo)");
 }
 
+// Draw the geometry layers (lines, polygons and fills) of some of the tiles, bottom layer first.
+// Each layer is one path across all the tiles, stroked or filled once.
+static void map_draw_cairo_geometry_layers(map_t* pMap, cairo_t* pCairo, rendermetrics_t* pRenderMetrics, mapclipbuffer_t* pClipBuffer, renderstats_t* pStats, maplayerstats_t* aLayerStats, const gint* aiTiles, gint nNumTiles)
+{
+	gint nStyleZoomLevel = g_sZoomLevels[pRenderMetrics->nZoomLevel-1].nStyleZoomLevel;
+	GTimer* pTimer = g_timer_new();
+
+	gint i;
+	for(i=pMap->pLayersArray->len-1 ; i>=0 ; i--) {
+		maplayer_t* pLayer = g_ptr_array_index(pMap->pLayersArray, i);
+		maplayerstyle_t* pLayerStyle = pLayer->paStylesAtZoomLevels[nStyleZoomLevel-1];
+
+		renderstats_t before = *pStats;
+		g_timer_start(pTimer);
+
+		if(pLayer->nDrawType == MAP_LAYER_RENDERTYPE_LINES) {
+			map_draw_cairo_layer_lines(pMap, pCairo, pRenderMetrics, pClipBuffer, pStats,
+									 aiTiles, nNumTiles, pLayer->nDataSource,	// data
+									 pLayerStyle);								// style
+		}
+		else if(pLayer->nDrawType == MAP_LAYER_RENDERTYPE_POLYGONS) {
+			map_draw_cairo_layer_polygons(pMap, pCairo, pRenderMetrics, pClipBuffer, pStats,
+									 aiTiles, nNumTiles, pLayer->nDataSource,	// data
+									 pLayerStyle);								// style
+		}
+		else if(pLayer->nDrawType == MAP_LAYER_RENDERTYPE_FILL) {
+			map_draw_cairo_layer_fill(pMap, pCairo, pRenderMetrics, pStats, pLayerStyle);
+		}
+		else {
+			continue;	// labels, done later
+		}
+		map_layerstats_add_frame_delta(&aLayerStats[i], &before, pStats, g_timer_elapsed(pTimer, NULL));
+	}
+	g_timer_destroy(pTimer);
+}
+
+// One raster cell's geometry, drawn into its own image surface (maybe by a worker thread)
+typedef struct {
+	map_t* pMap;
+	rendermetrics_t Metrics;			// the frame's, but with rWorldBoundingBox set to the cell and its margin
+	maprastercell_t Cell;
+	gint* aiTiles;						// the tiles that overlap it
+	gint nNumTiles;
+	cairo_surface_t* pSurface;
+	mapclipbuffer_t* pClipBuffer;		// each job needs its own
+	renderstats_t Stats;				// added to pMap->RenderStats once the job is done...
+	maplayerstats_t* aLayerStats;		// ...and these to pMap->pLayerStatsArray
+	GAsyncQueue* pDoneQueue;			// NULL if run on this thread
+} maprastercelljob_t;
+
+static GPtrArray* g_pCellClipBuffersArray = NULL;	// one per job, kept between frames
+
+static void map_draw_cairo_cell(maprastercelljob_t* pJob)
+{
+	// NOTE: may run on a worker thread.  Only the image surface and the tiles' already-projected points here: no GDK, no X, no scenemanager!
+	cairo_t* pCairo = cairo_create(pJob->pSurface);
+	cairo_translate(pCairo, -(pJob->Cell.nLeft), -(pJob->Cell.nTop));	// so everything can draw in window coordinates
+	cairo_set_miter_limit(pCairo, 10);
+	cairo_set_fill_rule(pCairo, CAIRO_FILL_RULE_WINDING);
+
+	map_draw_cairo_geometry_layers(pJob->pMap, pCairo, &(pJob->Metrics), pJob->pClipBuffer, &(pJob->Stats), pJob->aLayerStats, pJob->aiTiles, pJob->nNumTiles);
+
+	cairo_destroy(pCairo);
+}
+
+#ifdef ENABLE_PARALLEL_CELL_RENDERING
+
+static GThreadPool* g_pCellRenderPool = NULL;
+
+static void map_draw_cairo_cell_job_thread(gpointer pData, gpointer pUserData)
+{
+	maprastercelljob_t* pJob = (maprastercelljob_t*)pData;
+	map_draw_cairo_cell(pJob);
+	g_async_queue_push(pJob->pDoneQueue, pJob);
+}
+
+static gint map_draw_cairo_get_render_thread_count(void)
+{
+	glong nCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+	if(nCPUs < 1) nCPUs = 1;
+	return MIN(nCPUs, MAX_RENDER_THREADS);
+}
+
+#endif
+
+// Draw the geometry layers into the cells of the world-fixed pixel grid that cover the window, then copy the cells to the window.
+// Cells drawn in earlier frames come from the cache.  Every object is stored in each tile it touches, and each cell
+// draws every tile that overlaps it, so nothing is cut at tile or cell edges.
+static void map_draw_cairo_geometry_cells(map_t* pMap, cairo_t* pCairo, GPtrArray* pTiles, rendermetrics_t* pRenderMetrics, const GdkRegion* pClipRegion)
+{
+	if(g_pCellClipBuffersArray == NULL) {
+		g_pCellClipBuffersArray = g_ptr_array_new();
+	}
+
+	GArray* pCellsArray = g_array_new(FALSE, FALSE, sizeof(maprastercell_t));
+	map_rastercache_get_visible_cells(pRenderMetrics, pCellsArray);
+
+	cairo_surface_t** apSurfaces = g_new0(cairo_surface_t*, pCellsArray->len);
+	maprastercelljob_t* aJobs = g_new0(maprastercelljob_t, pCellsArray->len);
+	gint nNumJobs = 0;
+
+	gint iCell;
+	for(iCell=0 ; iCell<pCellsArray->len ; iCell++) {
+		maprastercell_t* pCell = &g_array_index(pCellsArray, maprastercell_t, iCell);
+
+		GdkRectangle rcCell = {pCell->nLeft, pCell->nTop, RASTER_CELL_SIZE, RASTER_CELL_SIZE};
+		if(pClipRegion != NULL && gdk_region_rect_in(pClipRegion, &rcCell) == GDK_OVERLAP_RECTANGLE_OUT) {
+			continue;	// not needed this frame
+		}
+
+#ifdef ENABLE_RASTER_CACHE
+		apSurfaces[iCell] = map_rastercache_lookup(pMap->pRasterCache, pRenderMetrics, pCell);
+		if(apSurfaces[iCell] != NULL) {
+			pMap->RenderStats.nCellsFromCache++;
+			continue;
+		}
+#endif
+		maprastercelljob_t* pJob = &aJobs[nNumJobs];
+		pJob->pMap = pMap;
+		pJob->Metrics = *pRenderMetrics;
+		pJob->Metrics.rWorldBoundingBox = pCell->rcWorld;
+		pJob->Cell = *pCell;
+
+		pJob->aiTiles = g_new(gint, pTiles->len);
+		pJob->aLayerStats = g_new0(maplayerstats_t, pMap->pLayersArray->len);
+		gint iTile;
+		for(iTile=0 ; iTile<pTiles->len ; iTile++) {
+			maptile_t* pTile = g_ptr_array_index(pTiles, iTile);
+			if(map_rect_a_overlap_type_with_rect_b(&(pTile->rcWorldBoundingBox), &(pCell->rcWorld)) != OVERLAP_NONE) {
+				pJob->aiTiles[pJob->nNumTiles++] = iTile;
+			}
+		}
+
+		while(g_pCellClipBuffersArray->len <= nNumJobs) {
+			g_ptr_array_add(g_pCellClipBuffersArray, map_math_clipbuffer_new());
+		}
+		pJob->pClipBuffer = g_ptr_array_index(g_pCellClipBuffersArray, nNumJobs);
+		pJob->pSurface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, RASTER_CELL_SIZE, RASTER_CELL_SIZE);
+		apSurfaces[iCell] = pJob->pSurface;
+		nNumJobs++;
+	}
+
+	if(nNumJobs > 0) {
+		// The jobs may only read the tiles, so simplify and project everything they'll draw here first
+		gint iLayer;
+		for(iLayer=0 ; iLayer<pMap->pLayersArray->len ; iLayer++) {
+			maplayer_t* pLayer = g_ptr_array_index(pMap->pLayersArray, iLayer);
+			if(pLayer->nDrawType != MAP_LAYER_RENDERTYPE_LINES && pLayer->nDrawType != MAP_LAYER_RENDERTYPE_POLYGONS) continue;
+
+			gint iTile;
+			for(iTile=0 ; iTile<pTiles->len ; iTile++) {
+				mapvisibleobjects_t objects;
+				map_projection_get_objects(pMap->pProjection, iTile, pLayer->nDataSource, &objects);
+			}
+		}
+	}
+
+	gint iJob;
+#ifdef ENABLE_PARALLEL_CELL_RENDERING
+	if(g_thread_supported() && nNumJobs > 1) {
+		if(g_pCellRenderPool == NULL) {
+			g_pCellRenderPool = g_thread_pool_new(map_draw_cairo_cell_job_thread, NULL, map_draw_cairo_get_render_thread_count(), FALSE, NULL);
+		}
+
+		GAsyncQueue* pDoneQueue = g_async_queue_new();
+		for(iJob=0 ; iJob<nNumJobs ; iJob++) {
+			aJobs[iJob].pDoneQueue = pDoneQueue;
+			g_thread_pool_push(g_pCellRenderPool, &aJobs[iJob], NULL);
+		}
+		for(iJob=0 ; iJob<nNumJobs ; iJob++) {
+			g_async_queue_pop(pDoneQueue);
+		}
+		g_async_queue_unref(pDoneQueue);
+	}
+	else
+#endif
+	{
+		for(iJob=0 ; iJob<nNumJobs ; iJob++) {
+			map_draw_cairo_cell(&aJobs[iJob]);
+		}
+	}
+
+	for(iJob=0 ; iJob<nNumJobs ; iJob++) {
+		maprastercelljob_t* pJob = &aJobs[iJob];
+#ifdef ENABLE_RASTER_CACHE
+		map_rastercache_add(pMap->pRasterCache, pRenderMetrics, &(pJob->Cell), pJob->pSurface);
+#endif
+		pMap->RenderStats.nPointsLoaded += pJob->Stats.nPointsLoaded;
+		pMap->RenderStats.nPointsEmitted += pJob->Stats.nPointsEmitted;
+		pMap->RenderStats.nStrokes += pJob->Stats.nStrokes;
+		pMap->RenderStats.nFills += pJob->Stats.nFills;
+		pMap->RenderStats.nObjectsDrawn += pJob->Stats.nObjectsDrawn;
+		pMap->RenderStats.nObjectsConsidered += pJob->Stats.nObjectsConsidered;
+		pMap->RenderStats.nObjectsCulled += pJob->Stats.nObjectsCulled;
+		pMap->RenderStats.nClipCalls += pJob->Stats.nClipCalls;
+		pMap->RenderStats.nCellsDrawn++;
+
+		gint iLayer;
+		for(iLayer=0 ; iLayer<pMap->pLayersArray->len ; iLayer++) {
+			map_layerstats_add(&g_array_index(pMap->pLayerStatsArray, maplayerstats_t, iLayer), &(pJob->aLayerStats[iLayer]));
+		}
+		g_free(pJob->aLayerStats);
+		g_free(pJob->aiTiles);
+	}
+	g_free(aJobs);
+
+	// Copy the cells to the window
+	for(iCell=0 ; iCell<pCellsArray->len ; iCell++) {
+		maprastercell_t* pCell = &g_array_index(pCellsArray, maprastercell_t, iCell);
+		if(apSurfaces[iCell] == NULL) continue;
+
+		cairo_set_source_surface(pCairo, apSurfaces[iCell], pCell->nLeft, pCell->nTop);
+		cairo_rectangle(pCairo, pCell->nLeft, pCell->nTop, RASTER_CELL_SIZE, RASTER_CELL_SIZE);
+		cairo_fill(pCairo);
+		cairo_surface_destroy(apSurfaces[iCell]);
+	}
+	g_free(apSurfaces);
+	g_array_free(pCellsArray, TRUE);
+}
+
 // ==============================================
 // Begin map_draw_cairo_* functions
 // ==============================================
 
 // useful for filling the screen with a color.  not much else.
-void map_draw_cairo_layer_fill(map_t* pMap, cairo_t* pCairo, rendermetrics_t* pRenderMetrics, maplayerstyle_t* pLayerStyle)
+void map_draw_cairo_layer_fill(map_t* pMap, cairo_t* pCairo, rendermetrics_t* pRenderMetrics, renderstats_t* pStats, maplayerstyle_t* pLayerStyle)
 {
 	if(pLayerStyle->pGlyphFill != NULL) {
 	}
@@ -236,8 +499,8 @@ void map_draw_cairo_layer_fill(map_t* pMap, cairo_t* pCairo, rendermetrics_t* pR
 		map_draw_cairo_set_rgb(pCairo, &(pLayerStyle->clrPrimary));
 	}
 
-	cairo_rectangle(pCairo, 0,0,pMap->MapDimensions.uWidth, pMap->MapDimensions.uHeight);
-	cairo_fill(pCairo);
+	cairo_paint(pCairo);	// the whole window, or raster cell
+	pStats->nFills++;
 
 	if(pLayerStyle->pGlyphFill != NULL) {
 		// Restore fill style
@@ -267,12 +530,15 @@ void map_draw_cairo_message(map_t* pMap, cairo_t *pCairo, gchar* pszMessage)
 //
 // Draw a whole layer of line labels
 //
-void map_draw_cairo_layer_road_labels(map_t* pMap, cairo_t* pCairo, rendermetrics_t* pRenderMetrics, GPtrArray* pRoadsArray, maplayerstyle_t* pLayerStyle)
+void map_draw_cairo_layer_road_labels(map_t* pMap, cairo_t* pCairo, rendermetrics_t* pRenderMetrics, gint iTile, gint nObjectType, maplayerstyle_t* pLayerStyle)
 {
 	gint i;
 
 	if(pLayerStyle->fFontSize == 0) return;
 
+	mapvisibleobjects_t objects;
+	map_projection_get_objects(pMap->pProjection, iTile, nObjectType, &objects);
+
 	gchar* pszFontFamily = ROAD_FONT;   // XXX: remove hardcoded font
 
 	// set font for whole layer
@@ -280,18 +546,66 @@ void map_draw_cairo_layer_road_labels(map_t* pMap, cairo_t* pCairo, rendermetric
 	cairo_select_font_face(pCairo, pszFontFamily, CAIRO_FONT_SLANT_NORMAL, pLayerStyle->bFontBold ? CAIRO_FONT_WEIGHT_BOLD : CAIRO_FONT_WEIGHT_NORMAL);
 	cairo_set_font_size(pCairo, pLayerStyle->fFontSize);
 
-	for(i=0 ; i<pRoadsArray->len ; i++) {
-		road_t* pRoad = g_ptr_array_index(pRoadsArray, i);
+	for(i=0 ; i<objects.pRoadsArray->len ; i++) {
+		road_t* pRoad = g_ptr_array_index(objects.pRoadsArray, i);
+		pMap->RenderStats.nObjectsConsidered++;
 
 		if(pRoad->pszName[0] == '\0') {
 			continue;
 		}
 
 		if(!map_rects_overlap(&(pRoad->rWorldBoundingBox), &(pRenderMetrics->rWorldBoundingBox))) {
+			pMap->RenderStats.nObjectsCulled++;
 			continue;
 		}
+		pMap->RenderStats.nLabelsAttempted++;
 
-		map_draw_cairo_road_label(pMap, pCairo, pLayerStyle, pRenderMetrics, pRoad->pMapPointsArray, pRoad->pszName);
+		map_draw_cairo_road_label(pMap, pCairo, pLayerStyle, pRenderMetrics,
+								  &objects.aScreenPoints[objects.anFirstPoint[i]], MAP_VISIBLE_OBJECT_NUM_POINTS(&objects, i), pRoad->pszName);
+	}
+	cairo_restore(pCairo);
+}
+
+//
+// Put back the labels of a layer (in one tile) that were placed on the same roads last frame.  This goes before
+// map_draw_cairo_layer_road_labels, so labels that were on screen keep their places instead of losing them to new ones.
+//
+void map_draw_cairo_layer_cached_road_labels(map_t* pMap, cairo_t* pCairo, rendermetrics_t* pRenderMetrics, gint iTile, gint nObjectType, maplayerstyle_t* pLayerStyle)
+{
+	gint i;
+
+	if(pLayerStyle->fFontSize == 0) return;
+
+	mapvisibleobjects_t objects;
+	map_projection_get_objects(pMap->pProjection, iTile, nObjectType, &objects);
+
+	gchar* pszFontFamily = ROAD_FONT;   // XXX: remove hardcoded font
+
+	// set font for whole layer
+	cairo_save(pCairo);
+	cairo_select_font_face(pCairo, pszFontFamily, CAIRO_FONT_SLANT_NORMAL, pLayerStyle->bFontBold ? CAIRO_FONT_WEIGHT_BOLD : CAIRO_FONT_WEIGHT_NORMAL);
+	cairo_set_font_size(pCairo, pLayerStyle->fFontSize);
+
+	for(i=0 ; i<objects.pRoadsArray->len ; i++) {
+		road_t* pRoad = g_ptr_array_index(objects.pRoadsArray, i);
+
+		if(pRoad->pszName[0] == '\0') {
+			continue;
+		}
+
+		if(!map_rects_overlap(&(pRoad->rWorldBoundingBox), &(pRenderMetrics->rWorldBoundingBox))) {
+			continue;
+		}
+
+		const maplabelplacement_t* pPlacement = map_labelcache_lookup(pMap->pLabelCache, pRenderMetrics, pRoad->pszName,
+																	  &objects.aScreenPoints[objects.anFirstPoint[i]], MAP_VISIBLE_OBJECT_NUM_POINTS(&objects, i));
+		if(pPlacement == NULL) {
+			continue;
+		}
+		if(!scenemanager_can_draw_label_at(pMap->pSceneManager, pRoad->pszName, NULL, SCENEMANAGER_FLAG_PARTLY_ON_SCREEN)) {
+			continue;
+		}
+		map_draw_cairo_road_label_cached(pMap, pCairo, pLayerStyle, pRenderMetrics, pPlacement);
 	}
 	cairo_restore(pCairo);
 }
@@ -315,28 +629,60 @@ void map_draw_cairo_layer_polygon_labels(map_t* pMap, cairo_t* pCairo, rendermet
 	gint i;
 	for(i=0 ; i<pRoadsArray->len ; i++) {
 		road_t* pRoad = g_ptr_array_index(pRoadsArray, i);
+		pMap->RenderStats.nObjectsConsidered++;
 		if(pRoad->pszName[0] == '\0') {
 			continue;
 		}
 
 		if(!map_rects_overlap(&(pRoad->rWorldBoundingBox), &(pRenderMetrics->rWorldBoundingBox))) {
+			pMap->RenderStats.nObjectsCulled++;
 			continue;
 		}
+		pMap->RenderStats.nLabelsAttempted++;
 
 		map_draw_cairo_polygon_label(pMap, pCairo, pLayerStyle, pRenderMetrics, pRoad->pMapPointsArray, &(pRoad->rWorldBoundingBox), pRoad->pszName);
 	}
 	cairo_restore(pCairo);
 }
 
+// Add one line to the path, from points already in screen space
+static void map_draw_cairo_line_projected(cairo_t* pCairo, const maplayerstyle_t* pLayerStyle, const screenpointf_t* aPoints, gint nNumPoints)
+{
+	gdouble fOffsetX = pLayerStyle->nPixelOffsetX;
+	gdouble fOffsetY = pLayerStyle->nPixelOffsetY;
+
+	cairo_move_to(pCairo, fOffsetX + aPoints[0].fX, fOffsetY + aPoints[0].fY);
+
+	gint iPoint;
+	for(iPoint=1 ; iPoint<nNumPoints ; iPoint++) {
+		cairo_line_to(pCairo, fOffsetX + aPoints[iPoint].fX, fOffsetY + aPoints[iPoint].fY);
+	}
+}
+
+// Add one line to the path
+static void map_draw_cairo_line(cairo_t* pCairo, const rendermetrics_t* pRenderMetrics, const maplayerstyle_t* pLayerStyle, const mappoint_t* aPoints, gint nNumPoints)
+{
+	// go to index 0
+	cairo_move_to(pCairo, 
+				  pLayerStyle->nPixelOffsetX + SCALE_X(pRenderMetrics, aPoints[0].fLongitude), 
+				  pLayerStyle->nPixelOffsetY + SCALE_Y(pRenderMetrics, aPoints[0].fLatitude));
+
+	// start at index 1 (0 was used above)
+	gint iPoint;
+	for(iPoint=1 ; iPoint<nNumPoints ; iPoint++) {
+		cairo_line_to(pCairo, 
+					  pLayerStyle->nPixelOffsetX + SCALE_X(pRenderMetrics, aPoints[iPoint].fLongitude), 
+					  pLayerStyle->nPixelOffsetY + SCALE_Y(pRenderMetrics, aPoints[iPoint].fLatitude));
+	}
+}
+
 //
-// Draw a whole layer of lines
+// Draw a whole layer of lines, from all the given tiles
 //
-void map_draw_cairo_layer_lines(cairo_t* pCairo, rendermetrics_t* pRenderMetrics, GPtrArray* pRoadsArray, maplayerstyle_t* pLayerStyle)
+void map_draw_cairo_layer_lines(map_t* pMap, cairo_t* pCairo, rendermetrics_t* pRenderMetrics, mapclipbuffer_t* pClipBuffer, renderstats_t* pStats, const gint* aiTiles, gint nNumTiles, gint nObjectType, maplayerstyle_t* pLayerStyle)
 {
-	mappoint_t* pPoint;
 	road_t* pRoad;
 	gint iString;
-	gint iPoint;
 
 	if(pLayerStyle->fLineWidth <= 0.0) return;	// Don't draw invisible lines
 	if(pLayerStyle->clrPrimary.fAlpha == 0.0) return;
@@ -377,46 +723,79 @@ void map_draw_cairo_layer_lines(cairo_t* pCairo, rendermetrics_t* pRenderMetrics
 	map_draw_cairo_set_rgba(pCairo, &(pLayerStyle->clrPrimary));
 	cairo_set_line_width(pCairo, pLayerStyle->fLineWidth);
 
-	for(iString=0 ; iString<pRoadsArray->len ; iString++) {
-		pRoad = g_ptr_array_index(pRoadsArray, iString);
+	// Clip lines that run off screen, to a rect big enough that the cut ends (and their caps) aren't visible.
+	// Not dashed lines: the dashes would start over at the cut, and crawl as the map scrolls.
+	gboolean bClip = (pLayerStyle->pDashStyle == NULL);
+	maprect_t rcClip;
+	map_math_get_worldrect_inflated_by_pixels(pRenderMetrics,
+		pLayerStyle->fLineWidth + MAX(ABS(pLayerStyle->nPixelOffsetX), ABS(pLayerStyle->nPixelOffsetY)) + 2, &rcClip);
 
-		EOverlapType eOverlapType = map_rect_a_overlap_type_with_rect_b(&(pRoad->rWorldBoundingBox), &(pRenderMetrics->rWorldBoundingBox));
-		if(eOverlapType == OVERLAP_NONE) {
-			continue;
-		}
-
-		if(pRoad->pMapPointsArray->len < 2) {
-			continue;
-		}
+	gint i;
+	for(i=0 ; i<nNumTiles ; i++) {
+		mapvisibleobjects_t objects;
+		map_projection_get_objects(pMap->pProjection, aiTiles[i], nObjectType, &objects);
 
-		pPoint = &g_array_index(pRoad->pMapPointsArray, mappoint_t, 0);
+		for(iString=0 ; iString<objects.pRoadsArray->len ; iString++) {
+			pRoad = g_ptr_array_index(objects.pRoadsArray, iString);
+			pStats->nObjectsConsidered++;
 
-		// go to index 0
-		cairo_move_to(pCairo, 
-					  pLayerStyle->nPixelOffsetX + SCALE_X(pRenderMetrics, pPoint->fLongitude), 
-					  pLayerStyle->nPixelOffsetY + SCALE_Y(pRenderMetrics, pPoint->fLatitude));
+			EOverlapType eOverlapType = map_rect_a_overlap_type_with_rect_b(&(pRoad->rWorldBoundingBox), &(pRenderMetrics->rWorldBoundingBox));
+			if(eOverlapType == OVERLAP_NONE) {
+				pStats->nObjectsCulled++;
+				continue;
+			}
 
-		// start at index 1 (0 was used above)
-		for(iPoint=1 ; iPoint<pRoad->pMapPointsArray->len ; iPoint++) {
-			pPoint = &g_array_index(pRoad->pMapPointsArray, mappoint_t, iPoint);//~ g_print("  point (%.05f,%.05f)\n", ScaleX(pPoint->fLongitude), ScaleY(pPoint->fLatitude));
-			cairo_line_to(pCairo, 
-						  pLayerStyle->nPixelOffsetX + SCALE_X(pRenderMetrics, pPoint->fLongitude), 
-						  pLayerStyle->nPixelOffsetY + SCALE_Y(pRenderMetrics, pPoint->fLatitude));
-		}
+			gint nNumPoints = MAP_VISIBLE_OBJECT_NUM_POINTS(&objects, iString);
+			if(nNumPoints < 2) {
+				continue;
+			}
+			pStats->nObjectsDrawn++;
+			pStats->nPointsLoaded += pRoad->pMapPointsArray->len;
+
+			if(eOverlapType == OVERLAP_PARTIAL && bClip) {
+				// draw just the pieces near the screen
+				gint nRuns = map_math_clip_polyline_to_worldrect(&objects.aMapPoints[objects.anFirstPoint[iString]], nNumPoints, &rcClip, pClipBuffer);
+				pStats->nClipCalls++;
+				const mappoint_t* pRunPoints = &g_array_index(pClipBuffer->pPointsArray, mappoint_t, 0);
+				gint iRun;
+				for(iRun=0 ; iRun<nRuns ; iRun++) {
+					gint nRunLength = g_array_index(pClipBuffer->pRunsArray, gint, iRun);
+					map_draw_cairo_line(pCairo, pRenderMetrics, pLayerStyle, pRunPoints, nRunLength);
+					pRunPoints += nRunLength;
+				}
+				pStats->nPointsEmitted += pClipBuffer->pPointsArray->len;
+			}
+			else {
+				map_draw_cairo_line_projected(pCairo, pLayerStyle, &objects.aScreenPoints[objects.anFirstPoint[iString]], nNumPoints);
+				pStats->nPointsEmitted += nNumPoints;
+			}
 #ifdef ENABLE_HACK_AROUND_CAIRO_LINE_CAP_BUG
-		cairo_stroke(pCairo);	// this is wrong place for it (see below)
+			cairo_stroke(pCairo);	// this is wrong place for it (see below)
+			pStats->nStrokes++;
 #endif
+		}
 	}
 
 #ifndef ENABLE_HACK_AROUND_CAIRO_LINE_CAP_BUG
 	// this is correct place to stroke, but we can't do this until Cairo fixes this bug:
 	// http://cairographics.org/samples/xxx_multi_segment_caps.html
 	cairo_stroke(pCairo);
+	pStats->nStrokes++;
 #endif
 
 	cairo_restore(pCairo);
 }
 
+static void map_draw_cairo_polygon_projected(cairo_t* pCairo, const screenpointf_t* aPoints, gint nNumPoints)
+{
+	cairo_move_to(pCairo, aPoints[0].fX, aPoints[0].fY);
+
+	gint iPoint;
+	for(iPoint=1 ; iPoint<nNumPoints ; iPoint++) {
+		cairo_line_to(pCairo, aPoints[iPoint].fX, aPoints[iPoint].fY);
+	}
+}
+
 void map_draw_cairo_polygon(cairo_t* pCairo, const rendermetrics_t* pRenderMetrics, const GArray* pMapPointsArray)
 {
 	// move to index 0
@@ -431,7 +810,8 @@ void map_draw_cairo_polygon(cairo_t* pCairo, const rendermetrics_t* pRenderMetri
 	}
 }
 
-void map_draw_cairo_layer_polygons(cairo_t* pCairo, rendermetrics_t* pRenderMetrics, GPtrArray* pRoadsArray, maplayerstyle_t* pLayerStyle)
+// Draw a whole layer of polygons, from all the given tiles
+void map_draw_cairo_layer_polygons(map_t* pMap, cairo_t* pCairo, rendermetrics_t* pRenderMetrics, mapclipbuffer_t* pClipBuffer, renderstats_t* pStats, const gint* aiTiles, gint nNumTiles, gint nObjectType, maplayerstyle_t* pLayerStyle)
 {
 	road_t* pRoad;
 
@@ -439,35 +819,53 @@ void map_draw_cairo_layer_polygons(cairo_t* pCairo, rendermetrics_t* pRenderMetr
 
 	// Set layer attributes	
 	map_draw_cairo_set_rgba(pCairo, &(pLayerStyle->clrPrimary));
+	// Even-odd, so holes come out whichever way they're wound (data imported before we spliced holes in
+	// doesn't wind them against the outer ring).  The importer clips polygons to their tiles, so the
+	// tiles' pieces of the path don't overlap.
 	cairo_set_fill_rule(pCairo, CAIRO_FILL_RULE_EVEN_ODD);
 	cairo_set_line_join(pCairo, pLayerStyle->nJoinStyle);
 
-	gint iString;
-	for(iString=0 ; iString<pRoadsArray->len ; iString++) {
-		pRoad = g_ptr_array_index(pRoadsArray, iString);
-
-		EOverlapType eOverlapType = map_rect_a_overlap_type_with_rect_b(&(pRoad->rWorldBoundingBox), &(pRenderMetrics->rWorldBoundingBox));
-		if(eOverlapType == OVERLAP_NONE) {
-//			g_print("OOPS!  A linestring with <3 points (%d)\n", pPointString->pPointsArray->len);
-			continue;
-		}
-
-		if(pRoad->pMapPointsArray->len < 3) {
-			continue;
-		}
+	gint i;
+	for(i=0 ; i<nNumTiles ; i++) {
+		mapvisibleobjects_t objects;
+		map_projection_get_objects(pMap->pProjection, aiTiles[i], nObjectType, &objects);
+
+		gint iString;
+		for(iString=0 ; iString<objects.pRoadsArray->len ; iString++) {
+			pRoad = g_ptr_array_index(objects.pRoadsArray, iString);
+			pStats->nObjectsConsidered++;
+
+			EOverlapType eOverlapType = map_rect_a_overlap_type_with_rect_b(&(pRoad->rWorldBoundingBox), &(pRenderMetrics->rWorldBoundingBox));
+			if(eOverlapType == OVERLAP_NONE) {
+				pStats->nObjectsCulled++;
+//				g_print("OOPS!  A linestring with <3 points (%d)\n", pPointString->pPointsArray->len);
+				continue;
+			}
 
-		if(eOverlapType == OVERLAP_PARTIAL) {
-			// draw clipped
-			GArray* pClipped = g_array_sized_new(FALSE, FALSE, sizeof(mappoint_t), pRoad->pMapPointsArray->len + 20);	// it's rarely more than a few extra points
-			map_math_clip_pointstring_to_worldrect(pRoad->pMapPointsArray, &(pRenderMetrics->rWorldBoundingBox), pClipped);
-			map_draw_cairo_polygon(pCairo, pRenderMetrics, pClipped);
-			g_array_free(pClipped, TRUE);
-		}
-		else {
-			map_draw_cairo_polygon(pCairo, pRenderMetrics, pRoad->pMapPointsArray);
+			gint nNumPoints = MAP_VISIBLE_OBJECT_NUM_POINTS(&objects, iString);
+			if(nNumPoints < 3) {
+				continue;
+			}
+			pStats->nObjectsDrawn++;
+			pStats->nPointsLoaded += pRoad->pMapPointsArray->len;
+
+			if(eOverlapType == OVERLAP_PARTIAL) {
+				// draw clipped
+				const GArray* pClipped = map_math_clip_polygon_to_worldrect(&objects.aMapPoints[objects.anFirstPoint[iString]], nNumPoints, &(pRenderMetrics->rWorldBoundingBox), pClipBuffer);
+				pStats->nClipCalls++;
+				if(pClipped->len >= 3) {
+					map_draw_cairo_polygon(pCairo, pRenderMetrics, pClipped);
+					pStats->nPointsEmitted += pClipped->len;
+				}
+			}
+			else {
+				map_draw_cairo_polygon_projected(pCairo, &objects.aScreenPoints[objects.anFirstPoint[iString]], nNumPoints);
+				pStats->nPointsEmitted += nNumPoints;
+			}
 		}
 	}
 	cairo_fill(pCairo);
+	pStats->nFills++;
 }
 
 /*
@@ -527,28 +925,87 @@ typedef struct labelposition {
 	gdouble fScore;
 } labelposition_t;
 
+//
+// Road label text, measured (and shaped) in the layer's font, which map_draw_cairo_layer_road_labels has selected
+//
+static const maptext_t* map_draw_cairo_road_label_text(map_t* pMap, cairo_t *pCairo, maplayerstyle_t* pLayerStyle, const gchar* pszText)
+{
+	return map_textcache_lookup(pMap->pTextCache, pCairo, ROAD_FONT, pLayerStyle->fFontSize, pLayerStyle->bFontBold, pszText);
+}
+
+//
+// Draw one piece of a road label, with the style's halo
+//
+static void map_draw_cairo_road_label_run(cairo_t *pCairo, maplayerstyle_t* pLayerStyle, const maptext_t* pText, gdouble fDrawX, gdouble fDrawY, gdouble fAngleInRadians)
+{
+	// Draw a "halo" around text if the style calls for it
+	if(pLayerStyle->fHaloSize >= 0) {
+		// Halo = stroking the text path with a fat white line
+		map_draw_cairo_set_rgba(pCairo, &(pLayerStyle->clrHalo));
+
+		gint iHaloOffsets;
+
+		for(iHaloOffsets = 0 ; iHaloOffsets < G_N_ELEMENTS(g_aHaloOffsets); iHaloOffsets++) {
+			map_textcache_draw(pCairo, pText, fDrawX + g_aHaloOffsets[iHaloOffsets].nX, fDrawY + g_aHaloOffsets[iHaloOffsets].nY, fAngleInRadians);
+		}
+	}
+	map_draw_cairo_set_rgba(pCairo, &(pLayerStyle->clrPrimary));
+	map_textcache_draw(pCairo, pText, fDrawX, fDrawY, fAngleInRadians);
+}
+
+//
+// Put a road label back where it was last frame, if there's still room for all of it
+//
+static gboolean map_draw_cairo_road_label_cached(map_t* pMap, cairo_t *pCairo, maplayerstyle_t* pLayerStyle, rendermetrics_t* pRenderMetrics, const maplabelplacement_t* pPlacement)
+{
+	gdouble fDrawX, fDrawY;
+	GdkPoint aBoundingPolygon[4];
+	gint i;
+
+	for(i=0 ; i<pPlacement->pRunsArray->len ; i++) {
+		map_labelcache_get_run(pRenderMetrics, &g_array_index(pPlacement->pRunsArray, maplabelrun_t, i), &fDrawX, &fDrawY, aBoundingPolygon);
+		if(FALSE == scenemanager_can_draw_polygon(pMap->pSceneManager, aBoundingPolygon, 4, SCENEMANAGER_FLAG_PARTLY_ON_SCREEN)) {
+			return FALSE;
+		}
+	}
+
+	for(i=0 ; i<pPlacement->pRunsArray->len ; i++) {
+		const maplabelrun_t* pRun = &g_array_index(pPlacement->pRunsArray, maplabelrun_t, i);
+		map_labelcache_get_run(pRenderMetrics, pRun, &fDrawX, &fDrawY, aBoundingPolygon);
+
+		const maptext_t* pText = map_draw_cairo_road_label_text(pMap, pCairo, pLayerStyle, pRun->pszText);
+		map_draw_cairo_road_label_run(pCairo, pLayerStyle, pText, fDrawX, fDrawY, pRun->fAngleInRadians);
+		scenemanager_claim_polygon(pMap->pSceneManager, aBoundingPolygon, 4);
+	}
+	scenemanager_claim_label(pMap->pSceneManager, pPlacement->pszLabel);
+	map_labelcache_mark_drawn(pMap->pLabelCache, pPlacement);
+	pMap->RenderStats.nLabelsPlaced++;
+	pMap->RenderStats.nLabelsFromCache++;
+	return TRUE;
+}
+
 //
 // Draw a label along a 2-point line
 //
-static void map_draw_cairo_road_label_one_segment(map_t* pMap, cairo_t *pCairo, maplayerstyle_t* pLayerStyle, rendermetrics_t* pRenderMetrics, GArray* pMapPointsArray, gchar* pszLabel)
+static void map_draw_cairo_road_label_one_segment(map_t* pMap, cairo_t *pCairo, maplayerstyle_t* pLayerStyle, rendermetrics_t* pRenderMetrics, const screenpointf_t* aPoints, gchar* pszLabel)
 {
 	// get permission to draw this label
 	if(FALSE == scenemanager_can_draw_label_at(pMap->pSceneManager, pszLabel, NULL, SCENEMANAGER_FLAG_PARTLY_ON_SCREEN)) {
 		return;
 	}
 
-	mappoint_t* pMapPoint1 = &g_array_index(pMapPointsArray, mappoint_t, 0);
-	mappoint_t* pMapPoint2 = &g_array_index(pMapPointsArray, mappoint_t, 1);
+	const screenpointf_t* pPoint1 = &aPoints[0];
+	const screenpointf_t* pPoint2 = &aPoints[1];
 
 	// swap first and second points such that the line goes left-to-right
-	if(pMapPoint2->fLongitude < pMapPoint1->fLongitude) {
-		mappoint_t* pTmp = pMapPoint1; pMapPoint1 = pMapPoint2; pMapPoint2 = pTmp;
+	if(pPoint2->fX < pPoint1->fX) {
+		const screenpointf_t* pTmp = pPoint1; pPoint1 = pPoint2; pPoint2 = pTmp;
 	}
 
-	gdouble fX1 = SCALE_X(pRenderMetrics, pMapPoint1->fLongitude);
-	gdouble fY1 = SCALE_Y(pRenderMetrics, pMapPoint1->fLatitude);
-	gdouble fX2 = SCALE_X(pRenderMetrics, pMapPoint2->fLongitude);
-	gdouble fY2 = SCALE_Y(pRenderMetrics, pMapPoint2->fLatitude);
+	gdouble fX1 = pPoint1->fX;
+	gdouble fY1 = pPoint1->fY;
+	gdouble fX2 = pPoint2->fX;
+	gdouble fY2 = pPoint2->fY;
 
 	gdouble fRise = fY2 - fY1;
 	gdouble fRun = fX2 - fX1;
@@ -559,10 +1016,9 @@ static void map_draw_cairo_road_label_one_segment(map_t* pMap, cairo_t *pCairo,
 	cairo_save(pCairo);
 
 	// get total width of string
-	cairo_text_extents_t extents;
-	cairo_text_extents(pCairo, pszLabel, &extents);
-	gdouble fLabelWidth = extents.width;
-	gdouble fFontHeight = -extents.y_bearing;
+	const maptext_t* pText = map_draw_cairo_road_label_text(pMap, pCairo, pLayerStyle, pszLabel);
+	gdouble fLabelWidth = pText->Extents.width;
+	gdouble fFontHeight = -(pText->Extents.y_bearing);
 
 	gdouble fLineLength = sqrt(fLineLengthSquared);
 
@@ -635,33 +1091,16 @@ static void map_draw_cairo_road_label_one_segment(map_t* pMap, cairo_t *pCairo,
 		fAngleInRadians = floor((fAngleInRadians * ROUND_DOWN_TEXT_ANGLE) + 0.5) / ROUND_DOWN_TEXT_ANGLE;
 #endif
 
-		cairo_save(pCairo);								// XXX: do we need this?
-
-
-		// Draw a "halo" around text if the style calls for it
-		if(pLayerStyle->fHaloSize >= 0) {
-			// Halo = stroking the text path with a fat white line
-			map_draw_cairo_set_rgba(pCairo, &(pLayerStyle->clrHalo));
-
-			gint iHaloOffsets;
-
-			for(iHaloOffsets = 0 ; iHaloOffsets < G_N_ELEMENTS(g_aHaloOffsets); iHaloOffsets++) {
-				cairo_save(pCairo);
-				cairo_move_to(pCairo, fDrawX + g_aHaloOffsets[iHaloOffsets].nX, fDrawY + g_aHaloOffsets[iHaloOffsets].nY);
-				cairo_rotate(pCairo, fAngleInRadians);
-				cairo_show_text(pCairo, pszLabel);
-				cairo_restore(pCairo);
-			}
-		}
-		map_draw_cairo_set_rgba(pCairo, &(pLayerStyle->clrPrimary));
-		cairo_move_to(pCairo, fDrawX, fDrawY);
-		cairo_rotate(pCairo, fAngleInRadians);
-		cairo_show_text(pCairo, pszLabel);
-		cairo_restore(pCairo);
+		map_draw_cairo_road_label_run(pCairo, pLayerStyle, pText, fDrawX, fDrawY, fAngleInRadians);
 
 		// claim the space this took up and the label (so it won't be drawn twice)
 		scenemanager_claim_polygon(pMap->pSceneManager, aBoundingPolygon, 4);
 		scenemanager_claim_label(pMap->pSceneManager, pszLabel);
+		pMap->RenderStats.nLabelsPlaced++;
+
+		// try the same place next frame
+		maplabelplacement_t* pPlacement = map_labelcache_add(pMap->pLabelCache, pRenderMetrics, pszLabel, aPoints, 2);
+		map_labelcache_add_run(pPlacement, pRenderMetrics, pszLabel, fDrawX, fDrawY, fAngleInRadians, aBoundingPolygon);
 
 		// success
 		break;
@@ -687,17 +1126,17 @@ static gint map_draw_cairo_road_label_position_sort(gconstpointer pA, gconstpoin
 */
 #endif
 
-static void map_draw_cairo_road_label(map_t* pMap, cairo_t *pCairo, maplayerstyle_t* pLayerStyle, rendermetrics_t* pRenderMetrics, GArray* pMapPointsArray, gchar* pszLabel)
+static void map_draw_cairo_road_label(map_t* pMap, cairo_t *pCairo, maplayerstyle_t* pLayerStyle, rendermetrics_t* pRenderMetrics, const screenpointf_t* aPoints, gint nNumPoints, gchar* pszLabel)
 {
-	if(pMapPointsArray->len < 2) return;
+	if(nNumPoints < 2) return;
 
 	// pass off single segments to a specialized function
-	if(pMapPointsArray->len == 2) {
-		map_draw_cairo_road_label_one_segment(pMap, pCairo, pLayerStyle, pRenderMetrics, pMapPointsArray, pszLabel);
+	if(nNumPoints == 2) {
+		map_draw_cairo_road_label_one_segment(pMap, pCairo, pLayerStyle, pRenderMetrics, aPoints, pszLabel);
 		return;
 	}
 
-	if(pMapPointsArray->len > ROAD_MAX_SEGMENTS) {
+	if(nNumPoints > ROAD_MAX_SEGMENTS) {
 		g_warning("not drawing label for road '%s' with > %d segments.\n", pszLabel, ROAD_MAX_SEGMENTS);
 		return;
 	}
@@ -713,8 +1152,7 @@ static void map_draw_cairo_road_label(map_t* pMap, cairo_t *pCairo, maplayerstyl
 	cairo_save(pCairo);
 
 	// get total width of string
-	cairo_text_extents_t extents;
-	cairo_text_extents(pCairo, pszLabel, &extents);
+	cairo_text_extents_t extents = map_draw_cairo_road_label_text(pMap, pCairo, pLayerStyle, pszLabel)->Extents;
 
 	// now find the ideal location
 
@@ -722,16 +1160,15 @@ static void map_draw_cairo_road_label(map_t* pMap, cairo_t *pCairo, maplayerstyl
 	labelposition_t aPositions[ROAD_MAX_SEGMENTS];
 	gdouble aSlopes[ROAD_MAX_SEGMENTS];
 
-	mappoint_t* apPoints[ROAD_MAX_SEGMENTS];
-	gint nNumPoints = pMapPointsArray->len;
+	const screenpointf_t* apPoints[ROAD_MAX_SEGMENTS];
 
-	mappoint_t* pMapPoint1;
-	mappoint_t* pMapPoint2;
+	const screenpointf_t* pPoint1;
+	const screenpointf_t* pPoint2;
 
 	// load point string into an array
 	gint iRead;
 	for(iRead=0 ; iRead<nNumPoints ; iRead++) {
-		apPoints[iRead] = &g_array_index(pMapPointsArray, mappoint_t, iRead);
+		apPoints[iRead] = &aPoints[iRead];
 	}
 
 	// measure total line length
@@ -740,13 +1177,13 @@ static void map_draw_cairo_road_label(map_t* pMap, cairo_t *pCairo, maplayerstyl
 	gint iPoint, iPosition;
 
 	for(iPoint=1 ; iPoint<nNumPoints ; iPoint++) {
-		pMapPoint1 = apPoints[iPoint-1];
-		pMapPoint2 = apPoints[iPoint];
+		pPoint1 = apPoints[iPoint-1];
+		pPoint2 = apPoints[iPoint];
 
-		gdouble fX1 = SCALE_X(pRenderMetrics, pMapPoint1->fLongitude);
-		gdouble fY1 = SCALE_Y(pRenderMetrics, pMapPoint1->fLatitude);
-		gdouble fX2 = SCALE_X(pRenderMetrics, pMapPoint2->fLongitude);
-		gdouble fY2 = SCALE_Y(pRenderMetrics, pMapPoint2->fLatitude);
+		gdouble fX1 = pPoint1->fX;
+		gdouble fY1 = pPoint1->fY;
+		gdouble fX2 = pPoint2->fX;
+		gdouble fY2 = pPoint2->fY;
 
 		// determine slope of the line
 		gdouble fRise = fY2 - fY1;
@@ -863,7 +1300,7 @@ static void map_draw_cairo_road_label(map_t* pMap, cairo_t *pCairo, maplayerstyl
 			// reverse the array
 			gint iRead,iWrite;
 			for(iWrite=0, iRead=nNumPoints-1 ; iRead>= 0 ; iWrite++, iRead--) {
-				apPoints[iWrite] = &g_array_index(pMapPointsArray, mappoint_t, iRead);
+				apPoints[iWrite] = &aPoints[iRead];
 			}
 		}
 
@@ -879,13 +1316,13 @@ static void map_draw_cairo_road_label(map_t* pMap, cairo_t *pCairo, maplayerstyl
 		for(iPoint = iStartPoint ; iPoint < iEndPoint ; iPoint++) {
 			if(nTotalStringLength == nStringStartIndex) break;	// done
 
-			pMapPoint1 = apPoints[iPoint-1];
-			pMapPoint2 = apPoints[iPoint];
+			pPoint1 = apPoints[iPoint-1];
+			pPoint2 = apPoints[iPoint];
 
-			gdouble fX1 = SCALE_X(pRenderMetrics, pMapPoint1->fLongitude);
-			gdouble fY1 = SCALE_Y(pRenderMetrics, pMapPoint1->fLatitude);
-			gdouble fX2 = SCALE_X(pRenderMetrics, pMapPoint2->fLongitude);
-			gdouble fY2 = SCALE_Y(pRenderMetrics, pMapPoint2->fLatitude);
+			gdouble fX1 = pPoint1->fX;
+			gdouble fY1 = pPoint1->fY;
+			gdouble fX2 = pPoint2->fX;
+			gdouble fY2 = pPoint2->fY;
 
 			// determine slope of the line
 			gdouble fRise = fY2 - fY1;
@@ -910,7 +1347,7 @@ static void map_draw_cairo_road_label(map_t* pMap, cairo_t *pCairo, maplayerstyl
 #endif
 
 			//g_print("(fRise(%f) / fRun(%f)) = %f, atan(fRise / fRun) = %f: ", fRise, fRun, fRise / fRun, fAngleInRadians);
-			//g_print("=== NEW SEGMENT, pixel (deltaY=%f, deltaX=%f), line len=%f, (%f,%f)->(%f,%f)\n",fRise, fRun, fLineLength, pMapPoint1->fLatitude,pMapPoint1->fLongitude,pMapPoint2->fLatitude,pMapPoint2->fLongitude);
+			//g_print("=== NEW SEGMENT, pixel (deltaY=%f, deltaX=%f), line len=%f, (%f,%f)->(%f,%f)\n",fRise, fRun, fLineLength, pPoint1->fX,pPoint1->fY,pPoint2->fX,pPoint2->fY);
 			//g_print("  has screen coords (%f,%f)->(%f,%f)\n", fX1,fY1,fX2,fY2);
 
 			gchar azLabelSegment[DRAW_LABEL_BUFFER_LEN];
@@ -1025,17 +1462,18 @@ static void map_draw_cairo_road_label(map_t* pMap, cairo_t *pCairo, maplayerstyl
 */
 #endif
 
-		// draw it
+		// draw it, and try the same place next frame
+		maplabelplacement_t* pPlacement = map_labelcache_add(pMap->pLabelCache, pRenderMetrics, pszLabel, aPoints, nNumPoints);
 		for(iPoint = iStartPoint ; iPoint < iEndPoint ; iPoint++) {
 			if(nTotalStringLength == nStringStartIndex) break;	// done
 
-			pMapPoint1 = apPoints[iPoint-1];
-			pMapPoint2 = apPoints[iPoint];
+			pPoint1 = apPoints[iPoint-1];
+			pPoint2 = apPoints[iPoint];
 
-			gdouble fX1 = SCALE_X(pRenderMetrics, pMapPoint1->fLongitude);
-			gdouble fY1 = SCALE_Y(pRenderMetrics, pMapPoint1->fLatitude);
-			gdouble fX2 = SCALE_X(pRenderMetrics, pMapPoint2->fLongitude);
-			gdouble fY2 = SCALE_Y(pRenderMetrics, pMapPoint2->fLatitude);
+			gdouble fX1 = pPoint1->fX;
+			gdouble fY1 = pPoint1->fY;
+			gdouble fX2 = pPoint2->fX;
+			gdouble fY2 = pPoint2->fY;
 
 			// determine slope of the line
 			gdouble fRise = fY2 - fY1;
@@ -1054,7 +1492,7 @@ static void map_draw_cairo_road_label(map_t* pMap, cairo_t *pCairo, maplayerstyl
 #endif
 
 			//g_print("(fRise(%f) / fRun(%f)) = %f, atan(fRise / fRun) = %f: ", fRise, fRun, fRise / fRun, fAngleInRadians);
-			//g_print("=== NEW SEGMENT, pixel (deltaY=%f, deltaX=%f), line len=%f, (%f,%f)->(%f,%f)\n",fRise, fRun, fLineLength, pMapPoint1->fLatitude,pMapPoint1->fLongitude,pMapPoint2->fLatitude,pMapPoint2->fLongitude);
+			//g_print("=== NEW SEGMENT, pixel (deltaY=%f, deltaX=%f), line len=%f, (%f,%f)->(%f,%f)\n",fRise, fRun, fLineLength, pPoint1->fX,pPoint1->fY,pPoint2->fX,pPoint2->fY);
 			//g_print("  has screen coords (%f,%f)->(%f,%f)\n", fX1,fY1,fX2,fY2);
 
 			gchar azLabelSegment[DRAW_LABEL_BUFFER_LEN];
@@ -1085,7 +1523,7 @@ static void map_draw_cairo_road_label(map_t* pMap, cairo_t *pCairo, maplayerstyl
 					//g_print("azLabelSegment = %s\n", azLabelSegment);
 	
 					// measure the label
-					cairo_text_extents(pCairo, azLabelSegment, &extents);
+					extents = map_draw_cairo_road_label_text(pMap, pCairo, pLayerStyle, azLabelSegment)->Extents;
 
 					// if we're skipping ahead some (frontpadding), effective line length is smaller, so subtract padding
 					if(extents.width <= (fLineLength - fFrontPadding)) {
@@ -1151,38 +1589,21 @@ static void map_draw_cairo_road_label(map_t* pMap, cairo_t *pCairo, maplayerstyl
 			aBoundingPolygon[3].x = fDrawX + (fNormalizedX * extents.width);
 			aBoundingPolygon[3].y = fDrawY + (fNormalizedY * extents.width);
 
-			cairo_save(pCairo);
-			cairo_set_source_rgba(pCairo, 0.0,0.0,0.0,1.0);
+			// usually already in the cache from measuring it above
+			const maptext_t* pSegmentText = map_draw_cairo_road_label_text(pMap, pCairo, pLayerStyle, azLabelSegment);
 
-			// Draw a "halo" around text if the style calls for it
 			// XXX: This is WRONG, we need to draw halos for all segments FIRST, then draw all text
-			if(pLayerStyle->fHaloSize >= 0) {
-				// Halo = stroking the text path with a fat white line
-				map_draw_cairo_set_rgba(pCairo, &(pLayerStyle->clrHalo));
-
-				gint iHaloOffsets;
-
-				for(iHaloOffsets = 0 ; iHaloOffsets < G_N_ELEMENTS(g_aHaloOffsets); iHaloOffsets++) {
-					cairo_save(pCairo);
-					cairo_move_to(pCairo, fDrawX + g_aHaloOffsets[iHaloOffsets].nX, fDrawY + g_aHaloOffsets[iHaloOffsets].nY);
-					cairo_rotate(pCairo, fAngleInRadians);
-					cairo_show_text(pCairo, azLabelSegment);
-					cairo_restore(pCairo);
-				}
-			}
-			map_draw_cairo_set_rgba(pCairo, &(pLayerStyle->clrPrimary));
-			cairo_move_to(pCairo, fDrawX, fDrawY);
-			cairo_rotate(pCairo, fAngleInRadians);
-			cairo_show_text(pCairo, azLabelSegment);
-			cairo_restore(pCairo);
+			map_draw_cairo_road_label_run(pCairo, pLayerStyle, pSegmentText, fDrawX, fDrawY, fAngleInRadians);
 
 			// claim the space this took up
 			scenemanager_claim_polygon(pMap->pSceneManager, aBoundingPolygon, 4);
+			map_labelcache_add_run(pPlacement, pRenderMetrics, azLabelSegment, fDrawX, fDrawY, fAngleInRadians, aBoundingPolygon);
 		}
 		cairo_restore(pCairo);
 
 		// claim the label (so it won't be drawn twice)
 		scenemanager_claim_label(pMap->pSceneManager, pszLabel);
+		pMap->RenderStats.nLabelsPlaced++;
 
 //         // success
 //         break;
@@ -1370,6 +1791,10 @@ static void map_draw_cairo_map_scale(map_t* pMap, cairo_t *pCairo, rendermetrics
 	cairo_set_line_cap(pCairo, CAIRO_LINE_CAP_SQUARE); 
 	cairo_set_source_rgba(pCairo, 1, 1, 1, 1);
 	cairo_set_line_width(pCairo, 4);
+
+	gdouble fLeft, fTop, fRight, fBottom;	// what we draw, for pMap->rcMapScale
+	cairo_stroke_extents(pCairo, &fLeft, &fTop, &fRight, &fBottom);
+
 	cairo_stroke_preserve(pCairo);
 
 	cairo_set_source_rgba(pCairo, 0.2, 0.2, 0.2, 1);
@@ -1383,19 +1808,90 @@ static void map_draw_cairo_map_scale(map_t* pMap, cairo_t *pCairo, rendermetrics
 	cairo_move_to(pCairo, fLeftCenterPointX + 3.0, fLeftCenterPointY - 4.0);
 	cairo_show_text(pCairo, pszImperialLabel);
 
-	// get total width of string
 	cairo_text_extents_t extents;
+	cairo_text_extents(pCairo, pszImperialLabel, &extents);
+	fRight = MAX(fRight, fLeftCenterPointX + 3.0 + extents.x_bearing + extents.width);
+	fTop = MIN(fTop, fLeftCenterPointY - 4.0 + extents.y_bearing);
+
+	// get total width of string
 	cairo_text_extents(pCairo, pszMetricLabel, &extents);
 	gdouble fFontHeight = -extents.y_bearing;
 
 	cairo_move_to(pCairo, fLeftCenterPointX + 3.0, fLeftCenterPointY + fFontHeight + 3.0);
 	cairo_show_text(pCairo, pszMetricLabel);
 
+	fRight = MAX(fRight, fLeftCenterPointX + 3.0 + extents.x_bearing + extents.width);
+	fBottom = MAX(fBottom, fLeftCenterPointY + fFontHeight + 3.0 + extents.y_bearing + extents.height);
+
 	cairo_restore(pCairo);
 
+	// whole pixels, and one more for antialiasing
+	pMap->rcMapScale.x = (gint)floor(fLeft) - 1;
+	pMap->rcMapScale.y = (gint)floor(fTop) - 1;
+	pMap->rcMapScale.width = (gint)ceil(fRight) + 1 - pMap->rcMapScale.x;
+	pMap->rcMapScale.height = (gint)ceil(fBottom) + 1 - pMap->rcMapScale.y;
+
 	g_free(pszImperialLabel);
 }
 
+// A table of each style layer's counters for this frame, top left, in drawing order (see map_set_show_layer_stats)
+static void map_draw_cairo_layer_stats(map_t* pMap, cairo_t *pCairo, rendermetrics_t* pRenderMetrics)
+{
+#define LAYER_STATS_FONT_NAME	("Monospace")
+#define LAYER_STATS_FONT_SIZE	(10.0)
+#define LAYER_STATS_MARGIN		(6.0)
+
+	GPtrArray* pLinesArray = g_ptr_array_new();
+	g_ptr_array_add(pLinesArray, g_strdup_printf("%-20s %-14s %8s %8s %8s %9s %6s %9s",
+						"layer", "type", "ms", "objects", "culled", "points", "clips", "labels"));
+
+	gint i;
+	for(i=pMap->pLayersArray->len-1 ; i>=0 ; i--) {
+		maplayer_t* pLayer = g_ptr_array_index(pMap->pLayersArray, i);
+		const maplayerstats_t* pStats = map_get_layer_stats(pMap, i);
+		if(pStats->nObjectsConsidered == 0 && pStats->fSeconds == 0.0) continue;	// not drawn this frame
+
+		gchar* pszLabels = (pStats->nLabelsAttempted > 0) ? g_strdup_printf("%d/%d", pStats->nLabelsPlaced, pStats->nLabelsAttempted) : g_strdup("");
+		g_ptr_array_add(pLinesArray, g_strdup_printf("%-20s %-14s %8.2f %8d %8d %9d %6d %9s",
+							map_object_type_itoa(pLayer->nDataSource), map_layer_render_type_itoa(pLayer->nDrawType),
+							pStats->fSeconds * 1000.0, pStats->nObjectsConsidered, pStats->nObjectsCulled,
+							pStats->nPointsEmitted, pStats->nClipCalls, pszLabels));
+		g_free(pszLabels);
+	}
+	g_ptr_array_add(pLinesArray, g_strdup_printf("load %.2f ms, geometry %.2f ms, labels %.2f ms, %d cells drawn, %d from cache",
+						pMap->RenderStats.fLoadSeconds * 1000.0, pMap->RenderStats.fGeometrySeconds * 1000.0, pMap->RenderStats.fLabelSeconds * 1000.0,
+						pMap->RenderStats.nCellsDrawn, pMap->RenderStats.nCellsFromCache));
+
+	cairo_save(pCairo);
+	cairo_select_font_face(pCairo, LAYER_STATS_FONT_NAME, CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+	cairo_set_font_size(pCairo, LAYER_STATS_FONT_SIZE);
+
+	cairo_font_extents_t fontExtents;
+	cairo_font_extents(pCairo, &fontExtents);
+
+	gdouble fWidth = 0.0;
+	for(i=0 ; i<pLinesArray->len ; i++) {
+		cairo_text_extents_t extents;
+		cairo_text_extents(pCairo, g_ptr_array_index(pLinesArray, i), &extents);
+		fWidth = MAX(fWidth, extents.x_advance);
+	}
+
+	// background
+	cairo_set_source_rgba(pCairo, 1, 1, 1, 0.85);
+	cairo_rectangle(pCairo, LAYER_STATS_MARGIN, LAYER_STATS_MARGIN,
+					fWidth + (2 * LAYER_STATS_MARGIN), (pLinesArray->len * fontExtents.height) + (2 * LAYER_STATS_MARGIN));
+	cairo_fill(pCairo);
+
+	cairo_set_source_rgba(pCairo, 0.1, 0.1, 0.1, 1);
+	for(i=0 ; i<pLinesArray->len ; i++) {
+		cairo_move_to(pCairo, 2 * LAYER_STATS_MARGIN, (2 * LAYER_STATS_MARGIN) + fontExtents.ascent + (i * fontExtents.height));
+		cairo_show_text(pCairo, g_ptr_array_index(pLinesArray, i));
+		g_free(g_ptr_array_index(pLinesArray, i));
+	}
+	cairo_restore(pCairo);
+	g_ptr_array_free(pLinesArray, TRUE);
+}
+
 /*
 static void map_draw_cairo_locations(map_t* pMap, cairo_t *pCairo, rendermetrics_t* pRenderMetrics)
 {
@@ -26,6 +26,7 @@
 
 #include <cairo.h>
 
-void map_draw_cairo(map_t* pMap, GPtrArray* pTiles, rendermetrics_t* pRenderMetrics, GdkPixmap* pPixmap, gint nDrawFlags);
+void map_draw_cairo(map_t* pMap, GPtrArray* pTiles, rendermetrics_t* pRenderMetrics, GdkPixmap* pPixmap, const GdkRegion* pClipRegion, gint nDrawFlags);
+void map_draw_cairo_surface(map_t* pMap, GPtrArray* pTiles, rendermetrics_t* pRenderMetrics, cairo_surface_t* pSurface, const GdkRegion* pClipRegion, gint nDrawFlags);
 
 #endif
@@ -22,6 +22,7 @@
  */
 
 #define MAX_GDK_LINE_SEGMENTS (2000)
+#define CLIP_RECT_MARGIN_IN_PIXELS	(32)	// when drawing part of the window, also draw objects this close to it (for wide lines)
 
 //#define ENABLE_MAP_GRAYSCALE_HACK 	// just a little test.  black and white might be good for something
 //#define ENABLE_CLIPPER_SHRINK_RECT_TEST	// NOTE: even with this on, objects won't be clipped unless they cross the real screen border
@@ -41,13 +42,14 @@
 #include "road.h"
 #include "map_style.h"
 #include "map_math.h"
+#include "map_projection.h"
 #include "locationset.h"
 #include "location.h"
 #include "scenemanager.h"
 
 //static void map_draw_gdk_background(map_t* pMap, GdkPixmap* pPixmap);
-static void map_draw_gdk_layer_polygons(map_t* pMap, GdkPixmap* pPixmap, rendermetrics_t* pRenderMetrics, GPtrArray* pRoadsArray, maplayerstyle_t* pLayerStyle);
-static void map_draw_gdk_layer_lines(map_t* pMap, GdkPixmap* pPixmap, rendermetrics_t* pRenderMetrics, GPtrArray* pRoadsArray, maplayerstyle_t* pLayerStyle);
+static void map_draw_gdk_layer_polygons(map_t* pMap, GdkPixmap* pPixmap, rendermetrics_t* pRenderMetrics, gint iTile, gint nObjectType, maplayerstyle_t* pLayerStyle);
+static void map_draw_gdk_layer_lines(map_t* pMap, GdkPixmap* pPixmap, rendermetrics_t* pRenderMetrics, gint iTile, gint nObjectType, maplayerstyle_t* pLayerStyle);
 static void map_draw_gdk_layer_fill(map_t* pMap, GdkPixmap* pPixmap, rendermetrics_t* pRenderMetrics, maplayerstyle_t* pLayerStyle);
 
 //static void map_draw_gdk_locations(map_t* pMap, GdkPixmap* pPixmap, rendermetrics_t* pRenderMetrics);
@@ -58,6 +60,7 @@ typedef struct {
 	GdkGC* pGC;
 	maplayerstyle_t* pLayerStyle;
 	rendermetrics_t* pRenderMetrics;
+	renderstats_t* pStats;
 } gdk_draw_context_t;
 
 //static void map_draw_gdk_tracks(map_t* pMap, GdkPixmap* pPixmap, rendermetrics_t* pRenderMetrics);
@@ -93,7 +96,57 @@ void map_draw_gdk_xor_rect(map_t* pMap, GdkDrawable* pTargetDrawable, screenrect
 	gdk_gc_set_values(pGC, &gcValues, GDK_GC_FUNCTION | GDK_GC_FOREGROUND);
 }
 
-void map_draw_gdk(map_t* pMap, GPtrArray* pTiles, rendermetrics_t* pRenderMetrics, GdkPixmap* pPixmap, gint nDrawFlags)
+// Draw the geometry layers, bottom layer first
+static void map_draw_gdk_geometry_layers(map_t* pMap, GPtrArray* pTiles, rendermetrics_t* pRenderMetrics, GdkPixmap* pPixmap)
+{
+	gint i;
+
+	gint nStyleZoomLevel = g_sZoomLevels[pRenderMetrics->nZoomLevel-1].nStyleZoomLevel;
+	GTimer* pTimer = g_timer_new();
+
+	// Draw layer list in reverse order (painter's algorithm: http://en.wikipedia.org/wiki/Painter's_algorithm )
+	for(i=pMap->pLayersArray->len-1 ; i>=0 ; i--) {
+		maplayer_t* pLayer = g_ptr_array_index(pMap->pLayersArray, i);
+
+		renderstats_t before = pMap->RenderStats;
+		g_timer_start(pTimer);
+
+		if(pLayer->nDrawType == MAP_LAYER_RENDERTYPE_FILL) {
+			map_draw_gdk_layer_fill(pMap, pPixmap,  pRenderMetrics,
+									 pLayer->paStylesAtZoomLevels[nStyleZoomLevel-1]);       // style
+		}
+		else if(pLayer->nDrawType == MAP_LAYER_RENDERTYPE_LINES) {
+			gint iTile;
+			for(iTile=0 ; iTile < pTiles->len ; iTile++) {
+				map_draw_gdk_layer_lines(pMap, pPixmap, pRenderMetrics,
+										 iTile, pLayer->nDataSource,               // data
+										 pLayer->paStylesAtZoomLevels[nStyleZoomLevel-1]);       // style
+			}
+		}
+		else if(pLayer->nDrawType == MAP_LAYER_RENDERTYPE_POLYGONS) {
+			gint iTile;
+			for(iTile=0 ; iTile < pTiles->len ; iTile++) {
+				map_draw_gdk_layer_polygons(pMap, pPixmap, pRenderMetrics,
+											iTile, pLayer->nDataSource,          // data
+											pLayer->paStylesAtZoomLevels[nStyleZoomLevel-1]);    // style
+			}
+		}
+		else if(pLayer->nDrawType == MAP_LAYER_RENDERTYPE_LOCATIONS) {
+//                 map_draw_gdk_locations(pMap, pPixmap, pRenderMetrics);
+			continue;
+		}
+		else {
+//             g_print("pLayer->nDrawType = %d\n", pLayer->nDrawType);
+//             g_assert_not_reached();
+			continue;
+		}
+		map_layerstats_add_frame_delta(&g_array_index(pMap->pLayerStatsArray, maplayerstats_t, i), &before, &(pMap->RenderStats), g_timer_elapsed(pTimer, NULL));
+	}
+	g_timer_destroy(pTimer);
+}
+
+// pClipRegion limits drawing to part of the window (NULL for all of it)
+void map_draw_gdk(map_t* pMap, GPtrArray* pTiles, rendermetrics_t* pRenderMetrics, GdkPixmap* pPixmap, const GdkRegion* pClipRegion, gint nDrawFlags)
 {
 	TIMER_BEGIN(maptimer, "BEGIN RENDER MAP (gdk)");
 
@@ -105,43 +158,25 @@ void map_draw_gdk(map_t* pMap, GPtrArray* pTiles, rendermetrics_t* pRenderMetric
 
 	// 2. Drawing
 	if(nDrawFlags & DRAWFLAG_GEOMETRY) {
-		gint i;
-
-		gint nStyleZoomLevel = g_sZoomLevels[pRenderMetrics->nZoomLevel-1].nStyleZoomLevel;
-
-		// 2.2. Draw layer list in reverse order (painter's algorithm: http://en.wikipedia.org/wiki/Painter's_algorithm )
-		for(i=pMap->pLayersArray->len-1 ; i>=0 ; i--) {
-			maplayer_t* pLayer = g_ptr_array_index(pMap->pLayersArray, i);
-
-			if(pLayer->nDrawType == MAP_LAYER_RENDERTYPE_FILL) {
-				map_draw_gdk_layer_fill(pMap, pPixmap,  pRenderMetrics,
-										 pLayer->paStylesAtZoomLevels[nStyleZoomLevel-1]);       // style
-			}
-			else if(pLayer->nDrawType == MAP_LAYER_RENDERTYPE_LINES) {
-				gint iTile;
-				for(iTile=0 ; iTile < pTiles->len ; iTile++) {
-					maptile_t* pTile = g_ptr_array_index(pTiles, iTile);
-					map_draw_gdk_layer_lines(pMap, pPixmap, pRenderMetrics,
-											 pTile->apMapObjectArrays[pLayer->nDataSource],               // data
-											 pLayer->paStylesAtZoomLevels[nStyleZoomLevel-1]);       // style
-				}
-			}
-			else if(pLayer->nDrawType == MAP_LAYER_RENDERTYPE_POLYGONS) {
-				gint iTile;
-				for(iTile=0 ; iTile < pTiles->len ; iTile++) {
-					maptile_t* pTile = g_ptr_array_index(pTiles, iTile);
-					map_draw_gdk_layer_polygons(pMap, pPixmap, pRenderMetrics,
-												pTile->apMapObjectArrays[pLayer->nDataSource],          // data
-												pLayer->paStylesAtZoomLevels[nStyleZoomLevel-1]);    // style
-				}
-			}
-			else if(pLayer->nDrawType == MAP_LAYER_RENDERTYPE_LOCATIONS) {
-//                 map_draw_gdk_locations(pMap, pPixmap, pRenderMetrics);
-			}
-			else {
-//                 g_print("pLayer->nDrawType = %d\n", pLayer->nDrawType);
-//                 g_assert_not_reached();
+		if(pClipRegion == NULL) {
+			map_draw_gdk_geometry_layers(pMap, pTiles, pRenderMetrics, pPixmap);
+		}
+		else {
+			// Each rectangle of the region on its own, clipped to it and with only the objects near it
+			GdkRectangle* aRects;
+			gint nNumRects;
+			gdk_region_get_rectangles(pClipRegion, &aRects, &nNumRects);
+
+			gint iRect;
+			for(iRect=0 ; iRect<nNumRects ; iRect++) {
+				rendermetrics_t metrics = *pRenderMetrics;
+				map_math_get_worldrect_of_windowrect(pRenderMetrics, &aRects[iRect], CLIP_RECT_MARGIN_IN_PIXELS, &(metrics.rWorldBoundingBox));
+
+				gdk_gc_set_clip_rectangle(pGC, &aRects[iRect]);
+				map_draw_gdk_geometry_layers(pMap, pTiles, &metrics, pPixmap);
 			}
+			gdk_gc_set_clip_rectangle(pGC, NULL);
+			g_free(aRects);
 		}
 	}
 
@@ -175,6 +210,7 @@ static void map_draw_gdk_layer_fill(map_t* pMap, GdkPixmap* pPixmap, rendermetri
 
 	gdk_draw_rectangle(pPixmap, pMap->pTargetWidget->style->fg_gc[GTK_WIDGET_STATE(pMap->pTargetWidget)],
 			TRUE, 0,0, pMap->MapDimensions.uWidth, pMap->MapDimensions.uHeight);
+	pMap->RenderStats.nFills++;
 
 	if(pLayerStyle->pGlyphFill != NULL) {
 		// Restore fill style
@@ -182,6 +218,27 @@ static void map_draw_gdk_layer_fill(map_t* pMap, GdkPixmap* pPixmap, rendermetri
 	}
 }
 
+// Round points already in screen space to GDK's integer points (aReturnPoints must hold nNumPoints)
+static void map_draw_gdk_copy_projected_points(const screenpointf_t* aProjectedPoints, gint nNumPoints, const gdk_draw_context_t* pContext, GdkPoint* aReturnPoints)
+{
+	gint nOffsetX = pContext->pLayerStyle->nPixelOffsetX;
+	gint nOffsetY = pContext->pLayerStyle->nPixelOffsetY;
+
+	gint iPoint;
+	for(iPoint=0 ; iPoint<nNumPoints ; iPoint++) {
+		aReturnPoints[iPoint].x = nOffsetX + (gint)aProjectedPoints[iPoint].fX;
+		aReturnPoints[iPoint].y = nOffsetY + (gint)aProjectedPoints[iPoint].fY;
+	}
+}
+
+static void map_draw_gdk_polygons_projected(const screenpointf_t* aProjectedPoints, gint nNumPoints, const gdk_draw_context_t* pContext)
+{
+	GdkPoint aPoints[MAX_GDK_LINE_SEGMENTS];
+	map_draw_gdk_copy_projected_points(aProjectedPoints, nNumPoints, pContext, aPoints);
+	gdk_draw_polygon(pContext->pPixmap, pContext->pGC, TRUE, aPoints, nNumPoints);
+	pContext->pStats->nFills++;
+}
+
 // 
 static void map_draw_gdk_polygons(const GArray* pMapPointsArray, const gdk_draw_context_t* pContext)
 {
@@ -198,14 +255,18 @@ static void map_draw_gdk_polygons(const GArray* pMapPointsArray, const gdk_draw_
 	}
 
 	gdk_draw_polygon(pContext->pPixmap, pContext->pGC, TRUE, aPoints, pMapPointsArray->len);
+	pContext->pStats->nFills++;
 }
 
-static void map_draw_gdk_layer_polygons(map_t* pMap, GdkPixmap* pPixmap, rendermetrics_t* pRenderMetrics, GPtrArray* pRoadsArray, maplayerstyle_t* pLayerStyle)
+static void map_draw_gdk_layer_polygons(map_t* pMap, GdkPixmap* pPixmap, rendermetrics_t* pRenderMetrics, gint iTile, gint nObjectType, maplayerstyle_t* pLayerStyle)
 {
 	road_t* pRoad;
 
 	if(pLayerStyle->clrPrimary.fAlpha == 0.0) return;	// invisible?  (not that we respect it in gdk drawing anyway)
-	if(pRoadsArray->len == 0) return;
+
+	mapvisibleobjects_t objects;
+	map_projection_get_objects(pMap->pProjection, iTile, nObjectType, &objects);
+	if(objects.pRoadsArray->len == 0) return;
 
 	GdkGC* pGC = pMap->pTargetWidget->style->fg_gc[GTK_WIDGET_STATE(pMap->pTargetWidget)];
 
@@ -229,37 +290,46 @@ static void map_draw_gdk_layer_polygons(map_t* pMap, GdkPixmap* pPixmap, renderm
 	context.pGC = pGC;
 	context.pLayerStyle = pLayerStyle;
 	context.pRenderMetrics = pRenderMetrics;
+	context.pStats = &(pMap->RenderStats);
 
 	gint iString;
-	for(iString=0 ; iString<pRoadsArray->len ; iString++) {
-		pRoad = g_ptr_array_index(pRoadsArray, iString);
+	for(iString=0 ; iString<objects.pRoadsArray->len ; iString++) {
+		pRoad = g_ptr_array_index(objects.pRoadsArray, iString);
+		pMap->RenderStats.nObjectsConsidered++;
 
 		EOverlapType eOverlapType = map_rect_a_overlap_type_with_rect_b(&(pRoad->rWorldBoundingBox), &(pRenderMetrics->rWorldBoundingBox));
 		if(eOverlapType == OVERLAP_NONE) {
+			pMap->RenderStats.nObjectsCulled++;
 			continue;
 		}
 
 		// XXX: should we remove this?
-		if(pRoad->pMapPointsArray->len < 3) {
+		gint nNumPoints = MAP_VISIBLE_OBJECT_NUM_POINTS(&objects, iString);
+		if(nNumPoints < 3) {
 			//g_warning("not drawing polygon with < 3 points\n");
 			continue;
 		}
 
-		if(pRoad->pMapPointsArray->len > MAX_GDK_LINE_SEGMENTS) {
+		if(nNumPoints > MAX_GDK_LINE_SEGMENTS) {
 			//g_warning("not drawing polygon with > %d points\n", MAX_GDK_LINE_SEGMENTS);
 			continue;
 		}
+		pMap->RenderStats.nObjectsDrawn++;
+		pMap->RenderStats.nPointsLoaded += pRoad->pMapPointsArray->len;
 
 		if(eOverlapType == OVERLAP_PARTIAL) {
 			// draw clipped
-       		GArray* pClipped = g_array_sized_new(FALSE, FALSE, sizeof(mappoint_t), pRoad->pMapPointsArray->len + 20);	// it's rarely more than a few extra points
-			map_math_clip_pointstring_to_worldrect(pRoad->pMapPointsArray, &(pRenderMetrics->rWorldBoundingBox), pClipped);
-			map_draw_gdk_polygons(pClipped, &context);
-			g_array_free(pClipped, TRUE);
+			const GArray* pClipped = map_math_clip_polygon_to_worldrect(&objects.aMapPoints[objects.anFirstPoint[iString]], nNumPoints, &(pRenderMetrics->rWorldBoundingBox), pMap->pClipBuffer);
+			pMap->RenderStats.nClipCalls++;
+			if(pClipped->len >= 3 && pClipped->len <= MAX_GDK_LINE_SEGMENTS) {	// clipping can add a few points
+				map_draw_gdk_polygons(pClipped, &context);
+				pMap->RenderStats.nPointsEmitted += pClipped->len;
+			}
 		}
 		else {
 			// draw normally
-			map_draw_gdk_polygons(pRoad->pMapPointsArray, &context);
+			map_draw_gdk_polygons_projected(&objects.aScreenPoints[objects.anFirstPoint[iString]], nNumPoints, &context);
+			pMap->RenderStats.nPointsEmitted += nNumPoints;
 		}
 	}
 	if(pLayerStyle->pGlyphFill != NULL) {
@@ -268,24 +338,42 @@ static void map_draw_gdk_layer_polygons(map_t* pMap, GdkPixmap* pPixmap, renderm
 	}
 }
 
-static void map_draw_gdk_lines(const GArray* pMapPointsArray, const gdk_draw_context_t* pContext)
+// Returns how many points were drawn
+static gint map_draw_gdk_lines(const mappoint_t* aMapPoints, gint nNumPoints, const gdk_draw_context_t* pContext)
 {
+	if(nNumPoints > MAX_GDK_LINE_SEGMENTS) {
+		//g_warning("not drawing line with > %d points\n", MAX_GDK_LINE_SEGMENTS);
+		return 0;
+	}
+
 	// Copy all points into this array.  Yuuup this is slow. :)
 	GdkPoint aPoints[MAX_GDK_LINE_SEGMENTS];
-	mappoint_t* pPoint;
 
 	gint iPoint;
-	for(iPoint=0 ; iPoint<pMapPointsArray->len ; iPoint++) {
-		pPoint = &g_array_index(pMapPointsArray, mappoint_t, iPoint);
-
-		aPoints[iPoint].x = pContext->pLayerStyle->nPixelOffsetX + (gint)SCALE_X(pContext->pRenderMetrics, pPoint->fLongitude);
-		aPoints[iPoint].y = pContext->pLayerStyle->nPixelOffsetY + (gint)SCALE_Y(pContext->pRenderMetrics, pPoint->fLatitude);
+	for(iPoint=0 ; iPoint<nNumPoints ; iPoint++) {
+		aPoints[iPoint].x = pContext->pLayerStyle->nPixelOffsetX + (gint)SCALE_X(pContext->pRenderMetrics, aMapPoints[iPoint].fLongitude);
+		aPoints[iPoint].y = pContext->pLayerStyle->nPixelOffsetY + (gint)SCALE_Y(pContext->pRenderMetrics, aMapPoints[iPoint].fLatitude);
 	}
 	
-	gdk_draw_lines(pContext->pPixmap, pContext->pGC, aPoints, pMapPointsArray->len);
+	gdk_draw_lines(pContext->pPixmap, pContext->pGC, aPoints, nNumPoints);
+	pContext->pStats->nStrokes++;
+	return nNumPoints;
+}
+
+static gint map_draw_gdk_lines_projected(const screenpointf_t* aProjectedPoints, gint nNumPoints, const gdk_draw_context_t* pContext)
+{
+	if(nNumPoints > MAX_GDK_LINE_SEGMENTS) {
+		return 0;
+	}
+
+	GdkPoint aPoints[MAX_GDK_LINE_SEGMENTS];
+	map_draw_gdk_copy_projected_points(aProjectedPoints, nNumPoints, pContext, aPoints);
+	gdk_draw_lines(pContext->pPixmap, pContext->pGC, aPoints, nNumPoints);
+	pContext->pStats->nStrokes++;
+	return nNumPoints;
 }
 
-static void map_draw_gdk_layer_lines(map_t* pMap, GdkPixmap* pPixmap, rendermetrics_t* pRenderMetrics, GPtrArray* pRoadsArray, maplayerstyle_t* pLayerStyle)
+static void map_draw_gdk_layer_lines(map_t* pMap, GdkPixmap* pPixmap, rendermetrics_t* pRenderMetrics, gint iTile, gint nObjectType, maplayerstyle_t* pLayerStyle)
 {
 	road_t* pRoad;
 	gint iString;
@@ -330,37 +418,56 @@ static void map_draw_gdk_layer_lines(map_t* pMap, GdkPixmap* pPixmap, rendermetr
 	context.pGC = pGC;
 	context.pLayerStyle = pLayerStyle;
 	context.pRenderMetrics = pRenderMetrics;
+	context.pStats = &(pMap->RenderStats);
+
+	// Clip lines that run off screen, to a rect big enough that the cut ends (and their caps) aren't visible.
+	// Not dashed lines: the dashes would start over at the cut, and crawl as the map scrolls.
+	gboolean bClip = (pLayerStyle->pDashStyle == NULL);
+	maprect_t rcClip;
+	map_math_get_worldrect_inflated_by_pixels(pRenderMetrics,
+		nLineWidth + MAX(ABS(pLayerStyle->nPixelOffsetX), ABS(pLayerStyle->nPixelOffsetY)) + 2, &rcClip);
 
-	for(iString=0 ; iString<pRoadsArray->len ; iString++) {
-		pRoad = g_ptr_array_index(pRoadsArray, iString);
+	mapvisibleobjects_t objects;
+	map_projection_get_objects(pMap->pProjection, iTile, nObjectType, &objects);
+
+	for(iString=0 ; iString<objects.pRoadsArray->len ; iString++) {
+		pRoad = g_ptr_array_index(objects.pRoadsArray, iString);
+		pMap->RenderStats.nObjectsConsidered++;
 
 		EOverlapType eOverlapType = map_rect_a_overlap_type_with_rect_b(&(pRoad->rWorldBoundingBox), &(pRenderMetrics->rWorldBoundingBox));
 		if(eOverlapType == OVERLAP_NONE) {
+			pMap->RenderStats.nObjectsCulled++;
 			continue;
 		}
 
-		if(pRoad->pMapPointsArray->len > MAX_GDK_LINE_SEGMENTS) {
-			//g_warning("not drawing line with > %d points\n", MAX_GDK_LINE_SEGMENTS);
-			continue;
-		}
-
-		if(pRoad->pMapPointsArray->len < 2) {
+		gint nNumPoints = MAP_VISIBLE_OBJECT_NUM_POINTS(&objects, iString);
+		if(nNumPoints < 2) {
 			//g_warning("not drawing line with < 2 points\n");
 			continue;
 		}
+		pMap->RenderStats.nObjectsDrawn++;
+		pMap->RenderStats.nPointsLoaded += pRoad->pMapPointsArray->len;
 
 #ifdef ENABLE_RANDOM_ROAD_COLORS
 		color_t clr;
 		util_random_color(&clr);
 		map_draw_gdk_set_color(pMap->pTargetWidget->style->fg_gc[GTK_WIDGET_STATE(pMap->pTargetWidget)], &clr);
 #endif
-		if(eOverlapType == OVERLAP_PARTIAL) {
-			// TODO: draw clipped
-			map_draw_gdk_lines(pRoad->pMapPointsArray, &context);
+		if(eOverlapType == OVERLAP_PARTIAL && bClip) {
+			// draw just the pieces near the screen (which also lets us draw long lines that GDK can't take whole)
+			gint nRuns = map_math_clip_polyline_to_worldrect(&objects.aMapPoints[objects.anFirstPoint[iString]], nNumPoints, &rcClip, pMap->pClipBuffer);
+			pMap->RenderStats.nClipCalls++;
+			const mappoint_t* pRunPoints = &g_array_index(pMap->pClipBuffer->pPointsArray, mappoint_t, 0);
+			gint iRun;
+			for(iRun=0 ; iRun<nRuns ; iRun++) {
+				gint nRunLength = g_array_index(pMap->pClipBuffer->pRunsArray, gint, iRun);
+				pMap->RenderStats.nPointsEmitted += map_draw_gdk_lines(pRunPoints, nRunLength, &context);
+				pRunPoints += nRunLength;
+			}
 		}
 		else {
 			// draw directly
-			map_draw_gdk_lines(pRoad->pMapPointsArray, &context);
+			pMap->RenderStats.nPointsEmitted += map_draw_gdk_lines_projected(&objects.aScreenPoints[objects.anFirstPoint[iString]], nNumPoints, &context);
 		}
 	}
 }
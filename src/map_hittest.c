@@ -27,17 +27,18 @@
 #include "map.h"
 #include "map_hittest.h"
 #include "map_math.h"
+#include "map_projection.h"
 #include "map_style.h"
 #include "road.h"
 #include "location.h"
 #include "locationset.h"
 
-static gboolean map_hittest_line(mappoint_t* pPoint1, mappoint_t* pPoint2, mappoint_t* pHitPoint, gdouble fMaxDistance, mappoint_t* pReturnClosestPoint, gdouble* pfReturnPercentAlongLine);
-static ESide map_hittest_side_test_line(mappoint_t* pPoint1, mappoint_t* pPoint2, mappoint_t* pClosestPointOnLine, mappoint_t* pHitPoint);
+static gboolean map_hittest_line(const mappoint_t* pPoint1, const mappoint_t* pPoint2, mappoint_t* pHitPoint, gdouble fMaxDistance, mappoint_t* pReturnClosestPoint, gdouble* pfReturnPercentAlongLine);
+static ESide map_hittest_side_test_line(const mappoint_t* pPoint1, const mappoint_t* pPoint2, mappoint_t* pClosestPointOnLine, mappoint_t* pHitPoint);
 //static gboolean map_hittest_locations(map_t* pMap, rendermetrics_t* pRenderMetrics, GPtrArray* pLocationsArray, mappoint_t* pHitPoint, maphit_t** ppReturnStruct);
 //static gboolean map_hittest_locationsets(map_t* pMap, rendermetrics_t* pRenderMetrics, mappoint_t* pHitPoint, maphit_t** ppReturnStruct);
 
-static gboolean map_hittest_layer_lines(GPtrArray* pRoadsArray, gdouble fMaxDistance, mappoint_t* pHitPoint, maphit_t** ppReturnStruct);
+static gboolean map_hittest_layer_lines(mapprojection_t* pProjection, gint iTile, gint nObjectType, gdouble fMaxDistance, mappoint_t* pHitPoint, maphit_t** ppReturnStruct);
 static gboolean map_hittest_layer_polygons(GPtrArray* pMapObjectArray, mappoint_t* pHitPoint, maphit_t** ppReturnStruct);
 
 #define EXTRA_CLICKABLE_ROAD_IN_PIXELS	(3)
@@ -54,6 +55,11 @@ gboolean map_hittest(map_t* pMap, mappoint_t* pMapPoint, maphit_t** ppReturnStru
 	GPtrArray* pTiles = pMap->pLastActiveTilesArray;
 	g_return_val_if_fail(pTiles != NULL, FALSE);
 
+	// line tests start in screen space; the map may have moved since the last draw
+	if(!map_projection_is_current(pMap->pProjection, &rendermetrics, pTiles)) {
+		map_projection_begin_frame(pMap->pProjection, &rendermetrics, pTiles);
+	}
+
 //     if(map_hittest_locationselections(pMap, &rendermetrics, pMap->pLocationSelectionArray, pMapPoint, ppReturnStruct)) {
 //         return TRUE;
 //     }
@@ -78,9 +84,7 @@ gboolean map_hittest(map_t* pMap, mappoint_t* pMapPoint, maphit_t** ppReturnStru
 
 			gint iTile;
 			for(iTile=0 ; iTile < pTiles->len ; iTile++) {
-				maptile_t* pTile = g_ptr_array_index(pTiles, iTile);
-
-				if(map_hittest_layer_lines(pTile->apMapObjectArrays[pLayer->nDataSource],
+				if(map_hittest_layer_lines(pMap->pProjection, iTile, pLayer->nDataSource,
 										   fMaxDistance,
 										   pMapPoint,
 										   ppReturnStruct))
@@ -138,7 +142,7 @@ void map_hittest_maphit_free(map_t* pMap, maphit_t* pHitStruct)
 	g_free(pHitStruct);
 }
 
-static gboolean map_hittest_layer_lines(GPtrArray* pMapObjectArray, gdouble fMaxDistance, mappoint_t* pHitPoint, maphit_t** ppReturnStruct)
+static gboolean map_hittest_layer_lines(mapprojection_t* pProjection, gint iTile, gint nObjectType, gdouble fMaxDistance, mappoint_t* pHitPoint, maphit_t** ppReturnStruct)
 {
 	g_assert(ppReturnStruct != NULL);
 	g_assert(*ppReturnStruct == NULL);	// pointer to null pointer
@@ -150,19 +154,43 @@ static gboolean map_hittest_layer_lines(GPtrArray* pMapObjectArray, gdouble fMax
 /*         map_hit_test_line(&p1, &p2, &p3, 20); */
 /*         return FALSE;                         */
 
+	// test what's drawn: the points simplified for this zoom level
+	mapvisibleobjects_t objects;
+	map_projection_get_objects(pProjection, iTile, nObjectType, &objects);
+
+	// Reject segments in screen space first: fMaxDistance in pixels (using the larger scale, so we never reject a hit), plus one for rounding
+	screenpointf_t hitScreenPoint;
+	map_math_project_points(&(pProjection->Metrics), pHitPoint, 1, &hitScreenPoint);
+	gdouble fMaxPixels = (fMaxDistance * MAX(ABS(pProjection->Metrics.fScaleX), ABS(pProjection->Metrics.fScaleY))) + 1;
+
 	// Loop through line strings, order doesn't matter here since they're all on the same level.
 	gint iString;
-	for(iString=0 ; iString<pMapObjectArray->len ; iString++) {
-		road_t* pRoad = g_ptr_array_index(pMapObjectArray, iString);
-		if(pRoad->pMapPointsArray->len < 2) continue;
+	for(iString=0 ; iString<objects.pRoadsArray->len ; iString++) {
+		road_t* pRoad = g_ptr_array_index(objects.pRoadsArray, iString);
+
+		gint nNumPoints = MAP_VISIBLE_OBJECT_NUM_POINTS(&objects, iString);
+		const mappoint_t* pRoadPoints = &objects.aMapPoints[objects.anFirstPoint[iString]];
+		const screenpointf_t* pRoadScreenPoints = &objects.aScreenPoints[objects.anFirstPoint[iString]];
+
+		if(nNumPoints < 2) continue;
 		// Can't do bounding box test on lines (unless we expand the box by fMaxDistance pixels)
 		//if(!map_math_mappoint_in_maprect(pHitPoint, &(pRoad->rWorldBoundingBox))) continue;
 
 		// start on 1 so we can do -1 trick below
 		gint iPoint;
-		for(iPoint=1 ; iPoint<pRoad->pMapPointsArray->len ; iPoint++) {
-			mappoint_t* pPoint1 = &g_array_index(pRoad->pMapPointsArray, mappoint_t, iPoint-1);
-			mappoint_t* pPoint2 = &g_array_index(pRoad->pMapPointsArray, mappoint_t, iPoint);
+		for(iPoint=1 ; iPoint<nNumPoints ; iPoint++) {
+			const screenpointf_t* pScreenPoint1 = &pRoadScreenPoints[iPoint-1];
+			const screenpointf_t* pScreenPoint2 = &pRoadScreenPoints[iPoint];
+			if(MIN(pScreenPoint1->fX, pScreenPoint2->fX) - fMaxPixels > hitScreenPoint.fX ||
+			   MAX(pScreenPoint1->fX, pScreenPoint2->fX) + fMaxPixels < hitScreenPoint.fX ||
+			   MIN(pScreenPoint1->fY, pScreenPoint2->fY) - fMaxPixels > hitScreenPoint.fY ||
+			   MAX(pScreenPoint1->fY, pScreenPoint2->fY) + fMaxPixels < hitScreenPoint.fY)
+			{
+				continue;
+			}
+
+			const mappoint_t* pPoint1 = &pRoadPoints[iPoint-1];
+			const mappoint_t* pPoint2 = &pRoadPoints[iPoint];
 
 			mappoint_t pointClosest;
 			gdouble fPercentAlongLine;
@@ -241,7 +269,7 @@ static gboolean map_hittest_layer_polygons(GPtrArray* pMapObjectArray, mappoint_
 	return FALSE;
 }
 
-static ESide map_hittest_side_test_line(mappoint_t* pPoint1, mappoint_t* pPoint2, mappoint_t* pClosestPointOnLine, mappoint_t* pHitPoint)
+static ESide map_hittest_side_test_line(const mappoint_t* pPoint1, const mappoint_t* pPoint2, mappoint_t* pClosestPointOnLine, mappoint_t* pHitPoint)
 {
 	// make a translated-to-origin *perpendicular* vector of the line (points to the "left" of the line when walking from point 1 to 2)
 	mappoint_t v;
@@ -415,7 +443,7 @@ static gboolean map_hittest_locationselections(map_t* pMap, rendermetrics_t* pRe
 #endif
 
 
-static gboolean map_hittest_line(mappoint_t* pPoint1, mappoint_t* pPoint2, mappoint_t* pHitPoint, gdouble fMaxDistance, mappoint_t* pReturnClosestPoint, gdouble* pfReturnPercentAlongLine)
+static gboolean map_hittest_line(const mappoint_t* pPoint1, const mappoint_t* pPoint2, mappoint_t* pHitPoint, gdouble fMaxDistance, mappoint_t* pReturnClosestPoint, gdouble* pfReturnPercentAlongLine)
 {
 //	if(pHitPoint->fLatitude < (pPoint1->fLatitude - fMaxDistance) && pHitPoint->fLatitude < (pPoint2->fLatitude - fMaxDistance)) return FALSE;
 //	if(pHitPoint->fLongitude < (pPoint1->fLongitude - fMaxDistance) && pHitPoint->fLongitude < (pPoint2->fLongitude - fMaxDistance)) return FALSE;
@@ -0,0 +1,187 @@
+/***************************************************************************
+ *            map_labelcache.c
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+Purpose of map_labelcache.c:
+ - Remember where road labels were placed, so the next frame at the same zoom level can put them back in the
+   same place: a couple of collision tests instead of a search, and labels don't jump around as the map scrolls
+ - Placements are kept in world pixels (see map_get_render_metrics, which keeps the offset to whole pixels),
+   keyed by the label.  The scenemanager allows one of each label per frame, so that's one placement per name,
+   along with the first and last points of its road to check that it's still the same road
+ - A placement only lives until the next frame with labels that doesn't draw it
+ - Zooming, resizing the window or changing the style (map_labelcache_clear) forgets them all
+*/
+
+#include <math.h>
+#include <string.h>
+#include <gtk/gtk.h>
+
+#include "map.h"
+#include "map_labelcache.h"
+
+#define ROAD_MATCH_TOLERANCE_IN_PIXELS	(0.5)	// projecting the same point with a different offset can round differently
+
+struct maplabelcache {
+	GHashTable* pPlacementsTable;	// maplabelplacement_t, keyed by pszLabel
+	guint uFrame;					// frames with labels, counted by map_labelcache_begin_frame
+
+	// the placements are only good for the scale they were made at
+	gint nZoomLevel;
+	gdouble fScaleX;
+	gdouble fScaleY;
+};
+
+static void map_labelcache_placement_free(gpointer pData)
+{
+	maplabelplacement_t* pPlacement = pData;
+	gint i;
+	for(i=0 ; i<pPlacement->pRunsArray->len ; i++) {
+		g_free(g_array_index(pPlacement->pRunsArray, maplabelrun_t, i).pszText);
+	}
+	g_array_free(pPlacement->pRunsArray, TRUE);
+	g_free(pPlacement->pszLabel);
+	g_free(pPlacement);
+}
+
+maplabelcache_t* map_labelcache_new(void)
+{
+	maplabelcache_t* pNew = g_new0(maplabelcache_t, 1);
+	pNew->pPlacementsTable = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, map_labelcache_placement_free);
+	return pNew;
+}
+
+static gboolean map_labelcache_clear_callback(gpointer pKey, gpointer pValue, gpointer pUserData)
+{
+	return TRUE;	// remove it
+}
+
+// Forget every placement.  Called when the style changes.
+void map_labelcache_clear(maplabelcache_t* pCache)
+{
+	g_assert(pCache != NULL);
+	g_hash_table_foreach_remove(pCache->pPlacementsTable, map_labelcache_clear_callback, NULL);
+}
+
+static gboolean map_labelcache_remove_stale_callback(gpointer pKey, gpointer pValue, gpointer pUserData)
+{
+	maplabelplacement_t* pPlacement = pValue;
+	maplabelcache_t* pCache = pUserData;
+	return (pPlacement->uFrame != pCache->uFrame);	// not drawn in the last frame
+}
+
+// Call before placing a frame's labels
+void map_labelcache_begin_frame(maplabelcache_t* pCache, const rendermetrics_t* pRenderMetrics)
+{
+	g_assert(pCache != NULL);
+
+	if(pCache->nZoomLevel != pRenderMetrics->nZoomLevel || pCache->fScaleX != pRenderMetrics->fScaleX || pCache->fScaleY != pRenderMetrics->fScaleY) {
+		map_labelcache_clear(pCache);
+		pCache->nZoomLevel = pRenderMetrics->nZoomLevel;
+		pCache->fScaleX = pRenderMetrics->fScaleX;
+		pCache->fScaleY = pRenderMetrics->fScaleY;
+	}
+	else {
+		g_hash_table_foreach_remove(pCache->pPlacementsTable, map_labelcache_remove_stale_callback, pCache);
+	}
+	pCache->uFrame++;
+}
+
+static gboolean map_labelcache_point_matches(const rendermetrics_t* pRenderMetrics, const screenpointf_t* pWorldPoint, const screenpointf_t* pScreenPoint)
+{
+	return (fabs((pWorldPoint->fX + pRenderMetrics->fOffsetX) - pScreenPoint->fX) <= ROAD_MATCH_TOLERANCE_IN_PIXELS &&
+			fabs((pWorldPoint->fY + pRenderMetrics->fOffsetY) - pScreenPoint->fY) <= ROAD_MATCH_TOLERANCE_IN_PIXELS);
+}
+
+// Returns where pszLabel went last frame if it was along this road (aRoadPoints, in screen space) and it
+// hasn't been drawn yet this frame, or NULL
+const maplabelplacement_t* map_labelcache_lookup(maplabelcache_t* pCache, const rendermetrics_t* pRenderMetrics, const gchar* pszLabel, const screenpointf_t* aRoadPoints, gint nNumRoadPoints)
+{
+	g_assert(pCache != NULL);
+
+	maplabelplacement_t* pPlacement = g_hash_table_lookup(pCache->pPlacementsTable, pszLabel);
+	if(pPlacement == NULL || pPlacement->uFrame == pCache->uFrame) return NULL;
+
+	if(pPlacement->nRoadPoints != nNumRoadPoints ||
+	   !map_labelcache_point_matches(pRenderMetrics, &(pPlacement->ptRoadFirst), &aRoadPoints[0]) ||
+	   !map_labelcache_point_matches(pRenderMetrics, &(pPlacement->ptRoadLast), &aRoadPoints[nNumRoadPoints-1]))
+	{
+		return NULL;
+	}
+	return pPlacement;
+}
+
+// Keep a placement found by map_labelcache_lookup for the next frame
+void map_labelcache_mark_drawn(maplabelcache_t* pCache, const maplabelplacement_t* pPlacement)
+{
+	((maplabelplacement_t*)pPlacement)->uFrame = pCache->uFrame;
+}
+
+// A run's position and bounding polygon in this frame's screen space
+void map_labelcache_get_run(const rendermetrics_t* pRenderMetrics, const maplabelrun_t* pRun, gdouble* pfDrawX, gdouble* pfDrawY, GdkPoint* aBoundingPolygon)
+{
+	*pfDrawX = pRun->fDrawX + pRenderMetrics->fOffsetX;
+	*pfDrawY = pRun->fDrawY + pRenderMetrics->fOffsetY;
+
+	gint i;
+	for(i=0 ; i<G_N_ELEMENTS(pRun->aBoundingPolygon) ; i++) {
+		aBoundingPolygon[i].x = (gint)floor(pRun->aBoundingPolygon[i].fX + pRenderMetrics->fOffsetX + 0.5);
+		aBoundingPolygon[i].y = (gint)floor(pRun->aBoundingPolygon[i].fY + pRenderMetrics->fOffsetY + 0.5);
+	}
+}
+
+// Start a new placement for pszLabel along this road (replacing any old one), drawn this frame.  Add its runs with map_labelcache_add_run.
+maplabelplacement_t* map_labelcache_add(maplabelcache_t* pCache, const rendermetrics_t* pRenderMetrics, const gchar* pszLabel, const screenpointf_t* aRoadPoints, gint nNumRoadPoints)
+{
+	g_assert(pCache != NULL);
+	g_assert(nNumRoadPoints >= 2);
+
+	maplabelplacement_t* pPlacement = g_new0(maplabelplacement_t, 1);
+	pPlacement->pszLabel = g_strdup(pszLabel);
+	pPlacement->nRoadPoints = nNumRoadPoints;
+	pPlacement->ptRoadFirst.fX = aRoadPoints[0].fX - pRenderMetrics->fOffsetX;
+	pPlacement->ptRoadFirst.fY = aRoadPoints[0].fY - pRenderMetrics->fOffsetY;
+	pPlacement->ptRoadLast.fX = aRoadPoints[nNumRoadPoints-1].fX - pRenderMetrics->fOffsetX;
+	pPlacement->ptRoadLast.fY = aRoadPoints[nNumRoadPoints-1].fY - pRenderMetrics->fOffsetY;
+	pPlacement->pRunsArray = g_array_new(FALSE, FALSE, sizeof(maplabelrun_t));
+	pPlacement->uFrame = pCache->uFrame;
+
+	g_hash_table_replace(pCache->pPlacementsTable, pPlacement->pszLabel, pPlacement);
+	return pPlacement;
+}
+
+// aBoundingPolygon (4 points) and the position are in screen space
+void map_labelcache_add_run(maplabelplacement_t* pPlacement, const rendermetrics_t* pRenderMetrics, const gchar* pszText, gdouble fDrawX, gdouble fDrawY, gdouble fAngleInRadians, const GdkPoint* aBoundingPolygon)
+{
+	maplabelrun_t run;
+	run.pszText = g_strdup(pszText);
+	run.fDrawX = fDrawX - pRenderMetrics->fOffsetX;
+	run.fDrawY = fDrawY - pRenderMetrics->fOffsetY;
+	run.fAngleInRadians = fAngleInRadians;
+
+	gint i;
+	for(i=0 ; i<G_N_ELEMENTS(run.aBoundingPolygon) ; i++) {
+		run.aBoundingPolygon[i].fX = aBoundingPolygon[i].x - pRenderMetrics->fOffsetX;
+		run.aBoundingPolygon[i].fY = aBoundingPolygon[i].y - pRenderMetrics->fOffsetY;
+	}
+	g_array_append_val(pPlacement->pRunsArray, run);
+}
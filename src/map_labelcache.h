@@ -0,0 +1,62 @@
+/***************************************************************************
+ *            map_labelcache.h
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _MAP_LABELCACHE_H_
+#define _MAP_LABELCACHE_H_
+
+#include <glib.h>
+#include <gdk/gdk.h>
+#include "map.h"
+
+// One piece of a placed label: the text drawn along one segment of its road.  Positions are in world
+// pixels (window position minus the render metrics' offset), so they don't change as the map scrolls.
+typedef struct {
+	gchar* pszText;					// the whole label, or the part of it on this segment
+	gdouble fDrawX;					// where the text starts
+	gdouble fDrawY;
+	gdouble fAngleInRadians;
+	screenpointf_t aBoundingPolygon[4];	// the space it claimed from the scenemanager
+} maplabelrun_t;
+
+// Where a label went, and the road it was placed along
+typedef struct {
+	gchar* pszLabel;
+	gint nRoadPoints;
+	screenpointf_t ptRoadFirst;		// world pixels
+	screenpointf_t ptRoadLast;
+	GArray* pRunsArray;				// maplabelrun_t
+	guint uFrame;					// the last frame it was drawn in
+} maplabelplacement_t;
+
+maplabelcache_t* map_labelcache_new(void);
+void map_labelcache_clear(maplabelcache_t* pCache);
+void map_labelcache_begin_frame(maplabelcache_t* pCache, const rendermetrics_t* pRenderMetrics);
+
+const maplabelplacement_t* map_labelcache_lookup(maplabelcache_t* pCache, const rendermetrics_t* pRenderMetrics, const gchar* pszLabel, const screenpointf_t* aRoadPoints, gint nNumRoadPoints);
+void map_labelcache_mark_drawn(maplabelcache_t* pCache, const maplabelplacement_t* pPlacement);
+void map_labelcache_get_run(const rendermetrics_t* pRenderMetrics, const maplabelrun_t* pRun, gdouble* pfDrawX, gdouble* pfDrawY, GdkPoint* aBoundingPolygon);
+
+maplabelplacement_t* map_labelcache_add(maplabelcache_t* pCache, const rendermetrics_t* pRenderMetrics, const gchar* pszLabel, const screenpointf_t* aRoadPoints, gint nNumRoadPoints);
+void map_labelcache_add_run(maplabelplacement_t* pPlacement, const rendermetrics_t* pRenderMetrics, const gchar* pszText, gdouble fDrawX, gdouble fDrawY, gdouble fAngleInRadians, const GdkPoint* aBoundingPolygon);
+
+#endif
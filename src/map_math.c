@@ -59,28 +59,6 @@ gdouble map_math_pixels_to_degrees_at_scale(gint nPixels, gint nScale)
 	return WORLD_METERS_TO_DEGREES(fMetersOfWorld);
 }
 
-gdouble map_degrees_to_pixels(map_t* pMap, gdouble fDegrees, guint16 uZoomLevel)
-{
-	gdouble fMonitorPixelsPerInch = 85.333;	// XXX: don't hardcode this
-
-	gdouble fResultInMeters = WORLD_DEGREES_TO_METERS(fDegrees);
-	gdouble fResultInPixels = (INCHES_PER_METER * fResultInMeters) * fMonitorPixelsPerInch;
-	fResultInPixels /= (float)g_sZoomLevels[uZoomLevel-1].uScale;
-	return fResultInPixels;
-}
-
-void map_windowpoint_to_mappoint(map_t* pMap, screenpoint_t* pScreenPoint, mappoint_t* pMapPoint)
-{
-	// Calculate the # of pixels away from the center point the click was
-	gint16 nPixelDeltaX = (gint)(pScreenPoint->nX) - (pMap->MapDimensions.uWidth / 2);
-	gint16 nPixelDeltaY = (gint)(pScreenPoint->nY) - (pMap->MapDimensions.uHeight / 2);
-
-	// Convert pixels to world coordinates
-	pMapPoint->fLongitude = pMap->MapCenter.fLongitude + map_math_pixels_to_degrees_at_scale(nPixelDeltaX, map_get_scale(pMap));
-	// reverse the X, clicking above
-	pMapPoint->fLatitude = pMap->MapCenter.fLatitude - map_math_pixels_to_degrees_at_scale(nPixelDeltaY, map_get_scale(pMap));
-}
-
 EOverlapType map_rect_a_overlap_type_with_rect_b(const maprect_t* pA, const maprect_t* pB)
 {
 	// First, quickly determine if there is no overlap
@@ -262,151 +240,338 @@ gboolean map_math_mappoints_equal(const mappoint_t* pA, const mappoint_t* pB)
 	return (pA->fLatitude == pB->fLatitude && pA->fLongitude == pB->fLongitude);
 }
 
-typedef struct {
-	gint nPointsSeen;
-	mappoint_t ptFirst;
-	mappoint_t ptPrevious;
-	gboolean bPreviousWasInside;
-} clip_stage_data_t;
+//
+// Clipping to a maprect.  Both clippers write into a mapclipbuffer_t, which the caller keeps and reuses
+// (the map keeps one for drawing), so clipping doesn't allocate once the buffer has grown to fit.
+//
+mapclipbuffer_t* map_math_clipbuffer_new(void)
+{
+	mapclipbuffer_t* pNew = g_new0(mapclipbuffer_t, 1);
+	pNew->pPointsArray = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+	pNew->pTempArray = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+	pNew->pRunsArray = g_array_new(FALSE, FALSE, sizeof(gint));
+	return pNew;
+}
 
-typedef struct {
-	clip_stage_data_t aStageData[4];
-	GArray* pOutputArray;
-	maprect_t* pClipRect;
-} clip_data_t;
+void map_math_clipbuffer_free(mapclipbuffer_t* pBuffer)
+{
+	g_array_free(pBuffer->pPointsArray, TRUE);
+	g_array_free(pBuffer->pTempArray, TRUE);
+	g_array_free(pBuffer->pRunsArray, TRUE);
+	g_free(pBuffer);
+}
 
-static void map_math_clip_linesegment_to_worldrect_edge_recursive(clip_data_t* pClipData, const mappoint_t* pCurrent, gint nEdge)
+// One Sutherland-Hodgman pass: clip the closed ring aPoints against one edge of pRect, appending to pOutput.
+// Inside is < for the north and east edges and >= for the south and west ones, so a point on a shared edge is in one rect.
+static void map_math_clip_ring_to_edge(const mappoint_t* aPoints, gint nNumPoints, const maprect_t* pRect, ERectEdge eEdge, GArray* pOutput)
 {
-	// A function pointer and argument for finding a crossing point (where a line segment crosses an axis-aligned line)
-	void (*segment_vs_axis_line_intersection_function)(const mappoint_t* pA, const mappoint_t* pB, gdouble fLinePosition, mappoint_t* pReturnPoint);
+	gboolean bHorizontal = (eEdge == EDGE_NORTH || eEdge == EDGE_SOUTH);
+	gboolean bInsideIsLess = (eEdge == EDGE_NORTH || eEdge == EDGE_EAST);
 	gdouble fLinePosition;
-
-	//g_debug("edge %d got point %f,%f", nEdge, pCurrent->fLongitude, pCurrent->fLatitude);
-
-	clip_stage_data_t* pStage = &pClipData->aStageData[nEdge];	// can obviously only access this if nEdge is valid
-
-	gboolean bCurrentIsInside;
-	switch(nEdge) {
-	case EDGE_NORTH:
-		bCurrentIsInside = (pCurrent->fLatitude < pClipData->pClipRect->B.fLatitude);
-		segment_vs_axis_line_intersection_function = map_math_get_intersection_of_line_segment_and_horizontal_line;
-		fLinePosition = pClipData->pClipRect->B.fLatitude;
-	break;
-	case EDGE_EAST:
-		bCurrentIsInside = (pCurrent->fLongitude < pClipData->pClipRect->B.fLongitude);
-		segment_vs_axis_line_intersection_function = map_math_get_intersection_of_line_segment_and_vertical_line;
-		fLinePosition = pClipData->pClipRect->B.fLongitude;
-	break;
-	case EDGE_SOUTH:
-		bCurrentIsInside = (pCurrent->fLatitude >= pClipData->pClipRect->A.fLatitude);
-		segment_vs_axis_line_intersection_function = map_math_get_intersection_of_line_segment_and_horizontal_line;
-		fLinePosition = pClipData->pClipRect->A.fLatitude;
-	break;
-	case EDGE_WEST:
-		bCurrentIsInside = (pCurrent->fLongitude >= pClipData->pClipRect->A.fLongitude);
-		segment_vs_axis_line_intersection_function = map_math_get_intersection_of_line_segment_and_vertical_line;
-		fLinePosition = pClipData->pClipRect->A.fLongitude;
-	break;
-	default:
-		// We get here when we've completed all four clipping planes.
-		g_array_append_val(pClipData->pOutputArray, *pCurrent);
-		return;
+	switch(eEdge) {
+	case EDGE_NORTH: fLinePosition = pRect->B.fLatitude; break;
+	case EDGE_EAST: fLinePosition = pRect->B.fLongitude; break;
+	case EDGE_SOUTH: fLinePosition = pRect->A.fLatitude; break;
+	default: fLinePosition = pRect->A.fLongitude; break;
 	}
 
+	#define IS_INSIDE(p)	(bInsideIsLess ? ((bHorizontal ? (p)->fLatitude : (p)->fLongitude) < fLinePosition) \
+											: ((bHorizontal ? (p)->fLatitude : (p)->fLongitude) >= fLinePosition))
+
+	const mappoint_t* pPrevious = &aPoints[nNumPoints-1];
+	gboolean bPreviousIsInside = IS_INSIDE(pPrevious);
 	mappoint_t ptCrossing;
-	if(pStage->nPointsSeen == 0) {
-		// Just save the point.  We can't do anything with one point!
-		pStage->ptFirst = *pCurrent;
-	}
-	else {
+	gint i;
+	for(i=0 ; i<nNumPoints ; i++) {
+		const mappoint_t* pCurrent = &aPoints[i];
+		gboolean bCurrentIsInside = IS_INSIDE(pCurrent);
+
+		if(bCurrentIsInside != bPreviousIsInside) {
+			// entering or leaving
+			if(bHorizontal) map_math_get_intersection_of_line_segment_and_horizontal_line(pCurrent, pPrevious, fLinePosition, &ptCrossing);
+			else map_math_get_intersection_of_line_segment_and_vertical_line(pCurrent, pPrevious, fLinePosition, &ptCrossing);
+			g_array_append_val(pOutput, ptCrossing);
+		}
 		if(bCurrentIsInside) {
-			if(pStage->bPreviousWasInside == FALSE) {
-				//g_debug("point entering");
-				segment_vs_axis_line_intersection_function(pCurrent, &(pStage->ptPrevious), fLinePosition, &ptCrossing);
-				map_math_clip_linesegment_to_worldrect_edge_recursive(pClipData, &ptCrossing, nEdge + 1);
+			g_array_append_val(pOutput, *pCurrent);
+		}
+		pPrevious = pCurrent;
+		bPreviousIsInside = bCurrentIsInside;
+	}
+	#undef IS_INSIDE
+}
+
+// Clip a polygon (a ring, without its closing point) to pRect.  Returns pBuffer->pPointsArray, which holds the result
+// until the buffer is used again.  Parts of the polygon along the rect's edges come out as zero-width slivers, which fill to nothing.
+const GArray* map_math_clip_polygon_to_worldrect(const mappoint_t* aPoints, gint nNumPoints, const maprect_t* pRect, mapclipbuffer_t* pBuffer)
+{
+	g_assert(EDGE_FIRST == 0);
+	g_assert(EDGE_LAST == 3);	// we make these assumptions with our edge incrementing
+
+	g_array_set_size(pBuffer->pPointsArray, 0);
+	if(nNumPoints <= 2) return pBuffer->pPointsArray;
+
+	// ping-pong between the two arrays, one edge at a time, ending in pPointsArray
+	const mappoint_t* aInput = aPoints;
+	gint nInput = nNumPoints;
+	GArray* pOutput = pBuffer->pTempArray;
+	ERectEdge eEdge;
+	for(eEdge=EDGE_FIRST ; eEdge<=EDGE_LAST ; eEdge++) {
+		g_array_set_size(pOutput, 0);
+		if(nInput > 0) {
+			map_math_clip_ring_to_edge(aInput, nInput, pRect, eEdge, pOutput);
+		}
+		aInput = &g_array_index(pOutput, mappoint_t, 0);
+		nInput = pOutput->len;
+		pOutput = (pOutput == pBuffer->pTempArray) ? pBuffer->pPointsArray : pBuffer->pTempArray;
+	}
+	g_assert(pOutput == pBuffer->pTempArray);	// so the last pass wrote pPointsArray
+	return pBuffer->pPointsArray;
+}
+
+// Liang-Barsky: clip the segment A->B to pRect.  Returns FALSE if none of it is inside, otherwise the part that is inside
+// is A + t*(B-A) for t in [*pfReturnStart, *pfReturnEnd].
+static gboolean map_math_clip_segment_to_worldrect(const mappoint_t* pA, const mappoint_t* pB, const maprect_t* pRect, gdouble* pfReturnStart, gdouble* pfReturnEnd)
+{
+	gdouble fDeltaX = pB->fLongitude - pA->fLongitude;
+	gdouble fDeltaY = pB->fLatitude - pA->fLatitude;
+
+	gdouble afP[4] = {-fDeltaX, fDeltaX, -fDeltaY, fDeltaY};
+	gdouble afQ[4] = {pA->fLongitude - pRect->A.fLongitude, pRect->B.fLongitude - pA->fLongitude,
+					  pA->fLatitude - pRect->A.fLatitude, pRect->B.fLatitude - pA->fLatitude};
+
+	gdouble fStart = 0.0;
+	gdouble fEnd = 1.0;
+	gint i;
+	for(i=0 ; i<4 ; i++) {
+		if(afP[i] == 0.0) {
+			if(afQ[i] < 0.0) return FALSE;	// parallel to this edge and outside it
+		}
+		else {
+			gdouble fT = afQ[i] / afP[i];
+			if(afP[i] < 0.0) {
+				if(fT > fEnd) return FALSE;
+				if(fT > fStart) fStart = fT;
+			}
+			else {
+				if(fT < fStart) return FALSE;
+				if(fT < fEnd) fEnd = fT;
+			}
+		}
+	}
+	*pfReturnStart = fStart;
+	*pfReturnEnd = fEnd;
+	return TRUE;
+}
+
+static void map_math_point_along_segment(const mappoint_t* pA, const mappoint_t* pB, gdouble fT, mappoint_t* pReturnPoint)
+{
+	pReturnPoint->fLatitude = pA->fLatitude + ((pB->fLatitude - pA->fLatitude) * fT);
+	pReturnPoint->fLongitude = pA->fLongitude + ((pB->fLongitude - pA->fLongitude) * fT);
+}
+
+// Clip a line to pRect.  A line can leave and re-enter, so the result is zero or more pieces: pBuffer->pPointsArray
+// holds their points back to back and pBuffer->pRunsArray how many points each has (always 2 or more).
+// Returns the number of pieces.
+gint map_math_clip_polyline_to_worldrect(const mappoint_t* aPoints, gint nNumPoints, const maprect_t* pRect, mapclipbuffer_t* pBuffer)
+{
+	GArray* pOutput = pBuffer->pPointsArray;
+	GArray* pRuns = pBuffer->pRunsArray;
+	g_array_set_size(pOutput, 0);
+	g_array_set_size(pRuns, 0);
+
+	gint nRunStart = -1;	// index into pOutput of the open piece's first point, or -1
+	mappoint_t ptClipped;
+	gint i;
+	for(i=1 ; i<nNumPoints ; i++) {
+		const mappoint_t* pA = &aPoints[i-1];
+		const mappoint_t* pB = &aPoints[i];
+
+		gdouble fStart, fEnd;
+		gboolean bVisible = map_math_clip_segment_to_worldrect(pA, pB, pRect, &fStart, &fEnd);
+
+		// close the open piece unless this segment carries straight on from it
+		if(nRunStart != -1 && (!bVisible || fStart > 0.0)) {
+			gint nRunLength = pOutput->len - nRunStart;
+			g_array_append_val(pRuns, nRunLength);
+			nRunStart = -1;
+		}
+		if(!bVisible) continue;
+
+		if(nRunStart == -1) {
+			nRunStart = pOutput->len;
+			if(fStart > 0.0) {
+				map_math_point_along_segment(pA, pB, fStart, &ptClipped);
+				g_array_append_val(pOutput, ptClipped);
+			}
+			else {
+				g_array_append_val(pOutput, *pA);
 			}
-			map_math_clip_linesegment_to_worldrect_edge_recursive(pClipData, pCurrent, nEdge + 1);
 		}
-		else if(pStage->bPreviousWasInside) {
-			//g_debug("point leaving");
-			segment_vs_axis_line_intersection_function(pCurrent, &(pStage->ptPrevious), fLinePosition, &ptCrossing);
-			map_math_clip_linesegment_to_worldrect_edge_recursive(pClipData, &ptCrossing, nEdge + 1);
+		if(fEnd < 1.0) {
+			map_math_point_along_segment(pA, pB, fEnd, &ptClipped);
+			g_array_append_val(pOutput, ptClipped);
+
+			// leaving
+			gint nRunLength = pOutput->len - nRunStart;
+			g_array_append_val(pRuns, nRunLength);
+			nRunStart = -1;
 		}
+		else {
+			g_array_append_val(pOutput, *pB);
+		}
+	}
+	if(nRunStart != -1) {
+		gint nRunLength = pOutput->len - nRunStart;
+		g_array_append_val(pRuns, nRunLength);
 	}
-	pStage->ptPrevious = *pCurrent;
-	pStage->bPreviousWasInside = bCurrentIsInside;
-	pStage->nPointsSeen++;
+	return pRuns->len;
 }
 
-static void map_math_clip_linesegment_to_worldrect_edge_finalize_recursive(clip_data_t* pClipData, gint nEdge)
+// The render metrics' world rect, grown by fPixels on every side
+void map_math_get_worldrect_inflated_by_pixels(const rendermetrics_t* pRenderMetrics, gdouble fPixels, maprect_t* pReturnRect)
 {
-	if(nEdge > EDGE_LAST) return;	// end recursion
+	gdouble fLongitude = (pRenderMetrics->fScreenLongitude / pRenderMetrics->nWindowWidth) * fPixels;
+	gdouble fLatitude = (pRenderMetrics->fScreenLatitude / pRenderMetrics->nWindowHeight) * fPixels;
 
-	// Connect last point to first point for this stage
-	clip_stage_data_t* pStage = &(pClipData->aStageData[nEdge]);	// can obviously only access this if nEdge is valid
-	map_math_clip_linesegment_to_worldrect_edge_recursive(pClipData, &(pStage->ptFirst), nEdge);
+	pReturnRect->A.fLongitude = pRenderMetrics->rWorldBoundingBox.A.fLongitude - fLongitude;
+	pReturnRect->A.fLatitude = pRenderMetrics->rWorldBoundingBox.A.fLatitude - fLatitude;
+	pReturnRect->B.fLongitude = pRenderMetrics->rWorldBoundingBox.B.fLongitude + fLongitude;
+	pReturnRect->B.fLatitude = pRenderMetrics->rWorldBoundingBox.B.fLatitude + fLatitude;
+}
 
-	// Continue cleanup, recursive
-	map_math_clip_linesegment_to_worldrect_edge_finalize_recursive(pClipData, nEdge + 1);
+// The part of the world under a rectangle of the window, plus fInflateByPixels all around
+void map_math_get_worldrect_of_windowrect(const rendermetrics_t* pRenderMetrics, const GdkRectangle* pWindowRect, gdouble fInflateByPixels, maprect_t* pReturnRect)
+{
+	// screen Y runs down, so the bottom edge is the lowest latitude
+	pReturnRect->A.fLongitude = ((pWindowRect->x - fInflateByPixels) - pRenderMetrics->fOffsetX) / pRenderMetrics->fScaleX;
+	pReturnRect->A.fLatitude = ((pWindowRect->y + pWindowRect->height + fInflateByPixels) - pRenderMetrics->fOffsetY) / pRenderMetrics->fScaleY;
+	pReturnRect->B.fLongitude = ((pWindowRect->x + pWindowRect->width + fInflateByPixels) - pRenderMetrics->fOffsetX) / pRenderMetrics->fScaleX;
+	pReturnRect->B.fLatitude = ((pWindowRect->y - fInflateByPixels) - pRenderMetrics->fOffsetY) / pRenderMetrics->fScaleY;
 }
 
-void map_math_clip_pointstring_to_worldrect(GArray* pMapPointsArray, maprect_t* pRect, GArray* pOutput)
+// World to screen for a run of points: SCALE_X and SCALE_Y, with the transform in locals and nothing else
+// in the loop, so the compiler can vectorize it
+void map_math_project_points(const rendermetrics_t* pRenderMetrics, const mappoint_t* aPoints, gint nNumPoints, screenpointf_t* aReturnPoints)
 {
-	g_assert(EDGE_FIRST == 0);
-	g_assert(EDGE_LAST == 3);	// we make these assumptions with our array indexing and nEdge incrementing
+	const gdouble fScaleX = pRenderMetrics->fScaleX;
+	const gdouble fOffsetX = pRenderMetrics->fOffsetX;
+	const gdouble fScaleY = pRenderMetrics->fScaleY;
+	const gdouble fOffsetY = pRenderMetrics->fOffsetY;
 
-	if(pMapPointsArray->len <= 2) return;
+	gint i;
+	for(i=0 ; i<nNumPoints ; i++) {
+		aReturnPoints[i].fX = (aPoints[i].fLongitude * fScaleX) + fOffsetX;
+		aReturnPoints[i].fY = (aPoints[i].fLatitude * fScaleY) + fOffsetY;
+	}
+}
+
+//
+// Line simplification (Douglas-Peucker)
+//
+typedef struct {
+	gint iFirst;
+	gint iLast;
+} simplify_span_t;
 
-	// Initialize clip data (most of it defaults to 0s)
-	clip_data_t* pClipData = g_new0(clip_data_t, 1);
-	pClipData->pOutputArray = pOutput;
-	pClipData->pClipRect = pRect;
+// Squared distance from each of aPoints[0..nCount) to the line through pA and pB.  No branches or calls in the loop,
+// so the compiler can vectorize it.  (Same result as map_math_point_distance_squared_from_line, with the division hoisted.)
+static void map_math_distances_squared_from_line(const mappoint_t* aPoints, gint nCount, const mappoint_t* pA, const mappoint_t* pB, gdouble* afReturnDistances)
+{
+	gdouble fLineLatitude = pB->fLatitude - pA->fLatitude;
+	gdouble fLineLongitude = pB->fLongitude - pA->fLongitude;
+	gdouble fLineLengthSquared = (fLineLatitude * fLineLatitude) + (fLineLongitude * fLineLongitude);
 
-	// Pass each point through the clippers (recursively)
 	gint i;
-	for(i=0 ; i<pMapPointsArray->len ; i++) {
-		mappoint_t* pCurrent = &g_array_index(pMapPointsArray, mappoint_t, i);
-		map_math_clip_linesegment_to_worldrect_edge_recursive(pClipData, pCurrent, EDGE_FIRST);
+	if(fLineLengthSquared == 0.0) {
+		// A and B are the same point (a loop), so measure from it
+		for(i=0 ; i<nCount ; i++) {
+			gdouble fLatitude = aPoints[i].fLatitude - pA->fLatitude;
+			gdouble fLongitude = aPoints[i].fLongitude - pA->fLongitude;
+			afReturnDistances[i] = (fLatitude * fLatitude) + (fLongitude * fLongitude);
+		}
+		return;
 	}
 
-	// Finalize clippers (recursively)
-	map_math_clip_linesegment_to_worldrect_edge_finalize_recursive(pClipData, EDGE_FIRST);
-	g_free(pClipData);
+	gdouble fScale = 1.0 / fLineLengthSquared;
+	for(i=0 ; i<nCount ; i++) {
+		// |AP x AB|^2 / |AB|^2
+		gdouble fCross = ((aPoints[i].fLatitude - pA->fLatitude) * fLineLongitude) - ((aPoints[i].fLongitude - pA->fLongitude) * fLineLatitude);
+		afReturnDistances[i] = fCross * fCross * fScale;
+	}
 }
 
-void static map_math_simplify_pointstring_recursive(const GArray* pInput, gint8* pabInclude, gdouble fTolerance, gint iFirst, gint iLast)
+static gboolean map_math_mappoint_is_less(const mappoint_t* pA, const mappoint_t* pB)
 {
-	if(iFirst+1 >= iLast) return;	// no points between first and last?
+	if(pA->fLatitude != pB->fLatitude) return (pA->fLatitude < pB->fLatitude);
+	return (pA->fLongitude < pB->fLongitude);
+}
 
-	mappoint_t* pA = &g_array_index(pInput, mappoint_t, iFirst);
-	mappoint_t* pB = &g_array_index(pInput, mappoint_t, iLast);
+// Marks the points of aPoints[iFirst..iLast] that survive simplification in pabInclude (the ends must already be marked).
+// Iterative, with an explicit stack of spans, so long chains can't overflow the C stack.
+//
+// With bSymmetric, each span is measured from whichever end is 'less' (and ties go to the first point found walking from
+// that end), so a run of points shared by two chains comes out the same whichever direction each one walks it.
+static void map_math_simplify_range(const mappoint_t* aPoints, gint8* pabInclude, gdouble fTolerance, gint iFirst, gint iLast, gboolean bSymmetric, GArray* pStack, gdouble* afDistances)
+{
+	gdouble fToleranceSquared = fTolerance * fTolerance;
 
-	// Init to bad values
-	gint iFarthestIndex = -1;
-	gdouble fBiggestDistanceSquared = 0.0;
+	simplify_span_t span = {iFirst, iLast};
+	g_array_set_size(pStack, 0);
+	g_array_append_val(pStack, span);
 
-	// Of all points between A and B, which is farthest from the line AB?
-	mappoint_t* pPoint;
-	gint i;
-	for(i=(iFirst+1) ; i<=(iLast-1) ; i++) {
-		pPoint = &g_array_index(pInput, mappoint_t, i);
-		gdouble fDistanceSquared = map_math_point_distance_squared_from_line(pPoint, pA, pB);
+	while(pStack->len > 0) {
+		span = g_array_index(pStack, simplify_span_t, pStack->len - 1);
+		g_array_set_size(pStack, pStack->len - 1);
+
+		gint nCount = span.iLast - span.iFirst - 1;
+		if(nCount <= 0) continue;	// no points between first and last?
+
+		const mappoint_t* pA = &aPoints[span.iFirst];
+		const mappoint_t* pB = &aPoints[span.iLast];
+		gboolean bBackward = (bSymmetric && map_math_mappoint_is_less(pB, pA));
 
-		if(fDistanceSquared > fBiggestDistanceSquared) {
-			fBiggestDistanceSquared = fDistanceSquared;
-			iFarthestIndex = i;
+		// Of all points between A and B, which is farthest from the line AB?
+		map_math_distances_squared_from_line(&aPoints[span.iFirst + 1], nCount, bBackward ? pB : pA, bBackward ? pA : pB, afDistances);
+
+		gint iFarthest = -1;
+		gdouble fBiggestDistanceSquared = 0.0;
+		gint i;
+		if(bBackward) {
+			for(i=nCount-1 ; i>=0 ; i--) {
+				if(afDistances[i] > fBiggestDistanceSquared) {
+					fBiggestDistanceSquared = afDistances[i];
+					iFarthest = i;
+				}
+			}
 		}
-	}
-	if((fBiggestDistanceSquared > (fTolerance * fTolerance)) && (iFarthestIndex != -1)) {	// add last test just in case fTolerance == 0.0
-		// Mark for inclusion
-		pabInclude[iFarthestIndex] = 1;
+		else {
+			for(i=0 ; i<nCount ; i++) {
+				if(afDistances[i] > fBiggestDistanceSquared) {
+					fBiggestDistanceSquared = afDistances[i];
+					iFarthest = i;
+				}
+			}
+		}
+
+		if((fBiggestDistanceSquared > fToleranceSquared) && (iFarthest != -1)) {	// add last test just in case fTolerance == 0.0
+			gint iFarthestIndex = span.iFirst + 1 + iFarthest;
+
+			// Mark for inclusion, and do both halves
+			pabInclude[iFarthestIndex] = 1;
 
-		map_math_simplify_pointstring_recursive(pInput, pabInclude, fTolerance, iFirst, iFarthestIndex);
-		map_math_simplify_pointstring_recursive(pInput, pabInclude, fTolerance, iFarthestIndex, iLast);
+			simplify_span_t half = {iFarthestIndex, span.iLast};
+			g_array_append_val(pStack, half);
+			half.iFirst = span.iFirst;
+			half.iLast = iFarthestIndex;
+			g_array_append_val(pStack, half);
+		}
 	}
 }
 
-void map_math_simplify_pointstring(const GArray* pInput, gdouble fTolerance, GArray* pOutput)
+// With pabLocked, points with pabLocked[i] != 0 are always kept (eg. where other roads join this one), and each run
+// between them is simplified symmetrically (see map_math_simplify_range), so neighbors that share it stay gap-free.
+static void map_math_simplify_pointstring_internal(const GArray* pInput, const gint8* pabLocked, gdouble fTolerance, GArray* pOutput)
 {
 	if(pInput->len <= 2) {
 		// Can't simplify this.
@@ -414,28 +579,55 @@ void map_math_simplify_pointstring(const GArray* pInput, gdouble fTolerance, GAr
 		return;
 	}
 
-	gint8* pabInclude = g_new0(gint8, pInput->len + 20);
+	const mappoint_t* aPoints = &g_array_index(pInput, mappoint_t, 0);
+	gint8* pabInclude = g_new0(gint8, pInput->len);
+	gdouble* afDistances = g_new(gdouble, pInput->len);
+	GArray* pStack = g_array_new(FALSE, FALSE, sizeof(simplify_span_t));
 
 	// Mark first and last points
 	pabInclude[0] = 1;
 	pabInclude[pInput->len-1] = 1;
 
-	map_math_simplify_pointstring_recursive(pInput, pabInclude, fTolerance, 0, pInput->len-1);  
+	gint i;
+	if(pabLocked == NULL) {
+		map_math_simplify_range(aPoints, pabInclude, fTolerance, 0, pInput->len-1, FALSE, pStack, afDistances);
+	}
+	else {
+		gint iPreviousLocked = 0;
+		for(i=1 ; i<pInput->len ; i++) {
+			if(pabLocked[i] || i == (pInput->len-1)) {
+				pabInclude[i] = 1;
+				map_math_simplify_range(aPoints, pabInclude, fTolerance, iPreviousLocked, i, TRUE, pStack, afDistances);
+				iPreviousLocked = i;
+			}
+		}
+	}
 
 	//
 	// cleanup
 	//
-	mappoint_t* pPoint;
-	gint i;
 	for(i=0 ; i<pInput->len ; i++) {
-		pPoint = &g_array_index(pInput, mappoint_t, i);
 		if(pabInclude[i] == 1) {
-			g_array_append_val(pOutput, *pPoint);
+			g_array_append_val(pOutput, aPoints[i]);
 		}
 	}
+	g_array_free(pStack, TRUE);
+	g_free(afDistances);
 	g_free(pabInclude);
 }
 
+void map_math_simplify_pointstring(const GArray* pInput, gdouble fTolerance, GArray* pOutput)
+{
+	map_math_simplify_pointstring_internal(pInput, NULL, fTolerance, pOutput);
+}
+
+// pabLocked has one entry per point.  See map_math_simplify_pointstring_internal.
+void map_math_simplify_pointstring_locked(const GArray* pInput, const gint8* pabLocked, gdouble fTolerance, GArray* pOutput)
+{
+	g_assert(pabLocked != NULL);
+	map_math_simplify_pointstring_internal(pInput, pabLocked, fTolerance, pOutput);
+}
+
 gdouble map_math_point_distance_squared_from_line(mappoint_t* pHitPoint, mappoint_t* pPoint1, mappoint_t* pPoint2)
 {
 	// Some bad ASCII art demonstrating the situation:
@@ -547,6 +739,28 @@ void map_util_bounding_box_union(maprect_t* pA, const maprect_t* pB)
 	pA->B.fLongitude = MAX(pA->B.fLongitude, pB->B.fLongitude);
 }
 
+void map_util_calculate_bounding_box(const GArray* pMapPointsArray, maprect_t* pBoundingRect)
+{
+	g_assert(pMapPointsArray != NULL);
+	g_assert(pMapPointsArray->len > 0);
+	g_assert(pBoundingRect != NULL);
+
+	pBoundingRect->A.fLatitude = MAX_LATITUDE;
+	pBoundingRect->A.fLongitude = MAX_LONGITUDE;
+	pBoundingRect->B.fLatitude = MIN_LATITUDE;
+	pBoundingRect->B.fLongitude = MIN_LONGITUDE;
+
+	gint i;
+	for(i=0 ; i<pMapPointsArray->len ; i++) {
+		mappoint_t* p = &g_array_index(pMapPointsArray, mappoint_t, i);
+
+		pBoundingRect->A.fLatitude = MIN(pBoundingRect->A.fLatitude, p->fLatitude);
+		pBoundingRect->B.fLatitude = MAX(pBoundingRect->B.fLatitude, p->fLatitude);
+		pBoundingRect->A.fLongitude = MIN(pBoundingRect->A.fLongitude, p->fLongitude);
+		pBoundingRect->B.fLongitude = MAX(pBoundingRect->B.fLongitude, p->fLongitude);
+	}
+}
+
 #ifdef ROADSTER_DEAD_CODE
 /*
 gdouble map_distance_in_units_to_degrees(map_t* pMap, gdouble fDistance, gint nDistanceUnit)
@@ -584,30 +798,6 @@ gdouble map_get_distance_in_pixels(map_t* pMap, mappoint_t* p1, mappoint_t* p2)
 	return sqrt((fDeltaX*fDeltaX) + (fDeltaY*fDeltaY));
 }
 
-void map_util_calculate_bounding_box(const GArray* pMapPointsArray, maprect_t* pBoundingRect)
-{
-	// untested
-	g_assert_not_reacher();
-
-	g_assert(pMapPointsArray != NULL);
-	g_assert(pMapPointsArray->len > 0);
-	g_assert(pBoundingRect != NULL);
-
-	pBoundingRect->A.fLatitude = MAX_LATITUDE;
-	pBoundingRect->A.fLongitude = MAX_LONGITUDE;
-	pBoundingRect->B.fLatitude = MIN_LATITUDE;
-	pBoundingRect->B.fLongitude = MIN_LONGITUDE;
-
-	gint i = 0;
-	for(i=0 ; i<pMapPointsArray->len ; i++) {
-		mappoint_t* p = &g_array_index(pMapPointsArray, mappoint_t, i);
-
-		pBoundingRect->A.fLatitude = min(pBoundingRect->A.fLatitude, p->fLatitude);
-		pBoundingRect->B.fLatitude = max(pBoundingRect->B.fLatitude, p->fLatitude);
-		pBoundingRect->A.fLongitude = min(pBoundingRect->A.fLongitude, p->fLongitude);
-		pBoundingRect->B.fLongitude = max(pBoundingRect->B.fLongitude, p->fLongitude);
-	}
-}
 
 */
 #endif
@@ -34,15 +34,25 @@ gboolean map_math_screenpoint_in_screenrect(screenpoint_t* pPt, screenrect_t* pR
 gboolean map_math_maprects_equal(maprect_t* pA, maprect_t* pB);
 gboolean map_math_mappoint_in_polygon(const mappoint_t* pPoint, const GArray* pMapPointsArray);
 gboolean map_math_mappoint_in_maprect(const mappoint_t* pPoint, const maprect_t* pRect);
+gboolean map_math_mappoints_equal(const mappoint_t* pA, const mappoint_t* pB);
 
 EOverlapType map_rect_a_overlap_type_with_rect_b(const maprect_t* pA, const maprect_t* pB);
 gboolean map_rects_overlap(const maprect_t* p1, const maprect_t* p2);
 
 void map_math_simplify_pointstring(const GArray* pInput, gdouble fTolerance, GArray* pOutput);
+void map_math_simplify_pointstring_locked(const GArray* pInput, const gint8* pabLocked, gdouble fTolerance, GArray* pOutput);
 gdouble map_math_point_distance_squared_from_line(mappoint_t* pHitPoint, mappoint_t* pPoint1, mappoint_t* pPoint2);
 
 gdouble map_math_pixels_to_degrees_at_scale(gint nPixels, gint nScale);
-void map_math_clip_pointstring_to_worldrect(GArray* pMapPointsArray, maprect_t* pRect, GArray* pOutput);
+
+mapclipbuffer_t* map_math_clipbuffer_new(void);
+void map_math_clipbuffer_free(mapclipbuffer_t* pBuffer);
+const GArray* map_math_clip_polygon_to_worldrect(const mappoint_t* aPoints, gint nNumPoints, const maprect_t* pRect, mapclipbuffer_t* pBuffer);
+gint map_math_clip_polyline_to_worldrect(const mappoint_t* aPoints, gint nNumPoints, const maprect_t* pRect, mapclipbuffer_t* pBuffer);
+void map_math_get_worldrect_inflated_by_pixels(const rendermetrics_t* pRenderMetrics, gdouble fPixels, maprect_t* pReturnRect);
+void map_math_get_worldrect_of_windowrect(const rendermetrics_t* pRenderMetrics, const GdkRectangle* pWindowRect, gdouble fInflateByPixels, maprect_t* pReturnRect);
+void map_math_project_points(const rendermetrics_t* pRenderMetrics, const mappoint_t* aPoints, gint nNumPoints, screenpointf_t* aReturnPoints);
+
 gboolean map_math_try_connect_linestrings(GArray* pA, const GArray* pB);
 void map_util_calculate_bounding_box(const GArray* pMapPointsArray, maprect_t* pBoundingRect);
 void map_util_bounding_box_union(maprect_t* pA, const maprect_t* pB);
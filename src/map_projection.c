@@ -0,0 +1,106 @@
+/***************************************************************************
+ *            map_projection.c
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+Purpose of map_projection.c:
+ - Project the visible tiles' points to screen space in one pass per tile and object type, at most once a frame
+ - The points are the tile's simplified ones for the zoom level (see map_tilemanager_tile_get_simplified)
+ - Drawing (lines, polygons, labels) and hit testing then read screen coordinates instead of each doing SCALE_X/SCALE_Y
+ - Buffers are kept between frames so we don't reallocate them every redraw
+*/
+
+#include <gtk/gtk.h>
+
+#include "map.h"
+#include "map_math.h"
+#include "map_projection.h"
+#include "map_tilemanager.h"
+
+#define BUFFER_INDEX(iTile, nObjectType)	(((iTile) * (MAP_NUM_OBJECT_TYPES + 1)) + (nObjectType))
+
+mapprojection_t* map_projection_new(void)
+{
+	mapprojection_t* pNew = g_new0(mapprojection_t, 1);
+	pNew->pBuffersArray = g_ptr_array_new();
+	pNew->pValidArray = g_array_new(FALSE, TRUE, sizeof(gboolean));
+	return pNew;
+}
+
+// Forget everything projected so far.  Called by map_draw for each frame, after the tiles are loaded.
+void map_projection_begin_frame(mapprojection_t* pProjection, const rendermetrics_t* pRenderMetrics, GPtrArray* pTilesArray)
+{
+	g_assert(pProjection != NULL);
+	g_assert(pRenderMetrics != NULL);
+	g_assert(pTilesArray != NULL);
+
+	pProjection->Metrics = *pRenderMetrics;
+	pProjection->pTilesArray = pTilesArray;
+
+	// one buffer per tile and object type, kept from frame to frame
+	gint nNumBuffers = BUFFER_INDEX(pTilesArray->len, 0);
+	while(pProjection->pBuffersArray->len < nNumBuffers) {
+		g_ptr_array_add(pProjection->pBuffersArray, g_array_new(FALSE, FALSE, sizeof(screenpointf_t)));
+	}
+
+	g_array_set_size(pProjection->pValidArray, nNumBuffers);
+	gint i;
+	for(i=0 ; i<nNumBuffers ; i++) {
+		g_array_index(pProjection->pValidArray, gboolean, i) = FALSE;
+	}
+}
+
+// Are the buffers for these tiles, seen this way?  (Hit testing can happen after the map has moved but before it's redrawn.)
+gboolean map_projection_is_current(const mapprojection_t* pProjection, const rendermetrics_t* pRenderMetrics, const GPtrArray* pTilesArray)
+{
+	return (pProjection->pTilesArray == pTilesArray &&
+			pProjection->Metrics.fScaleX == pRenderMetrics->fScaleX &&
+			pProjection->Metrics.fOffsetX == pRenderMetrics->fOffsetX &&
+			pProjection->Metrics.fScaleY == pRenderMetrics->fScaleY &&
+			pProjection->Metrics.fOffsetY == pRenderMetrics->fOffsetY);
+}
+
+// A tile's objects of one type, with their points simplified for the zoom level and projected to screen space
+void map_projection_get_objects(mapprojection_t* pProjection, gint iTile, gint nObjectType, mapvisibleobjects_t* pReturnObjects)
+{
+	g_assert(pProjection->pTilesArray != NULL);
+	g_assert(iTile >= 0 && iTile < pProjection->pTilesArray->len);
+	g_assert(nObjectType >= 0 && nObjectType <= MAP_NUM_OBJECT_TYPES);
+
+	maptile_t* pTile = g_ptr_array_index(pProjection->pTilesArray, iTile);
+	const maptilesimplified_t* pSimplified = map_tilemanager_tile_get_simplified(pTile, nObjectType, pProjection->Metrics.nZoomLevel);
+
+	gint iBuffer = BUFFER_INDEX(iTile, nObjectType);
+	GArray* pBuffer = g_ptr_array_index(pProjection->pBuffersArray, iBuffer);
+	if(!g_array_index(pProjection->pValidArray, gboolean, iBuffer)) {
+		// the whole tile and type in one pass
+		g_array_set_size(pBuffer, pSimplified->pPointsArray->len);
+		map_math_project_points(&(pProjection->Metrics), &g_array_index(pSimplified->pPointsArray, mappoint_t, 0), pSimplified->pPointsArray->len,
+								&g_array_index(pBuffer, screenpointf_t, 0));
+		g_array_index(pProjection->pValidArray, gboolean, iBuffer) = TRUE;
+	}
+
+	pReturnObjects->pRoadsArray = pTile->apMapObjectArrays[nObjectType];
+	pReturnObjects->anFirstPoint = &g_array_index(pSimplified->pFirstPointArray, gint, 0);
+	pReturnObjects->aMapPoints = &g_array_index(pSimplified->pPointsArray, mappoint_t, 0);
+	pReturnObjects->aScreenPoints = &g_array_index(pBuffer, screenpointf_t, 0);
+}
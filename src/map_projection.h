@@ -0,0 +1,53 @@
+/***************************************************************************
+ *            map_projection.h
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _MAP_PROJECTION_H_
+#define _MAP_PROJECTION_H_
+
+#include <glib.h>
+#include "map.h"
+
+// One object type of one visible tile, ready to draw (see map_projection_get_objects)
+typedef struct {
+	GPtrArray* pRoadsArray;					// the tile's road_t's of this type
+	const gint* anFirstPoint;				// where each road's points start in the arrays below, plus one past the end
+	const mappoint_t* aMapPoints;			// each road's points, simplified for the zoom level (see map_tilemanager_tile_get_simplified)...
+	const screenpointf_t* aScreenPoints;	// ...and the same points in screen space
+} mapvisibleobjects_t;
+
+#define MAP_VISIBLE_OBJECT_NUM_POINTS(pObjects, i)	((pObjects)->anFirstPoint[(i)+1] - (pObjects)->anFirstPoint[(i)])
+
+struct mapprojection {
+	rendermetrics_t Metrics;			// the transform the buffers were projected with
+	GPtrArray* pTilesArray;				// the tiles they were projected from (not owned)
+
+	GPtrArray* pBuffersArray;			// GArray of screenpointf_t for each tile and object type
+	GArray* pValidArray;				// gboolean for each of the above
+};
+
+mapprojection_t* map_projection_new(void);
+void map_projection_begin_frame(mapprojection_t* pProjection, const rendermetrics_t* pRenderMetrics, GPtrArray* pTilesArray);
+gboolean map_projection_is_current(const mapprojection_t* pProjection, const rendermetrics_t* pRenderMetrics, const GPtrArray* pTilesArray);
+void map_projection_get_objects(mapprojection_t* pProjection, gint iTile, gint nObjectType, mapvisibleobjects_t* pReturnObjects);
+
+#endif
@@ -0,0 +1,205 @@
+/***************************************************************************
+ *            map_rastercache.c
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+Purpose of map_rastercache.c:
+ - Keep the drawn geometry layers (lines, polygons, fills) between frames, so panning is mostly copying
+ - The window is covered by square cells of a pixel grid fixed to the world at each zoom level (see map_get_render_metrics,
+   which puts the window on whole pixels of that grid), and each cell's geometry is drawn into its own image surface
+ - Surfaces are kept in least-recently-used order and the oldest are dropped to stay under a memory budget
+ - Cached cells are only good for one style: call map_rastercache_clear when it changes
+*/
+
+#include <math.h>
+#include <gtk/gtk.h>
+
+#include "map.h"
+#include "map_rastercache.h"
+
+#define RASTER_CELL_BYTES	(RASTER_CELL_SIZE * RASTER_CELL_SIZE * 4)	// CAIRO_FORMAT_ARGB32
+
+typedef struct {
+	gint nZoomLevel;
+	gint32 nCellX;
+	gint32 nCellY;
+	gdouble fScaleX;			// the scale it was drawn at (for one zoom level it varies a tiny bit with the window size)
+	gdouble fScaleY;
+	cairo_surface_t* pSurface;
+	GList* pLink;				// our link in pLRUQueue
+} maprastercacheentry_t;
+
+struct maprastercache {
+	GHashTable* pEntriesTable;	// maprastercacheentry_t, keyed by zoom level and cell
+	GQueue* pLRUQueue;			// maprastercacheentry_t, most recently used at the head
+	gint nBytes;
+	gint nBudgetBytes;
+};
+
+static guint map_rastercache_entry_hash(gconstpointer pKey)
+{
+	const maprastercacheentry_t* pEntry = pKey;
+	return ((guint)pEntry->nCellX * 73856093U) ^ ((guint)pEntry->nCellY * 19349663U) ^ ((guint)pEntry->nZoomLevel * 83492791U);
+}
+
+static gboolean map_rastercache_entry_equal(gconstpointer pA, gconstpointer pB)
+{
+	const maprastercacheentry_t* pEntryA = pA;
+	const maprastercacheentry_t* pEntryB = pB;
+	return (pEntryA->nCellX == pEntryB->nCellX && pEntryA->nCellY == pEntryB->nCellY && pEntryA->nZoomLevel == pEntryB->nZoomLevel);
+}
+
+maprastercache_t* map_rastercache_new(gint nBudgetBytes)
+{
+	maprastercache_t* pNew = g_new0(maprastercache_t, 1);
+	pNew->pEntriesTable = g_hash_table_new(map_rastercache_entry_hash, map_rastercache_entry_equal);
+	pNew->pLRUQueue = g_queue_new();
+	pNew->nBudgetBytes = nBudgetBytes;
+	return pNew;
+}
+
+static void map_rastercache_remove(maprastercache_t* pCache, maprastercacheentry_t* pEntry)
+{
+	g_hash_table_remove(pCache->pEntriesTable, pEntry);
+	g_queue_delete_link(pCache->pLRUQueue, pEntry->pLink);
+	cairo_surface_destroy(pEntry->pSurface);
+	pCache->nBytes -= RASTER_CELL_BYTES;
+	g_free(pEntry);
+}
+
+// Forget every cell.  Called when the style changes.
+void map_rastercache_clear(maprastercache_t* pCache)
+{
+	g_assert(pCache != NULL);
+	while(!g_queue_is_empty(pCache->pLRUQueue)) {
+		map_rastercache_remove(pCache, g_queue_peek_head(pCache->pLRUQueue));
+	}
+	g_assert(pCache->nBytes == 0);
+}
+
+static void map_rastercache_get_cell_range(const rendermetrics_t* pRenderMetrics, gint32* pnFirstX, gint32* pnFirstY, gint32* pnLastX, gint32* pnLastY)
+{
+	// a window pixel's place in the world grid is its window position minus the (whole pixel) offset
+	*pnFirstX = (gint32)floor(-(pRenderMetrics->fOffsetX) / RASTER_CELL_SIZE);
+	*pnFirstY = (gint32)floor(-(pRenderMetrics->fOffsetY) / RASTER_CELL_SIZE);
+	*pnLastX = (gint32)floor((pRenderMetrics->nWindowWidth - 1 - pRenderMetrics->fOffsetX) / RASTER_CELL_SIZE);
+	*pnLastY = (gint32)floor((pRenderMetrics->nWindowHeight - 1 - pRenderMetrics->fOffsetY) / RASTER_CELL_SIZE);
+}
+
+// World rect of a range of cells, plus the margin
+static void map_rastercache_get_cell_range_worldrect(const rendermetrics_t* pRenderMetrics, gint32 nFirstX, gint32 nFirstY, gint32 nLastX, gint32 nLastY, maprect_t* pReturnRect)
+{
+	gdouble fLeft = ((gdouble)nFirstX * RASTER_CELL_SIZE) - RASTER_CELL_MARGIN_IN_PIXELS;
+	gdouble fRight = ((gdouble)(nLastX + 1) * RASTER_CELL_SIZE) + RASTER_CELL_MARGIN_IN_PIXELS;
+	gdouble fTop = ((gdouble)nFirstY * RASTER_CELL_SIZE) - RASTER_CELL_MARGIN_IN_PIXELS;
+	gdouble fBottom = ((gdouble)(nLastY + 1) * RASTER_CELL_SIZE) + RASTER_CELL_MARGIN_IN_PIXELS;
+
+	// fScaleY is negative: the bottom of the cells is the lowest latitude
+	pReturnRect->A.fLongitude = fLeft / pRenderMetrics->fScaleX;
+	pReturnRect->B.fLongitude = fRight / pRenderMetrics->fScaleX;
+	pReturnRect->A.fLatitude = fBottom / pRenderMetrics->fScaleY;
+	pReturnRect->B.fLatitude = fTop / pRenderMetrics->fScaleY;
+}
+
+// Fills pCellsArray (of maprastercell_t) with the cells that cover the window
+void map_rastercache_get_visible_cells(const rendermetrics_t* pRenderMetrics, GArray* pCellsArray)
+{
+	gint32 nFirstX, nFirstY, nLastX, nLastY;
+	map_rastercache_get_cell_range(pRenderMetrics, &nFirstX, &nFirstY, &nLastX, &nLastY);
+
+	g_array_set_size(pCellsArray, 0);
+	gint32 nCellX, nCellY;
+	for(nCellY=nFirstY ; nCellY<=nLastY ; nCellY++) {
+		for(nCellX=nFirstX ; nCellX<=nLastX ; nCellX++) {
+			maprastercell_t cell;
+			cell.nCellX = nCellX;
+			cell.nCellY = nCellY;
+			cell.nLeft = (nCellX * RASTER_CELL_SIZE) + (gint)(pRenderMetrics->fOffsetX);
+			cell.nTop = (nCellY * RASTER_CELL_SIZE) + (gint)(pRenderMetrics->fOffsetY);
+			map_rastercache_get_cell_range_worldrect(pRenderMetrics, nCellX, nCellY, nCellX, nCellY, &(cell.rcWorld));
+			g_array_append_val(pCellsArray, cell);
+		}
+	}
+}
+
+// The world rect that the visible cells (with their margins) draw from.  Cells reach past the edges
+// of the window, and a cached cell is drawn once, so load the tiles for all of it.
+void map_rastercache_get_cells_worldrect(const rendermetrics_t* pRenderMetrics, maprect_t* pReturnRect)
+{
+	gint32 nFirstX, nFirstY, nLastX, nLastY;
+	map_rastercache_get_cell_range(pRenderMetrics, &nFirstX, &nFirstY, &nLastX, &nLastY);
+	map_rastercache_get_cell_range_worldrect(pRenderMetrics, nFirstX, nFirstY, nLastX, nLastY, pReturnRect);
+}
+
+// Returns a new reference to the cell's surface (release it with cairo_surface_destroy), or NULL if it isn't cached
+cairo_surface_t* map_rastercache_lookup(maprastercache_t* pCache, const rendermetrics_t* pRenderMetrics, const maprastercell_t* pCell)
+{
+	g_assert(pCache != NULL);
+
+	maprastercacheentry_t key;
+	key.nZoomLevel = pRenderMetrics->nZoomLevel;
+	key.nCellX = pCell->nCellX;
+	key.nCellY = pCell->nCellY;
+
+	maprastercacheentry_t* pEntry = g_hash_table_lookup(pCache->pEntriesTable, &key);
+	if(pEntry == NULL) return NULL;
+
+	if(pEntry->fScaleX != pRenderMetrics->fScaleX || pEntry->fScaleY != pRenderMetrics->fScaleY) {
+		// the window was resized, so the grid moved a little
+		map_rastercache_remove(pCache, pEntry);
+		return NULL;
+	}
+
+	// move to the front
+	g_queue_unlink(pCache->pLRUQueue, pEntry->pLink);
+	g_queue_push_head_link(pCache->pLRUQueue, pEntry->pLink);
+	return cairo_surface_reference(pEntry->pSurface);
+}
+
+// Keeps a reference to pSurface (a RASTER_CELL_SIZE square ARGB32 image), dropping the least recently used cells if we're over budget
+void map_rastercache_add(maprastercache_t* pCache, const rendermetrics_t* pRenderMetrics, const maprastercell_t* pCell, cairo_surface_t* pSurface)
+{
+	g_assert(pCache != NULL);
+	g_assert(pSurface != NULL);
+
+	maprastercacheentry_t* pEntry = g_new0(maprastercacheentry_t, 1);
+	pEntry->nZoomLevel = pRenderMetrics->nZoomLevel;
+	pEntry->nCellX = pCell->nCellX;
+	pEntry->nCellY = pCell->nCellY;
+
+	maprastercacheentry_t* pOld = g_hash_table_lookup(pCache->pEntriesTable, pEntry);
+	if(pOld != NULL) {
+		map_rastercache_remove(pCache, pOld);
+	}
+
+	pEntry->fScaleX = pRenderMetrics->fScaleX;
+	pEntry->fScaleY = pRenderMetrics->fScaleY;
+	pEntry->pSurface = cairo_surface_reference(pSurface);
+	g_queue_push_head(pCache->pLRUQueue, pEntry);
+	pEntry->pLink = g_queue_peek_head_link(pCache->pLRUQueue);
+	g_hash_table_insert(pCache->pEntriesTable, pEntry, pEntry);
+	pCache->nBytes += RASTER_CELL_BYTES;
+
+	while(pCache->nBytes > pCache->nBudgetBytes && g_queue_get_length(pCache->pLRUQueue) > 1) {
+		map_rastercache_remove(pCache, g_queue_peek_tail(pCache->pLRUQueue));
+	}
+}
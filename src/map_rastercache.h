@@ -0,0 +1,52 @@
+/***************************************************************************
+ *            map_rastercache.h
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _MAP_RASTERCACHE_H_
+#define _MAP_RASTERCACHE_H_
+
+#include <glib.h>
+#include <cairo.h>
+#include "map.h"
+
+#define RASTER_CELL_SIZE				(256)	// in pixels, cells are square
+#define RASTER_CELL_MARGIN_IN_PIXELS	(32)	// objects this close to a cell are drawn into it, so wide lines aren't cut at its edges
+
+// One cell of the pixel grid at a zoom level.  The grid is fixed to the world, not the window, so cells line up from frame to frame.
+typedef struct {
+	gint32 nCellX;
+	gint32 nCellY;
+	gint nLeft;					// where the cell's top-left corner is in the window this frame
+	gint nTop;
+	maprect_t rcWorld;			// what to draw into it: the cell, plus RASTER_CELL_MARGIN_IN_PIXELS all around
+} maprastercell_t;
+
+maprastercache_t* map_rastercache_new(gint nBudgetBytes);
+void map_rastercache_clear(maprastercache_t* pCache);
+
+void map_rastercache_get_visible_cells(const rendermetrics_t* pRenderMetrics, GArray* pCellsArray);
+void map_rastercache_get_cells_worldrect(const rendermetrics_t* pRenderMetrics, maprect_t* pReturnRect);
+
+cairo_surface_t* map_rastercache_lookup(maprastercache_t* pCache, const rendermetrics_t* pRenderMetrics, const maprastercell_t* pCell);
+void map_rastercache_add(maprastercache_t* pCache, const rendermetrics_t* pRenderMetrics, const maprastercell_t* pCell, cairo_surface_t* pSurface);
+
+#endif
@@ -30,6 +30,8 @@
 #include "main.h"
 #include "glyph.h"
 #include "map_style.h"
+#include "map_labelcache.h"
+#include "map_rastercache.h"
 #include "util.h"
 
 #define MIN_STYLE_LEVEL (1)
@@ -77,6 +79,11 @@ void map_style_load(map_t* pMap, const gchar* pszFileName)
 
 	pMap->pLayersArray = g_ptr_array_new();
 	map_style_load_from_file(pMap, pszFileName);
+
+	// geometry drawn and labels placed with the old style
+	map_rastercache_clear(pMap->pRasterCache);
+	map_labelcache_clear(pMap->pLabelCache);
+	pMap->pLastFrameTarget = NULL;
 }
 
 static maplayer_t* map_style_new_layer()
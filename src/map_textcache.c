@@ -0,0 +1,156 @@
+/***************************************************************************
+ *            map_textcache.c
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+Purpose of map_textcache.c:
+ - Keep label text measured between frames: the same road names are measured every frame, and the multi-segment
+   labeller measures every prefix of a name to see how much of it fits on each segment
+ - Entries are keyed by the string, font family, font size and boldness.  The caller selects that font on
+   its cairo_t before the lookup, and it's used to measure a string the first time we see it
+ - With cairo 1.8 or later the glyphs are kept too, so drawing a label (nine times, with its halo) doesn't
+   turn the string into glyphs again
+ - When it's full the cache is simply emptied; the labels on screen are measured again in the next frame
+ - Labels are only drawn on the thread that calls map_draw, so there's no locking
+*/
+
+#include <string.h>
+#include <gtk/gtk.h>
+
+#include "map.h"
+#include "map_textcache.h"
+
+#if defined(CAIRO_VERSION_ENCODE) && (CAIRO_VERSION >= CAIRO_VERSION_ENCODE(1,8,0))
+#define HAVE_CAIRO_TEXT_TO_GLYPHS	// cairo_scaled_font_text_to_glyphs
+#endif
+
+struct maptextcache {
+	GHashTable* pEntriesTable;	// maptext_t, keyed by itself
+	gint nMaxEntries;
+};
+
+static guint map_textcache_entry_hash(gconstpointer pKey)
+{
+	const maptext_t* pText = pKey;
+	return g_str_hash(pText->pszText) ^ (g_str_hash(pText->pszFontFamily) * 31U) ^ ((guint)(pText->fFontSize * 64.0) * 83492791U) ^ (pText->bBold ? 0x9e3779b9U : 0U);
+}
+
+static gboolean map_textcache_entry_equal(gconstpointer pA, gconstpointer pB)
+{
+	const maptext_t* pTextA = pA;
+	const maptext_t* pTextB = pB;
+	return (pTextA->fFontSize == pTextB->fFontSize && pTextA->bBold == pTextB->bBold &&
+			strcmp(pTextA->pszText, pTextB->pszText) == 0 && strcmp(pTextA->pszFontFamily, pTextB->pszFontFamily) == 0);
+}
+
+static void map_textcache_entry_free(gpointer pData)
+{
+	maptext_t* pText = pData;
+#ifdef HAVE_CAIRO_TEXT_TO_GLYPHS
+	if(pText->aGlyphs != NULL) cairo_glyph_free(pText->aGlyphs);
+#endif
+	g_free(pText->pszText);
+	g_free(pText->pszFontFamily);
+	g_free(pText);
+}
+
+maptextcache_t* map_textcache_new(gint nMaxEntries)
+{
+	maptextcache_t* pNew = g_new0(maptextcache_t, 1);
+	pNew->pEntriesTable = g_hash_table_new_full(map_textcache_entry_hash, map_textcache_entry_equal, NULL, map_textcache_entry_free);
+	pNew->nMaxEntries = nMaxEntries;
+	return pNew;
+}
+
+static gboolean map_textcache_clear_callback(gpointer pKey, gpointer pValue, gpointer pUserData)
+{
+	return TRUE;	// remove it
+}
+
+void map_textcache_clear(maptextcache_t* pCache)
+{
+	g_assert(pCache != NULL);
+	g_hash_table_foreach_remove(pCache->pEntriesTable, map_textcache_clear_callback, NULL);
+}
+
+// Measure (and shape) pszText in the font currently selected on pCairo
+static void map_textcache_measure(cairo_t* pCairo, maptext_t* pText)
+{
+#ifdef HAVE_CAIRO_TEXT_TO_GLYPHS
+	cairo_scaled_font_t* pScaledFont = cairo_get_scaled_font(pCairo);
+	if(cairo_scaled_font_text_to_glyphs(pScaledFont, 0.0, 0.0, pText->pszText, -1, &(pText->aGlyphs), &(pText->nNumGlyphs), NULL, NULL, NULL) == CAIRO_STATUS_SUCCESS) {
+		cairo_scaled_font_glyph_extents(pScaledFont, pText->aGlyphs, pText->nNumGlyphs, &(pText->Extents));
+		return;
+	}
+	// not valid UTF-8 (the multi-segment labeller cuts strings at any byte), so leave it to cairo_show_text
+	pText->aGlyphs = NULL;
+	pText->nNumGlyphs = 0;
+#endif
+	cairo_text_extents(pCairo, pText->pszText, &(pText->Extents));
+}
+
+// The caller must have selected pszFontFamily at fFontSize (bold or not) on pCairo.  The returned text belongs
+// to the cache and is good until the next lookup (which may empty it).
+const maptext_t* map_textcache_lookup(maptextcache_t* pCache, cairo_t* pCairo, const gchar* pszFontFamily, gdouble fFontSize, gboolean bBold, const gchar* pszText)
+{
+	g_assert(pCache != NULL);
+	g_assert(pszText != NULL);
+
+	maptext_t key;
+	key.pszText = (gchar*)pszText;
+	key.pszFontFamily = (gchar*)pszFontFamily;
+	key.fFontSize = fFontSize;
+	key.bBold = bBold;
+
+	maptext_t* pText = g_hash_table_lookup(pCache->pEntriesTable, &key);
+	if(pText != NULL) return pText;
+
+	if(g_hash_table_size(pCache->pEntriesTable) >= pCache->nMaxEntries) {
+		map_textcache_clear(pCache);
+	}
+
+	pText = g_new0(maptext_t, 1);
+	pText->pszText = g_strdup(pszText);
+	pText->pszFontFamily = g_strdup(pszFontFamily);
+	pText->fFontSize = fFontSize;
+	pText->bBold = bBold;
+	map_textcache_measure(pCairo, pText);
+
+	g_hash_table_insert(pCache->pEntriesTable, pText, pText);
+	return pText;
+}
+
+// Draw the text with its origin (left end of the baseline) at fX,fY, turned by fAngleInRadians around that point
+void map_textcache_draw(cairo_t* pCairo, const maptext_t* pText, gdouble fX, gdouble fY, gdouble fAngleInRadians)
+{
+	cairo_save(pCairo);
+	cairo_translate(pCairo, fX, fY);
+	cairo_rotate(pCairo, fAngleInRadians);
+	if(pText->aGlyphs != NULL) {
+		cairo_show_glyphs(pCairo, pText->aGlyphs, pText->nNumGlyphs);
+	}
+	else {
+		cairo_move_to(pCairo, 0.0, 0.0);
+		cairo_show_text(pCairo, pText->pszText);
+	}
+	cairo_restore(pCairo);
+}
@@ -0,0 +1,49 @@
+/***************************************************************************
+ *            map_textcache.h
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _MAP_TEXTCACHE_H_
+#define _MAP_TEXTCACHE_H_
+
+#include <glib.h>
+#include <cairo.h>
+#include "map.h"
+
+// One string measured (and shaped, with cairo 1.8 or later) in one font
+typedef struct {
+	gchar* pszText;
+	gchar* pszFontFamily;
+	gdouble fFontSize;
+	gboolean bBold;
+
+	cairo_text_extents_t Extents;
+	cairo_glyph_t* aGlyphs;		// positioned from (0,0), or NULL if we can't shape text here (draw pszText instead)
+	gint nNumGlyphs;
+} maptext_t;
+
+maptextcache_t* map_textcache_new(gint nMaxEntries);
+void map_textcache_clear(maptextcache_t* pCache);
+
+const maptext_t* map_textcache_lookup(maptextcache_t* pCache, cairo_t* pCairo, const gchar* pszFontFamily, gdouble fFontSize, gboolean bBold, const gchar* pszText);
+void map_textcache_draw(cairo_t* pCairo, const maptext_t* pText, gdouble fX, gdouble fY, gdouble fAngleInRadians);
+
+#endif
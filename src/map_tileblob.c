@@ -0,0 +1,155 @@
+/***************************************************************************
+ *            map_tileblob.c
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+Purpose of map_tileblob.c:
+ - The tile grid, shared by the tile manager and the importer
+ - The format of precomputed tiles: the importer appends each object to a blob for every
+   tile it touches (table TileChunk<LOD>), so loading a tile is one keyed read instead of a spatial query
+
+Blob format: records, back to back, in native byte order (like the WKB we read in db.c):
+	header (maptileblob_header_t)
+	name (nNameLength bytes, no nul)
+	points (nNumPoints * mappoint_t)
+*/
+
+#include <string.h>
+#include <math.h>
+#include <gtk/gtk.h>
+
+#include "map.h"
+#include "map_tileblob.h"
+
+const maptilesize_t g_aTileSizeAtLevelOfDetail[MAP_NUM_LEVELS_OF_DETAIL] = {
+	{1000.0, 	70, 	70.0 / 1000.0},
+	{100.0, 	35, 	35.0 / 100.0},
+	{10.0, 		35, 	35.0 / 10.0},
+	{1.0, 		100, 	100.0 / 1.0},
+};
+
+typedef struct {
+	guint8 uTypeID;
+	guint8 uSuffixID;
+	guint16 uNameLength;
+	guint32 uNumPoints;
+	guint16 auAddresses[4];		// left start, left end, right start, right end
+} maptileblob_header_t;
+
+// Which tile (along one axis) holds this latitude or longitude
+gint32 map_tileblob_tile_index(gdouble fDegrees, gint nLOD)
+{
+	g_assert(nLOD >= MAP_LEVEL_OF_DETAIL_BEST && nLOD <= MAP_LEVEL_OF_DETAIL_WORST);
+	return (gint32)floor((fDegrees * g_aTileSizeAtLevelOfDetail[nLOD].fShift) / (gdouble)g_aTileSizeAtLevelOfDetail[nLOD].nModulus);
+}
+
+void map_tileblob_tile_rect(gint nLOD, gint32 nTileX, gint32 nTileY, maprect_t* pReturnRect)
+{
+	g_assert(nLOD >= MAP_LEVEL_OF_DETAIL_BEST && nLOD <= MAP_LEVEL_OF_DETAIL_WORST);
+	gdouble fShift = g_aTileSizeAtLevelOfDetail[nLOD].fShift;
+	gint nModulus = g_aTileSizeAtLevelOfDetail[nLOD].nModulus;
+
+	pReturnRect->A.fLatitude = (gdouble)(nTileY * nModulus) / fShift;
+	pReturnRect->A.fLongitude = (gdouble)(nTileX * nModulus) / fShift;
+	pReturnRect->B.fLatitude = (gdouble)((nTileY+1) * nModulus) / fShift;
+	pReturnRect->B.fLongitude = (gdouble)((nTileX+1) * nModulus) / fShift;
+}
+
+gboolean map_object_type_is_polygon(gint nType)
+{
+	// XXX: do this more robustly
+	return (nType == MAP_OBJECT_TYPE_PARK ||
+			nType == MAP_OBJECT_TYPE_LAKE ||
+			nType == MAP_OBJECT_TYPE_MISC_AREA ||
+			nType == MAP_OBJECT_TYPE_URBAN_AREA);
+}
+
+void map_tileblob_append_record(GByteArray* pBlob, gint nTypeID, const gchar* pszName, gint nSuffixID, gint nAddressLeftStart, gint nAddressLeftEnd, gint nAddressRightStart, gint nAddressRightEnd, const GArray* pPointsArray)
+{
+	g_assert(pBlob != NULL);
+	g_assert(pPointsArray != NULL);
+	g_assert(sizeof(mappoint_t) == 2 * sizeof(gdouble));	// we copy the points straight in
+
+	if(pszName == NULL) pszName = "";
+
+	maptileblob_header_t header;
+	memset(&header, 0, sizeof(header));
+	header.uTypeID = nTypeID;
+	header.uSuffixID = nSuffixID;
+	header.uNameLength = MIN(strlen(pszName), G_MAXUINT16);
+	header.uNumPoints = pPointsArray->len;
+	header.auAddresses[0] = nAddressLeftStart;		// NOTE: Road0 stores these as INT2 too
+	header.auAddresses[1] = nAddressLeftEnd;
+	header.auAddresses[2] = nAddressRightStart;
+	header.auAddresses[3] = nAddressRightEnd;
+
+	g_byte_array_append(pBlob, (const guint8*)&header, sizeof(header));
+	g_byte_array_append(pBlob, (const guint8*)pszName, header.uNameLength);
+	g_byte_array_append(pBlob, (const guint8*)pPointsArray->data, pPointsArray->len * sizeof(mappoint_t));
+}
+
+// Reads the record at *ppData and advances *ppData past it.  Returns FALSE at the end of the blob.
+gboolean map_tileblob_read_record(const guint8** ppData, const guint8* pEnd, maptileblob_record_t* pReturnRecord)
+{
+	const guint8* p = *ppData;
+	if(p >= pEnd) return FALSE;
+
+	if((pEnd - p) < sizeof(maptileblob_header_t)) {
+		g_warning("truncated tile blob (%d bytes left)\n", (gint)(pEnd - p));
+		return FALSE;
+	}
+
+	maptileblob_header_t header;
+	memcpy(&header, p, sizeof(header));	// may be unaligned
+	p += sizeof(header);
+
+	gsize uPointBytes = header.uNumPoints * sizeof(mappoint_t);
+	if((pEnd - p) < (header.uNameLength + uPointBytes)) {
+		g_warning("truncated tile blob record (%d points)\n", header.uNumPoints);
+		return FALSE;
+	}
+
+	pReturnRecord->nTypeID = header.uTypeID;
+	pReturnRecord->nSuffixID = header.uSuffixID;
+	pReturnRecord->nAddressLeftStart = header.auAddresses[0];
+	pReturnRecord->nAddressLeftEnd = header.auAddresses[1];
+	pReturnRecord->nAddressRightStart = header.auAddresses[2];
+	pReturnRecord->nAddressRightEnd = header.auAddresses[3];
+
+	pReturnRecord->pchName = (const gchar*)p;
+	pReturnRecord->nNameLength = header.uNameLength;
+	p += header.uNameLength;
+
+	pReturnRecord->nNumPoints = header.uNumPoints;
+	pReturnRecord->pPoints = p;
+	p += uPointBytes;
+
+	*ppData = p;
+	return TRUE;
+}
+
+// Replaces the contents of pMapPointsArray with the record's points
+void map_tileblob_record_get_points(const maptileblob_record_t* pRecord, GArray* pMapPointsArray)
+{
+	g_array_set_size(pMapPointsArray, pRecord->nNumPoints);
+	memcpy(pMapPointsArray->data, pRecord->pPoints, pRecord->nNumPoints * sizeof(mappoint_t));
+}
@@ -0,0 +1,65 @@
+/***************************************************************************
+ *            map_tileblob.h
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _MAP_TILEBLOB_H_
+#define _MAP_TILEBLOB_H_
+
+#include <glib.h>
+#include "map.h"
+
+// The tile grid.  Tile (nTileX, nTileY) at a LOD covers longitudes [nTileX * fWidth, (nTileX+1) * fWidth)
+// and latitudes [nTileY * fWidth, (nTileY+1) * fWidth).
+typedef struct {
+	gdouble fShift;					// the units we care about (eg. 1000 = 1000ths of a degree)
+	gint nModulus;					// how many of the above units each tile is on a side
+	gdouble fWidth;					// width and height of a tile, in degrees
+} maptilesize_t;
+
+extern const maptilesize_t g_aTileSizeAtLevelOfDetail[MAP_NUM_LEVELS_OF_DETAIL];
+
+gint32 map_tileblob_tile_index(gdouble fDegrees, gint nLOD);
+void map_tileblob_tile_rect(gint nLOD, gint32 nTileX, gint32 nTileY, maprect_t* pReturnRect);
+
+gboolean map_object_type_is_polygon(gint nType);
+
+// One map object in a tile blob, as returned by map_tileblob_read_record().  Pointers point into the blob.
+typedef struct {
+	gint nTypeID;
+	gint nSuffixID;
+	const gchar* pchName;		// NOT nul-terminated
+	gint nNameLength;
+
+	gint nAddressLeftStart;		// LOD 0 only (0 elsewhere)
+	gint nAddressLeftEnd;
+	gint nAddressRightStart;
+	gint nAddressRightEnd;
+
+	gint nNumPoints;
+	const guint8* pPoints;		// nNumPoints mappoint_t's, possibly unaligned
+} maptileblob_record_t;
+
+void map_tileblob_append_record(GByteArray* pBlob, gint nTypeID, const gchar* pszName, gint nSuffixID, gint nAddressLeftStart, gint nAddressLeftEnd, gint nAddressRightStart, gint nAddressRightEnd, const GArray* pPointsArray);
+gboolean map_tileblob_read_record(const guint8** ppData, const guint8* pEnd, maptileblob_record_t* pReturnRecord);
+void map_tileblob_record_get_points(const maptileblob_record_t* pRecord, GArray* pMapPointsArray);
+
+#endif
@@ -27,33 +27,32 @@ Purpose of map_tilemanager.c:
  - Cache tiles
 */
 
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
 #include <gtk/gtk.h>
 #include <stdlib.h>
+#include <math.h>
 #include <string.h>
 #include "util.h"
 #include "map_tilemanager.h"
 #include "map_math.h"
+#include "map_tileblob.h"
 #include "db.h"
 #include "road.h"
 
 #define ENABLE_ADD_FINAL_POLYGON_POINT
 #define ENABLE_RUN_TIME_ROAD_STITCHING
+#define ENABLE_RUNTIME_SIMPLIFICATION	// drop detail finer than a pixel before drawing (see map_tilemanager_tile_get_simplified)
+
+#define SIMPLIFY_TOLERANCE_IN_PIXELS	(0.5)
 
 // Prototypes
 static void _map_tilemanager_tile_load_map_objects(maptile_t* pTile, maprect_t* pRect, gint nLOD);
+static gboolean _map_tilemanager_tile_load_map_objects_from_blob(maptile_t* pTile, gint nLOD, gint32 nTileX, gint32 nTileY);
 static maptile_t* map_tilemanager_tile_cache_lookup(maptilemanager_t* pTileManager, maprect_t* pRect, gint nLOD);
-static maptile_t* map_tilemanager_tile_new(maptilemanager_t* pTileManager, maprect_t* pRect, gint nLOD);
-
-struct {
-	gdouble fShift;					// the units we care about (eg. 1000 = 1000ths of a degree)
-	gint nModulus;					// how many of the above units each tile is on a side
-	gdouble fWidth;					// width and height of a tile, in degrees
-} g_aTileSizeAtLevelOfDetail[MAP_NUM_LEVELS_OF_DETAIL] = {
-	{1000.0, 	70, 	70.0 / 1000.0},
-	{100.0, 	35, 	35.0 / 100.0},
-	{10.0, 		35, 	35.0 / 10.0},
-	{1.0, 		100, 	100.0 / 1.0},
-};
+static maptile_t* map_tilemanager_tile_new(maptilemanager_t* pTileManager, maprect_t* pRect, gint nLOD, gint32 nTileX, gint32 nTileY);
 
 // Public API
 maptilemanager_t* map_tilemanager_new()
@@ -154,7 +153,10 @@ GPtrArray* map_tilemanager_load_tiles_for_worldrect(maptilemanager_t* pTileManag
 			}
 			else {
 				// cache miss
-				pTile = map_tilemanager_tile_new(pTileManager, &rect, nLOD);
+				// nLatStart and nLonStart are multiples of nTileModulus, so these are exact
+				gint32 nTileX = (nLonStart / nTileModulus) + nLon;
+				gint32 nTileY = (nLatStart / nTileModulus) + nLat;
+				pTile = map_tilemanager_tile_new(pTileManager, &rect, nLOD, nTileX, nTileY);
 				g_ptr_array_add(pTileArray, pTile);
 			}
 		}
@@ -167,10 +169,94 @@ void map_tilemanager_free_tile_list(maptilemanager_t* pTileManager, GPtrArray* p
 	g_ptr_array_free(pTiles, TRUE);
 }
 
+// Append the points of pMapPointsArray that land in a different pixel than the last one kept, on a pixel grid fixed to the
+// world (so the result doesn't change as the map scrolls).  The first and last points are always kept.
+static void map_tilemanager_append_pixel_snapped(const GArray* pMapPointsArray, gdouble fDegreesPerPixel, GArray* pOutput)
+{
+	gint64 nLastCellX = 0;
+	gint64 nLastCellY = 0;
+
+	gint i;
+	for(i=0 ; i<pMapPointsArray->len ; i++) {
+		const mappoint_t* pPoint = &g_array_index(pMapPointsArray, mappoint_t, i);
+		gint64 nCellX = (gint64)floor(pPoint->fLongitude / fDegreesPerPixel);
+		gint64 nCellY = (gint64)floor(pPoint->fLatitude / fDegreesPerPixel);
+
+		if(i == 0 || i == (pMapPointsArray->len - 1) || nCellX != nLastCellX || nCellY != nLastCellY) {
+			g_array_append_val(pOutput, *pPoint);
+			nLastCellX = nCellX;
+			nLastCellY = nCellY;
+		}
+	}
+}
+
+static void map_tilemanager_simplified_free(maptilesimplified_t* pSimplified)
+{
+	g_array_free(pSimplified->pPointsArray, TRUE);
+	g_array_free(pSimplified->pFirstPointArray, TRUE);
+	g_free(pSimplified);
+}
+
+// The tile's objects of one type with detail finer than SIMPLIFY_TOLERANCE_IN_PIXELS removed: points that share a pixel
+// are merged, then Douglas-Peucker runs on what's left.  This only depends on the zoom level, not on where the map is
+// scrolled to, so it's done the first time the tile is drawn at a zoom level and kept with the tile until it's drawn
+// at another one.  (Keeping every zoom level would grow each cached tile by a copy of its points per level visited.)
+const maptilesimplified_t* map_tilemanager_tile_get_simplified(maptile_t* pTile, gint nObjectType, gint nZoomLevel)
+{
+	g_assert(nObjectType >= 0 && nObjectType <= MAP_NUM_OBJECT_TYPES);
+	g_assert(nZoomLevel >= MIN_ZOOM_LEVEL && nZoomLevel <= MAX_ZOOM_LEVEL);
+
+	maptilesimplified_t* pSimplified = pTile->apSimplified[nObjectType][nZoomLevel-1];
+	if(pSimplified != NULL) {
+		return pSimplified;
+	}
+
+	// NOTE: a frame draws at one zoom level (and the cell jobs don't call this), so nothing still points into these
+	gint iZoomLevel;
+	for(iZoomLevel=0 ; iZoomLevel<NUM_ZOOM_LEVELS ; iZoomLevel++) {
+		if(pTile->apSimplified[nObjectType][iZoomLevel] != NULL) {
+			map_tilemanager_simplified_free(pTile->apSimplified[nObjectType][iZoomLevel]);
+			pTile->apSimplified[nObjectType][iZoomLevel] = NULL;
+		}
+	}
+
+	pSimplified = g_new0(maptilesimplified_t, 1);
+	pSimplified->pPointsArray = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+	pSimplified->pFirstPointArray = g_array_new(FALSE, FALSE, sizeof(gint));
+
+	GPtrArray* pRoadsArray = pTile->apMapObjectArrays[nObjectType];
+	if(pRoadsArray != NULL) {
+		gdouble fDegreesPerPixel = map_math_pixels_to_degrees_at_scale(1, g_sZoomLevels[nZoomLevel-1].uScale);
+		GArray* pSnappedArray = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+
+		gint i;
+		for(i=0 ; i<pRoadsArray->len ; i++) {
+			road_t* pRoad = g_ptr_array_index(pRoadsArray, i);
+
+			gint nFirstPoint = pSimplified->pPointsArray->len;
+			g_array_append_val(pSimplified->pFirstPointArray, nFirstPoint);
+
+#ifdef ENABLE_RUNTIME_SIMPLIFICATION
+			g_array_set_size(pSnappedArray, 0);
+			map_tilemanager_append_pixel_snapped(pRoad->pMapPointsArray, fDegreesPerPixel, pSnappedArray);
+			map_math_simplify_pointstring(pSnappedArray, fDegreesPerPixel * SIMPLIFY_TOLERANCE_IN_PIXELS, pSimplified->pPointsArray);
+#else
+			g_array_append_vals(pSimplified->pPointsArray, pRoad->pMapPointsArray->data, pRoad->pMapPointsArray->len);
+#endif
+		}
+		g_array_free(pSnappedArray, TRUE);
+	}
+	gint nEnd = pSimplified->pPointsArray->len;
+	g_array_append_val(pSimplified->pFirstPointArray, nEnd);
+
+	pTile->apSimplified[nObjectType][nZoomLevel-1] = pSimplified;
+	return pSimplified;
+}
+
 //
 // Private
 //
-static maptile_t* map_tilemanager_tile_new(maptilemanager_t* pTileManager, maprect_t* pRect, gint nLOD)
+static maptile_t* map_tilemanager_tile_new(maptilemanager_t* pTileManager, maprect_t* pRect, gint nLOD, gint32 nTileX, gint32 nTileY)
 {
 	//g_print("New tile for (%f,%f),(%f,%f)\n", pRect->A.fLongitude, pRect->A.fLatitude, pRect->B.fLongitude, pRect->B.fLatitude);
 
@@ -183,7 +269,15 @@ static maptile_t* map_tilemanager_tile_new(maptilemanager_t* pTileManager, mapre
 		pNewTile->apMapObjectArrays[i] = g_ptr_array_new();
 	}
 //	g_print("(");
+#ifdef ENABLE_TILE_BLOBS
+	// load the importer's precomputed tile (see map_tileblob.c).  A tile with nothing in its blob may still
+	// have Road rows from a DB imported before we had tiles, so ask the Road tables unless the importer marked it empty.
+	if(!_map_tilemanager_tile_load_map_objects_from_blob(pNewTile, nLOD, nTileX, nTileY) && !db_tile_is_empty(nLOD, nTileX, nTileY)) {
+		_map_tilemanager_tile_load_map_objects(pNewTile, pRect, nLOD);
+	}
+#else
 	_map_tilemanager_tile_load_map_objects(pNewTile, pRect, nLOD);
+#endif
 //	_map_tilemanager_tile_load_locations(pNewTile, pRect);
 //	g_print(")");
 
@@ -213,13 +307,84 @@ static maptile_t* map_tilemanager_tile_cache_lookup(maptilemanager_t* pTileManag
 	return NULL;
 }
 
-gboolean map_object_type_is_polygon(gint nType)
+static gboolean _map_tilemanager_tile_load_map_objects_from_blob(maptile_t* pTile, gint nLOD, gint32 nTileX, gint32 nTileY)
 {
-	// XXX: do this more robustly
-	return (nType == MAP_OBJECT_TYPE_PARK || 
-			nType == MAP_OBJECT_TYPE_LAKE ||
-			nType == MAP_OBJECT_TYPE_MISC_AREA || 
-			nType == MAP_OBJECT_TYPE_URBAN_AREA);
+	GByteArray* pBlob = g_byte_array_new();
+	if(!db_tile_load(nLOD, nTileX, nTileY, pBlob)) {
+		g_byte_array_free(pBlob, TRUE);
+		return FALSE;
+	}
+
+	road_t* pPreviousRoad = NULL;
+	gint nPreviousRoadTypeID = 0;
+
+	const guint8* pData = pBlob->data;
+	const guint8* pEnd = pBlob->data + pBlob->len;
+	maptileblob_record_t record;
+	while(map_tileblob_read_record(&pData, pEnd, &record)) {
+		gint nTypeID = record.nTypeID;
+		if(nTypeID < MAP_OBJECT_TYPE_FIRST || nTypeID > MAP_OBJECT_TYPE_LAST) {
+			g_warning("tile blob record has bad type '%d'\n", nTypeID);
+			continue;
+		}
+
+		GArray* pPointsArray = g_array_sized_new(FALSE, FALSE, sizeof(mappoint_t), record.nNumPoints + 1);	// +1 for the final polygon point
+		map_tileblob_record_get_points(&record, pPointsArray);
+
+		maprect_t rcBoundingBox;
+		map_util_calculate_bounding_box(pPointsArray, &rcBoundingBox);
+
+		// Build name by adding suffix, if one is present
+		gchar* pszName;
+		if(record.nNameLength > 0) {
+			gchar* pszBaseName = g_strndup(record.pchName, record.nNameLength);
+			const gchar* pszSuffix = road_suffix_itoa(record.nSuffixID, ROAD_SUFFIX_LENGTH_SHORT);
+			pszName = g_strdup_printf("%s%s%s", pszBaseName, (pszSuffix[0] != '\0') ? " " : "", pszSuffix);
+			g_free(pszBaseName);
+		}
+		else {
+			pszName = g_strdup("");
+		}
+
+#ifdef ENABLE_RUN_TIME_ROAD_STITCHING
+		// Check if we can stitch this road segment onto previous road (the importer writes a road's pieces together)
+		if(pPreviousRoad != NULL && nTypeID == nPreviousRoadTypeID && !map_object_type_is_polygon(nTypeID) && strcmp(pszName, pPreviousRoad->pszName) == 0) {
+			if(map_math_try_connect_linestrings(pPreviousRoad->pMapPointsArray, pPointsArray)) {
+				map_util_bounding_box_union(&(pPreviousRoad->rWorldBoundingBox), &(rcBoundingBox));
+
+				g_array_free(pPointsArray, TRUE);
+				g_free(pszName);
+				continue;
+			}
+		}
+#endif
+		road_t* pNewRoad = g_new0(road_t, 1);
+		g_assert(pNewRoad);
+
+		pNewRoad->pMapPointsArray = pPointsArray;
+		pNewRoad->rWorldBoundingBox = rcBoundingBox;
+		pNewRoad->pszName = pszName;
+
+		if(nLOD == MAP_LEVEL_OF_DETAIL_BEST) {
+			pNewRoad->nAddressLeftStart = record.nAddressLeftStart;
+			pNewRoad->nAddressLeftEnd = record.nAddressLeftEnd;
+			pNewRoad->nAddressRightStart = record.nAddressRightStart;
+			pNewRoad->nAddressRightEnd = record.nAddressRightEnd;
+		}
+
+#ifdef ENABLE_ADD_FINAL_POLYGON_POINT
+		if(map_object_type_is_polygon(nTypeID) && pNewRoad->pMapPointsArray->len > 0) {
+			mappoint_t p = g_array_index(pNewRoad->pMapPointsArray, mappoint_t, 0);
+			g_array_append_val(pNewRoad->pMapPointsArray, p);
+		}
+#endif
+		pPreviousRoad = pNewRoad;
+		nPreviousRoadTypeID = nTypeID;
+
+		g_ptr_array_add(pTile->apMapObjectArrays[nTypeID], pNewRoad);
+	}
+	g_byte_array_free(pBlob, TRUE);
+	return TRUE;
 }
 
 static void _map_tilemanager_tile_load_map_objects(maptile_t* pTile, maprect_t* pRect, gint nLOD)
@@ -32,9 +32,17 @@ typedef struct {
 
 #include "map.h"
 
+// One object type of a tile, simplified for drawing at one zoom level (see map_tilemanager_tile_get_simplified)
+typedef struct {
+	GArray* pPointsArray;		// mappoint_t: every object's kept points, back to back, in the tile's order
+	GArray* pFirstPointArray;	// gint: where each object's points start in pPointsArray, plus one past the end
+} maptilesimplified_t;
+
 typedef struct {
 	maprect_t rcWorldBoundingBox;
 	GPtrArray* apMapObjectArrays[ MAP_NUM_OBJECT_TYPES + 1 ];
+
+	maptilesimplified_t* apSimplified[ MAP_NUM_OBJECT_TYPES + 1 ][ NUM_ZOOM_LEVELS ];	// only the zoom level last drawn at is kept (NULL for the others)
 } maptile_t;
 
 maptilemanager_t* map_tilemanager_new();
@@ -43,4 +51,6 @@ maptilemanager_t* map_tilemanager_new();
 GPtrArray* map_tilemanager_load_tiles_for_worldrect(maptilemanager_t* pTileManager, maprect_t* pWorldRect, gint nLOD);
 void map_tilemanager_free_tile_list(maptilemanager_t* pTileManager, GPtrArray* pTiles);
 
+const maptilesimplified_t* map_tilemanager_tile_get_simplified(maptile_t* pTile, gint nObjectType, gint nZoomLevel);
+
 #endif
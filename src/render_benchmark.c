@@ -0,0 +1,307 @@
+/***************************************************************************
+ *            render_benchmark.c
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+Purpose of render_benchmark.c:
+ - render-benchmark: draw a script of viewports from the database to cairo image surfaces, with no window or X server
+ - One tab-separated row per viewport and run: load, geometry and label times, objects and points drawn, labels placed
+ - The same database and script give the same images and counters every time: the raster cache is cleared before
+   each frame, and cells are drawn on this thread unless --threads is given (then only the timings change)
+ - With --layers, one row per style layer drawn instead (see map_get_layer_stats), to see which layers cost the most
+ - The tile cache is kept, so with --runs the first run shows cold loads and the rest warm ones
+ - Try it on a database imported from tiger-generate's output for a dataset that doesn't change between runs
+
+Script format: one viewport per line, '#' starts a comment
+	latitude longitude zoomlevel width height [name]
+*/
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include <cairo.h>
+
+#include "main.h"
+#include "db.h"
+#include "map.h"
+#include "map_labelcache.h"
+#include "map_rastercache.h"
+#include "map_style.h"
+
+#define EXIT_STATUS_SUCCESS			(0)
+#define EXIT_STATUS_RENDER_FAILED	(1)
+#define EXIT_STATUS_USAGE			(2)
+#define EXIT_STATUS_SETUP_FAILED	(3)
+
+#define MAX_VIEWPORT_SIZE			(4096)	// pixels, either way
+#define MAX_VIEWPORT_NAME_LENGTH	(63)
+
+// options
+static gint g_nRuns = 1;
+static gboolean g_bThreads = FALSE;
+static gboolean g_bNoLabels = FALSE;
+static gboolean g_bLayers = FALSE;
+static gchar* g_pszPNGDirectory = NULL;
+static gchar* g_pszStyleFile = "layers.xml";
+static gboolean g_bVerbose = FALSE;
+
+static GOptionEntry g_aOptions[] = {
+	{"runs", 'n', 0, G_OPTION_ARG_INT, &g_nRuns, "Draw every viewport this many times (default 1)", "N"},
+	{"threads", 't', 0, G_OPTION_ARG_NONE, &g_bThreads, "Draw the raster cells on worker threads, like roadster does", NULL},
+	{"no-labels", 0, 0, G_OPTION_ARG_NONE, &g_bNoLabels, "Draw only the geometry layers", NULL},
+	{"layers", 0, 0, G_OPTION_ARG_NONE, &g_bLayers, "Print a row for each style layer instead of each viewport", NULL},
+	{"png-dir", 0, 0, G_OPTION_ARG_FILENAME, &g_pszPNGDirectory, "Write each viewport (from the first run) to DIR/name.png", "DIR"},
+	{"style", 0, 0, G_OPTION_ARG_STRING, &g_pszStyleFile, "Style file in the data directory (default layers.xml)", "FILE"},
+	{"verbose", 'v', 0, G_OPTION_ARG_NONE, &g_bVerbose, "Show the map's own messages (on stderr)", NULL},
+	{NULL}
+};
+
+typedef struct render_benchmark_viewport {
+	mappoint_t Center;
+	gint nZoomLevel;
+	gint nWidth;
+	gint nHeight;
+	gchar szName[MAX_VIEWPORT_NAME_LENGTH+1];
+} render_benchmark_viewport_t;
+
+static void render_benchmark_print_handler(const gchar* pszString)
+{
+	if(g_bVerbose) {
+		fputs(pszString, stderr);
+	}
+}
+
+// Read the viewport script into an array of render_benchmark_viewport_t.  Returns NULL (after saying why) if it's bad.
+static GArray* render_benchmark_load_script(const gchar* pszFileName)
+{
+	gchar* pszContents = NULL;
+	GError* pError = NULL;
+	if(!g_file_get_contents(pszFileName, &pszContents, NULL, &pError)) {
+		fprintf(stderr, "%s: %s\n", g_get_prgname(), pError->message);
+		g_error_free(pError);
+		return NULL;
+	}
+
+	GArray* pViewportsArray = g_array_new(FALSE, FALSE, sizeof(render_benchmark_viewport_t));
+	gchar** apszLines = g_strsplit(pszContents, "\n", -1);
+	gboolean bSuccess = TRUE;
+
+	gint i;
+	for(i=0 ; apszLines[i] != NULL ; i++) {
+		gchar* pszComment = strchr(apszLines[i], '#');
+		if(pszComment != NULL) *pszComment = '\0';
+		g_strstrip(apszLines[i]);
+		if(apszLines[i][0] == '\0') continue;
+
+		render_benchmark_viewport_t viewport;
+		memset(&viewport, 0, sizeof(viewport));
+		gint nFields = sscanf(apszLines[i], "%lf %lf %d %d %d %63s", &(viewport.Center.fLatitude), &(viewport.Center.fLongitude),
+							  &(viewport.nZoomLevel), &(viewport.nWidth), &(viewport.nHeight), viewport.szName);
+		if(nFields < 5 ||
+		   viewport.nZoomLevel < MIN_ZOOM_LEVEL || viewport.nZoomLevel > MAX_ZOOM_LEVEL ||
+		   viewport.nWidth < 1 || viewport.nWidth > MAX_VIEWPORT_SIZE || viewport.nHeight < 1 || viewport.nHeight > MAX_VIEWPORT_SIZE)
+		{
+			fprintf(stderr, "%s: %s:%d: expected 'latitude longitude zoomlevel width height [name]' with zoomlevel %d-%d and sizes up to %d\n",
+					g_get_prgname(), pszFileName, i+1, MIN_ZOOM_LEVEL, MAX_ZOOM_LEVEL, MAX_VIEWPORT_SIZE);
+			bSuccess = FALSE;
+			break;
+		}
+		if(nFields == 5) {
+			g_snprintf(viewport.szName, sizeof(viewport.szName), "viewport%d", pViewportsArray->len + 1);
+		}
+		g_array_append_val(pViewportsArray, viewport);
+	}
+	g_strfreev(apszLines);
+	g_free(pszContents);
+
+	if(bSuccess && pViewportsArray->len == 0) {
+		fprintf(stderr, "%s: %s: no viewports\n", g_get_prgname(), pszFileName);
+		bSuccess = FALSE;
+	}
+	if(!bSuccess) {
+		g_array_free(pViewportsArray, TRUE);
+		return NULL;
+	}
+	return pViewportsArray;
+}
+
+// One row for each style layer drawn in the last frame, in drawing order
+static void render_benchmark_print_layers(const map_t* pMap, gint nRun, const render_benchmark_viewport_t* pViewport)
+{
+	gint i;
+	for(i=pMap->pLayersArray->len-1 ; i>=0 ; i--) {
+		maplayer_t* pLayer = g_ptr_array_index(pMap->pLayersArray, i);
+		const maplayerstats_t* pStats = map_get_layer_stats(pMap, i);
+		if(pStats->nObjectsConsidered == 0 && pStats->fSeconds == 0.0) continue;
+
+		fprintf(stdout, "%d\t%s\t%d\t%d\t%s\t%s\t%.6f\t%d\t%d\t%d\t%d\t%d\t%d\n",
+			nRun, pViewport->szName, pViewport->nZoomLevel, i, map_object_type_itoa(pLayer->nDataSource), map_layer_render_type_itoa(pLayer->nDrawType),
+			pStats->fSeconds, pStats->nObjectsConsidered, pStats->nObjectsCulled, pStats->nPointsEmitted, pStats->nClipCalls,
+			pStats->nLabelsAttempted, pStats->nLabelsPlaced);
+	}
+}
+
+// Draw one viewport and print its row (or rows).  Returns FALSE if the PNG couldn't be written.
+static gboolean render_benchmark_viewport(map_t* pMap, gint nRun, const render_benchmark_viewport_t* pViewport)
+{
+	dimensions_t dimensions;
+	dimensions.uWidth = pViewport->nWidth;
+	dimensions.uHeight = pViewport->nHeight;
+	map_set_dimensions(pMap, &dimensions);
+	map_set_centerpoint(pMap, &(pViewport->Center));
+	map_set_zoomlevel(pMap, pViewport->nZoomLevel);
+
+	// every frame draws all of its geometry and places all of its labels (otherwise later viewports would time copying cells and reusing placements)
+	map_rastercache_clear(pMap->pRasterCache);
+	map_labelcache_clear(pMap->pLabelCache);
+
+	cairo_surface_t* pSurface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, pViewport->nWidth, pViewport->nHeight);
+
+	GTimer* pTimer = g_timer_new();
+	map_draw_to_surface(pMap, pSurface, g_bNoLabels ? DRAWFLAG_GEOMETRY : DRAWFLAG_ALL);
+	gdouble fSeconds = g_timer_elapsed(pTimer, NULL);
+	g_timer_destroy(pTimer);
+
+	if(g_bLayers) {
+		render_benchmark_print_layers(pMap, nRun, pViewport);
+	}
+	else {
+		const renderstats_t* pStats = map_get_render_stats(pMap);
+		fprintf(stdout, "%d\t%s\t%f\t%f\t%d\t%d\t%d\t%.6f\t%.6f\t%.6f\t%.6f\t%d\t%d\t%d\t%d\t%d\t%d\n",
+			nRun, pViewport->szName, pViewport->Center.fLatitude, pViewport->Center.fLongitude, pViewport->nZoomLevel, pViewport->nWidth, pViewport->nHeight,
+			pStats->fLoadSeconds, pStats->fGeometrySeconds, pStats->fLabelSeconds, fSeconds,
+			pStats->nObjectsDrawn, pStats->nPointsLoaded, pStats->nPointsEmitted, pStats->nStrokes, pStats->nFills, pStats->nLabelsPlaced);
+	}
+	fflush(stdout);
+
+	gboolean bSuccess = TRUE;
+	if(g_pszPNGDirectory != NULL && nRun == 1) {
+		gchar* pszFileName = g_strdup_printf("%s.png", pViewport->szName);
+		gchar* pszPath = g_build_filename(g_pszPNGDirectory, pszFileName, NULL);
+		cairo_status_t eStatus = cairo_surface_write_to_png(pSurface, pszPath);
+		if(eStatus != CAIRO_STATUS_SUCCESS) {
+			fprintf(stderr, "%s: couldn't write %s: %s\n", g_get_prgname(), pszPath, cairo_status_to_string(eStatus));
+			bSuccess = FALSE;
+		}
+		g_free(pszPath);
+		g_free(pszFileName);
+	}
+	cairo_surface_destroy(pSurface);
+	return bSuccess;
+}
+
+// Same settings as roadster itself.  Only reads, so it doesn't create the tables.
+static gboolean render_benchmark_connect(void)
+{
+	gchar* pszHost = NULL;
+	gchar* pszUser = NULL;
+	gchar* pszPassword = NULL;
+	gchar* pszDatabase = NULL;
+
+	gchar* pszConfigFile = g_strdup_printf("%s/.roadster/roadster.conf", g_get_home_dir());
+	GKeyFile* pKeyFile = g_key_file_new();
+	if(g_key_file_load_from_file(pKeyFile, pszConfigFile, G_KEY_FILE_NONE, NULL)) {
+		pszHost = g_key_file_get_string(pKeyFile, "mysql", "host", NULL);
+		pszUser = g_key_file_get_string(pKeyFile, "mysql", "user", NULL);
+		pszPassword = g_key_file_get_string(pKeyFile, "mysql", "password", NULL);
+		pszDatabase = g_key_file_get_string(pKeyFile, "mysql", "database", NULL);
+	}
+	g_key_file_free(pKeyFile);
+	g_free(pszConfigFile);
+
+	db_init();
+	gboolean bSuccess = db_connect(pszHost, pszUser, pszPassword, pszDatabase);
+	g_free(pszHost);
+	g_free(pszUser);
+	g_free(pszPassword);
+	g_free(pszDatabase);
+	return bSuccess;
+}
+
+int main(int argc, char* argv[])
+{
+	GOptionContext* pContext = g_option_context_new("SCRIPT - time drawing a list of viewports, without a window");
+	g_option_context_add_main_entries(pContext, g_aOptions, NULL);
+	GError* pError = NULL;
+	if(!g_option_context_parse(pContext, &argc, &argv, &pError)) {
+		fprintf(stderr, "%s: %s\n", g_get_prgname(), pError->message);
+		g_error_free(pError);
+		return EXIT_STATUS_USAGE;
+	}
+	g_option_context_free(pContext);
+
+	if(argc != 2 || g_nRuns < 1) {
+		fprintf(stderr, "usage: %s [OPTION...] SCRIPT  (see --help)\n", g_get_prgname());
+		return EXIT_STATUS_USAGE;
+	}
+
+	// without threads, map_draw_cairo draws the cells one after another on this thread
+	if(g_bThreads && !g_thread_supported()) g_thread_init(NULL);
+	g_type_init();
+	g_set_print_handler(render_benchmark_print_handler);
+
+	GArray* pViewportsArray = render_benchmark_load_script(argv[1]);
+	if(pViewportsArray == NULL) {
+		return EXIT_STATUS_USAGE;
+	}
+
+	if(!render_benchmark_connect()) {
+		fprintf(stderr, "%s: couldn't connect to the database\n", g_get_prgname());
+		return EXIT_STATUS_SETUP_FAILED;
+	}
+
+	map_style_init();
+
+	map_t* pMap = NULL;
+	map_new(&pMap, NULL);	// no target widget: we only draw with map_draw_to_surface
+	map_style_load(pMap, g_pszStyleFile);
+	if(pMap->pLayersArray->len == 0) {
+		fprintf(stderr, "%s: couldn't load the style file %s\n", g_get_prgname(), g_pszStyleFile);
+		db_deinit();
+		return EXIT_STATUS_SETUP_FAILED;
+	}
+
+	if(g_bLayers) {
+		fprintf(stdout, "run\tviewport\tzoom\tlayer\tobject_type\trender_type\tseconds\tobjects\tculled\tpoints_emitted\tclip_calls\tlabels_attempted\tlabels_placed\n");
+	}
+	else {
+		fprintf(stdout, "run\tviewport\tlatitude\tlongitude\tzoom\twidth\theight\tload_seconds\tgeometry_seconds\tlabel_seconds\ttotal_seconds\tobjects\tpoints_loaded\tpoints_emitted\tstrokes\tfills\tlabels_placed\n");
+	}
+
+	gint nFailed = 0;
+	gint nRun;
+	for(nRun=1 ; nRun<=g_nRuns ; nRun++) {
+		gint i;
+		for(i=0 ; i<pViewportsArray->len ; i++) {
+			if(!render_benchmark_viewport(pMap, nRun, &g_array_index(pViewportsArray, render_benchmark_viewport_t, i))) nFailed++;
+		}
+	}
+
+	g_array_free(pViewportsArray, TRUE);
+	db_deinit();
+
+	return (nFailed == 0) ? EXIT_STATUS_SUCCESS : EXIT_STATUS_RENDER_FAILED;
+}
@@ -0,0 +1,274 @@
+/***************************************************************************
+ *            roadster_import.c
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+Purpose of roadster_import.c:
+ - roadster-import: import TIGER counties from the command line, without the GUI
+ - For building datasets on headless machines, from scripts, several at once
+ - Exit status: 0 if every county imported, 1 if any failed, 2 for bad arguments, 3 if it couldn't get started
+*/
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "main.h"
+#include "db.h"
+#include "import_scheduler.h"
+#include "import_tiger.h"
+
+#ifdef USE_GNOME_VFS
+#include <gnome-vfs-2.0/libgnomevfs/gnome-vfs.h>
+#endif
+
+#define EXIT_STATUS_SUCCESS			(0)
+#define EXIT_STATUS_IMPORT_FAILED	(1)
+#define EXIT_STATUS_USAGE			(2)
+#define EXIT_STATUS_SETUP_FAILED	(3)
+
+typedef struct roadster_import {
+	gint nTotal;
+	gint nFinished;
+	gint nFailed;
+	gdouble fTotalMegabytes;		// size of the archives, for throughput
+
+	importscheduler_progress_t lastProgress;
+	GTimer* pTimer;
+} roadster_import_t;
+
+// options
+static gint g_nIOLimit = IMPORT_SCHEDULER_DEFAULT_IO_LIMIT;
+static gint g_nCPULimit = IMPORT_SCHEDULER_DEFAULT_CPU_LIMIT;
+static gint g_nDBLimit = IMPORT_SCHEDULER_DEFAULT_DB_LIMIT;
+static gchar* g_pszDBHost = NULL;
+static gchar* g_pszDBUser = NULL;
+static gchar* g_pszDBPassword = NULL;
+static gchar* g_pszDBName = NULL;
+static gboolean g_bVerbose = FALSE;
+static gboolean g_bLockSharedVertices = FALSE;
+
+static GOptionEntry g_aOptions[] = {
+	{"io", 0, 0, G_OPTION_ARG_INT, &g_nIOLimit, "Counties read from disk at once", "N"},
+	{"cpu", 0, 0, G_OPTION_ARG_INT, &g_nCPULimit, "Counties parsed at once", "N"},
+	{"db", 0, 0, G_OPTION_ARG_INT, &g_nDBLimit, "Counties written to the database at once", "N"},
+	{"host", 0, 0, G_OPTION_ARG_STRING, &g_pszDBHost, "MySQL host (default from ~/.roadster/roadster.conf)", "HOST"},
+	{"user", 0, 0, G_OPTION_ARG_STRING, &g_pszDBUser, "MySQL user", "USER"},
+	{"password", 0, 0, G_OPTION_ARG_STRING, &g_pszDBPassword, "MySQL password", "PASSWORD"},
+	{"database", 0, 0, G_OPTION_ARG_STRING, &g_pszDBName, "MySQL database", "NAME"},
+	{"verbose", 'v', 0, G_OPTION_ARG_NONE, &g_bVerbose, "Show the importer's own messages (on stderr)", NULL},
+	{"lock-shared-vertices", 0, 0, G_OPTION_ARG_NONE, &g_bLockSharedVertices, "Keep the points where roads and polygon edges meet at every level of detail", NULL},
+	{NULL}
+};
+
+// The importer g_print()s as it goes.  Keep stdout for our report.
+static void roadster_import_print_handler(const gchar* pszString)
+{
+	if(g_bVerbose) {
+		fputs(pszString, stderr);
+	}
+}
+
+static void roadster_import_add_file(importscheduler_t* pScheduler, roadster_import_t* pImport, const gchar* pszPath)
+{
+	gchar* pszAbsolutePath = g_path_is_absolute(pszPath) ? g_strdup(pszPath) : g_build_filename(g_get_current_dir(), pszPath, NULL);
+	gchar* pszURI = gnome_vfs_get_uri_from_local_path(pszAbsolutePath);
+
+	pImport->nTotal++;
+
+	gint nTigerSetNumber;
+	if(pszURI != NULL && import_tiger_get_set_number(pszURI, &nTigerSetNumber)) {
+		struct stat info;
+		if(g_stat(pszAbsolutePath, &info) == 0) {
+			pImport->fTotalMegabytes += ((gdouble)info.st_size) / (1024.0 * 1024.0);
+		}
+		import_scheduler_add(pScheduler, pszURI, nTigerSetNumber);
+	}
+	else {
+		fprintf(stdout, "not a TIGER file (TGRnnnnn.ZIP): %s\n", pszPath);
+		pImport->nFinished++;
+		pImport->nFailed++;
+	}
+	g_free(pszURI);
+	g_free(pszAbsolutePath);
+}
+
+static gint roadster_import_compare_names(gconstpointer a, gconstpointer b)
+{
+	return strcmp(*(const gchar**)a, *(const gchar**)b);
+}
+
+// Add every TGRnnnnn.ZIP in a directory, in name order
+static void roadster_import_add_directory(importscheduler_t* pScheduler, roadster_import_t* pImport, const gchar* pszPath)
+{
+	GDir* pDir = g_dir_open(pszPath, 0, NULL);
+	if(pDir == NULL) {
+		fprintf(stdout, "can't read directory: %s\n", pszPath);
+		pImport->nTotal++;
+		pImport->nFinished++;
+		pImport->nFailed++;
+		return;
+	}
+
+	GPtrArray* pNamesArray = g_ptr_array_new();
+	const gchar* pszName;
+	while((pszName = g_dir_read_name(pDir)) != NULL) {
+		if(strlen(pszName) == 12 && g_str_has_prefix(pszName, "TGR") && g_str_has_suffix(pszName, ".ZIP")) {
+			g_ptr_array_add(pNamesArray, g_strdup(pszName));
+		}
+	}
+	g_dir_close(pDir);
+
+	g_ptr_array_sort(pNamesArray, roadster_import_compare_names);
+
+	gint i;
+	for(i=0 ; i<pNamesArray->len ; i++) {
+		gchar* pszFilePath = g_build_filename(pszPath, g_ptr_array_index(pNamesArray, i), NULL);
+		roadster_import_add_file(pScheduler, pImport, pszFilePath);
+		g_free(pszFilePath);
+		g_free(g_ptr_array_index(pNamesArray, i));
+	}
+	g_ptr_array_free(pNamesArray, TRUE);
+}
+
+static void roadster_import_progress_callback(const importscheduler_progress_t* pProgress, gpointer pUserData)
+{
+	roadster_import_t* pImport = (roadster_import_t*)pUserData;
+	pImport->lastProgress = *pProgress;
+}
+
+static void roadster_import_finished_callback(const gchar* pszURI, gint nTigerSetNumber, gboolean bSuccess, gpointer pUserData)
+{
+	roadster_import_t* pImport = (roadster_import_t*)pUserData;
+
+	pImport->nFinished++;
+	if(!bSuccess) pImport->nFailed++;
+
+	gdouble fElapsed = g_timer_elapsed(pImport->pTimer, NULL);
+	fprintf(stdout, "[%d/%d] TGR%05d.ZIP %s (%.1fs elapsed", pImport->nFinished, pImport->nTotal, nTigerSetNumber, bSuccess ? "ok" : "FAILED", fElapsed);
+	if(pImport->lastProgress.fSecondsRemaining >= 0.0 && pImport->nFinished < pImport->nTotal) {
+		gint nSeconds = (gint)(pImport->lastProgress.fSecondsRemaining + 0.5);
+		fprintf(stdout, ", about %d:%02d left", nSeconds / 60, nSeconds % 60);
+	}
+	fprintf(stdout, ")\n");
+	fflush(stdout);
+}
+
+// Settings in ~/.roadster/roadster.conf (shared with roadster) are used for any not given on the command line
+static gboolean roadster_import_connect(void)
+{
+	gchar* pszConfigFile = g_strdup_printf("%s/.roadster/roadster.conf", g_get_home_dir());
+	GKeyFile* pKeyFile = g_key_file_new();
+	if(g_key_file_load_from_file(pKeyFile, pszConfigFile, G_KEY_FILE_NONE, NULL)) {
+		if(g_pszDBHost == NULL) g_pszDBHost = g_key_file_get_string(pKeyFile, "mysql", "host", NULL);
+		if(g_pszDBUser == NULL) g_pszDBUser = g_key_file_get_string(pKeyFile, "mysql", "user", NULL);
+		if(g_pszDBPassword == NULL) g_pszDBPassword = g_key_file_get_string(pKeyFile, "mysql", "password", NULL);
+		if(g_pszDBName == NULL) g_pszDBName = g_key_file_get_string(pKeyFile, "mysql", "database", NULL);
+	}
+	g_key_file_free(pKeyFile);
+	g_free(pszConfigFile);
+
+	db_init();
+	if(!db_connect(g_pszDBHost, g_pszDBUser, g_pszDBPassword, g_pszDBName)) {
+		return FALSE;
+	}
+	db_create_tables();
+	return TRUE;
+}
+
+int main(int argc, char* argv[])
+{
+	if(!g_thread_supported()) g_thread_init(NULL);
+	g_type_init();
+
+	GOptionContext* pContext = g_option_context_new("TGRnnnnn.ZIP|DIRECTORY... - import TIGER/Line counties into the roadster database");
+	g_option_context_add_main_entries(pContext, g_aOptions, NULL);
+	GError* pError = NULL;
+	if(!g_option_context_parse(pContext, &argc, &argv, &pError)) {
+		fprintf(stderr, "%s: %s\n", g_get_prgname(), pError->message);
+		g_error_free(pError);
+		return EXIT_STATUS_USAGE;
+	}
+	g_option_context_free(pContext);
+
+	if(argc < 2) {
+		fprintf(stderr, "usage: %s [OPTION...] TGRnnnnn.ZIP|DIRECTORY...  (see --help)\n", g_get_prgname());
+		return EXIT_STATUS_USAGE;
+	}
+	if(g_nIOLimit < 1 || g_nCPULimit < 1 || g_nDBLimit < 1) {
+		fprintf(stderr, "%s: --io, --cpu and --db must be at least 1\n", g_get_prgname());
+		return EXIT_STATUS_USAGE;
+	}
+
+	import_tiger_set_lock_shared_vertices(g_bLockSharedVertices);
+	g_set_print_handler(roadster_import_print_handler);
+
+	if(!gnome_vfs_init()) {
+		fprintf(stderr, "%s: gnome_vfs_init failed\n", g_get_prgname());
+		return EXIT_STATUS_SETUP_FAILED;
+	}
+	if(!roadster_import_connect()) {
+		fprintf(stderr, "%s: couldn't connect to the database\n", g_get_prgname());
+		return EXIT_STATUS_SETUP_FAILED;
+	}
+
+	roadster_import_t import = {0};
+	importscheduler_t* pScheduler = import_scheduler_new(g_nIOLimit, g_nCPULimit, g_nDBLimit);
+
+	gint i;
+	for(i=1 ; i<argc ; i++) {
+		if(g_file_test(argv[i], G_FILE_TEST_IS_DIR)) {
+			roadster_import_add_directory(pScheduler, &import, argv[i]);
+		}
+		else {
+			roadster_import_add_file(pScheduler, &import, argv[i]);
+		}
+	}
+
+	fprintf(stdout, "importing %d counties (%.1f MB) with --io=%d --cpu=%d --db=%d on %d threads\n",
+		import.nTotal - import.nFailed, import.fTotalMegabytes, g_nIOLimit, g_nCPULimit, g_nDBLimit, import_tiger_get_thread_count());
+	fflush(stdout);
+
+	import.lastProgress.fSecondsRemaining = -1.0;
+	import.pTimer = g_timer_new();
+	import_scheduler_run(pScheduler, roadster_import_progress_callback, roadster_import_finished_callback, &import);
+	gdouble fElapsed = g_timer_elapsed(import.pTimer, NULL);
+	g_timer_destroy(import.pTimer);
+	import_scheduler_free(pScheduler);
+
+	gint nSucceeded = import.nTotal - import.nFailed;
+	fprintf(stdout, "imported %d of %d counties in %.1fs", nSucceeded, import.nTotal, fElapsed);
+	if(fElapsed > 0.0) {
+		fprintf(stdout, " (%.2f counties/minute, %.2f MB/s)", (nSucceeded * 60.0) / fElapsed, import.fTotalMegabytes / fElapsed);
+	}
+	fprintf(stdout, "\n");
+
+	db_deinit();
+	gnome_vfs_shutdown();
+
+	return (import.nFailed == 0) ? EXIT_STATUS_SUCCESS : EXIT_STATUS_IMPORT_FAILED;
+}
@@ -25,8 +25,15 @@
 Purpose of scenemanager.c:
  - Keep text labels and other screen objects from overlapping
  - Prevent the same text from showing up too often (currently not more than once)
+ - Claimed space is kept as a list of convex polygons (labels are rotated rectangles), each filed in the cells of a
+   grid over the window that its bounding box touches.  A test only looks at the claims in the cells it touches, and
+   each of those is checked exactly with the separating axis test.  (A single GdkRegion of everything claimed broke
+   into thousands of rectangles on busy maps, and every test had to intersect all of them.)
+ - Polygons with more than SCENEMANAGER_MAX_POLYGON_POINTS points are treated as their bounding box.  A polygon that
+   isn't convex is treated as its convex hull, which only errs on the side of not drawing.
 */
 
+#include <math.h>
 #include <gtk/gtk.h>
 
 #include "main.h"
@@ -34,12 +41,30 @@ Purpose of scenemanager.c:
 
 #define ENABLE_NO_DUPLICATE_LABELS
 
+#define SCENEMANAGER_GRID_CELL_SIZE			(64)	// in pixels, about the size of a short label
+#define SCENEMANAGER_MAX_POLYGON_POINTS		(8)
+
+// A claimed polygon, in screen space
+typedef struct {
+	gint nNumPoints;
+	gdouble afX[SCENEMANAGER_MAX_POLYGON_POINTS];
+	gdouble afY[SCENEMANAGER_MAX_POLYGON_POINTS];
+	gdouble fMinX;		// bounding box
+	gdouble fMinY;
+	gdouble fMaxX;
+	gdouble fMaxY;
+	guint uTestStamp;	// the last test that looked at it (see scenemanager_is_free)
+} scenemanagerclaim_t;
+
+static void scenemanager_add_to_grid(scenemanager_t* pSceneManager, gint iClaim);
+
 void scenemanager_new(scenemanager_t** ppReturn)
 {
 	// create new scenemanager and return it
 	scenemanager_t* pNew = g_new0(scenemanager_t, 1);
 	pNew->pLabelHash = g_hash_table_new(g_str_hash, g_str_equal);
-	pNew->pTakenRegion = gdk_region_new();
+	pNew->pClaimsArray = g_array_new(FALSE, FALSE, sizeof(scenemanagerclaim_t));
+	pNew->pGridCellsArray = g_ptr_array_new();
 	*ppReturn = pNew;
 }
 
@@ -48,6 +73,165 @@ void scenemanager_set_screen_dimensions(scenemanager_t* pSceneManager, gint nWin
 {
 	pSceneManager->nWindowWidth = nWindowWidth;
 	pSceneManager->nWindowHeight = nWindowHeight;
+
+	// size the grid to the window (claims off the window go in the edge cells)
+	gint nGridColumns = MAX(1, (nWindowWidth + SCENEMANAGER_GRID_CELL_SIZE - 1) / SCENEMANAGER_GRID_CELL_SIZE);
+	gint nGridRows = MAX(1, (nWindowHeight + SCENEMANAGER_GRID_CELL_SIZE - 1) / SCENEMANAGER_GRID_CELL_SIZE);
+	if(nGridColumns == pSceneManager->nGridColumns && nGridRows == pSceneManager->nGridRows) return;
+
+	gint i;
+	for(i=0 ; i<pSceneManager->pGridCellsArray->len ; i++) {
+		g_array_free(g_ptr_array_index(pSceneManager->pGridCellsArray, i), TRUE);
+	}
+	g_ptr_array_set_size(pSceneManager->pGridCellsArray, 0);
+	for(i=0 ; i<(nGridColumns * nGridRows) ; i++) {
+		g_ptr_array_add(pSceneManager->pGridCellsArray, g_array_new(FALSE, FALSE, sizeof(gint)));
+	}
+	pSceneManager->nGridColumns = nGridColumns;
+	pSceneManager->nGridRows = nGridRows;
+
+	// file any claims already made in the new grid
+	for(i=0 ; i<pSceneManager->pClaimsArray->len ; i++) {
+		scenemanager_add_to_grid(pSceneManager, i);
+	}
+}
+
+// Fills pClaim with the polygon.  Returns FALSE if it has no area to claim (fewer than 3 points).
+static gboolean scenemanager_make_claim(const GdkPoint* pPoints, gint nNumPoints, scenemanagerclaim_t* pClaim)
+{
+	if(nNumPoints < 3) return FALSE;
+
+	pClaim->fMinX = pClaim->fMaxX = pPoints[0].x;
+	pClaim->fMinY = pClaim->fMaxY = pPoints[0].y;
+	gint i;
+	for(i=1 ; i<nNumPoints ; i++) {
+		pClaim->fMinX = MIN(pClaim->fMinX, pPoints[i].x);
+		pClaim->fMaxX = MAX(pClaim->fMaxX, pPoints[i].x);
+		pClaim->fMinY = MIN(pClaim->fMinY, pPoints[i].y);
+		pClaim->fMaxY = MAX(pClaim->fMaxY, pPoints[i].y);
+	}
+
+	if(nNumPoints > SCENEMANAGER_MAX_POLYGON_POINTS) {
+		pClaim->nNumPoints = 4;
+		pClaim->afX[0] = pClaim->fMinX;	pClaim->afY[0] = pClaim->fMinY;
+		pClaim->afX[1] = pClaim->fMaxX;	pClaim->afY[1] = pClaim->fMinY;
+		pClaim->afX[2] = pClaim->fMaxX;	pClaim->afY[2] = pClaim->fMaxY;
+		pClaim->afX[3] = pClaim->fMinX;	pClaim->afY[3] = pClaim->fMaxY;
+	}
+	else {
+		pClaim->nNumPoints = nNumPoints;
+		for(i=0 ; i<nNumPoints ; i++) {
+			pClaim->afX[i] = pPoints[i].x;
+			pClaim->afY[i] = pPoints[i].y;
+		}
+	}
+	pClaim->uTestStamp = 0;
+	return TRUE;
+}
+
+static void scenemanager_make_rectangle_claim(const GdkRectangle* pRect, scenemanagerclaim_t* pClaim)
+{
+	GdkPoint aPoints[4] = {{pRect->x, pRect->y}, {pRect->x + pRect->width, pRect->y},
+						   {pRect->x + pRect->width, pRect->y + pRect->height}, {pRect->x, pRect->y + pRect->height}};
+	scenemanager_make_claim(aPoints, 4, pClaim);
+}
+
+// TRUE if one of pA's edges is a separating axis: the two polygons' shadows on its normal don't overlap
+static gboolean scenemanager_edges_separate(const scenemanagerclaim_t* pA, const scenemanagerclaim_t* pB)
+{
+	gint iEdge;
+	for(iEdge=0 ; iEdge<pA->nNumPoints ; iEdge++) {
+		gint iNext = (iEdge + 1) % pA->nNumPoints;
+		gdouble fNormalX = -(pA->afY[iNext] - pA->afY[iEdge]);
+		gdouble fNormalY = pA->afX[iNext] - pA->afX[iEdge];
+		if(fNormalX == 0.0 && fNormalY == 0.0) continue;	// repeated point
+
+		gdouble fMinA = G_MAXDOUBLE, fMaxA = -G_MAXDOUBLE;
+		gdouble fMinB = G_MAXDOUBLE, fMaxB = -G_MAXDOUBLE;
+		gint i;
+		for(i=0 ; i<pA->nNumPoints ; i++) {
+			gdouble f = (pA->afX[i] * fNormalX) + (pA->afY[i] * fNormalY);
+			fMinA = MIN(fMinA, f);
+			fMaxA = MAX(fMaxA, f);
+		}
+		for(i=0 ; i<pB->nNumPoints ; i++) {
+			gdouble f = (pB->afX[i] * fNormalX) + (pB->afY[i] * fNormalY);
+			fMinB = MIN(fMinB, f);
+			fMaxB = MAX(fMaxB, f);
+		}
+		// touching along an edge isn't overlapping (like two GdkRegions sharing an edge)
+		if(fMaxA <= fMinB || fMaxB <= fMinA) return TRUE;
+	}
+	return FALSE;
+}
+
+static gboolean scenemanager_claims_overlap(const scenemanagerclaim_t* pA, const scenemanagerclaim_t* pB)
+{
+	if(pA->fMaxX <= pB->fMinX || pB->fMaxX <= pA->fMinX || pA->fMaxY <= pB->fMinY || pB->fMaxY <= pA->fMinY) {
+		return FALSE;
+	}
+	return !(scenemanager_edges_separate(pA, pB) || scenemanager_edges_separate(pB, pA));
+}
+
+// The range of grid cells a bounding box touches (clamped to the grid)
+static void scenemanager_get_cell_range(const scenemanager_t* pSceneManager, const scenemanagerclaim_t* pClaim, gint* pnFirstColumn, gint* pnFirstRow, gint* pnLastColumn, gint* pnLastRow)
+{
+	*pnFirstColumn = CLAMP((gint)floor(pClaim->fMinX / SCENEMANAGER_GRID_CELL_SIZE), 0, pSceneManager->nGridColumns - 1);
+	*pnLastColumn = CLAMP((gint)floor(pClaim->fMaxX / SCENEMANAGER_GRID_CELL_SIZE), 0, pSceneManager->nGridColumns - 1);
+	*pnFirstRow = CLAMP((gint)floor(pClaim->fMinY / SCENEMANAGER_GRID_CELL_SIZE), 0, pSceneManager->nGridRows - 1);
+	*pnLastRow = CLAMP((gint)floor(pClaim->fMaxY / SCENEMANAGER_GRID_CELL_SIZE), 0, pSceneManager->nGridRows - 1);
+}
+
+static void scenemanager_add_to_grid(scenemanager_t* pSceneManager, gint iClaim)
+{
+	const scenemanagerclaim_t* pClaim = &g_array_index(pSceneManager->pClaimsArray, scenemanagerclaim_t, iClaim);
+
+	gint nFirstColumn, nFirstRow, nLastColumn, nLastRow;
+	scenemanager_get_cell_range(pSceneManager, pClaim, &nFirstColumn, &nFirstRow, &nLastColumn, &nLastRow);
+
+	gint nRow, nColumn;
+	for(nRow=nFirstRow ; nRow<=nLastRow ; nRow++) {
+		for(nColumn=nFirstColumn ; nColumn<=nLastColumn ; nColumn++) {
+			GArray* pCell = g_ptr_array_index(pSceneManager->pGridCellsArray, (nRow * pSceneManager->nGridColumns) + nColumn);
+			g_array_append_val(pCell, iClaim);
+		}
+	}
+}
+
+static void scenemanager_add_claim(scenemanager_t* pSceneManager, const scenemanagerclaim_t* pClaim)
+{
+	g_assert(pSceneManager->pGridCellsArray->len > 0);	// see scenemanager_set_screen_dimensions
+
+	g_array_append_val(pSceneManager->pClaimsArray, *pClaim);
+	scenemanager_add_to_grid(pSceneManager, pSceneManager->pClaimsArray->len - 1);
+}
+
+// TRUE if pTest doesn't overlap anything claimed
+static gboolean scenemanager_is_free(scenemanager_t* pSceneManager, const scenemanagerclaim_t* pTest)
+{
+	g_assert(pSceneManager->pGridCellsArray->len > 0);	// see scenemanager_set_screen_dimensions
+
+	gint nFirstColumn, nFirstRow, nLastColumn, nLastRow;
+	scenemanager_get_cell_range(pSceneManager, pTest, &nFirstColumn, &nFirstRow, &nLastColumn, &nLastRow);
+
+	guint uTestStamp = ++(pSceneManager->uTestStamp);
+
+	gint nRow, nColumn;
+	for(nRow=nFirstRow ; nRow<=nLastRow ; nRow++) {
+		for(nColumn=nFirstColumn ; nColumn<=nLastColumn ; nColumn++) {
+			GArray* pCell = g_ptr_array_index(pSceneManager->pGridCellsArray, (nRow * pSceneManager->nGridColumns) + nColumn);
+
+			gint i;
+			for(i=0 ; i<pCell->len ; i++) {
+				scenemanagerclaim_t* pClaim = &g_array_index(pSceneManager->pClaimsArray, scenemanagerclaim_t, g_array_index(pCell, gint, i));
+				if(pClaim->uTestStamp == uTestStamp) continue;	// already tested it in another cell
+				pClaim->uTestStamp = uTestStamp;
+
+				if(scenemanager_claims_overlap(pTest, pClaim)) return FALSE;
+			}
+		}
+	}
+	return TRUE;
 }
 
 gboolean scenemanager_can_draw_label_at(scenemanager_t* pSceneManager, const gchar* pszLabel, GdkPoint* unused_pScreenLocation, gint nFlags)
@@ -104,13 +288,9 @@ gboolean scenemanager_can_draw_polygon(scenemanager_t* pSceneManager, GdkPoint *
 	//
 	// 2) Enforce overlap rules
 	//
-	GdkRegion* pNewRegion = gdk_region_polygon(pPoints, nNumPoints, GDK_WINDING_RULE);
-
-	gdk_region_intersect(pNewRegion, pSceneManager->pTakenRegion); // sets pNewRegion to the intersection of itself and the 'taken region'
-	gboolean bOK = gdk_region_empty(pNewRegion);	// it's ok to draw here if the intersection is empty
-	gdk_region_destroy(pNewRegion);
-
-	return bOK;
+	scenemanagerclaim_t test;
+	if(!scenemanager_make_claim(pPoints, nNumPoints, &test)) return TRUE;	// no area, so it can't overlap anything
+	return scenemanager_is_free(pSceneManager, &test);
 }
 
 gboolean scenemanager_can_draw_rectangle(scenemanager_t* pSceneManager, GdkRectangle* pRect, gint nFlags)
@@ -136,13 +316,9 @@ gboolean scenemanager_can_draw_rectangle(scenemanager_t* pSceneManager, GdkRecta
 	//
 	// 2) Enforce overlap rules
 	//
-	GdkRegion* pNewRegion = gdk_region_rectangle(pRect);
-
-	gdk_region_intersect(pNewRegion, pSceneManager->pTakenRegion); // sets pNewRegion to the intersection of itself and the 'taken region'
-	gboolean bOK = gdk_region_empty(pNewRegion);	// it's ok to draw here if the intersection is empty
-	gdk_region_destroy(pNewRegion);
-
-	return bOK;
+	scenemanagerclaim_t test;
+	scenemanager_make_rectangle_claim(pRect, &test);
+	return scenemanager_is_free(pSceneManager, &test);
 }
 
 void scenemanager_claim_label(scenemanager_t* pSceneManager, gchar* pszLabel)
@@ -157,16 +333,17 @@ void scenemanager_claim_label(scenemanager_t* pSceneManager, gchar* pszLabel)
 
 void scenemanager_claim_polygon(scenemanager_t* pSceneManager, GdkPoint *pPoints, gint nNumPoints)
 {
-	// Create a GdkRegion from the given points and union it with the 'taken region'
-	GdkRegion* pNewRegion = gdk_region_polygon(pPoints, nNumPoints, GDK_WINDING_RULE);
-	gdk_region_union(pSceneManager->pTakenRegion, pNewRegion);
-	gdk_region_destroy(pNewRegion);
+	scenemanagerclaim_t claim;
+	if(scenemanager_make_claim(pPoints, nNumPoints, &claim)) {
+		scenemanager_add_claim(pSceneManager, &claim);
+	}
 }
 
 void scenemanager_claim_rectangle(scenemanager_t* pSceneManager, GdkRectangle* pRect)
 {
-	// Add the area of the rectangle to the region
-	gdk_region_union_with_rect(pSceneManager->pTakenRegion, pRect);
+	scenemanagerclaim_t claim;
+	scenemanager_make_rectangle_claim(pRect, &claim);
+	scenemanager_add_claim(pSceneManager, &claim);
 }
 
 void scenemanager_clear(scenemanager_t* pSceneManager)
@@ -177,7 +354,11 @@ void scenemanager_clear(scenemanager_t* pSceneManager)
 	g_hash_table_destroy(pSceneManager->pLabelHash);
 	pSceneManager->pLabelHash = g_hash_table_new(g_str_hash, g_str_equal);
 
-	// Empty the region (XXX: better way?)
-	gdk_region_destroy(pSceneManager->pTakenRegion);
-	pSceneManager->pTakenRegion = gdk_region_new();
+	// Empty the claims and the grid (keeping their memory for the next frame)
+	g_array_set_size(pSceneManager->pClaimsArray, 0);
+	gint i;
+	for(i=0 ; i<pSceneManager->pGridCellsArray->len ; i++) {
+		g_array_set_size(g_ptr_array_index(pSceneManager->pGridCellsArray, i), 0);
+	}
+	pSceneManager->uTestStamp = 0;
 }
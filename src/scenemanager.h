@@ -30,7 +30,12 @@
 #define SCENEMANAGER_FLAG_PARTLY_ON_SCREEN	(2)
 
 typedef struct scenemanager {
-	GdkRegion* pTakenRegion;
+	// claimed space: convex polygons, indexed by a grid of square cells over the window (see scenemanager.c)
+	GArray* pClaimsArray;
+	GPtrArray* pGridCellsArray;		// a GArray of indexes into pClaimsArray for each cell, row by row
+	gint nGridColumns;
+	gint nGridRows;
+	guint uTestStamp;				// counts overlap tests, so a claim in several cells is only tested once
 
 	gint nWindowWidth;
 	gint nWindowHeight;
@@ -0,0 +1,216 @@
+/***************************************************************************
+ *            scenemanager_benchmark.c
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+Purpose of scenemanager_benchmark.c:
+ - scenemanager-benchmark: time the scenemanager placing 1k, 10k and 50k labels, the way map_draw_cairo does it:
+   test a rotated box with scenemanager_can_draw_polygon and claim it with scenemanager_claim_polygon if it's free
+ - The window grows with the number of labels, so each size is about as crowded as a busy map
+ - The same boxes go through the single GdkRegion the scenemanager used to keep, for comparison (it gets slow
+   quickly, so only up to --region-max-claims)
+ - Output is one tab-separated line per test, to paste into a spreadsheet
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <gtk/gtk.h>
+
+#include "scenemanager.h"
+
+#define EXIT_STATUS_SUCCESS			(0)
+#define EXIT_STATUS_USAGE			(2)
+
+#define PIXELS_PER_LABEL			(6000)	// window area per label to place
+#define CANDIDATES_PER_LABEL		(4)		// give up on a size after this many boxes per label
+#define MIN_LABEL_WIDTH				(30)	// in pixels, a few letters...
+#define MAX_LABEL_WIDTH				(150)	// ...to a long street name
+#define MIN_LABEL_HEIGHT			(10)
+#define MAX_LABEL_HEIGHT			(16)
+
+// options
+static gint g_nMaxClaims = 50000;
+static gint g_nRegionMaxClaims = 10000;
+static gint g_nQueries = 10000;
+static gint g_nSeed = 1;
+
+static GOptionEntry g_aOptions[] = {
+	{"max-claims", 0, 0, G_OPTION_ARG_INT, &g_nMaxClaims, "Most labels to place (default 50000)", "N"},
+	{"region-max-claims", 0, 0, G_OPTION_ARG_INT, &g_nRegionMaxClaims, "Most labels to place with the old GdkRegion (default 10000)", "N"},
+	{"queries", 0, 0, G_OPTION_ARG_INT, &g_nQueries, "Boxes to test (without claiming) after placing them all (default 10000)", "N"},
+	{"seed", 0, 0, G_OPTION_ARG_INT, &g_nSeed, "Random seed (default 1)", "N"},
+	{NULL}
+};
+
+static gint g_anClaims[] = {1000, 10000, 50000};
+
+typedef struct {
+	GdkPoint aPoints[4];
+} labelbox_t;
+
+// The old scenemanager: everything claimed is one GdkRegion
+typedef struct {
+	GdkRegion* pTakenRegion;
+} regionmanager_t;
+
+static gboolean region_can_draw_polygon(regionmanager_t* pManager, GdkPoint* pPoints, gint nNumPoints)
+{
+	GdkRegion* pNewRegion = gdk_region_polygon(pPoints, nNumPoints, GDK_WINDING_RULE);
+	gdk_region_intersect(pNewRegion, pManager->pTakenRegion);
+	gboolean bOK = gdk_region_empty(pNewRegion);
+	gdk_region_destroy(pNewRegion);
+	return bOK;
+}
+
+static void region_claim_polygon(regionmanager_t* pManager, GdkPoint* pPoints, gint nNumPoints)
+{
+	GdkRegion* pNewRegion = gdk_region_polygon(pPoints, nNumPoints, GDK_WINDING_RULE);
+	gdk_region_union(pManager->pTakenRegion, pNewRegion);
+	gdk_region_destroy(pNewRegion);
+}
+
+// Rotated boxes the size of labels, anywhere in a square window
+static GArray* scenemanager_benchmark_make_boxes(GRand* pRand, gint nNumBoxes, gint nWindowSize)
+{
+	GArray* pBoxes = g_array_sized_new(FALSE, FALSE, sizeof(labelbox_t), nNumBoxes);
+
+	gint i;
+	for(i=0 ; i<nNumBoxes ; i++) {
+		gdouble fCenterX = g_rand_double_range(pRand, 0.0, nWindowSize);
+		gdouble fCenterY = g_rand_double_range(pRand, 0.0, nWindowSize);
+		gdouble fHalfWidth = g_rand_double_range(pRand, MIN_LABEL_WIDTH, MAX_LABEL_WIDTH) / 2.0;
+		gdouble fHalfHeight = g_rand_double_range(pRand, MIN_LABEL_HEIGHT, MAX_LABEL_HEIGHT) / 2.0;
+		gdouble fAngle = g_rand_double_range(pRand, -G_PI/2.0, G_PI/2.0);
+		gdouble fCos = cos(fAngle);
+		gdouble fSin = sin(fAngle);
+
+		static const gint aCorners[4][2] = {{-1,-1}, {1,-1}, {1,1}, {-1,1}};
+		labelbox_t box;
+		gint iCorner;
+		for(iCorner=0 ; iCorner<4 ; iCorner++) {
+			gdouble fX = aCorners[iCorner][0] * fHalfWidth;
+			gdouble fY = aCorners[iCorner][1] * fHalfHeight;
+			box.aPoints[iCorner].x = (gint)floor(fCenterX + (fX * fCos) - (fY * fSin) + 0.5);
+			box.aPoints[iCorner].y = (gint)floor(fCenterY + (fX * fSin) + (fY * fCos) + 0.5);
+		}
+		g_array_append_val(pBoxes, box);
+	}
+	return pBoxes;
+}
+
+// Place boxes from pCandidates until nClaims are claimed (or we run out), then test pQueries, and print the results.
+// With pRegionManager, use it instead of pSceneManager.
+static void scenemanager_benchmark_run(scenemanager_t* pSceneManager, regionmanager_t* pRegionManager, gint nClaims, gint nWindowSize, const GArray* pCandidates, const GArray* pQueries)
+{
+	GTimer* pTimer = g_timer_new();
+
+	gint nClaimed = 0;
+	gint nAttempts = 0;
+	gint i;
+	for(i=0 ; i<pCandidates->len && nClaimed<nClaims ; i++) {
+		labelbox_t* pBox = &g_array_index(pCandidates, labelbox_t, i);
+		nAttempts++;
+		if(pRegionManager != NULL) {
+			if(region_can_draw_polygon(pRegionManager, pBox->aPoints, 4)) {
+				region_claim_polygon(pRegionManager, pBox->aPoints, 4);
+				nClaimed++;
+			}
+		}
+		else {
+			if(scenemanager_can_draw_polygon(pSceneManager, pBox->aPoints, 4, SCENEMANAGER_FLAG_NONE)) {
+				scenemanager_claim_polygon(pSceneManager, pBox->aPoints, 4);
+				nClaimed++;
+			}
+		}
+	}
+	gdouble fClaimSeconds = g_timer_elapsed(pTimer, NULL);
+
+	g_timer_start(pTimer);
+	gint nFree = 0;
+	for(i=0 ; i<pQueries->len ; i++) {
+		labelbox_t* pBox = &g_array_index(pQueries, labelbox_t, i);
+		if(pRegionManager != NULL) {
+			if(region_can_draw_polygon(pRegionManager, pBox->aPoints, 4)) nFree++;
+		}
+		else {
+			if(scenemanager_can_draw_polygon(pSceneManager, pBox->aPoints, 4, SCENEMANAGER_FLAG_NONE)) nFree++;
+		}
+	}
+	gdouble fQuerySeconds = g_timer_elapsed(pTimer, NULL);
+	g_timer_destroy(pTimer);
+
+	fprintf(stdout, "%s\t%d\t%d\t%d\t%d\t%.6f\t%.3f\t%.3f\t%d\n",
+		(pRegionManager != NULL) ? "region" : "grid", nClaims, nWindowSize, nAttempts, nClaimed, fClaimSeconds,
+		(fClaimSeconds * 1000000.0) / MAX(nAttempts, 1), (fQuerySeconds * 1000000.0) / MAX(pQueries->len, 1), nFree);
+	fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+	GOptionContext* pContext = g_option_context_new("- time label collision tests in the scenemanager");
+	g_option_context_add_main_entries(pContext, g_aOptions, NULL);
+	GError* pError = NULL;
+	if(!g_option_context_parse(pContext, &argc, &argv, &pError)) {
+		fprintf(stderr, "%s: %s\n", g_get_prgname(), pError->message);
+		g_error_free(pError);
+		return EXIT_STATUS_USAGE;
+	}
+	g_option_context_free(pContext);
+
+	if(g_nMaxClaims < 1 || g_nQueries < 0) {
+		fprintf(stderr, "%s: --max-claims must be at least 1 and --queries can't be negative\n", g_get_prgname());
+		return EXIT_STATUS_USAGE;
+	}
+
+	fprintf(stdout, "implementation\tclaims\twindow_size\tattempts\tclaimed\tclaim_seconds\tusec_per_attempt\tusec_per_query\tfree_queries\n");
+
+	gint iSize;
+	for(iSize=0 ; iSize<G_N_ELEMENTS(g_anClaims) ; iSize++) {
+		gint nClaims = g_anClaims[iSize];
+		if(nClaims > g_nMaxClaims) break;
+
+		gint nWindowSize = (gint)sqrt((gdouble)nClaims * PIXELS_PER_LABEL);
+
+		// the same boxes for both, from the same seed for every run
+		GRand* pRand = g_rand_new_with_seed(g_nSeed + iSize);
+		GArray* pCandidates = scenemanager_benchmark_make_boxes(pRand, nClaims * CANDIDATES_PER_LABEL, nWindowSize);
+		GArray* pQueries = scenemanager_benchmark_make_boxes(pRand, g_nQueries, nWindowSize);
+		g_rand_free(pRand);
+
+		scenemanager_t* pSceneManager;
+		scenemanager_new(&pSceneManager);
+		scenemanager_set_screen_dimensions(pSceneManager, nWindowSize, nWindowSize);
+		scenemanager_benchmark_run(pSceneManager, NULL, nClaims, nWindowSize, pCandidates, pQueries);
+
+		if(nClaims <= g_nRegionMaxClaims) {
+			regionmanager_t regionManager;
+			regionManager.pTakenRegion = gdk_region_new();
+			scenemanager_benchmark_run(NULL, &regionManager, nClaims, nWindowSize, pCandidates, pQueries);
+			gdk_region_destroy(regionManager.pTakenRegion);
+		}
+
+		g_array_free(pQueries, TRUE);
+		g_array_free(pCandidates, TRUE);
+	}
+	return EXIT_STATUS_SUCCESS;
+}
@@ -0,0 +1,209 @@
+/***************************************************************************
+ *            simplify_benchmark.c
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+Purpose of simplify_benchmark.c:
+ - simplify-benchmark: time map_math_simplify_pointstring and map_math_simplify_pointstring_locked on synthetic
+   chains (smooth random walks) from a few points up to millions, at the importer's LOD tolerances
+ - For the locked mode, also check what the importer relies on: every locked point is kept, and a chain gives the
+   same points when walked backward (so two polygons sharing an edge, or two roads sharing a junction, stay gap-free)
+ - Output is one tab-separated line per test, to paste into a spreadsheet
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <glib.h>
+
+#include "map.h"
+#include "map_math.h"
+
+#define EXIT_STATUS_SUCCESS			(0)
+#define EXIT_STATUS_CHECK_FAILED	(1)
+#define EXIT_STATUS_USAGE			(2)
+
+#define STEP_DEGREES				(0.0001)	// about 10 meters between points
+#define MIN_SECONDS_PER_TEST		(0.2)		// repeat short tests until they take at least this long
+
+// options
+static gint g_nLockEvery = 25;
+static gint g_nMaxPoints = 2000000;
+static gint g_nSeed = 1;
+
+static GOptionEntry g_aOptions[] = {
+	{"lock-every", 0, 0, G_OPTION_ARG_INT, &g_nLockEvery, "Lock every Nth point in the locked tests (default 25)", "N"},
+	{"max-points", 0, 0, G_OPTION_ARG_INT, &g_nMaxPoints, "Longest chain to test (default 2000000)", "N"},
+	{"seed", 0, 0, G_OPTION_ARG_INT, &g_nSeed, "Random seed (default 1)", "N"},
+	{NULL}
+};
+
+// Same as the importer's LOD 1-3 tolerances for highways and polygons (see g_afObjectTypeToleranceAtLODs)
+static gdouble g_afTolerances[] = {0.002, 0.008, 0.032, 0.08};
+
+// A smooth random walk: the heading drifts a little at each point
+static GArray* simplify_benchmark_make_chain(GRand* pRand, gint nNumPoints)
+{
+	GArray* pChain = g_array_sized_new(FALSE, FALSE, sizeof(mappoint_t), nNumPoints);
+
+	mappoint_t point = {42.3, -71.1};
+	gdouble fHeading = g_rand_double_range(pRand, 0.0, 2.0 * G_PI);
+	gint i;
+	for(i=0 ; i<nNumPoints ; i++) {
+		g_array_append_val(pChain, point);
+
+		fHeading += g_rand_double_range(pRand, -0.3, 0.3);
+		point.fLatitude += sin(fHeading) * STEP_DEGREES;
+		point.fLongitude += cos(fHeading) * STEP_DEGREES;
+	}
+	return pChain;
+}
+
+static void simplify_benchmark_reverse(const GArray* pChain, const gint8* pabLocked, GArray* pReturnChain, gint8* pabReturnLocked)
+{
+	g_array_set_size(pReturnChain, pChain->len);
+	gint i;
+	for(i=0 ; i<pChain->len ; i++) {
+		g_array_index(pReturnChain, mappoint_t, i) = g_array_index(pChain, mappoint_t, pChain->len - 1 - i);
+		pabReturnLocked[i] = pabLocked[pChain->len - 1 - i];
+	}
+}
+
+// Returns FALSE if a locked point is missing from pOutput, or walking pChain backward gives different points
+static gboolean simplify_benchmark_check_locked(const GArray* pChain, const gint8* pabLocked, gdouble fTolerance, const GArray* pOutput)
+{
+	// pOutput is a subsequence of pChain, so walk them together
+	gint i;
+	gint iOutput = 0;
+	for(i=0 ; i<pChain->len ; i++) {
+		const mappoint_t* pPoint = &g_array_index(pChain, mappoint_t, i);
+		if(iOutput < pOutput->len && map_math_mappoints_equal(&g_array_index(pOutput, mappoint_t, iOutput), pPoint)) {
+			iOutput++;
+		}
+		else if(pabLocked[i]) {
+			return FALSE;
+		}
+	}
+
+	GArray* pReversed = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+	gint8* pabReversedLocked = g_new(gint8, pChain->len);
+	GArray* pReversedOutput = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+	simplify_benchmark_reverse(pChain, pabLocked, pReversed, pabReversedLocked);
+	map_math_simplify_pointstring_locked(pReversed, pabReversedLocked, fTolerance, pReversedOutput);
+
+	gboolean bSame = (pReversedOutput->len == pOutput->len);
+	for(i=0 ; bSame && i<pOutput->len ; i++) {
+		bSame = map_math_mappoints_equal(&g_array_index(pOutput, mappoint_t, i), &g_array_index(pReversedOutput, mappoint_t, pOutput->len - 1 - i));
+	}
+
+	g_array_free(pReversedOutput, TRUE);
+	g_free(pabReversedLocked);
+	g_array_free(pReversed, TRUE);
+	return bSame;
+}
+
+// Simplify pChain (locked if pabLocked isn't NULL) as many times as fits in MIN_SECONDS_PER_TEST and print the results
+static gboolean simplify_benchmark_run(const GArray* pChain, const gint8* pabLocked, gdouble fTolerance)
+{
+	GArray* pOutput = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+	GTimer* pTimer = g_timer_new();
+
+	gint nRuns = 0;
+	do {
+		g_array_set_size(pOutput, 0);
+		if(pabLocked != NULL) {
+			map_math_simplify_pointstring_locked(pChain, pabLocked, fTolerance, pOutput);
+		}
+		else {
+			map_math_simplify_pointstring(pChain, fTolerance, pOutput);
+		}
+		nRuns++;
+	} while(g_timer_elapsed(pTimer, NULL) < MIN_SECONDS_PER_TEST);
+	gdouble fSeconds = g_timer_elapsed(pTimer, NULL) / nRuns;
+	g_timer_destroy(pTimer);
+
+	gboolean bPassed = TRUE;
+	if(pabLocked != NULL) {
+		bPassed = simplify_benchmark_check_locked(pChain, pabLocked, fTolerance, pOutput);
+	}
+
+	fprintf(stdout, "%s\t%d\t%g\t%d\t%d\t%.6f\t%.1f\t%s\n",
+		(pabLocked != NULL) ? "locked" : "plain", pChain->len, fTolerance, (pabLocked != NULL) ? g_nLockEvery : 0,
+		pOutput->len, fSeconds, (pChain->len / fSeconds) / 1000000.0, bPassed ? "ok" : "FAILED");
+	fflush(stdout);
+
+	g_array_free(pOutput, TRUE);
+	return bPassed;
+}
+
+int main(int argc, char* argv[])
+{
+	GOptionContext* pContext = g_option_context_new("- time line simplification, with and without locked points");
+	g_option_context_add_main_entries(pContext, g_aOptions, NULL);
+	GError* pError = NULL;
+	if(!g_option_context_parse(pContext, &argc, &argv, &pError)) {
+		fprintf(stderr, "%s: %s\n", g_get_prgname(), pError->message);
+		g_error_free(pError);
+		return EXIT_STATUS_USAGE;
+	}
+	g_option_context_free(pContext);
+
+	if(g_nLockEvery < 1 || g_nMaxPoints < 2) {
+		fprintf(stderr, "%s: --lock-every must be at least 1 and --max-points at least 2\n", g_get_prgname());
+		return EXIT_STATUS_USAGE;
+	}
+
+	GRand* pRand = g_rand_new_with_seed(g_nSeed);
+	gboolean bPassed = TRUE;
+
+	fprintf(stdout, "mode\tpoints\ttolerance\tlock_every\toutput_points\tseconds\tmpoints_per_second\tcheck\n");
+
+	gint nNumPoints;
+	for(nNumPoints=20 ; ; nNumPoints *= 10) {
+		nNumPoints = MIN(nNumPoints, g_nMaxPoints);
+		GArray* pChain = simplify_benchmark_make_chain(pRand, nNumPoints);
+
+		gint8* pabLocked = g_new0(gint8, nNumPoints);
+		gint i;
+		for(i=0 ; i<nNumPoints ; i+=g_nLockEvery) {
+			pabLocked[i] = 1;
+		}
+
+		gint iTolerance;
+		for(iTolerance=0 ; iTolerance<G_N_ELEMENTS(g_afTolerances) ; iTolerance++) {
+			bPassed &= simplify_benchmark_run(pChain, NULL, g_afTolerances[iTolerance]);
+			bPassed &= simplify_benchmark_run(pChain, pabLocked, g_afTolerances[iTolerance]);
+		}
+
+		g_free(pabLocked);
+		g_array_free(pChain, TRUE);
+
+		if(nNumPoints == g_nMaxPoints) break;
+	}
+	g_rand_free(pRand);
+
+	if(!bPassed) {
+		fprintf(stderr, "%s: locked simplification lost a locked point or wasn't the same both ways\n", g_get_prgname());
+		return EXIT_STATUS_CHECK_FAILED;
+	}
+	return EXIT_STATUS_SUCCESS;
+}
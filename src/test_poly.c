@@ -176,16 +176,16 @@ static gboolean test_poly_on_time_to_update(GtkWidget *pDrawingArea, GdkEventExp
 
 
 		if(g_Test_Poly.pPointsArray->len > 0) {
-			GArray* pClipped = g_array_new(FALSE, FALSE, sizeof(mappoint_t));
+			mapclipbuffer_t* pClipBuffer = map_math_clipbuffer_new();
 			mappoint_t ptFirst = g_array_index(g_Test_Poly.pPointsArray, mappoint_t, 0);
 			g_array_append_val(g_Test_Poly.pPointsArray, ptFirst);
-				map_math_clip_pointstring_to_worldrect(g_Test_Poly.pPointsArray, &rcClipper, pClipped);
+				const GArray* pClipped = map_math_clip_polygon_to_worldrect(&g_array_index(g_Test_Poly.pPointsArray, mappoint_t, 0), g_Test_Poly.pPointsArray->len, &rcClipper, pClipBuffer);
 			g_array_remove_index(g_Test_Poly.pPointsArray, g_Test_Poly.pPointsArray->len-1);
 
 			// Simplify
 			map_math_simplify_pointstring(pClipped, fValue, pSimplified);
 
-			g_array_free(pClipped, TRUE);
+			map_math_clipbuffer_free(pClipBuffer);
 		}
 
 		// Draw clip rectangle
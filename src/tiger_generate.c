@@ -0,0 +1,772 @@
+/***************************************************************************
+ *            tiger_generate.c
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+Purpose of tiger_generate.c:
+ - tiger-generate: write a synthetic TIGER/Line county (TGRnnnnn.ZIP) for reproducible import and render tests
+ - A grid of streets split at every intersection (like TIGER), some of them curved with many RT2 shape points
+ - Parks (block polygons) and lakes with islands (shoreline rings) as RT7/RT8/RTi landmarks, cities as RTc places
+ - Presets go from a village to a metro area, and every knob can be set on its own
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <glib.h>
+#include <zlib.h>
+
+// Line lengths, not counting the "\r\n" (see TGR2003.PDF and the TIGER_*_LINE_LENGTH in import_tiger.c)
+#define RT1_RECORD_LENGTH		(228)
+#define RT2_RECORD_LENGTH		(208)
+#define RT7_RECORD_LENGTH		(74)
+#define RT8_RECORD_LENGTH		(36)
+#define RTc_RECORD_LENGTH		(122)
+#define RTi_RECORD_LENGTH		(127)
+#define RECORD_LENGTH_MAX		(228)
+
+#define RT2_POINTS_PER_RECORD	(10)
+
+#define METERS_PER_DEGREE_LATITUDE	(111320.0)
+
+#define DEFAULT_COUNTY			(25025)		// Suffolk, MA
+#define DEFAULT_LATITUDE		(42.30)		// south-west corner of the grid
+#define DEFAULT_LONGITUDE		(-71.10)
+
+#define MAJOR_ROAD_EVERY		(10)		// every Nth street is a major road
+#define HIGHWAY_EVERY			(40)		// every Nth street is a limited-access highway
+
+#define LAKE_SHORE_CHAINS		(6)			// chains around a lake
+#define ISLAND_SHORE_CHAINS		(3)
+
+typedef struct tigergen_preset {
+	const gchar* pszName;
+	gint nBlocks;					// streets are (nBlocks+1) x (nBlocks+1)
+	gint nCities;
+	gint nParks;
+	gint nLakes;
+} tigergen_preset_t;
+
+static tigergen_preset_t g_aPresets[] = {
+	{"village", 8, 1, 1, 1},
+	{"town", 40, 3, 8, 4},
+	{"city", 150, 8, 60, 25},
+	{"metro", 500, 30, 500, 200},
+};
+
+// options
+static gint g_nCounty = DEFAULT_COUNTY;
+static gchar* g_pszPreset = "town";
+static gint g_nBlocks = -1;
+static gint g_nCities = -1;
+static gint g_nParks = -1;
+static gint g_nLakes = -1;
+static gdouble g_fBlockMeters = 120.0;
+static gdouble g_fCurvedFraction = 0.2;
+static gint g_nCurvePoints = 24;
+static gint g_nSeed = 1;
+static gchar* g_pszOutputDir = ".";
+static gboolean g_bStored = FALSE;
+
+static GOptionEntry g_aOptions[] = {
+	{"county", 0, 0, G_OPTION_ARG_INT, &g_nCounty, "State and county FIPS code, used for the file name (default 25025)", "SSCCC"},
+	{"preset", 0, 0, G_OPTION_ARG_STRING, &g_pszPreset, "village, town, city or metro (default town)", "NAME"},
+	{"blocks", 0, 0, G_OPTION_ARG_INT, &g_nBlocks, "Blocks along each side of the street grid", "N"},
+	{"block-size", 0, 0, G_OPTION_ARG_DOUBLE, &g_fBlockMeters, "Block size in meters (default 120)", "METERS"},
+	{"curved", 0, 0, G_OPTION_ARG_DOUBLE, &g_fCurvedFraction, "Fraction of street chains that curve (default 0.2)", "F"},
+	{"curve-points", 0, 0, G_OPTION_ARG_INT, &g_nCurvePoints, "RT2 shape points per curved chain (default 24)", "N"},
+	{"cities", 0, 0, G_OPTION_ARG_INT, &g_nCities, "Cities (RTc places), as bands across the grid", "N"},
+	{"parks", 0, 0, G_OPTION_ARG_INT, &g_nParks, "Parks (one block each)", "N"},
+	{"lakes", 0, 0, G_OPTION_ARG_INT, &g_nLakes, "Lakes (each with an island)", "N"},
+	{"seed", 0, 0, G_OPTION_ARG_INT, &g_nSeed, "Random seed (default 1)", "N"},
+	{"output", 'o', 0, G_OPTION_ARG_STRING, &g_pszOutputDir, "Directory to write TGRnnnnn.ZIP to (default .)", "DIR"},
+	{"stored", 0, 0, G_OPTION_ARG_NONE, &g_bStored, "Don't compress the archive members", NULL},
+	{NULL}
+};
+
+static const gchar* g_apszStreetNames[] = {
+	"Adams", "Birch", "Cedar", "Dexter", "Elm", "Franklin", "Grove", "Hancock", "Irving", "Juniper",
+	"Kent", "Linden", "Maple", "Newbury", "Oak", "Pine", "Quincy", "Russell", "Spruce", "Tremont",
+	"Union", "Vernon", "Walnut", "Xavier", "York", "Zelda"
+};
+
+typedef struct tigergen {
+	gint nBlocks;
+	gint nCities;
+	gint nStateFIPS;
+	gint nCountyFIPS;
+
+	gdouble fLatitude;				// south-west corner
+	gdouble fLongitude;
+	gdouble fBlockLatitude;			// size of a block in degrees
+	gdouble fBlockLongitude;
+
+	GRand* pRand;
+
+	gint nNextTLID;
+	gint nNextTZID;					// grid nodes use 1..(nBlocks+1)^2
+	gint nNextPOLYID;				// grid blocks use 1..nBlocks^2
+	gint nNextLANDID;
+
+	GString* pRT1;
+	GString* pRT2;
+	GString* pRT7;
+	GString* pRT8;
+	GString* pRTc;
+	GString* pRTi;
+
+	gint nNumRT1s;
+	gint nNumRT2s;
+} tigergen_t;
+
+typedef struct tigergen_chain {
+	const gchar* pszName;			// "" for none
+	const gchar* pszType;			// FETYPE, eg. "St"
+	const gchar* pszCFCC;
+	gint nAddressStart;				// 0 for none
+	gint nCityLeft;					// index into cities, -1 for none
+	gint nCityRight;
+	gint nTZIDA;
+	gint nTZIDB;
+	gint nPOLYIDLeft;				// 0 for none
+	gint nPOLYIDRight;
+} tigergen_chain_t;
+
+//
+// Fixed-width fields
+//
+static gchar* tigergen_new_line(gchar* pLine, gint nLength, gchar chRecordType)
+{
+	memset(pLine, ' ', nLength);
+	pLine[0] = chRecordType;
+	memcpy(&pLine[2-1], "0000", 4);		// version
+	return pLine;
+}
+
+// columns are 1-based, like the TIGER documentation
+static void tigergen_put_string(gchar* pLine, gint nColumn, gint nWidth, const gchar* pszValue)
+{
+	gint nLength = MIN(strlen(pszValue), nWidth);
+	memcpy(&pLine[nColumn-1], pszValue, nLength);
+}
+
+static void tigergen_put_int(gchar* pLine, gint nColumn, gint nWidth, gint nValue)
+{
+	gchar azBuffer[32];
+	g_snprintf(azBuffer, sizeof(azBuffer), "%*d", nWidth, nValue);
+	memcpy(&pLine[nColumn-1], azBuffer, nWidth);
+}
+
+static void tigergen_put_zero_padded(gchar* pLine, gint nColumn, gint nWidth, gint nValue)
+{
+	gchar azBuffer[32];
+	g_snprintf(azBuffer, sizeof(azBuffer), "%0*d", nWidth, nValue);
+	memcpy(&pLine[nColumn-1], azBuffer, nWidth);
+}
+
+// Longitude is 10 columns and latitude 9: a sign and millionths of a degree
+static void tigergen_put_point(gchar* pLine, gint nColumn, gdouble fLongitude, gdouble fLatitude)
+{
+	gchar azBuffer[32];
+	g_snprintf(azBuffer, sizeof(azBuffer), "%+010d%+09d", (gint)floor((fLongitude * 1000000.0) + 0.5), (gint)floor((fLatitude * 1000000.0) + 0.5));
+	memcpy(&pLine[nColumn-1], azBuffer, 19);
+}
+
+static void tigergen_end_line(GString* pFile, gchar* pLine, gint nLength)
+{
+	g_string_append_len(pFile, pLine, nLength);
+	g_string_append(pFile, "\r\n");
+}
+
+//
+// Records
+//
+static gint tigergen_city_fips(gint iCity)
+{
+	return 10000 + (iCity * 15);
+}
+
+// Write an RT1, its RT2s and its RTi.  pPoints has the two end points and any shape points between them.
+static void tigergen_add_chain(tigergen_t* pGen, const tigergen_chain_t* pChain, const gdouble* afLongitudes, const gdouble* afLatitudes, gint nNumPoints)
+{
+	gchar azLine[RECORD_LENGTH_MAX];
+	gint nTLID = pGen->nNextTLID++;
+
+	// RT1: complete chain basic data
+	tigergen_new_line(azLine, RT1_RECORD_LENGTH, '1');
+	tigergen_put_int(azLine, 6, 10, nTLID);
+	tigergen_put_string(azLine, 20, 30, pChain->pszName);
+	tigergen_put_string(azLine, 50, 4, pChain->pszType);
+	tigergen_put_string(azLine, 56, 3, pChain->pszCFCC);
+	if(pChain->nAddressStart > 0) {
+		// odd numbers on the left, even on the right
+		tigergen_put_int(azLine, 59, 11, pChain->nAddressStart + 1);
+		tigergen_put_int(azLine, 70, 11, pChain->nAddressStart + 99);
+		tigergen_put_int(azLine, 81, 11, pChain->nAddressStart + 2);
+		tigergen_put_int(azLine, 92, 11, pChain->nAddressStart + 98);
+		tigergen_put_zero_padded(azLine, 107, 5, 2100 + MAX(pChain->nCityLeft, 0));
+		tigergen_put_zero_padded(azLine, 112, 5, 2100 + MAX(pChain->nCityRight, 0));
+	}
+	tigergen_put_zero_padded(azLine, 131, 2, pGen->nStateFIPS);
+	tigergen_put_zero_padded(azLine, 133, 2, pGen->nStateFIPS);
+	tigergen_put_zero_padded(azLine, 135, 3, pGen->nCountyFIPS);
+	tigergen_put_zero_padded(azLine, 138, 3, pGen->nCountyFIPS);
+	if(pChain->nCityLeft >= 0) tigergen_put_zero_padded(azLine, 161, 5, tigergen_city_fips(pChain->nCityLeft));
+	if(pChain->nCityRight >= 0) tigergen_put_zero_padded(azLine, 166, 5, tigergen_city_fips(pChain->nCityRight));
+	tigergen_put_point(azLine, 191, afLongitudes[0], afLatitudes[0]);
+	tigergen_put_point(azLine, 210, afLongitudes[nNumPoints-1], afLatitudes[nNumPoints-1]);
+	tigergen_end_line(pGen->pRT1, azLine, RT1_RECORD_LENGTH);
+	pGen->nNumRT1s++;
+
+	// RT2: shape points, ten to a record
+	gint iPoint = 1;
+	gint nSequence = 1;
+	while(iPoint < (nNumPoints-1)) {
+		tigergen_new_line(azLine, RT2_RECORD_LENGTH, '2');
+		tigergen_put_int(azLine, 6, 10, nTLID);
+		tigergen_put_int(azLine, 16, 3, nSequence++);
+
+		gint iSlot;
+		for(iSlot=0 ; iSlot<RT2_POINTS_PER_RECORD ; iSlot++) {
+			if(iPoint < (nNumPoints-1)) {
+				tigergen_put_point(azLine, 19 + (iSlot * 19), afLongitudes[iPoint], afLatitudes[iPoint]);
+				iPoint++;
+			}
+			else {
+				tigergen_put_point(azLine, 19 + (iSlot * 19), 0.0, 0.0);	// unused
+			}
+		}
+		tigergen_end_line(pGen->pRT2, azLine, RT2_RECORD_LENGTH);
+		pGen->nNumRT2s++;
+	}
+
+	// RTi: TZIDs of the ends and the polygons on each side
+	tigergen_new_line(azLine, RTi_RECORD_LENGTH, 'I');
+	tigergen_put_zero_padded(azLine, 6, 2, pGen->nStateFIPS);
+	tigergen_put_zero_padded(azLine, 8, 3, pGen->nCountyFIPS);
+	tigergen_put_int(azLine, 11, 10, nTLID);
+	tigergen_put_int(azLine, 21, 10, pChain->nTZIDA);
+	tigergen_put_int(azLine, 31, 10, pChain->nTZIDB);
+	if(pChain->nPOLYIDLeft != 0) tigergen_put_int(azLine, 46, 10, pChain->nPOLYIDLeft);
+	if(pChain->nPOLYIDRight != 0) tigergen_put_int(azLine, 61, 10, pChain->nPOLYIDRight);
+	tigergen_end_line(pGen->pRTi, azLine, RTi_RECORD_LENGTH);
+}
+
+// RT7 and RT8: a landmark and the polygon it covers
+static void tigergen_add_landmark(tigergen_t* pGen, const gchar* pszCFCC, const gchar* pszName, gint nPOLYID)
+{
+	gchar azLine[RECORD_LENGTH_MAX];
+	gint nLANDID = pGen->nNextLANDID++;
+
+	tigergen_new_line(azLine, RT7_RECORD_LENGTH, '7');
+	tigergen_put_zero_padded(azLine, 6, 2, pGen->nStateFIPS);
+	tigergen_put_zero_padded(azLine, 8, 3, pGen->nCountyFIPS);
+	tigergen_put_int(azLine, 11, 10, nLANDID);
+	tigergen_put_string(azLine, 22, 3, pszCFCC);
+	tigergen_put_string(azLine, 25, 30, pszName);
+	tigergen_end_line(pGen->pRT7, azLine, RT7_RECORD_LENGTH);
+
+	tigergen_new_line(azLine, RT8_RECORD_LENGTH, '8');
+	tigergen_put_zero_padded(azLine, 6, 2, pGen->nStateFIPS);
+	tigergen_put_zero_padded(azLine, 8, 3, pGen->nCountyFIPS);
+	tigergen_put_int(azLine, 16, 10, nPOLYID);
+	tigergen_put_int(azLine, 26, 10, nLANDID);
+	tigergen_end_line(pGen->pRT8, azLine, RT8_RECORD_LENGTH);
+}
+
+static void tigergen_add_city(tigergen_t* pGen, gint iCity)
+{
+	gchar azLine[RECORD_LENGTH_MAX];
+	gchar azName[64];
+	g_snprintf(azName, sizeof(azName), "Synthetic City %d", iCity + 1);
+
+	tigergen_new_line(azLine, RTc_RECORD_LENGTH, 'C');
+	tigergen_put_zero_padded(azLine, 6, 2, pGen->nStateFIPS);
+	tigergen_put_zero_padded(azLine, 8, 3, pGen->nCountyFIPS);
+	tigergen_put_string(azLine, 11, 4, "2000");
+	tigergen_put_zero_padded(azLine, 15, 5, tigergen_city_fips(iCity));
+	tigergen_put_string(azLine, 25, 1, "P");	// a place
+	tigergen_put_string(azLine, 63, 60, azName);
+	tigergen_end_line(pGen->pRTc, azLine, RTc_RECORD_LENGTH);
+}
+
+//
+// Street grid
+//
+static gint tigergen_node_tzid(tigergen_t* pGen, gint nX, gint nY)
+{
+	return (nY * (pGen->nBlocks + 1)) + nX + 1;
+}
+
+// blocks outside the grid have no polygon
+static gint tigergen_block_polyid(tigergen_t* pGen, gint nX, gint nY)
+{
+	if(nX < 0 || nY < 0 || nX >= pGen->nBlocks || nY >= pGen->nBlocks) return 0;
+	return (nY * pGen->nBlocks) + nX + 1;
+}
+
+static gint tigergen_city_at(tigergen_t* pGen, gint nX)
+{
+	if(nX < 0) nX = 0;
+	if(nX >= pGen->nBlocks) nX = pGen->nBlocks - 1;
+	return (nX * pGen->nCities) / pGen->nBlocks;
+}
+
+// Street n's class: highway, major road or local street
+static const gchar* tigergen_street_cfcc(gint n)
+{
+	if(n > 0 && (n % HIGHWAY_EVERY) == 0) return "A11";
+	if((n % MAJOR_ROAD_EVERY) == 0) return "A31";
+	return "A41";
+}
+
+// One block-long piece of street from (fX1,fY1) to (fX2,fY2), in block units.  Some of them bow out to one side.
+static void tigergen_add_street_chain(tigergen_t* pGen, tigergen_chain_t* pChain, gdouble fX1, gdouble fY1, gdouble fX2, gdouble fY2)
+{
+	gint nNumPoints = 2;
+	if(g_rand_double(pGen->pRand) < g_fCurvedFraction) {
+		nNumPoints += g_nCurvePoints;
+	}
+
+	gdouble* afLongitudes = g_new(gdouble, nNumPoints);
+	gdouble* afLatitudes = g_new(gdouble, nNumPoints);
+
+	// bow out by up to a fifth of a block, as a half sine wave (the ends stay on the grid)
+	gdouble fBow = (nNumPoints > 2) ? g_rand_double_range(pGen->pRand, -0.2, 0.2) : 0.0;
+	gint i;
+	for(i=0 ; i<nNumPoints ; i++) {
+		gdouble t = ((gdouble)i) / (nNumPoints - 1);
+		gdouble fOffset = fBow * sin(t * G_PI);
+		gdouble fX = fX1 + ((fX2 - fX1) * t) - ((fY2 - fY1) * fOffset);
+		gdouble fY = fY1 + ((fY2 - fY1) * t) + ((fX2 - fX1) * fOffset);
+		afLongitudes[i] = pGen->fLongitude + (fX * pGen->fBlockLongitude);
+		afLatitudes[i] = pGen->fLatitude + (fY * pGen->fBlockLatitude);
+	}
+	tigergen_add_chain(pGen, pChain, afLongitudes, afLatitudes, nNumPoints);
+
+	g_free(afLongitudes);
+	g_free(afLatitudes);
+}
+
+static void tigergen_add_streets(tigergen_t* pGen)
+{
+	gint nBlocks = pGen->nBlocks;
+	gchar azName[32];
+	gint nX, nY;
+
+	// east-west streets: 1st St, 2nd St, ...  each split at every cross street
+	for(nY=0 ; nY<=nBlocks ; nY++) {
+		gint nNumber = nY + 1;
+		const gchar* pszOrdinal = "th";
+		if((nNumber % 100) < 11 || (nNumber % 100) > 13) {
+			if((nNumber % 10) == 1) pszOrdinal = "st";
+			else if((nNumber % 10) == 2) pszOrdinal = "nd";
+			else if((nNumber % 10) == 3) pszOrdinal = "rd";
+		}
+		g_snprintf(azName, sizeof(azName), "%d%s", nNumber, pszOrdinal);
+
+		for(nX=0 ; nX<nBlocks ; nX++) {
+			tigergen_chain_t chain = {0};
+			chain.pszName = azName;
+			chain.pszType = "St";
+			chain.pszCFCC = tigergen_street_cfcc(nY);
+			chain.nAddressStart = (nX + 1) * 100;
+			chain.nCityLeft = chain.nCityRight = tigergen_city_at(pGen, nX);
+			chain.nTZIDA = tigergen_node_tzid(pGen, nX, nY);
+			chain.nTZIDB = tigergen_node_tzid(pGen, nX+1, nY);
+			chain.nPOLYIDLeft = tigergen_block_polyid(pGen, nX, nY);		// heading east, north is on the left
+			chain.nPOLYIDRight = tigergen_block_polyid(pGen, nX, nY-1);
+			tigergen_add_street_chain(pGen, &chain, nX, nY, nX+1, nY);
+		}
+	}
+
+	// north-south avenues: Adams Ave, Birch Ave, ...
+	for(nX=0 ; nX<=nBlocks ; nX++) {
+		gint nNumNames = G_N_ELEMENTS(g_apszStreetNames);
+		if(nX < nNumNames) {
+			g_snprintf(azName, sizeof(azName), "%s", g_apszStreetNames[nX]);
+		}
+		else {
+			g_snprintf(azName, sizeof(azName), "%s %d", g_apszStreetNames[nX % nNumNames], nX / nNumNames);
+		}
+
+		for(nY=0 ; nY<nBlocks ; nY++) {
+			tigergen_chain_t chain = {0};
+			chain.pszName = azName;
+			chain.pszType = "Ave";
+			chain.pszCFCC = tigergen_street_cfcc(nX);
+			chain.nAddressStart = (nY + 1) * 100;
+			chain.nCityLeft = tigergen_city_at(pGen, nX-1);
+			chain.nCityRight = tigergen_city_at(pGen, nX);
+			chain.nTZIDA = tigergen_node_tzid(pGen, nX, nY);
+			chain.nTZIDB = tigergen_node_tzid(pGen, nX, nY+1);
+			chain.nPOLYIDLeft = tigergen_block_polyid(pGen, nX-1, nY);	// heading north, west is on the left
+			chain.nPOLYIDRight = tigergen_block_polyid(pGen, nX, nY);
+			tigergen_add_street_chain(pGen, &chain, nX, nY, nX, nY+1);
+		}
+	}
+}
+
+//
+// Parks and lakes
+//
+
+// Pick a block that isn't a park or lake yet.  abTaken marks blocks already used.
+static gint tigergen_pick_block(tigergen_t* pGen, gboolean* abTaken)
+{
+	gint nNumBlocks = pGen->nBlocks * pGen->nBlocks;
+	gint iBlock = g_rand_int_range(pGen->pRand, 0, nNumBlocks);
+	gint i;
+	for(i=0 ; i<nNumBlocks ; i++) {
+		gint iTry = (iBlock + i) % nNumBlocks;
+		if(!abTaken[iTry]) {
+			abTaken[iTry] = TRUE;
+			return iTry;
+		}
+	}
+	return -1;
+}
+
+// A closed ring of shoreline chains (CFCC H01, which the importer keeps for polygons but doesn't draw), going
+// counter-clockwise around (fX,fY) so the inside is on the left.
+static void tigergen_add_shore_ring(tigergen_t* pGen, gdouble fX, gdouble fY, gdouble fRadius, gint nNumChains, gint nPOLYIDInside, gint nPOLYIDOutside)
+{
+	gint nFirstTZID = pGen->nNextTZID;
+	pGen->nNextTZID += nNumChains;
+
+	gint nPointsPerChain = MAX(g_nCurvePoints, 4) + 2;
+	gdouble* afLongitudes = g_new(gdouble, nPointsPerChain);
+	gdouble* afLatitudes = g_new(gdouble, nPointsPerChain);
+
+	gint iChain;
+	for(iChain=0 ; iChain<nNumChains ; iChain++) {
+		gint i;
+		for(i=0 ; i<nPointsPerChain ; i++) {
+			gdouble fAngle = (2.0 * G_PI * (iChain + ((gdouble)i / (nPointsPerChain - 1)))) / nNumChains;
+			// a little lumpy, but the same at the shared ends
+			gdouble fWobble = (i == 0 || i == (nPointsPerChain - 1)) ? 1.0 : (1.0 + 0.1 * sin(fAngle * 5.0));
+			afLongitudes[i] = pGen->fLongitude + ((fX + (fRadius * fWobble * cos(fAngle))) * pGen->fBlockLongitude);
+			afLatitudes[i] = pGen->fLatitude + ((fY + (fRadius * fWobble * sin(fAngle))) * pGen->fBlockLatitude);
+		}
+
+		tigergen_chain_t chain = {0};
+		chain.pszName = "";
+		chain.pszType = "";
+		chain.pszCFCC = "H01";
+		chain.nCityLeft = chain.nCityRight = -1;
+		chain.nTZIDA = nFirstTZID + iChain;
+		chain.nTZIDB = nFirstTZID + ((iChain + 1) % nNumChains);
+		chain.nPOLYIDLeft = nPOLYIDInside;
+		chain.nPOLYIDRight = nPOLYIDOutside;
+		tigergen_add_chain(pGen, &chain, afLongitudes, afLatitudes, nPointsPerChain);
+	}
+	g_free(afLongitudes);
+	g_free(afLatitudes);
+}
+
+static void tigergen_add_landmarks(tigergen_t* pGen, gint nParks, gint nLakes)
+{
+	gboolean* abTaken = g_new0(gboolean, pGen->nBlocks * pGen->nBlocks);
+	gchar azName[32];
+	gint i;
+
+	// a park is a whole block, bounded by its four streets
+	for(i=0 ; i<nParks ; i++) {
+		gint iBlock = tigergen_pick_block(pGen, abTaken);
+		if(iBlock == -1) break;
+
+		g_snprintf(azName, sizeof(azName), "Park %d", i + 1);
+		tigergen_add_landmark(pGen, "D85", azName, iBlock + 1);
+	}
+
+	// a lake sits inside a block and has an island in it, so its polygon has two rings
+	for(i=0 ; i<nLakes ; i++) {
+		gint iBlock = tigergen_pick_block(pGen, abTaken);
+		if(iBlock == -1) break;
+
+		gdouble fX = (iBlock % pGen->nBlocks) + 0.5;
+		gdouble fY = (iBlock / pGen->nBlocks) + 0.5;
+
+		gint nLakePOLYID = pGen->nNextPOLYID++;
+		gint nIslandPOLYID = pGen->nNextPOLYID++;
+		tigergen_add_shore_ring(pGen, fX, fY, 0.35, LAKE_SHORE_CHAINS, nLakePOLYID, iBlock + 1);
+		tigergen_add_shore_ring(pGen, fX + 0.05, fY, 0.1, ISLAND_SHORE_CHAINS, nIslandPOLYID, nLakePOLYID);
+
+		g_snprintf(azName, sizeof(azName), "Lake %d", i + 1);
+		tigergen_add_landmark(pGen, "H31", azName, nLakePOLYID);
+	}
+	g_free(abTaken);
+}
+
+//
+// ZIP writing (just enough for zipreader.c: no zip64, no data descriptors)
+//
+typedef struct tigergen_zip_entry {
+	gchar* pszName;
+	guint32 nCRC32;
+	guint32 nCompressedSize;
+	guint32 nUncompressedSize;
+	guint32 nOffset;
+	guint16 nMethod;
+} tigergen_zip_entry_t;
+
+static void tigergen_put_le16(GString* pOut, guint16 n)
+{
+	g_string_append_c(pOut, n & 0xFF);
+	g_string_append_c(pOut, (n >> 8) & 0xFF);
+}
+
+static void tigergen_put_le32(GString* pOut, guint32 n)
+{
+	tigergen_put_le16(pOut, n & 0xFFFF);
+	tigergen_put_le16(pOut, (n >> 16) & 0xFFFF);
+}
+
+static gboolean tigergen_write_member(FILE* pFile, GArray* pEntriesArray, guint32* pnOffset, const gchar* pszName, GString* pContent)
+{
+	tigergen_zip_entry_t entry = {0};
+	entry.pszName = g_strdup(pszName);
+	entry.nCRC32 = crc32(crc32(0L, Z_NULL, 0), (const Bytef*)pContent->str, pContent->len);
+	entry.nUncompressedSize = pContent->len;
+	entry.nOffset = *pnOffset;
+
+	guchar* pData = (guchar*)pContent->str;
+	gsize nDataLength = pContent->len;
+	guchar* pCompressed = NULL;
+
+	if(g_bStored) {
+		entry.nMethod = 0;
+	}
+	else {
+		// raw deflate (no zlib header), as ZIP wants it
+		z_stream zstream = {0};
+		if(deflateInit2(&zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+			return FALSE;
+		}
+		gsize nBound = deflateBound(&zstream, pContent->len);
+		pCompressed = g_malloc(nBound);
+		zstream.next_in = (Bytef*)pContent->str;
+		zstream.avail_in = pContent->len;
+		zstream.next_out = pCompressed;
+		zstream.avail_out = nBound;
+		gint nResult = deflate(&zstream, Z_FINISH);
+		deflateEnd(&zstream);
+		if(nResult != Z_STREAM_END) {
+			g_free(pCompressed);
+			return FALSE;
+		}
+		entry.nMethod = 8;
+		pData = pCompressed;
+		nDataLength = zstream.total_out;
+	}
+	entry.nCompressedSize = nDataLength;
+
+	// local file header
+	GString* pHeader = g_string_new(NULL);
+	tigergen_put_le32(pHeader, 0x04034b50);
+	tigergen_put_le16(pHeader, 20);					// version needed
+	tigergen_put_le16(pHeader, 0);					// flags
+	tigergen_put_le16(pHeader, entry.nMethod);
+	tigergen_put_le16(pHeader, 0);					// time
+	tigergen_put_le16(pHeader, 0x21);				// date (1980-01-01)
+	tigergen_put_le32(pHeader, entry.nCRC32);
+	tigergen_put_le32(pHeader, entry.nCompressedSize);
+	tigergen_put_le32(pHeader, entry.nUncompressedSize);
+	tigergen_put_le16(pHeader, strlen(pszName));
+	tigergen_put_le16(pHeader, 0);					// extra length
+	g_string_append(pHeader, pszName);
+
+	gboolean bSuccess = (fwrite(pHeader->str, 1, pHeader->len, pFile) == pHeader->len &&
+						 fwrite(pData, 1, nDataLength, pFile) == nDataLength);
+	*pnOffset += pHeader->len + nDataLength;
+
+	g_string_free(pHeader, TRUE);
+	g_free(pCompressed);
+
+	g_array_append_val(pEntriesArray, entry);
+	return bSuccess;
+}
+
+static gboolean tigergen_write_central_directory(FILE* pFile, GArray* pEntriesArray, guint32 nOffset)
+{
+	GString* pOut = g_string_new(NULL);
+	gint i;
+	for(i=0 ; i<pEntriesArray->len ; i++) {
+		tigergen_zip_entry_t* pEntry = &g_array_index(pEntriesArray, tigergen_zip_entry_t, i);
+		tigergen_put_le32(pOut, 0x02014b50);
+		tigergen_put_le16(pOut, 20);				// version made by
+		tigergen_put_le16(pOut, 20);				// version needed
+		tigergen_put_le16(pOut, 0);					// flags
+		tigergen_put_le16(pOut, pEntry->nMethod);
+		tigergen_put_le16(pOut, 0);					// time
+		tigergen_put_le16(pOut, 0x21);				// date
+		tigergen_put_le32(pOut, pEntry->nCRC32);
+		tigergen_put_le32(pOut, pEntry->nCompressedSize);
+		tigergen_put_le32(pOut, pEntry->nUncompressedSize);
+		tigergen_put_le16(pOut, strlen(pEntry->pszName));
+		tigergen_put_le16(pOut, 0);					// extra length
+		tigergen_put_le16(pOut, 0);					// comment length
+		tigergen_put_le16(pOut, 0);					// disk number
+		tigergen_put_le16(pOut, 0);					// internal attributes
+		tigergen_put_le32(pOut, 0);					// external attributes
+		tigergen_put_le32(pOut, pEntry->nOffset);
+		g_string_append(pOut, pEntry->pszName);
+	}
+	guint32 nDirectoryLength = pOut->len;
+
+	// end of central directory
+	tigergen_put_le32(pOut, 0x06054b50);
+	tigergen_put_le16(pOut, 0);
+	tigergen_put_le16(pOut, 0);
+	tigergen_put_le16(pOut, pEntriesArray->len);
+	tigergen_put_le16(pOut, pEntriesArray->len);
+	tigergen_put_le32(pOut, nDirectoryLength);
+	tigergen_put_le32(pOut, nOffset);
+	tigergen_put_le16(pOut, 0);						// comment length
+
+	gboolean bSuccess = (fwrite(pOut->str, 1, pOut->len, pFile) == pOut->len);
+	g_string_free(pOut, TRUE);
+	return bSuccess;
+}
+
+static gboolean tigergen_write_zip(tigergen_t* pGen, const gchar* pszPath, const gchar* pszTitle)
+{
+	FILE* pFile = fopen(pszPath, "wb");
+	if(pFile == NULL) return FALSE;
+
+	GString* pMET = g_string_new(NULL);
+	g_string_append_printf(pMET, "Title: %s\n", pszTitle);
+
+	struct {
+		const gchar* pszExtension;
+		GString* pContent;
+	} aMembers[] = {
+		{"MET", pMET}, {"RT1", pGen->pRT1}, {"RT2", pGen->pRT2}, {"RT7", pGen->pRT7},
+		{"RT8", pGen->pRT8}, {"RTC", pGen->pRTc}, {"RTI", pGen->pRTi},
+	};
+
+	GArray* pEntriesArray = g_array_new(FALSE, FALSE, sizeof(tigergen_zip_entry_t));
+	guint32 nOffset = 0;
+	gboolean bSuccess = TRUE;
+	gint i;
+	for(i=0 ; i<G_N_ELEMENTS(aMembers) && bSuccess ; i++) {
+		gchar* pszName = g_strdup_printf("TGR%02d%03d.%s", pGen->nStateFIPS, pGen->nCountyFIPS, aMembers[i].pszExtension);
+		bSuccess = tigergen_write_member(pFile, pEntriesArray, &nOffset, pszName, aMembers[i].pContent);
+		g_free(pszName);
+	}
+	if(bSuccess) {
+		bSuccess = tigergen_write_central_directory(pFile, pEntriesArray, nOffset);
+	}
+	if(fclose(pFile) != 0) bSuccess = FALSE;
+
+	for(i=0 ; i<pEntriesArray->len ; i++) {
+		g_free(g_array_index(pEntriesArray, tigergen_zip_entry_t, i).pszName);
+	}
+	g_array_free(pEntriesArray, TRUE);
+	g_string_free(pMET, TRUE);
+	return bSuccess;
+}
+
+int main(int argc, char* argv[])
+{
+	GOptionContext* pContext = g_option_context_new("- write a synthetic TIGER/Line county");
+	g_option_context_add_main_entries(pContext, g_aOptions, NULL);
+	GError* pError = NULL;
+	if(!g_option_context_parse(pContext, &argc, &argv, &pError)) {
+		fprintf(stderr, "%s: %s\n", g_get_prgname(), pError->message);
+		g_error_free(pError);
+		return 2;
+	}
+	g_option_context_free(pContext);
+
+	// start from the preset and override with whatever was given
+	tigergen_preset_t* pPreset = NULL;
+	gint i;
+	for(i=0 ; i<G_N_ELEMENTS(g_aPresets) ; i++) {
+		if(g_ascii_strcasecmp(g_pszPreset, g_aPresets[i].pszName) == 0) pPreset = &g_aPresets[i];
+	}
+	if(pPreset == NULL) {
+		fprintf(stderr, "%s: unknown preset '%s' (try village, town, city or metro)\n", g_get_prgname(), g_pszPreset);
+		return 2;
+	}
+	if(g_nBlocks < 0) g_nBlocks = pPreset->nBlocks;
+	if(g_nCities < 0) g_nCities = pPreset->nCities;
+	if(g_nParks < 0) g_nParks = pPreset->nParks;
+	if(g_nLakes < 0) g_nLakes = pPreset->nLakes;
+
+	if(g_nBlocks < 1 || g_nCities < 1 || g_nCurvePoints < 0 || g_nCounty < 1000 || g_nCounty > 99999) {
+		fprintf(stderr, "%s: --blocks and --cities must be at least 1 and --county a 5 digit FIPS code\n", g_get_prgname());
+		return 2;
+	}
+
+	tigergen_t gen = {0};
+	gen.nBlocks = g_nBlocks;
+	gen.nCities = MIN(g_nCities, g_nBlocks);
+	gen.nStateFIPS = g_nCounty / 1000;
+	gen.nCountyFIPS = g_nCounty % 1000;
+	gen.fLatitude = DEFAULT_LATITUDE;
+	gen.fLongitude = DEFAULT_LONGITUDE;
+	gen.fBlockLatitude = g_fBlockMeters / METERS_PER_DEGREE_LATITUDE;
+	gen.fBlockLongitude = g_fBlockMeters / (METERS_PER_DEGREE_LATITUDE * cos(DEFAULT_LATITUDE * G_PI / 180.0));
+	gen.pRand = g_rand_new_with_seed(g_nSeed);
+	gen.nNextTLID = 1;
+	gen.nNextTZID = ((g_nBlocks + 1) * (g_nBlocks + 1)) + 1;
+	gen.nNextPOLYID = (g_nBlocks * g_nBlocks) + 1;
+	gen.nNextLANDID = 1;
+	gen.pRT1 = g_string_new(NULL);
+	gen.pRT2 = g_string_new(NULL);
+	gen.pRT7 = g_string_new(NULL);
+	gen.pRT8 = g_string_new(NULL);
+	gen.pRTc = g_string_new(NULL);
+	gen.pRTi = g_string_new(NULL);
+
+	for(i=0 ; i<gen.nCities ; i++) {
+		tigergen_add_city(&gen, i);
+	}
+	tigergen_add_streets(&gen);
+	tigergen_add_landmarks(&gen, g_nParks, g_nLakes);
+
+	gchar* pszTitle = g_strdup_printf("Synthetic county %05d (%s, %dx%d blocks of %.0fm, seed %d)", g_nCounty, pPreset->pszName, g_nBlocks, g_nBlocks, g_fBlockMeters, g_nSeed);
+	gchar* pszFileName = g_strdup_printf("TGR%05d.ZIP", g_nCounty);
+	gchar* pszPath = g_build_filename(g_pszOutputDir, pszFileName, NULL);
+
+	gboolean bSuccess = tigergen_write_zip(&gen, pszPath, pszTitle);
+	if(bSuccess) {
+		fprintf(stdout, "%s: %d RT1, %d RT2, %d cities, %d parks, %d lakes\n", pszPath, gen.nNumRT1s, gen.nNumRT2s, gen.nCities, g_nParks, g_nLakes);
+	}
+	else {
+		fprintf(stderr, "%s: couldn't write %s\n", g_get_prgname(), pszPath);
+	}
+
+	g_free(pszPath);
+	g_free(pszFileName);
+	g_free(pszTitle);
+	g_string_free(gen.pRT1, TRUE);
+	g_string_free(gen.pRT2, TRUE);
+	g_string_free(gen.pRT7, TRUE);
+	g_string_free(gen.pRT8, TRUE);
+	g_string_free(gen.pRTc, TRUE);
+	g_string_free(gen.pRTi, TRUE);
+	g_rand_free(gen.pRand);
+
+	return bSuccess ? 0 : 1;
+}
@@ -0,0 +1,295 @@
+/***************************************************************************
+ *            zipreader.c
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+Purpose of zipreader.c:
+ - Read members straight out of a ZIP archive held in memory, without temp files or an unzip process
+ - Members are decompressed a piece at a time (zipstream_read), so a big one never has to be in memory whole
+ - Only what TIGER archives use: stored and deflated members, no ZIP64, no encryption
+*/
+
+#include <string.h>
+#include <glib.h>
+#include <zlib.h>
+
+#include "zipreader.h"
+
+#define ZIP_SIGNATURE_LOCAL_HEADER		(0x04034b50)
+#define ZIP_SIGNATURE_CENTRAL_HEADER	(0x02014b50)
+#define ZIP_SIGNATURE_END_OF_DIRECTORY	(0x06054b50)
+
+#define ZIP_LOCAL_HEADER_LENGTH			(30)
+#define ZIP_CENTRAL_HEADER_LENGTH		(46)
+#define ZIP_END_OF_DIRECTORY_LENGTH		(22)
+#define ZIP_MAX_COMMENT_LENGTH			(65535)
+
+#define ZIP_METHOD_STORED				(0)
+#define ZIP_METHOD_DEFLATED				(8)
+
+#define ZIP_FLAG_ENCRYPTED				(1)
+
+// all ZIP fields are little-endian
+static guint16 zip_read_u16(const guchar* p)
+{
+	return (guint16)(p[0] | (p[1] << 8));
+}
+
+static guint32 zip_read_u32(const guchar* p)
+{
+	return ((guint32)p[0]) | ((guint32)p[1] << 8) | ((guint32)p[2] << 16) | ((guint32)p[3] << 24);
+}
+
+// The end-of-central-directory record is at the very end, unless there's an archive comment after it
+static const guchar* zipreader_find_end_of_directory(const guchar* pData, gsize nLength)
+{
+	if(nLength < ZIP_END_OF_DIRECTORY_LENGTH) return NULL;
+
+	gsize nLowest = (nLength > (ZIP_END_OF_DIRECTORY_LENGTH + ZIP_MAX_COMMENT_LENGTH)) ? (nLength - ZIP_END_OF_DIRECTORY_LENGTH - ZIP_MAX_COMMENT_LENGTH) : 0;
+	gsize i = nLength - ZIP_END_OF_DIRECTORY_LENGTH;
+	while(TRUE) {
+		if(zip_read_u32(&pData[i]) == ZIP_SIGNATURE_END_OF_DIRECTORY) return &pData[i];
+		if(i == nLowest) break;
+		i--;
+	}
+	return NULL;
+}
+
+// Returns NULL if pBuffer doesn't hold a ZIP archive we can read.  pBuffer must outlive the reader.
+zipreader_t* zipreader_new(const gchar* pBuffer, gsize nLength)
+{
+	g_assert(pBuffer != NULL);
+
+	const guchar* pData = (const guchar*)pBuffer;
+	const guchar* pEnd = zipreader_find_end_of_directory(pData, nLength);
+	if(pEnd == NULL) {
+		g_warning("zipreader_new: no end of central directory (not a ZIP file?)\n");
+		return NULL;
+	}
+
+	gint nEntries = zip_read_u16(&pEnd[10]);
+	gsize nDirectoryLength = zip_read_u32(&pEnd[12]);
+	gsize nDirectoryOffset = zip_read_u32(&pEnd[16]);
+	if(nDirectoryOffset + nDirectoryLength > nLength) {
+		g_warning("zipreader_new: central directory is out of bounds\n");
+		return NULL;
+	}
+
+	zipreader_t* pNew = g_new0(zipreader_t, 1);
+	pNew->pData = pData;
+	pNew->nLength = nLength;
+	pNew->pEntriesArray = g_array_sized_new(FALSE, FALSE, sizeof(zipentry_t), nEntries);
+
+	const guchar* p = &pData[nDirectoryOffset];
+	const guchar* pDirectoryEnd = p + nDirectoryLength;
+	gint i;
+	for(i=0 ; i<nEntries ; i++) {
+		if(p + ZIP_CENTRAL_HEADER_LENGTH > pDirectoryEnd || zip_read_u32(p) != ZIP_SIGNATURE_CENTRAL_HEADER) {
+			g_warning("zipreader_new: bad central directory entry %d\n", i);
+			zipreader_free(pNew);
+			return NULL;
+		}
+
+		gint nNameLength = zip_read_u16(&p[28]);
+		gint nExtraLength = zip_read_u16(&p[30]);
+		gint nCommentLength = zip_read_u16(&p[32]);
+		if(p + ZIP_CENTRAL_HEADER_LENGTH + nNameLength > pDirectoryEnd) {
+			g_warning("zipreader_new: bad central directory entry %d\n", i);
+			zipreader_free(pNew);
+			return NULL;
+		}
+
+		zipentry_t entry;
+		entry.pszName = g_strndup((const gchar*)&p[ZIP_CENTRAL_HEADER_LENGTH], nNameLength);
+		entry.nMethod = zip_read_u16(&p[10]);
+		entry.nCRC32 = zip_read_u32(&p[16]);
+		entry.nCompressedSize = zip_read_u32(&p[20]);
+		entry.nUncompressedSize = zip_read_u32(&p[24]);
+		entry.nLocalHeaderOffset = zip_read_u32(&p[42]);
+
+		if(zip_read_u16(&p[8]) & ZIP_FLAG_ENCRYPTED) {
+			entry.nMethod = -1;	// can't read it, but keep it listed
+		}
+		g_array_append_val(pNew->pEntriesArray, entry);
+
+		p += (ZIP_CENTRAL_HEADER_LENGTH + nNameLength + nExtraLength + nCommentLength);
+	}
+	return pNew;
+}
+
+void zipreader_free(zipreader_t* pZip)
+{
+	g_assert(pZip != NULL);
+
+	gint i;
+	for(i=0 ; i<pZip->pEntriesArray->len ; i++) {
+		g_free(g_array_index(pZip->pEntriesArray, zipentry_t, i).pszName);
+	}
+	g_array_free(pZip->pEntriesArray, TRUE);
+	g_free(pZip);
+}
+
+// Find a member by file name, ignoring any directory and case
+const zipentry_t* zipreader_find_entry(zipreader_t* pZip, const gchar* pszBaseName)
+{
+	g_assert(pZip != NULL);
+	g_assert(pszBaseName != NULL);
+
+	gint i;
+	for(i=0 ; i<pZip->pEntriesArray->len ; i++) {
+		zipentry_t* pEntry = &g_array_index(pZip->pEntriesArray, zipentry_t, i);
+
+		const gchar* pszEntryBaseName = strrchr(pEntry->pszName, '/');
+		pszEntryBaseName = (pszEntryBaseName != NULL) ? (pszEntryBaseName + 1) : pEntry->pszName;
+
+		if(g_ascii_strcasecmp(pszEntryBaseName, pszBaseName) == 0) return pEntry;
+	}
+	return NULL;
+}
+
+zipstream_t* zipreader_open_entry(zipreader_t* pZip, const zipentry_t* pEntry)
+{
+	g_assert(pZip != NULL);
+	g_assert(pEntry != NULL);
+
+	if(pEntry->nMethod != ZIP_METHOD_STORED && pEntry->nMethod != ZIP_METHOD_DEFLATED) {
+		g_warning("zipreader_open_entry: %s uses unsupported method %d\n", pEntry->pszName, pEntry->nMethod);
+		return NULL;
+	}
+
+	// the data follows the local header, whose name and extra field lengths can differ from the central directory's
+	gsize nOffset = pEntry->nLocalHeaderOffset;
+	if(nOffset + ZIP_LOCAL_HEADER_LENGTH > pZip->nLength || zip_read_u32(&pZip->pData[nOffset]) != ZIP_SIGNATURE_LOCAL_HEADER) {
+		g_warning("zipreader_open_entry: bad local header for %s\n", pEntry->pszName);
+		return NULL;
+	}
+	nOffset += ZIP_LOCAL_HEADER_LENGTH + zip_read_u16(&pZip->pData[nOffset + 26]) + zip_read_u16(&pZip->pData[nOffset + 28]);
+	if(nOffset + pEntry->nCompressedSize > pZip->nLength) {
+		g_warning("zipreader_open_entry: %s is truncated\n", pEntry->pszName);
+		return NULL;
+	}
+
+	zipstream_t* pNew = g_new0(zipstream_t, 1);
+	pNew->pEntry = pEntry;
+	pNew->pCompressed = &pZip->pData[nOffset];
+	pNew->nCompressedRemaining = pEntry->nCompressedSize;
+	pNew->nCRC32 = crc32(0L, Z_NULL, 0);
+
+	if(pEntry->nMethod == ZIP_METHOD_DEFLATED) {
+		// the whole compressed member is already in memory, so give it all to zlib up front
+		pNew->zstream.next_in = (Bytef*)pNew->pCompressed;
+		pNew->zstream.avail_in = pEntry->nCompressedSize;
+
+		// negative window bits = raw deflate data, no zlib header
+		if(inflateInit2(&pNew->zstream, -MAX_WBITS) != Z_OK) {
+			g_warning("zipreader_open_entry: inflateInit2 failed\n");
+			g_free(pNew);
+			return NULL;
+		}
+		pNew->bInflateInitialized = TRUE;
+	}
+	return pNew;
+}
+
+// Read up to nMaxLength bytes.  Only returns less at the end of the member.  Returns 0 at the end and -1 on error.
+gint zipstream_read(zipstream_t* pStream, gchar* pBuffer, gint nMaxLength)
+{
+	g_assert(pStream != NULL);
+	g_assert(pBuffer != NULL);
+
+	if(pStream->bError) return -1;
+
+	gint nRead = 0;
+	if(pStream->pEntry->nMethod == ZIP_METHOD_STORED) {
+		nRead = MIN((gsize)nMaxLength, pStream->nCompressedRemaining);
+		memcpy(pBuffer, pStream->pCompressed, nRead);
+		pStream->pCompressed += nRead;
+		pStream->nCompressedRemaining -= nRead;
+	}
+	else {
+		pStream->zstream.next_out = (Bytef*)pBuffer;
+		pStream->zstream.avail_out = nMaxLength;
+
+		while(pStream->zstream.avail_out > 0) {
+			gint nResult = inflate(&pStream->zstream, Z_SYNC_FLUSH);
+			if(nResult == Z_STREAM_END) break;
+			if(nResult != Z_OK) {
+				// includes Z_BUF_ERROR: all the input is there, so no progress means it's corrupt or truncated
+				g_warning("zipstream_read: inflate failed on %s (%d)\n", pStream->pEntry->pszName, nResult);
+				pStream->bError = TRUE;
+				return -1;
+			}
+		}
+		nRead = nMaxLength - pStream->zstream.avail_out;
+	}
+
+	pStream->nCRC32 = crc32(pStream->nCRC32, (const Bytef*)pBuffer, nRead);
+	pStream->nUncompressedRead += nRead;
+
+	// verify at the end
+	if(nRead < nMaxLength) {
+		if(pStream->nUncompressedRead != pStream->pEntry->nUncompressedSize || pStream->nCRC32 != pStream->pEntry->nCRC32) {
+			g_warning("zipstream_read: %s failed CRC or size check\n", pStream->pEntry->pszName);
+			pStream->bError = TRUE;
+			return -1;
+		}
+	}
+	return nRead;
+}
+
+// Returns FALSE if there was an error reading the member
+gboolean zipstream_close(zipstream_t* pStream)
+{
+	g_assert(pStream != NULL);
+
+	gboolean bSuccess = !pStream->bError;
+	if(pStream->bInflateInitialized) {
+		inflateEnd(&pStream->zstream);
+	}
+	g_free(pStream);
+	return bSuccess;
+}
+
+// For small members.  The returned buffer is zero-terminated (not counted in the length) and must be g_free()d.
+gboolean zipreader_read_entire_entry(zipreader_t* pZip, const zipentry_t* pEntry, gchar** ppReturnBuffer, gint* pnReturnLength)
+{
+	g_assert(ppReturnBuffer != NULL);
+	g_assert(pnReturnLength != NULL);
+
+	zipstream_t* pStream = zipreader_open_entry(pZip, pEntry);
+	if(pStream == NULL) return FALSE;
+
+	gint nLength = pEntry->nUncompressedSize;
+	gchar* pBuffer = g_malloc(nLength + 1);
+
+	// ask for one more byte than expected, so the read also reaches (and verifies) the end
+	gint nRead = zipstream_read(pStream, pBuffer, nLength + 1);
+	if(!zipstream_close(pStream) || nRead != nLength) {
+		g_free(pBuffer);
+		return FALSE;
+	}
+	pBuffer[nLength] = '\0';
+
+	*ppReturnBuffer = pBuffer;
+	*pnReturnLength = nLength;
+	return TRUE;
+}
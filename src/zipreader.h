@@ -0,0 +1,70 @@
+/***************************************************************************
+ *            zipreader.h
+ *
+ *  Copyright  2005  Ian McIntosh
+ *  ian_mcintosh@linuxadvocate.org
+ ****************************************************************************/
+
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _ZIPREADER_H_
+#define _ZIPREADER_H_
+
+#include <glib.h>
+#include <zlib.h>
+
+typedef struct zipentry {
+	gchar* pszName;				// as stored, may include a directory
+	gint nMethod;				// ZIP_METHOD_*
+	guint32 nCRC32;
+	gsize nCompressedSize;
+	gsize nUncompressedSize;
+	gsize nLocalHeaderOffset;
+} zipentry_t;
+
+typedef struct zipreader {
+	const guchar* pData;		// the whole archive, not owned
+	gsize nLength;
+
+	GArray* pEntriesArray;		// zipentry_t, from the central directory
+} zipreader_t;
+
+// An open member being decompressed a piece at a time
+typedef struct zipstream {
+	const zipentry_t* pEntry;
+	const guchar* pCompressed;	// points into the archive
+	gsize nCompressedRemaining;
+	gsize nUncompressedRead;
+
+	z_stream zstream;
+	gboolean bInflateInitialized;
+	guint32 nCRC32;
+	gboolean bError;
+} zipstream_t;
+
+zipreader_t* zipreader_new(const gchar* pBuffer, gsize nLength);
+void zipreader_free(zipreader_t* pZip);
+
+const zipentry_t* zipreader_find_entry(zipreader_t* pZip, const gchar* pszBaseName);
+
+zipstream_t* zipreader_open_entry(zipreader_t* pZip, const zipentry_t* pEntry);
+gint zipstream_read(zipstream_t* pStream, gchar* pBuffer, gint nMaxLength);
+gboolean zipstream_close(zipstream_t* pStream);
+
+gboolean zipreader_read_entire_entry(zipreader_t* pZip, const zipentry_t* pEntry, gchar** ppReturnBuffer, gint* pnReturnLength);
+
+#endif